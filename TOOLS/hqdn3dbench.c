@@ -0,0 +1,139 @@
+/*
+ * benchmark for the hqdn3d row kernels
+ *
+ * Runs the vertical+temporal and the temporal only kernel of every
+ * implementation the CPU supports over the same frames, checks that the
+ * output matches the C version exactly and prints the time per pixel.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "config.h"
+#include "cpudetect.h"
+#include "libmpcodecs/hqdn3d.h"
+
+#define W 1920
+#define H 1080
+#define FRAMES 10
+
+static int Coefs[2][512*16];
+static unsigned char  src[FRAMES][W*H];
+static unsigned int   horiz[W*H];
+static unsigned char  dst[2][W*H];
+static unsigned short ant[2][W*H];
+static unsigned int   line[2][W];
+
+// same as in vf_hqdn3d.c
+static void PrecalcCoefs(int *Ct, double Dist25)
+{
+    int i;
+    double Gamma, Simil, C;
+
+    Gamma = log(0.25) / log(1.0 - Dist25/255.0 - 0.00001);
+
+    for (i = -255*16; i <= 255*16; i++) {
+        Simil = 1.0 - abs(i) / (16*255.0);
+        C = pow(Simil, Gamma) * 65536.0 * (double)i / 16.0;
+        Ct[16*256+i] = (C<0) ? (C-0.5) : (C+0.5);
+    }
+
+    Ct[0] = (Dist25 != 0);
+}
+
+// Returns current time in microseconds
+static unsigned int GetTimer(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void reset(int k)
+{
+    int i;
+    for (i = 0; i < W*H; i++)
+        ant[k][i] = src[0][i] << 8;
+}
+
+/// run both kernels over all frames into dst[k], return microseconds
+static unsigned int run(const struct hqdn3d_dsp *dsp, int k, int temporal_only)
+{
+    int f, y;
+    unsigned int t;
+
+    reset(k);
+    t = GetTimer();
+    for (f = 0; f < FRAMES; f++) {
+        if (temporal_only) {
+            for (y = 0; y < H; y++)
+                dsp->temporal(src[f] + y*W, ant[k] + y*W, dst[k] + y*W, W,
+                              Coefs[1]);
+            continue;
+        }
+        memcpy(line[k], horiz, sizeof(line[k]));
+        for (y = 1; y < H; y++)
+            dsp->vertical(line[k], horiz + y*W, ant[k] + y*W, dst[k] + y*W,
+                          W, Coefs[0], Coefs[1]);
+    }
+    return GetTimer() - t;
+}
+
+static void bench(const char *name, unsigned int cpu)
+{
+    struct hqdn3d_dsp ref, dsp;
+    int mode;
+
+    hqdn3d_init_dsp(&ref, 0);
+    hqdn3d_init_dsp(&dsp, cpu);
+    for (mode = 0; mode < 2; mode++) {
+        unsigned int t = run(&dsp, 1, mode);
+        run(&ref, 0, mode);
+        printf("%s %-16s %6.3f ns/pixel %s\n", name,
+               mode ? "temporal:" : "vertical+temporal:",
+               t * 1000.0 / ((double)W * H * FRAMES),
+               memcmp(dst[0], dst[1], sizeof(dst[0])) ||
+               memcmp(ant[0], ant[1], sizeof(ant[0])) ? "MISMATCH" : "");
+    }
+}
+
+int main(void)
+{
+    int f, i;
+
+    GetCpuCaps(&gCpuCaps);
+    PrecalcCoefs(Coefs[0], 4.0);
+    PrecalcCoefs(Coefs[1], 6.0);
+    srand(1);
+    for (i = 0; i < W*H; i++) {
+        src[0][i] = (i % W + i / W) / 12 + rand() % 16;
+        horiz[i]  = src[0][i] << 16 | (rand() & 0xFFFF);
+    }
+    for (f = 1; f < FRAMES; f++)
+        for (i = 0; i < W*H; i++)
+            src[f][i] = src[f-1][i] + rand() % 7 - 3;
+
+    bench("C:   ", 0);
+    if (gCpuCaps.hasSSE2)
+        bench("SSE2:", HQDN3D_CPU_SSE2);
+    if (gCpuCaps.hasAVX2)
+        bench("AVX2:", HQDN3D_CPU_AVX2);
+    return 0;
+}
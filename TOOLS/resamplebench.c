@@ -0,0 +1,132 @@
+/*
+ * benchmark for the polyphase FIR kernels of the resample audio filter
+ *
+ * Steps through a 160 phase filter bank the way af_resample does for
+ * 44.1 kHz to 48 kHz, for stereo and 5.1 s16 and float audio, with
+ * every implementation the CPU supports. Checks the s16 output against
+ * the C version, prints the largest difference of the float output and
+ * the time per output sample.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "config.h"
+#include "cpudetect.h"
+#include "libaf/af_dsp.h"
+
+#define L       16
+#define UP      160
+#define DN      147
+#define MAXCH   6
+#define OUTPUTS 480000
+
+static int16_t ws[UP*L];
+static float   wf[UP*L];
+static int16_t xs[MAXCH*2*L*DN];
+static float   xf[MAXCH*2*L*DN];
+static int16_t outs[2][OUTPUTS*MAXCH];
+static float   outf[2][OUTPUTS*MAXCH];
+
+// Returns current time in microseconds
+static unsigned int GetTimer(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* The queues only change between outputs in the filter, here every
+   output reads one of DN windows of random samples instead. */
+static unsigned int run(const struct af_dsp *dsp, int k, int nch, int flt)
+{
+    unsigned int t = GetTimer();
+    int n, wi = 0;
+
+    for (n = 0; n < OUTPUTS; n++) {
+        int q = n % DN;
+        if (flt)
+            dsp->fir16_float(outf[k] + n*nch, xf + q*MAXCH*2*L, 2*L,
+                             wf + wi*L, nch);
+        else
+            dsp->fir16_s16(outs[k] + n*nch, xs + q*MAXCH*2*L, 2*L,
+                           ws + wi*L, nch);
+        if (++wi == UP)
+            wi = 0;
+    }
+    return GetTimer() - t;
+}
+
+static void bench(const char *name, unsigned int cpu)
+{
+    static const int channels[2] = { 2, 6 };
+    struct af_dsp ref, dsp;
+    int c, flt, i;
+
+    af_dsp_init(&ref, 0);
+    af_dsp_init(&dsp, cpu);
+    for (flt = 0; flt < 2; flt++)
+        for (c = 0; c < 2; c++) {
+            int nch = channels[c];
+            unsigned int t = run(&dsp, 1, nch, flt);
+            run(&ref, 0, nch, flt);
+            if (flt) {
+                float d = 0;
+                for (i = 0; i < OUTPUTS*nch; i++)
+                    d = fmaxf(d, fabsf(outf[0][i] - outf[1][i]));
+                printf("%s float %d ch: %6.3f ns/sample, max diff %g\n", name,
+                       nch, t * 1000.0 / ((double)OUTPUTS * nch), d);
+            } else {
+                printf("%s s16   %d ch: %6.3f ns/sample %s\n", name,
+                       nch, t * 1000.0 / ((double)OUTPUTS * nch),
+                       memcmp(outs[0], outs[1], OUTPUTS*nch*2) ?
+                       "MISMATCH" : "");
+            }
+        }
+}
+
+int main(void)
+{
+    int i;
+
+    GetCpuCaps(&gCpuCaps);
+    srand(1);
+    // windowed sinc, each phase sums to about 1
+    for (i = 0; i < UP*L; i++) {
+        int p = i / L, t = i % L;
+        double x = (t * UP + p - UP*L/2.0) / UP;
+        double v = (x == 0 ? 1 : sin(M_PI*x) / (M_PI*x)) *
+                   (0.54 - 0.46 * cos(2*M_PI*(t * UP + p) / (UP*L)));
+        wf[i] = v;
+        ws[i] = lrint(v * 32767);
+    }
+    for (i = 0; i < MAXCH*2*L*DN; i++) {
+        xs[i] = rand() % 65536 - 32768;
+        xf[i] = xs[i] / 32768.0f;
+    }
+
+    bench("C:   ", 0);
+    if (gCpuCaps.hasSSE2)
+        bench("SSE2:", AF_DSP_CPU_SSE2);
+    if (gCpuCaps.hasAVX2)
+        bench("AVX2:", AF_DSP_CPU_SSE2 | AF_DSP_CPU_AVX2);
+    return 0;
+}
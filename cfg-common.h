@@ -26,6 +26,7 @@
 #include "libmpcodecs/dec_video.h"
 #include "libmpcodecs/vd.h"
 #include "libmpcodecs/vf_scale.h"
+#include "libmpcodecs/vf_threads.h"
 #include "libmpdemux/demux_audio.h"
 #include "libmpdemux/demux_mpg.h"
 #include "libmpdemux/demux_ts.h"
@@ -507,6 +508,7 @@ const m_option_t common_opts[] = {
 
     {"vop", "-vop has been removed, use -vf instead.\n", CONF_TYPE_PRINT, CONF_NOCFG ,0,0, NULL},
     {"vf*", &vf_settings, CONF_TYPE_OBJ_SETTINGS_LIST, 0, 0, 0, &vf_obj_list},
+    {"vf-threads", &vf_threads, CONF_TYPE_INT, CONF_RANGE, 0, VF_MAX_THREADS, NULL},
     // select audio/video codec (by name) or codec family (by number):
     {"afm", &audio_fm_list, CONF_TYPE_STRING_LIST, 0, 0, 0, NULL},
     {"vfm", &video_fm_list, CONF_TYPE_STRING_LIST, 0, 0, 0, NULL},
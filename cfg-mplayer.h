@@ -91,6 +91,8 @@ const m_option_t mplayer_opts[]={
     {"master", "Option -master has been removed, use -af volume instead.\n", CONF_TYPE_PRINT, 0, 0, 0, NULL},
     // override audio buffer size (used only by -ao oss, anyway obsolete...)
     {"abs", &ao_data.buffersize, CONF_TYPE_INT, CONF_MIN, 0, 0, NULL},
+    // milliseconds of audio queued for the audio thread, 0 disables it
+    {"audio-queue", &audio_queue_ms, CONF_TYPE_INT, CONF_RANGE, 0, 10000, NULL},
 
     // -ao pcm options:
     {"aofile", "-aofile has been removed. Use -ao pcm:file=<filename> instead.\n", CONF_TYPE_PRINT, 0, 0, 0, NULL},
@@ -315,19 +317,26 @@ const m_option_t mplayer_opts[]={
 
     {"noloop", &mpctx_s.loop_times, CONF_TYPE_FLAG, 0, 0, -1, NULL},
     {"loop", &mpctx_s.loop_times, CONF_TYPE_INT, CONF_RANGE, -1, 10000, NULL},
+    {"loop-ram", &loop_ram_mb, CONF_TYPE_INT, CONF_RANGE, 0, 2047, NULL},
     {"allow-dangerous-playlist-parsing", &allow_playlist_parsing, CONF_TYPE_FLAG, 0, 0, 1, NULL},
     {"noallow-dangerous-playlist-parsing", &allow_playlist_parsing, CONF_TYPE_FLAG, 0, 1, 0, NULL},
     {"playlist", NULL, CONF_TYPE_STRING, CONF_NOCFG, 0, 0, NULL},
     {"shuffle", NULL, CONF_TYPE_FLAG, CONF_NOCFG, 0, 0, NULL},
     {"noshuffle", NULL, CONF_TYPE_FLAG, CONF_NOCFG, 0, 0, NULL},
+    {"gapless", &gapless, CONF_TYPE_FLAG, 0, 0, 1, NULL},
+    {"nogapless", &gapless, CONF_TYPE_FLAG, 0, 1, 0, NULL},
 
     // a-v sync stuff:
     {"correct-pts", &user_correct_pts, CONF_TYPE_FLAG, 0, 0, 1, NULL},
     {"nocorrect-pts", &user_correct_pts, CONF_TYPE_FLAG, 0, 1, 0, NULL},
+    {"hr-seek", &hr_seek, CONF_TYPE_FLAG, 0, 0, 1, NULL},
+    {"nohr-seek", &hr_seek, CONF_TYPE_FLAG, 0, 1, 0, NULL},
+    {"frame-cache", &frame_cache_mb, CONF_TYPE_INT, CONF_RANGE, 0, 4096, NULL},
     {"noautosync", &autosync, CONF_TYPE_FLAG, 0, 0, -1, NULL},
     {"autosync", &autosync, CONF_TYPE_INT, CONF_RANGE, 0, 10000, NULL},
 
     {"softsleep", &softsleep, CONF_TYPE_FLAG, 0, 0, 1, NULL},
+    {"sleep-spin", &sleep_spin, CONF_TYPE_INT, CONF_RANGE, 0, 20000, NULL},
 #ifdef HAVE_RTC
     {"nortc", &nortc, CONF_TYPE_FLAG, 0, 0, 1, NULL},
     {"rtc", &nortc, CONF_TYPE_FLAG, 0, 1, 0, NULL},
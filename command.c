@@ -19,6 +19,7 @@
 #define _BSD_SOURCE
 
 #include <stdlib.h>
+#include <math.h>
 #include <inttypes.h>
 #include <unistd.h>
 #include <string.h>
@@ -297,6 +298,17 @@ static int mp_property_filename(m_option_t *prop, int action, void *arg,
     return m_property_string_ro(prop, action, arg, f);
 }
 
+/// Presentation error statistics of the displayed frames (RO)
+static int mp_property_frame_jitter(m_option_t *prop, int action, void *arg,
+                                    MPContext *mpctx)
+{
+    static char buf[256];
+    if (!mpctx->sh_video)
+        return M_PROPERTY_UNAVAILABLE;
+    frame_jitter_print(&mpctx->jitter, buf, sizeof(buf));
+    return m_property_string_ro(prop, action, arg, buf);
+}
+
 /// Demuxer name (RO)
 static int mp_property_demuxer(m_option_t *prop, int action, void *arg,
                                MPContext *mpctx)
@@ -2095,6 +2107,8 @@ static const m_option_t mp_properties[] = {
      0, 0, 0, NULL },
     { "demuxer", mp_property_demuxer, CONF_TYPE_STRING,
      0, 0, 0, NULL },
+    { "frame_jitter", mp_property_frame_jitter, CONF_TYPE_STRING,
+     0, 0, 0, NULL },
     { "stream_pos", mp_property_stream_pos, CONF_TYPE_POSITION,
      M_OPT_MIN, 0, 0, NULL },
     { "stream_start", mp_property_stream_start, CONF_TYPE_POSITION,
@@ -2471,6 +2485,236 @@ static const char *property_error_string(int error_value)
 }
 ///@}
 
+
+/**
+ * \defgroup PropertyObservers Property change events
+ * \ingroup Properties
+ *
+ * Slave mode clients subscribe to properties with observe_property and
+ * get a CHANGE_<name>=<value> line whenever the value changes, or
+ * CHANGE_<name> if the property became unavailable. The player marks
+ * the properties a state change can affect, only those are read again
+ * and compared with the last value sent.
+ *
+ *@{
+ */
+
+typedef struct {
+    char *name;
+    char *value;        ///< last value sent, NULL if unavailable
+    int sent;
+    int dirty;
+} prop_observer_t;
+
+static prop_observer_t *observers;
+static int num_observers;
+static int observers_dirty;
+static double observed_sec = MP_NOPTS_VALUE; // whole second of the last time marking
+
+static const char * const seek_props[] = {
+    "time_pos", "percent_pos", "stream_pos", "stream_time_pos", "chapter",
+    "angle", NULL
+};
+static const char * const pause_props[] = { "pause", "time_pos", NULL };
+static const char * const track_props[] = {
+    "switch_audio", "switch_video", "switch_program", "sub", "sub_source",
+    "sub_vob", "sub_demux", "sub_file", "audio_format", "audio_codec",
+    "audio_bitrate", "samplerate", "channels", "video_format", "video_codec",
+    "video_bitrate", "width", "height", "fps", "aspect", NULL
+};
+static const char * const metadata_props[] = { "metadata", NULL };
+/// marked whenever playback passes a whole second
+static const char * const time_props[] = {
+    "time_pos", "percent_pos", "stream_pos", "stream_time_pos", "chapter", NULL
+};
+
+/// properties affected by each enum mp_change, NULL for all of them
+static const char * const * const change_props[] = {
+    NULL, seek_props, pause_props, track_props, metadata_props
+};
+
+/// Mark the observers of a property and its sub-properties, all if NULL.
+static void mark_observers(const char *prop)
+{
+    int i, l = prop ? strlen(prop) : 0;
+
+    for (i = 0; i < num_observers; i++) {
+        const char *name = observers[i].name;
+        if (!prop || (!strncasecmp(name, prop, l) &&
+                      (!name[l] || name[l] == '/')))
+            observers[i].dirty = observers_dirty = 1;
+    }
+}
+
+static void mark_prop_list(const char * const *p)
+{
+    if (!p)
+        mark_observers(NULL);
+    else
+        for (; *p; p++)
+            mark_observers(*p);
+}
+
+void mp_property_changed(enum mp_change what)
+{
+    if (num_observers)
+        mark_prop_list(change_props[what]);
+}
+
+/// A command changed a property.
+static void property_set_by_command(const char *name)
+{
+    int i;
+
+    if (!num_observers)
+        return;
+    for (i = 0; track_props[i]; i++)
+        if (!strcasecmp(name, track_props[i])) {
+            mark_prop_list(track_props);
+            return;
+        }
+    mark_observers(name);
+}
+
+static void observe_property(MPContext *mpctx, const char *name)
+{
+    prop_observer_t *o;
+    m_option_t *prop;
+    int i, r;
+
+    for (i = 0; i < num_observers; i++)
+        if (!strcasecmp(observers[i].name, name))
+            return;
+    r = mp_property_do(name, M_PROPERTY_GET_TYPE, &prop, mpctx);
+    if (r == M_PROPERTY_UNKNOWN) {
+        mp_msg(MSGT_CPLAYER, MSGL_WARN, "Unknown property: '%s'\n", name);
+        mp_msg(MSGT_GLOBAL, MSGL_INFO, "ANS_ERROR=%s\n", property_error_string(r));
+        return;
+    }
+    o = realloc(observers, (num_observers + 1) * sizeof(*observers));
+    if (!o)
+        return;
+    observers = o;
+    o = &observers[num_observers++];
+    o->name  = strdup(name);
+    o->value = NULL;
+    o->sent  = 0;
+    // the current value is sent right away
+    o->dirty = observers_dirty = 1;
+}
+
+static void unobserve_property(const char *name)
+{
+    int i;
+
+    for (i = 0; i < num_observers; i++)
+        if (!strcasecmp(observers[i].name, name)) {
+            free(observers[i].name);
+            free(observers[i].value);
+            memmove(&observers[i], &observers[i + 1],
+                    (num_observers - i - 1) * sizeof(*observers));
+            num_observers--;
+            return;
+        }
+}
+
+/// Mark the properties a command may have changed.
+static void property_changed_by_cmd(mp_cmd_t *cmd)
+{
+    int i;
+
+    if (!num_observers)
+        return;
+    switch (cmd->id) {
+    case MP_CMD_SET_PROPERTY:
+    case MP_CMD_STEP_PROPERTY:
+        property_set_by_command(cmd->args[0].v.s);
+        break;
+    case MP_CMD_GET_PROPERTY:
+    case MP_CMD_OBSERVE_PROPERTY:
+    case MP_CMD_UNOBSERVE_PROPERTY:
+    case MP_CMD_GET_TIME_POS:
+    case MP_CMD_GET_TIME_LENGTH:
+    case MP_CMD_GET_PERCENT_POS:
+    case MP_CMD_GET_FILENAME:
+    case MP_CMD_GET_VIDEO_CODEC:
+    case MP_CMD_GET_VIDEO_BITRATE:
+    case MP_CMD_GET_VIDEO_RESOLUTION:
+    case MP_CMD_GET_AUDIO_CODEC:
+    case MP_CMD_GET_AUDIO_BITRATE:
+    case MP_CMD_GET_AUDIO_SAMPLES:
+    case MP_CMD_GET_META_TITLE:
+    case MP_CMD_GET_META_ARTIST:
+    case MP_CMD_GET_META_ALBUM:
+    case MP_CMD_GET_META_YEAR:
+    case MP_CMD_GET_META_COMMENT:
+    case MP_CMD_GET_META_TRACK:
+    case MP_CMD_GET_META_GENRE:
+    case MP_CMD_GET_VO_FULLSCREEN:
+    case MP_CMD_GET_SUB_VISIBILITY:
+        break;
+    default:
+        for (i = 0; set_prop_cmd[i].name; i++)
+            if (set_prop_cmd[i].cmd == cmd->id)
+                break;
+        if (set_prop_cmd[i].name)
+            property_set_by_command(set_prop_cmd[i].name);
+        else
+            mark_observers(NULL);   // anything may have changed
+    }
+    if (cmd->pausing)
+        mark_prop_list(pause_props);
+}
+
+void mp_property_notify(MPContext *mpctx)
+{
+    int i;
+
+    if (!num_observers)
+        return;
+    if (mpctx->sh_video || mpctx->sh_audio) {
+        double pts = mpctx->sh_video ? mpctx->sh_video->pts :
+                     playing_audio_pts(mpctx->sh_audio, mpctx->d_audio,
+                                       mpctx->audio_out);
+        // no time yet right after a seek
+        if (pts != MP_NOPTS_VALUE && floor(pts) != observed_sec) {
+            observed_sec = floor(pts);
+            mark_prop_list(time_props);
+        }
+    }
+    if (mpctx->demuxer && mpctx->demuxer->info_changed) {
+        mpctx->demuxer->info_changed = 0;
+        mark_prop_list(metadata_props);
+    }
+    if (!observers_dirty)
+        return;
+    observers_dirty = 0;
+    for (i = 0; i < num_observers; i++) {
+        prop_observer_t *o = &observers[i];
+        char *val;
+
+        if (!o->dirty)
+            continue;
+        o->dirty = 0;
+        if (mp_property_do(o->name, M_PROPERTY_TO_STRING, &val, mpctx) <= 0)
+            val = NULL;
+        if (o->sent && (val && o->value ? !strcmp(val, o->value) :
+                                          val == o->value)) {
+            free(val);
+            continue;
+        }
+        if (val)
+            mp_msg(MSGT_GLOBAL, MSGL_INFO, "CHANGE_%s=%s\n", o->name, val);
+        else
+            mp_msg(MSGT_GLOBAL, MSGL_INFO, "CHANGE_%s\n", o->name);
+        free(o->value);
+        o->value = val;
+        o->sent  = 1;
+    }
+}
+
+///@}
+
 static void remove_subtitle_range(MPContext *mpctx, int start, int count)
 {
     int idx;
@@ -2698,6 +2942,14 @@ int run_command(MPContext *mpctx, mp_cmd_t *cmd)
             }
             break;
 
+        case MP_CMD_OBSERVE_PROPERTY:
+            observe_property(mpctx, cmd->args[0].v.s);
+            break;
+
+        case MP_CMD_UNOBSERVE_PROPERTY:
+            unobserve_property(cmd->args[0].v.s);
+            break;
+
         case MP_CMD_EDL_MARK:
             if (edl_fd) {
                 float v = sh_video ? sh_video->pts :
@@ -2763,6 +3015,15 @@ int run_command(MPContext *mpctx, mp_cmd_t *cmd)
             brk_cmd = 1;
             break;
 
+        case MP_CMD_FRAME_BACK_STEP:
+            // not in the frame cache, seek to the previous frame
+            if (sh_video && sh_video->frametime > 0) {
+                rel_seek_secs -= sh_video->frametime;
+                cmd->pausing = 1;
+                brk_cmd = 1;
+            }
+            break;
+
         case MP_CMD_FILE_FILTER:
             file_filter = cmd->args[0].v.i;
             break;
@@ -3517,5 +3778,7 @@ int run_command(MPContext *mpctx, mp_cmd_t *cmd)
         if (mpctx->was_paused)
             mpctx->osd_function = OSD_PAUSE;
     }
+    property_changed_by_cmd(cmd);
+    mp_property_notify(mpctx);
     return brk_cmd;
 }
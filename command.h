@@ -26,4 +26,18 @@ int run_command(struct MPContext *mpctx, struct mp_cmd *cmd);
 char *property_expand_string(struct MPContext *mpctx, char *str);
 void property_print_help(void);
 
+/// Player state changes that can alter property values.
+enum mp_change {
+    MP_CHANGE_FILE,     ///< a new file is played, all properties
+    MP_CHANGE_SEEK,
+    MP_CHANGE_PAUSE,
+    MP_CHANGE_TRACKS,   ///< stream selection and decoders
+    MP_CHANGE_METADATA,
+};
+
+/// Mark the observed properties that a change can affect.
+void mp_property_changed(enum mp_change what);
+/// Send the change events of the marked properties to slave mode clients.
+void mp_property_notify(struct MPContext *mpctx);
+
 #endif /* MPLAYER_COMMAND_H */
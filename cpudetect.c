@@ -261,7 +261,16 @@ do_cpuid(unsigned int ax, unsigned int *p)
          "xchg %%"REG_b", %%"REG_S
          : "=a" (p[0]), "=S" (p[1]),
            "=c" (p[2]), "=d" (p[3])
-         : "0" (ax));
+         : "0" (ax), "2" (0));
+}
+
+// XCR0 bits 1 and 2: the OS saves the xmm and ymm registers
+static int os_saves_ymm(void)
+{
+    unsigned int eax, edx;
+    __asm__ volatile(".byte 0x0f, 0x01, 0xd0" // xgetbv
+                     : "=a" (eax), "=d" (edx) : "c" (0));
+    return (eax & 6) == 6;
 }
 
 void GetCpuCaps( CpuCaps *caps)
@@ -310,6 +319,11 @@ void GetCpuCaps( CpuCaps *caps)
         caps->hasSSE4 = (regs2[2] & (1 << 19 )) >> 19; // 0x0080000
         caps->hasSSE42 = (regs2[2] & (1 << 20)) >> 20; // 0x0100000
         caps->hasAVX  = (regs2[2] & (1 << 28 )) >> 28; // 0x10000000
+        if (regs[0] >= 0x00000007 && (regs2[2] & (1 << 27)) && os_saves_ymm()) {
+            unsigned int regs7[4];
+            do_cpuid(0x00000007, regs7);
+            caps->hasAVX2 = caps->hasAVX && (regs7[1] & (1 << 5)); // 0x0000020
+        }
         caps->hasMMX2 = caps->hasSSE; // SSE cpus supports mmxext too
         cl_size = ((regs2[1] >> 8) & 0xFF)*8;
         if(cl_size) caps->cl_size = cl_size;
@@ -456,6 +470,7 @@ void GetCpuCaps( CpuCaps *caps)
     caps->hasSSE42=0;
     caps->hasSSE4a=0;
     caps->hasAVX=0;
+    caps->hasAVX2=0;
     caps->isX86=0;
     caps->hasAltiVec = 0;
 #if HAVE_ALTIVEC
@@ -0,0 +1,180 @@
+/*
+ * cache of recently decoded video frames
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmpcodecs/img_format.h"
+#include "frame_cache.h"
+
+/// timestamps closer than this are the same frame
+#define PTS_EPS 0.0001
+
+typedef struct cached_frame {
+    mp_image_t *mpi;
+    double pts;
+    int size;
+} cached_frame_t;
+
+/* The frames are kept in a ring, first is the oldest. */
+struct frame_cache {
+    cached_frame_t *frames;
+    int alloc;
+    int first;
+    int count;
+    int64_t bytes;
+    int64_t max_bytes;
+};
+
+static cached_frame_t *frame_at(frame_cache_t *fc, int i)
+{
+    return &fc->frames[(fc->first + i) % fc->alloc];
+}
+
+frame_cache_t *frame_cache_new(int size_mb)
+{
+    frame_cache_t *fc = calloc(1, sizeof(*fc));
+    if (fc)
+        fc->max_bytes = (int64_t)size_mb << 20;
+    return fc;
+}
+
+void frame_cache_clear(frame_cache_t *fc)
+{
+    while (fc->count) {
+        free_mp_image(frame_at(fc, --fc->count)->mpi);
+    }
+    fc->first = 0;
+    fc->bytes = 0;
+}
+
+void frame_cache_free(frame_cache_t *fc)
+{
+    if (!fc)
+        return;
+    frame_cache_clear(fc);
+    free(fc->frames);
+    free(fc);
+}
+
+/// \return the oldest frame for reuse if it has the size and format of mpi
+static mp_image_t *drop_first(frame_cache_t *fc, mp_image_t *mpi)
+{
+    cached_frame_t *f = frame_at(fc, 0);
+    mp_image_t *old = f->mpi;
+
+    fc->bytes -= f->size;
+    fc->first  = (fc->first + 1) % fc->alloc;
+    fc->count--;
+    if (mpi && old->w == mpi->w && old->h == mpi->h &&
+        old->imgfmt == mpi->imgfmt)
+        return old;
+    free_mp_image(old);
+    return NULL;
+}
+
+void frame_cache_add(frame_cache_t *fc, mp_image_t *mpi, double pts,
+                     double max_gap)
+{
+    mp_image_t *copy = NULL;
+    cached_frame_t *f;
+    int size;
+
+    while (fc->count && frame_at(fc, fc->count - 1)->pts >= pts - PTS_EPS) {
+        f = frame_at(fc, --fc->count);
+        fc->bytes -= f->size;
+        free_mp_image(f->mpi);
+    }
+    if (fc->count && pts - frame_at(fc, fc->count - 1)->pts > max_gap)
+        frame_cache_clear(fc);
+
+    // hardware surfaces are only handles the decoder reuses
+    if (IMGFMT_IS_HWACCEL(mpi->imgfmt))
+        return;
+    size = mpi->bpp * mpi->w * (mpi->h + 2) / 8;
+    if (size <= 0 || size > fc->max_bytes)
+        return;
+    while (fc->count && fc->bytes + size > fc->max_bytes) {
+        free_mp_image(copy);
+        copy = drop_first(fc, mpi);
+    }
+    if (fc->count == fc->alloc) {
+        int i, n = fc->alloc ? 2 * fc->alloc : 64;
+        cached_frame_t *frames = malloc(n * sizeof(*frames));
+        if (!frames) {
+            free_mp_image(copy);
+            return;
+        }
+        for (i = 0; i < fc->count; i++)
+            frames[i] = *frame_at(fc, i);
+        free(fc->frames);
+        fc->frames = frames;
+        fc->alloc  = n;
+        fc->first  = 0;
+    }
+    if (!copy) {
+        copy = alloc_mpi(mpi->w, mpi->h, mpi->imgfmt);
+        if (!copy->planes[0]) {
+            free_mp_image(copy);
+            return;
+        }
+    }
+    copy_mpi(copy, mpi);
+    if ((mpi->flags & MP_IMGFLAG_RGB_PALETTE) && mpi->planes[1])
+        memcpy(copy->planes[1], mpi->planes[1], 1024);
+    copy->fields     = mpi->fields;
+    copy->pict_type  = mpi->pict_type;
+
+    f = frame_at(fc, fc->count++);
+    f->mpi  = copy;
+    f->pts  = pts;
+    f->size = size;
+    fc->bytes += size;
+}
+
+int frame_cache_count(frame_cache_t *fc)
+{
+    return fc->count;
+}
+
+mp_image_t *frame_cache_get(frame_cache_t *fc, int i, double *pts)
+{
+    cached_frame_t *f = frame_at(fc, i);
+    *pts = f->pts;
+    return f->mpi;
+}
+
+int frame_cache_find(frame_cache_t *fc, double pts)
+{
+    int lo = 0, hi = fc->count - 1;
+
+    if (!fc->count || pts < frame_at(fc, 0)->pts - PTS_EPS ||
+        pts > frame_at(fc, hi)->pts + PTS_EPS)
+        return -1;
+    // the pts are increasing
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (frame_at(fc, mid)->pts <= pts + PTS_EPS)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
@@ -0,0 +1,54 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_FRAME_CACHE_H
+#define MPLAYER_FRAME_CACHE_H
+
+#include "libmpcodecs/mp_image.h"
+
+/**
+ * Copies of the last decoded frames in presentation order, bounded by
+ * their size in memory. Frames are numbered from 0, the oldest, to
+ * frame_cache_count() - 1, the last one added.
+ */
+typedef struct frame_cache frame_cache_t;
+
+frame_cache_t *frame_cache_new(int size_mb);
+void frame_cache_free(frame_cache_t *fc);
+void frame_cache_clear(frame_cache_t *fc);
+
+/**
+ * \brief store a copy of a decoded frame
+ *
+ * The frames at or after pts are dropped first, they are decoded again
+ * after a seek back. If pts is more than max_gap after the last frame the
+ * cache starts over, the frames would not be contiguous. Frames in
+ * hardware decoding formats (VDPAU, XvMC) are not stored.
+ */
+void frame_cache_add(frame_cache_t *fc, mp_image_t *mpi, double pts,
+                     double max_gap);
+
+int frame_cache_count(frame_cache_t *fc);
+
+/// \return frame i, its pts is stored in *pts
+mp_image_t *frame_cache_get(frame_cache_t *fc, int i, double *pts);
+
+/// \return the last frame at or before pts, -1 if pts is not covered
+int frame_cache_find(frame_cache_t *fc, double pts);
+
+#endif /* MPLAYER_FRAME_CACHE_H */
@@ -1265,13 +1265,20 @@ static const char help_text[] = MSGTR_Help;
 "[AO_ALSA]   noblock\n"\
 "[AO_ALSA]     Opens device in non-blocking mode.\n"\
 "[AO_ALSA]   device=<device-name>\n"\
-"[AO_ALSA]     Sets device (change , to . and : to =)\n"
+"[AO_ALSA]     Sets device (change , to . and : to =)\n"\
+"[AO_ALSA]   mmap\n"\
+"[AO_ALSA]     Writes to the device buffer through mmap.\n"\
+"[AO_ALSA]   buffer_time=<ms>\n"\
+"[AO_ALSA]     Sets the device buffer length (default: 500).\n"\
+"[AO_ALSA]   period_time=<ms>\n"\
+"[AO_ALSA]     Sets the period length (default: 1/16 of the buffer).\n"
 #define MSGTR_AO_ALSA_ChannelsNotSupported "[AO_ALSA] %d channels are not supported.\n"
 #define MSGTR_AO_ALSA_OpenInNonblockModeFailed "[AO_ALSA] Open in nonblock-mode failed, trying to open in block-mode.\n"
 #define MSGTR_AO_ALSA_PlaybackOpenError "[AO_ALSA] Playback open error: %s\n"
 #define MSGTR_AO_ALSA_ErrorSetBlockMode "[AL_ALSA] Error setting block-mode %s.\n"
 #define MSGTR_AO_ALSA_UnableToGetInitialParameters "[AO_ALSA] Unable to get initial parameters: %s\n"
 #define MSGTR_AO_ALSA_UnableToSetAccessType "[AO_ALSA] Unable to set access type: %s\n"
+#define MSGTR_AO_ALSA_MmapNotSupported "[AO_ALSA] mmap access is not supported, using read/write: %s\n"
 #define MSGTR_AO_ALSA_FormatNotSupportedByHardware "[AO_ALSA] Format %s is not supported by hardware, trying default.\n"
 #define MSGTR_AO_ALSA_UnableToSetFormat "[AO_ALSA] Unable to set format: %s\n"
 #define MSGTR_AO_ALSA_UnableToSetChannels "[AO_ALSA] Unable to set channels: %s\n"
@@ -29,6 +29,11 @@
 #include <sys/time.h>
 #include <fcntl.h>
 #include <ctype.h>
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
 
 #include "input.h"
 #include "mouse.h"
@@ -88,6 +93,7 @@ static const mp_cmd_t mp_cmds[] = {
   { MP_CMD_STOP, "stop", 0, { {-1,{0}} } },
   { MP_CMD_PAUSE, "pause", 0, { {-1,{0}} } },
   { MP_CMD_FRAME_STEP, "frame_step", 0, { {-1,{0}} } },
+  { MP_CMD_FRAME_BACK_STEP, "frame_back_step", 0, { {-1,{0}} } },
   { MP_CMD_PLAY_TREE_STEP, "pt_step",1, { { MP_CMD_ARG_INT ,{0}}, { MP_CMD_ARG_INT ,{0}}, {-1,{0}} } },
   { MP_CMD_PLAY_TREE_UP_STEP, "pt_up_step",1,  { { MP_CMD_ARG_INT,{0} }, { MP_CMD_ARG_INT ,{0}}, {-1,{0}} } },
   { MP_CMD_PLAY_ALT_SRC_STEP, "alt_src_step",1, { { MP_CMD_ARG_INT,{0} }, {-1,{0}} } },
@@ -200,6 +206,8 @@ static const mp_cmd_t mp_cmds[] = {
   { MP_CMD_SET_PROPERTY, "set_property", 2, { {MP_CMD_ARG_STRING, {0}},  {MP_CMD_ARG_STRING, {0}}, {-1,{0}} } },
   { MP_CMD_GET_PROPERTY, "get_property", 1, { {MP_CMD_ARG_STRING, {0}},  {-1,{0}} } },
   { MP_CMD_STEP_PROPERTY, "step_property", 1, { {MP_CMD_ARG_STRING, {0}}, {MP_CMD_ARG_FLOAT,{0}}, {MP_CMD_ARG_INT,{0}}, {-1,{0}} } },
+  { MP_CMD_OBSERVE_PROPERTY, "observe_property", 1, { {MP_CMD_ARG_STRING, {0}},  {-1,{0}} } },
+  { MP_CMD_UNOBSERVE_PROPERTY, "unobserve_property", 1, { {MP_CMD_ARG_STRING, {0}},  {-1,{0}} } },
 
   { MP_CMD_SEEK_CHAPTER, "seek_chapter", 1, { {MP_CMD_ARG_INT,{0}}, {MP_CMD_ARG_INT,{0}}, {-1,{0}} } },
   { MP_CMD_SET_MOUSE_POS, "set_mouse_pos", 2, { {MP_CMD_ARG_INT,{0}}, {MP_CMD_ARG_INT,{0}}, {-1,{0}} } },
@@ -418,6 +426,7 @@ static const mp_cmd_bind_t def_cmd_binds[] = {
   { { 'p', 0 }, "pause" },
   { { ' ', 0 }, "pause" },
   { { '.', 0 }, "frame_step" },
+  { { ',', 0 }, "frame_back_step" },
   { { KEY_HOME, 0 }, "pt_up_step 1" },
   { { KEY_END, 0 }, "pt_up_step -1" },
   { { '>', 0 }, "pt_step 1" },
@@ -544,6 +553,7 @@ typedef struct mp_input_fd {
   unsigned got_cmd : 1;
   unsigned no_select : 1;
   unsigned no_readfunc_retval : 1;
+  unsigned ready : 1;
   // These fields are for the cmd fds.
   char* buffer;
   int pos,size;
@@ -612,6 +622,11 @@ static char* ar_dev = NULL;
 static char* in_file = NULL;
 static int in_file_fd = -1;
 
+#ifdef HAVE_EPOLL
+// watches the selectable fds, the wakeup eventfd and the sleep timer
+static int epoll_fd = -1, wakeup_fd = -1, timer_fd = -1;
+#endif
+
 static int mp_input_print_key_list(m_option_t* cfg);
 static int mp_input_print_cmd_list(m_option_t* cfg);
 
@@ -649,6 +664,83 @@ mp_input_default_cmd_func(int fd,char* buf, int l);
 static char*
 mp_input_get_key_name(int key);
 
+#ifdef HAVE_EPOLL
+static int epoll_add(int fd)
+{
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events  = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0 && errno != EEXIST)
+    return -1;
+  return 0;
+}
+
+/// \return 0 if epoll is not usable
+static int epoll_init(void)
+{
+  unsigned int i;
+
+  if (epoll_fd >= 0)
+    return 1;
+  if (epoll_fd == -2)
+    return 0;
+  epoll_fd  = epoll_create(MP_MAX_KEY_FD + MP_MAX_CMD_FD + 2);
+  wakeup_fd = eventfd(0, 0);
+  timer_fd  = timerfd_create(CLOCK_MONOTONIC, 0);
+  if (epoll_fd < 0 || wakeup_fd < 0 || timer_fd < 0 ||
+      epoll_add(wakeup_fd) < 0 || epoll_add(timer_fd) < 0) {
+    mp_msg(MSGT_INPUT, MSGL_V, "epoll not available, using select()\n");
+    if (epoll_fd  >= 0) close(epoll_fd);
+    if (wakeup_fd >= 0) close(wakeup_fd);
+    if (timer_fd  >= 0) close(timer_fd);
+    epoll_fd  = -2;
+    wakeup_fd = timer_fd = -1;
+    return 0;
+  }
+  fcntl(wakeup_fd, F_SETFL, O_NONBLOCK);
+  fcntl(timer_fd, F_SETFL, O_NONBLOCK);
+  for (i = 0; i < num_key_fd; i++)
+    if (!key_fds[i].no_select && epoll_add(key_fds[i].fd) < 0)
+      key_fds[i].no_select = 1;
+  for (i = 0; i < num_cmd_fd; i++)
+    if (!cmd_fds[i].no_select && epoll_add(cmd_fds[i].fd) < 0)
+      cmd_fds[i].no_select = 1;
+  return 1;
+}
+
+/// watch a new fd, one that epoll does not support (regular files) is read on every poll
+static void epoll_watch(mp_input_fd_t *f)
+{
+  if (!f->no_select && epoll_fd >= 0 && epoll_add(f->fd) < 0)
+    f->no_select = 1;
+}
+
+static void epoll_unwatch(int fd)
+{
+  unsigned int i;
+  struct epoll_event ev;
+
+  if (epoll_fd < 0)
+    return;
+  // the same fd may be registered as key and as cmd fd
+  for (i = 0; i < num_key_fd; i++)
+    if (key_fds[i].fd == fd && !key_fds[i].dead)
+      return;
+  for (i = 0; i < num_cmd_fd; i++)
+    if (cmd_fds[i].fd == fd && !cmd_fds[i].dead && !cmd_fds[i].eof)
+      return;
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+static void drain(int fd)
+{
+  uint64_t count;
+  while (read(fd, &count, sizeof(count)) > 0)
+    ;
+}
+#endif
+
 
 int
 mp_input_add_cmd_fd(int fd, int select, mp_cmd_func_t read_func, mp_close_func_t close_func) {
@@ -666,6 +758,9 @@ mp_input_add_cmd_fd(int fd, int select, mp_cmd_func_t read_func, mp_close_func_t
   cmd_fds[num_cmd_fd].read_func = read_func ? read_func : mp_input_default_cmd_func;
   cmd_fds[num_cmd_fd].close_func = close_func;
   cmd_fds[num_cmd_fd].no_select = !select;
+#ifdef HAVE_EPOLL
+  epoll_watch(&cmd_fds[num_cmd_fd]);
+#endif
   num_cmd_fd++;
 
   return 1;
@@ -681,6 +776,10 @@ mp_input_rm_cmd_fd(int fd) {
   }
   if(i == num_cmd_fd)
     return;
+#ifdef HAVE_EPOLL
+  cmd_fds[i].dead = 1;
+  epoll_unwatch(fd);
+#endif
   if(cmd_fds[i].close_func)
     cmd_fds[i].close_func(cmd_fds[i].fd);
   free(cmd_fds[i].buffer);
@@ -700,6 +799,10 @@ mp_input_rm_key_fd(int fd) {
   }
   if(i == num_key_fd)
     return;
+#ifdef HAVE_EPOLL
+  key_fds[i].dead = 1;
+  epoll_unwatch(fd);
+#endif
   if(key_fds[i].close_func)
     key_fds[i].close_func(key_fds[i].fd);
 
@@ -724,6 +827,9 @@ mp_input_add_key_fd(int fd, int select, mp_key_func_t read_func, mp_close_func_t
   key_fds[num_key_fd].read_func = read_func;
   key_fds[num_key_fd].close_func = close_func;
   key_fds[num_key_fd].no_select = !select;
+#ifdef HAVE_EPOLL
+  epoll_watch(&key_fds[num_key_fd]);
+#endif
   num_key_fd++;
 
   return 1;
@@ -746,6 +852,9 @@ mp_input_add_event_fd(int fd, void (*read_func)(void))
   key_fds[num_key_fd].read_func = read_func;
   key_fds[num_key_fd].close_func = NULL;
   key_fds[num_key_fd].no_readfunc_retval = 1;
+#ifdef HAVE_EPOLL
+  epoll_watch(&key_fds[num_key_fd]);
+#endif
   num_key_fd++;
 
   return 1;
@@ -1221,31 +1330,53 @@ static mp_cmd_t *check_autorepeat(int paused)
 
 
 /**
- * \param time time to wait at most for an event in milliseconds
+ * \brief wait for input and set ready on the fds that have some
+ * \param time time to wait at most in milliseconds, forever if negative
  */
-static mp_cmd_t *read_events(int time, int paused)
+static void wait_events(int time)
 {
     int i;
-    int got_cmd = 0;
-    mp_cmd_t *autorepeat_cmd;
 #ifdef HAVE_POSIX_SELECT
     fd_set fds;
 #endif
-    for (i = 0; i < num_key_fd; i++)
-	if (key_fds[i].dead) {
-	    mp_input_rm_key_fd(key_fds[i].fd);
-	    i--;
+#ifdef HAVE_EPOLL
+    // before the scan, the fds epoll cannot watch are marked no_select here
+    int use_epoll = epoll_init();
+#endif
+
+    if (time < 0)
+	// nothing would wake us for the fds that are polled
+	for (i = 0; i < num_key_fd + num_cmd_fd; i++) {
+	    mp_input_fd_t *f = i < num_key_fd ? &key_fds[i] : &cmd_fds[i - num_key_fd];
+	    if (f->no_select && f->read_func != (void *)mplayer_get_key) {
+		time = 20;
+		break;
+	    }
 	}
-    for (i = 0; i < num_cmd_fd; i++)
-	if (cmd_fds[i].dead || cmd_fds[i].eof) {
-	    mp_input_rm_cmd_fd(cmd_fds[i].fd);
-	    i--;
+#ifdef HAVE_EPOLL
+    if (use_epoll) {
+	struct epoll_event ev[MP_MAX_KEY_FD + MP_MAX_CMD_FD + 2];
+	int n = epoll_wait(epoll_fd, ev, FF_ARRAY_ELEMS(ev), time);
+	if (n < 0 && errno != EINTR)
+	    mp_msg(MSGT_INPUT, MSGL_ERR, MSGTR_INPUT_INPUT_ErrSelect,
+		   strerror(errno));
+	while (n-- > 0) {
+	    int fd = ev[n].data.fd;
+	    if (fd == wakeup_fd || fd == timer_fd)
+		drain(fd);
+	    for (i = 0; i < num_key_fd; i++)
+		if (key_fds[i].fd == fd)
+		    key_fds[i].ready = 1;
+	    for (i = 0; i < num_cmd_fd; i++)
+		if (cmd_fds[i].fd == fd)
+		    cmd_fds[i].ready = 1;
 	}
-	else if (cmd_fds[i].got_cmd)
-	    got_cmd = 1;
+	return;
+    }
+#endif
 #ifdef HAVE_POSIX_SELECT
     FD_ZERO(&fds);
-    if (!got_cmd) {
+    {
 	int max_fd = 0, num_fd = 0;
 	for (i = 0; i < num_key_fd; i++) {
 	    if (key_fds[i].no_select)
@@ -1279,18 +1410,49 @@ static mp_cmd_t *read_events(int time, int paused)
 		FD_ZERO(&fds);
 	    }
 	} else if (time)
-	    usec_sleep(time * 1000);
+	    usec_sleep((time > 0 ? time : 20) * 1000);
     }
+    for (i = 0; i < num_key_fd; i++)
+	key_fds[i].ready = !key_fds[i].no_select && FD_ISSET(key_fds[i].fd, &fds);
+    for (i = 0; i < num_cmd_fd; i++)
+	cmd_fds[i].ready = !cmd_fds[i].no_select && FD_ISSET(cmd_fds[i].fd, &fds);
 #else
-    if (!got_cmd && time)
-	usec_sleep(time * 1000);
+    if (time)
+	usec_sleep((time > 0 ? time : 20) * 1000);
 #endif
+}
 
+/**
+ * \param time time to wait at most for an event in milliseconds
+ */
+static mp_cmd_t *read_events(int time, int paused)
+{
+    int i;
+    int got_cmd = 0;
+    mp_cmd_t *autorepeat_cmd;
+    for (i = 0; i < num_key_fd; i++)
+	if (key_fds[i].dead) {
+	    mp_input_rm_key_fd(key_fds[i].fd);
+	    i--;
+	} else
+	    key_fds[i].ready = 0;
+    for (i = 0; i < num_cmd_fd; i++)
+	if (cmd_fds[i].dead || cmd_fds[i].eof) {
+	    mp_input_rm_cmd_fd(cmd_fds[i].fd);
+	    i--;
+	}
+	else {
+	    cmd_fds[i].ready = 0;
+	    if (cmd_fds[i].got_cmd)
+		got_cmd = 1;
+	}
+    if (!got_cmd)
+	wait_events(time);
 
     for (i = 0; i < num_key_fd; i++) {
 	int code;
-#ifdef HAVE_POSIX_SELECT
-	if (!key_fds[i].no_select && !FD_ISSET(key_fds[i].fd, &fds))
+#if defined(HAVE_EPOLL) || defined(HAVE_POSIX_SELECT)
+	if (!key_fds[i].no_select && !key_fds[i].ready)
 	    continue;
 #endif
 
@@ -1327,8 +1489,8 @@ static mp_cmd_t *read_events(int time, int paused)
     for (i = 0; i < num_cmd_fd; i++) {
 	char *cmd;
 	int r;
-#ifdef HAVE_POSIX_SELECT
-	if (!cmd_fds[i].no_select && !FD_ISSET(cmd_fds[i].fd, &fds) &&
+#if defined(HAVE_EPOLL) || defined(HAVE_POSIX_SELECT)
+	if (!cmd_fds[i].no_select && !cmd_fds[i].ready &&
 	    !cmd_fds[i].got_cmd)
 	    continue;
 #endif
@@ -1849,6 +2011,14 @@ mp_input_uninit(void) {
   while ((cmd = mp_input_get_queued_cmd(0)))
     mp_cmd_free(cmd);
   mplayer_key_fifo_uninit();
+#ifdef HAVE_EPOLL
+  if (epoll_fd >= 0) {
+    close(epoll_fd);
+    close(wakeup_fd);
+    close(timer_fd);
+  }
+  epoll_fd = wakeup_fd = timer_fd = -1;
+#endif
 }
 
 void
@@ -1917,3 +2087,52 @@ mp_input_check_interrupt(int time) {
   mp_cmd_free(cmd);
   return 0;
 }
+
+int mp_input_sleep_until(int64_t deadline)
+{
+#if defined(HAVE_EPOLL) && defined(HAVE_CLOCK_GETTIME)
+  if (cmd_queue_length || async_quit_request)
+    return 1;
+  if (epoll_init()) {
+    struct itimerspec its;
+    struct epoll_event ev;
+    int n;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec  =  deadline / 1000000;
+    its.it_value.tv_nsec = (deadline % 1000000) * 1000;
+    if (its.it_value.tv_sec <= 0 && its.it_value.tv_nsec <= 0)
+      return 0;
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+    while ((n = epoll_wait(epoll_fd, &ev, 1, -1)) < 0 && errno == EINTR)
+      if (async_quit_request)
+        break;
+    if (n == 1 && ev.data.fd == timer_fd) {
+      drain(timer_fd);
+      return 0;
+    }
+    // disarm, the input is read by the next mp_input_get_cmd()
+    memset(&its, 0, sizeof(its));
+    timerfd_settime(timer_fd, 0, &its, NULL);
+    drain(timer_fd);
+    if (n == 1 && ev.data.fd == wakeup_fd)
+      drain(wakeup_fd);
+    return 1;
+  }
+#endif
+  sleep_until(deadline);
+  return 0;
+}
+
+void mp_input_wakeup(void)
+{
+#ifdef HAVE_EPOLL
+  if (wakeup_fd >= 0) {
+    uint64_t one = 1;
+    // EAGAIN: the counter is full, the wakeup is pending anyway
+    if (write(wakeup_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+      mp_msg(MSGT_INPUT, MSGL_ERR, "Input wakeup failed: %s\n",
+             strerror(errno));
+  }
+#endif
+}
@@ -19,6 +19,7 @@
 #ifndef MPLAYER_INPUT_H
 #define MPLAYER_INPUT_H
 
+#include <stdint.h>
 #include "m_config.h"
 
 // All command IDs
@@ -136,6 +137,9 @@ typedef enum {
   MP_CMD_STOP,
   MP_CMD_OVERLAY_ADD,
   MP_CMD_OVERLAY_REMOVE,
+  MP_CMD_OBSERVE_PROPERTY,
+  MP_CMD_UNOBSERVE_PROPERTY,
+  MP_CMD_FRAME_BACK_STEP,
 
   /// DVDNAV commands
   MP_CMD_DVDNAV_UP = 1000,
@@ -346,6 +350,18 @@ void mp_input_register_options(m_config_t* cfg);
 int
 mp_input_check_interrupt(int time);
 
+/**
+ * \brief sleep until GetTimerUS() reaches deadline
+ *
+ * With epoll the sleep ends as soon as a key or command fd has input or
+ * mp_input_wakeup() is called.
+ * \return 1 if the sleep ended before the deadline
+ */
+int mp_input_sleep_until(int64_t deadline);
+
+/// end a running mp_input_sleep_until(), safe to call from a signal handler
+void mp_input_wakeup(void);
+
 extern int async_quit_request;
 
 extern int pausing_default;
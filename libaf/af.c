@@ -252,6 +252,21 @@ void af_remove(af_stream_t* s, af_instance_t* af)
   free(af);
 }
 
+/* Length multipliers of the configured chain, the filters only change
+   them on reinit */
+static void af_calc_sizing(af_stream_t* s)
+{
+  af_instance_t* af=s->first;
+  s->mul = 1;
+  s->max_mul = 1;
+  while(af){
+    s->mul *= af->mul;
+    if(s->mul > s->max_mul)
+      s->max_mul = s->mul;
+    af=af->next;
+  }
+}
+
 int af_reinit(af_stream_t* s, af_instance_t* af)
 {
   do{
@@ -345,6 +360,7 @@ int af_reinit(af_stream_t* s, af_instance_t* af)
       return AF_ERROR;
     }
   }while(af);
+  af_calc_sizing(s);
   return AF_OK;
 }
 
@@ -353,6 +369,10 @@ void af_uninit(af_stream_t* s)
 {
   while(s->first)
     af_remove(s,s->first);
+  free(s->buf[0]);
+  free(s->buf[1]);
+  s->buf[0] = s->buf[1] = NULL;
+  s->buf_len[0] = s->buf_len[1] = 0;
 }
 
 /**
@@ -376,6 +396,14 @@ static int fixup_output_format(af_stream_t* s)
 	return AF_ERROR;
     }
 
+    // Planar float never leaves the filter chain
+    if(AF_FORMAT_IS_PLANAR(s->output.format) ||
+       (s->output.format == AF_FORMAT_UNKNOWN &&
+        AF_FORMAT_IS_PLANAR(s->last->data->format))){
+      s->output.format = AF_FORMAT_FLOAT_NE;
+      s->output.bps = 4;
+    }
+
     // Check output format fix if not OK
     if(s->output.format != AF_FORMAT_UNKNOWN &&
 		s->last->data->format != s->output.format){
@@ -574,14 +602,53 @@ af_instance_t* af_add(af_stream_t* s, char* name){
   return new;
 }
 
+/* Lend af the chain buffer that does not hold its input. A buffer only
+   grows when the chain input is longer than ever before or a filter
+   released more than its average share of buffered data. */
+static int af_lend_buffer(af_stream_t* s, af_instance_t* af,
+			  af_data_t* data, int in_len)
+{
+  int i = data->audio == s->buf[0];
+  int len = af_lencalc(af->mul,data);
+  if(len > s->buf_len[i]){
+    // Enough for the output of every filter for this input length
+    int chain_len = in_len * s->max_mul + AF_NCH * 8 + 1;
+    if(chain_len > len)
+      len = chain_len;
+    mp_msg(MSGT_AFILTER, MSGL_V, "[libaf] Reallocating chain buffer %i, "
+	   "old len = %i, new len = %i\n",i,s->buf_len[i],len);
+    free(s->buf[i]);
+    s->buf[i] = malloc(len);
+    if(!s->buf[i]){
+      s->buf_len[i] = 0;
+      mp_msg(MSGT_AFILTER, MSGL_FATAL, "[libaf] Could not allocate memory \n");
+      return AF_ERROR;
+    }
+    s->buf_len[i] = len;
+  }
+  af->data->audio = s->buf[i];
+  af->data->len = s->buf_len[i];
+  return AF_OK;
+}
+
 // Filter data chunk through the filters in the list
 af_data_t* af_play(af_stream_t* s, af_data_t* data)
 {
   af_instance_t* af=s->first;
+  int in_len = data->len;
   // Iterate through all filters
   do{
     if (data->len <= 0) break;
-    data=af->play(af,data);
+    if((af->info->flags & AF_FLAGS_LOCAL_BUFFER) && !af->inplace){
+      if(AF_OK != af_lend_buffer(s,af,data,in_len))
+	return NULL;
+      data=af->play(af,data);
+      // Only on loan for this call
+      af->data->audio = NULL;
+      af->data->len = 0;
+    }
+    else
+      data=af->play(af,data);
     af=af->next;
   }while(af && data);
   return data;
@@ -597,18 +664,10 @@ int af_lencalc(double mul, af_data_t* d)
   return d->len * mul + t + 1;
 }
 
-// Calculate average ratio of filter output size to input size
+// Average ratio of filter output size to input size
 double af_calc_filter_multiplier(af_stream_t* s)
 {
-  af_instance_t* af=s->first;
-  double mul = 1;
-  // Iterate through all filters and calculate total multiplication factor
-  do{
-      mul *= af->mul;
-      af=af->next;
-  }while(af);
-
-  return mul;
+  return s->mul;
 }
 
 /* Calculate the total delay [bytes output] caused by the filters */
@@ -49,6 +49,10 @@ typedef struct af_data_s
 // Flags used for defining the behavior of an audio filter
 #define AF_FLAGS_REENTRANT 	0x00000000
 #define AF_FLAGS_NOT_REENTRANT 	0x00000001
+/* play() writes its output to af->data->audio after RESIZE_LOCAL_BUFFER
+   and keeps nothing in it between calls, so the chain can lend it one
+   of its own buffers instead */
+#define AF_FLAGS_LOCAL_BUFFER	0x00000002
 
 /* Audio filter information not specific for current instance, but for
    a specific filter */
@@ -77,6 +81,8 @@ typedef struct af_instance_s
 		 * corresponding output */
   double mul; /* length multiplier: how much does this instance change
 		 the length of the buffer. */
+  int inplace; /* play() writes its output over the input and does not
+		  need a buffer of its own, set on AF_CONTROL_REINIT */
 }af_instance_t;
 
 // Initialization flags
@@ -115,6 +121,14 @@ typedef struct af_stream
   af_data_t output;
   // Configuration for this stream
   af_cfg_t cfg;
+  /* Buffers lent in turn to the AF_FLAGS_LOCAL_BUFFER filters, so that
+     each one reads from one and writes to the other */
+  void* buf[2];
+  int buf_len[2];
+  /* Length multiplier of the whole chain and the largest one from the
+     chain input to the output of any filter, updated on reinit */
+  double mul;
+  double max_mul;
 }af_stream_t;
 
 /*********************************************
@@ -212,8 +226,8 @@ af_data_t* af_play(af_stream_t* s, af_data_t* data);
 af_instance_t *af_control_any_rev (af_stream_t* s, int cmd, void* arg);
 
 /**
- * \brief calculate average ratio of filter output lenth to input length
- * \return the ratio
+ * \brief average ratio of filter output lenth to input length
+ * \return the ratio, computed when the chain was last configured
  */
 double af_calc_filter_multiplier(af_stream_t* s);
 
@@ -319,10 +333,16 @@ void af_fix_parameters(af_data_t *data);
 
 /** Memory reallocation macro: if a local buffer is used (i.e. if the
    filter doesn't operate on the incoming buffer this macro must be
-   called to ensure the buffer is big enough.
+   called to ensure the buffer is big enough. For AF_FLAGS_LOCAL_BUFFER
+   filters the chain has already lent a big enough one.
  * \ingroup af_filter
  */
 #define RESIZE_LOCAL_BUFFER(a,d)\
 ((a->data->len < af_lencalc(a->mul,d))?af_resize_local_buffer(a,d):AF_OK)
 
+/** Number of samples in each channel plane of an AF_FORMAT_PLANAR block
+ * \ingroup af_filter
+ */
+#define AF_PLANE_LEN(d) ((d)->len/((d)->bps*(d)->nch))
+
 #endif /* MPLAYER_AF_H */
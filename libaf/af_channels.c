@@ -271,10 +271,18 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
   // Reset unused channels
   memset(l->audio,0,c->len / c->nch * l->nch);
 
-  if(AF_OK == check_routes(s,c->nch,l->nch))
-    for(i=0;i<s->nr;i++)
+  if(AF_OK == check_routes(s,c->nch,l->nch)){
+    // Routing planar data is a plain copy of whole planes
+    if(AF_FORMAT_IS_PLANAR(c->format)){
+      int plane = c->len / c->nch;
+      for(i=0;i<s->nr;i++)
+	memcpy((char*)l->audio + s->route[i][TO] * plane,
+	       (char*)c->audio + s->route[i][FR] * plane, plane);
+    }
+    else for(i=0;i<s->nr;i++)
       copy(c->audio,l->audio,c->nch,s->route[i][FR],
 	   l->nch,s->route[i][TO],c->len,c->bps);
+  }
 
   // Set output data
   c->audio = l->audio;
@@ -303,6 +311,6 @@ const af_info_t af_info_channels = {
   "channels",
   "Anders",
   "",
-  AF_FLAGS_REENTRANT,
+  AF_FLAGS_REENTRANT | AF_FLAGS_LOCAL_BUFFER,
   af_open
 };
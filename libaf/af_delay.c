@@ -58,6 +58,9 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
     af->data->nch    = ((af_data_t*)arg)->nch;
     af->data->format = ((af_data_t*)arg)->format;
     af->data->bps    = ((af_data_t*)arg)->bps;
+    // The delay queues are fed from interleaved samples
+    if(AF_FORMAT_IS_PLANAR(af->data->format))
+      af->data->format = AF_FORMAT_FLOAT_NE;
 
     // Allocate new delay queues
     for(i=0;i<af->data->nch;i++){
@@ -66,7 +69,9 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
 	mp_msg(MSGT_AFILTER, MSGL_FATAL, "[delay] Out of memory\n");
     }
 
-    return control(af,AF_CONTROL_DELAY_LEN | AF_CONTROL_SET,s->d);
+    if(AF_OK != control(af,AF_CONTROL_DELAY_LEN | AF_CONTROL_SET,s->d))
+      return AF_ERROR;
+    return af_test_output(af,(af_data_t*)arg);
   }
   case AF_CONTROL_COMMAND_LINE:{
     int n = 1;
@@ -0,0 +1,1119 @@
+/*
+ * sample kernels for the audio filters
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+
+#include "config.h"
+#include "cpudetect.h"
+#include "mpbswap.h"
+#include "mpx86asm.h"
+#include "af_dsp.h"
+
+#include "libavutil/common.h"
+
+static void s16_to_float_C(float *dst, const int16_t *src, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        dst[i] = (1.0f/32768.0f) * src[i];
+}
+
+static void s32_to_float_C(float *dst, const int32_t *src, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        dst[i] = (1.0f/2147483648.0f) * src[i];
+}
+
+static void float_to_s16_C(int16_t *dst, const float *src, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        dst[i] = av_clip_int16(lrintf(32768.0f * src[i]));
+}
+
+static void float_to_s32_C(int32_t *dst, const float *src, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        float f = src[i];
+        if (f <= -1.0f)
+            dst[i] = INT_MIN;
+        else if (f >= 1.0f) // no need to use corrected constant, rounding won't cause overflow
+            dst[i] = INT_MAX;
+        else
+            dst[i] = lrintf(f * 2147483648.0f);
+    }
+}
+
+static void bswap16_C(uint16_t *dst, const uint16_t *src, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        dst[i] = bswap_16(src[i]);
+}
+
+static void bswap32_C(uint32_t *dst, const uint32_t *src, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        dst[i] = bswap_32(src[i]);
+}
+
+static void gain_clip_C(float *p, float g, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        p[i] = av_clipf(p[i] * g, -1.0, 1.0);
+}
+
+static void scale_C(float *dst, const float *src, float g, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        dst[i] = src[i] * g;
+}
+
+static void mac_C(float *dst, const float *src, float g, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        dst[i] += src[i] * g;
+}
+
+/// frames i0 to n of the channels ch0 to nch
+static void deinterleave_rect(float *dst, int stride, const float *src,
+                              int nch, int ch0, int i0, int n)
+{
+    int ch, i;
+    for (ch = ch0; ch < nch; ch++)
+        for (i = i0; i < n; i++)
+            dst[ch*stride + i] = src[i*nch + ch];
+}
+
+static void interleave_rect(float *dst, const float *src, int stride,
+                            int nch, int ch0, int i0, int n)
+{
+    int ch, i;
+    for (ch = ch0; ch < nch; ch++)
+        for (i = i0; i < n; i++)
+            dst[i*nch + ch] = src[ch*stride + i];
+}
+
+static void deinterleave_C(float *dst, int stride, const float *src,
+                           int nch, int n)
+{
+    deinterleave_rect(dst, stride, src, nch, 0, 0, n);
+}
+
+static void interleave_C(float *dst, const float *src, int stride,
+                         int nch, int n)
+{
+    interleave_rect(dst, src, stride, nch, 0, 0, n);
+}
+
+static void blend_C(float *dst, const float *a, const float *b,
+                    const float *w, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        dst[i] = a[i] - w[i] * (a[i] - b[i]);
+}
+
+static void blend_s16_C(int16_t *dst, const int16_t *a, const int16_t *b,
+                        const int32_t *w, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        dst[i] = a[i] - ((w[i] * (a[i] - b[i])) >> 16);
+}
+
+// same summation order as the FIR macro in af_resample_template.c
+static void fir16_float_C(float *out, const float *x, int stride,
+                          const float *w, int nch)
+{
+    int c;
+    for (c = 0; c < nch; c++, x += stride)
+        out[c] = w[0] *x[0] +w[1] *x[1] +w[2] *x[2] +w[3] *x[3]
+               + w[4] *x[4] +w[5] *x[5] +w[6] *x[6] +w[7] *x[7]
+               + w[8] *x[8] +w[9] *x[9] +w[10]*x[10]+w[11]*x[11]
+               + w[12]*x[12]+w[13]*x[13]+w[14]*x[14]+w[15]*x[15];
+}
+
+static void fir16_s16_C(int16_t *out, const int16_t *x, int stride,
+                        const int16_t *w, int nch)
+{
+    int c;
+    for (c = 0; c < nch; c++, x += stride)
+        out[c] = ( w[0] *x[0] +w[1] *x[1] +w[2] *x[2] +w[3] *x[3]
+                 + w[4] *x[4] +w[5] *x[5] +w[6] *x[6] +w[7] *x[7]
+                 + w[8] *x[8] +w[9] *x[9] +w[10]*x[10]+w[11]*x[11]
+                 + w[12]*x[12]+w[13]*x[13]+w[14]*x[14]+w[15]*x[15] ) >> 16;
+}
+
+#if HAVE_NEON
+static void float_to_s16_NEON(int16_t *out, const float *in, int len)
+{
+    const float *in_end = in + len;
+    while (in < in_end - 7) {
+      __asm__(
+          "vld1.32 {q0,q1}, [%0]!\n\t"
+          "vcvt.s32.f32 q0, q0, #31\n\t"
+          "vqrshrn.s32  d0, q0, #15\n\t"
+          "vcvt.s32.f32 q1, q1, #31\n\t"
+          "vqrshrn.s32  d1, q1, #15\n\t"
+          "vst1.16 {q0}, [%1]!\n\t"
+      : "+r"(in), "+r"(out)
+      :: "q0", "q1", "memory");
+    }
+    while (in < in_end) {
+      __asm__(
+          "vld1.32 {d0[0]}, [%0]!\n\t"
+          "vcvt.s32.f32 d0, d0, #31\n\t"
+          "vqrshrn.s32  d0, q0, #15\n\t"
+          "vst1.16 {d0[0]}, [%1]!\n\t"
+      : "+r"(in), "+r"(out)
+      :: "d0", "memory");
+    }
+}
+
+static void gain_clip_NEON(float *data, float level, int len)
+{
+  if (len >= 8)
+  {
+    __asm__(
+      "vmov.32 d2[0], %2\n\t"
+      "vdup.32 q8, %3\n\t"
+      "vneg.f32 q9, q8\n\t"
+"0:\n\t"
+      "vld1.32 {q0}, [%0]\n\t"
+      "vmul.f32 q0, q0, d2[0]\n\t"
+      "cmp %0, %1\n\t"
+      "vmin.f32 q0, q0, q8\n\t"
+      "vmax.f32 q0, q0, q9\n\t"
+      "vst1.32 {q0}, [%0]!\n\t"
+      "blo 0b\n\t"
+    : "+&r"(data)
+    : "r"(data + len - 7), "r"(level), "r"(0x3f800000)
+    : "cc", "q0", "d2", "q8", "q9", "memory");
+    len &= 3;
+  }
+  gain_clip_C(data, level, len);
+}
+#endif /* HAVE_NEON */
+
+#if HAVE_SSE2_INLINE
+static const float __attribute__((aligned(16))) ps_1_32768[4] = { 1.0f/32768.0f, 1.0f/32768.0f, 1.0f/32768.0f, 1.0f/32768.0f };
+static const float __attribute__((aligned(16))) ps_1_2p31[4]  = { 1.0f/2147483648.0f, 1.0f/2147483648.0f, 1.0f/2147483648.0f, 1.0f/2147483648.0f };
+static const float __attribute__((aligned(16))) ps_32768[4]   = { 32768.0f, 32768.0f, 32768.0f, 32768.0f };
+static const float __attribute__((aligned(16))) ps_32767[4]   = { 32767.0f, 32767.0f, 32767.0f, 32767.0f };
+static const float __attribute__((aligned(16))) ps_m32768[4]  = { -32768.0f, -32768.0f, -32768.0f, -32768.0f };
+static const float __attribute__((aligned(16))) ps_2p31[4]    = { 2147483648.0f, 2147483648.0f, 2147483648.0f, 2147483648.0f };
+static const float __attribute__((aligned(16))) ps_1[4]       = { 1.0f, 1.0f, 1.0f, 1.0f };
+static const float __attribute__((aligned(16))) ps_m1[4]      = { -1.0f, -1.0f, -1.0f, -1.0f };
+
+static void s16_to_float_SSE2(float *dst, const int16_t *src, int n)
+{
+    int n8 = n & ~7;
+    x86_reg x = -n8;
+    if (n8)
+    __asm__ volatile(
+        "movaps        %[k], %%xmm7             \n\t"
+        "1:                                     \n\t"
+        "movdqu (%[s],%[x],2), %%xmm1           \n\t"
+        "punpcklwd   %%xmm1, %%xmm0             \n\t"
+        "punpckhwd   %%xmm1, %%xmm2             \n\t"
+        "psrad          $16, %%xmm0             \n\t"
+        "psrad          $16, %%xmm2             \n\t"
+        "cvtdq2ps    %%xmm0, %%xmm0             \n\t"
+        "cvtdq2ps    %%xmm2, %%xmm2             \n\t"
+        "mulps       %%xmm7, %%xmm0             \n\t"
+        "mulps       %%xmm7, %%xmm2             \n\t"
+        "movups      %%xmm0,   (%[d],%[x],4)    \n\t"
+        "movups      %%xmm2, 16(%[d],%[x],4)    \n\t"
+        "add             $8, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n8), [d]"r"(dst + n8), [k]"m"(*ps_1_32768)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm7",) "memory"
+    );
+    s16_to_float_C(dst + n8, src + n8, n & 7);
+}
+
+static void s32_to_float_SSE2(float *dst, const int32_t *src, int n)
+{
+    int n8 = n & ~7;
+    x86_reg x = -n8;
+    if (n8)
+    __asm__ volatile(
+        "movaps        %[k], %%xmm7             \n\t"
+        "1:                                     \n\t"
+        "movdqu   (%[s],%[x],4), %%xmm0         \n\t"
+        "movdqu 16(%[s],%[x],4), %%xmm1         \n\t"
+        "cvtdq2ps    %%xmm0, %%xmm0             \n\t"
+        "cvtdq2ps    %%xmm1, %%xmm1             \n\t"
+        "mulps       %%xmm7, %%xmm0             \n\t"
+        "mulps       %%xmm7, %%xmm1             \n\t"
+        "movups      %%xmm0,   (%[d],%[x],4)    \n\t"
+        "movups      %%xmm1, 16(%[d],%[x],4)    \n\t"
+        "add             $8, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n8), [d]"r"(dst + n8), [k]"m"(*ps_1_2p31)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm7",) "memory"
+    );
+    s32_to_float_C(dst + n8, src + n8, n & 7);
+}
+
+static void float_to_s16_SSE2(int16_t *dst, const float *src, int n)
+{
+    int n8 = n & ~7;
+    x86_reg x = -n8;
+    if (n8)
+    __asm__ volatile(
+        "movaps        %[k], %%xmm7             \n\t"
+        "movaps       %[hi], %%xmm6             \n\t"
+        "movaps       %[lo], %%xmm5             \n\t"
+        "1:                                     \n\t"
+        "movups   (%[s],%[x],4), %%xmm0         \n\t"
+        "movups 16(%[s],%[x],4), %%xmm1         \n\t"
+        "mulps       %%xmm7, %%xmm0             \n\t"
+        "mulps       %%xmm7, %%xmm1             \n\t"
+        "minps       %%xmm6, %%xmm0             \n\t"
+        "minps       %%xmm6, %%xmm1             \n\t"
+        "maxps       %%xmm5, %%xmm0             \n\t"
+        "maxps       %%xmm5, %%xmm1             \n\t"
+        "cvtps2dq    %%xmm0, %%xmm0             \n\t"
+        "cvtps2dq    %%xmm1, %%xmm1             \n\t"
+        "packssdw    %%xmm1, %%xmm0             \n\t"
+        "movdqu      %%xmm0, (%[d],%[x],2)      \n\t"
+        "add             $8, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n8), [d]"r"(dst + n8), [k]"m"(*ps_32768),
+          [hi]"m"(*ps_32767), [lo]"m"(*ps_m32768)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm5", "xmm6", "xmm7",) "memory"
+    );
+    float_to_s16_C(dst + n8, src + n8, n & 7);
+}
+
+/* cvtps2dq returns INT_MIN for everything out of range, which is right for
+   samples <= -1.0 and gets flipped to INT_MAX for samples >= 1.0 */
+static void float_to_s32_SSE2(int32_t *dst, const float *src, int n)
+{
+    int n8 = n & ~7;
+    x86_reg x = -n8;
+    if (n8)
+    __asm__ volatile(
+        "movaps        %[k], %%xmm7             \n\t"
+        "movaps      %[one], %%xmm6             \n\t"
+        "1:                                     \n\t"
+        "movups   (%[s],%[x],4), %%xmm0         \n\t"
+        "movups 16(%[s],%[x],4), %%xmm1         \n\t"
+        "movaps      %%xmm6, %%xmm2             \n\t"
+        "movaps      %%xmm6, %%xmm3             \n\t"
+        "cmpleps     %%xmm0, %%xmm2             \n\t"
+        "cmpleps     %%xmm1, %%xmm3             \n\t"
+        "mulps       %%xmm7, %%xmm0             \n\t"
+        "mulps       %%xmm7, %%xmm1             \n\t"
+        "cvtps2dq    %%xmm0, %%xmm0             \n\t"
+        "cvtps2dq    %%xmm1, %%xmm1             \n\t"
+        "pxor        %%xmm2, %%xmm0             \n\t"
+        "pxor        %%xmm3, %%xmm1             \n\t"
+        "movdqu      %%xmm0,   (%[d],%[x],4)    \n\t"
+        "movdqu      %%xmm1, 16(%[d],%[x],4)    \n\t"
+        "add             $8, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n8), [d]"r"(dst + n8), [k]"m"(*ps_2p31),
+          [one]"m"(*ps_1)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm6", "xmm7",) "memory"
+    );
+    float_to_s32_C(dst + n8, src + n8, n & 7);
+}
+
+#define BSWAP16_SSE2(r, t) \
+    "movdqa       " r ", " t "          \n\t" \
+    "psllw          $8, " r "           \n\t" \
+    "psrlw          $8, " t "           \n\t" \
+    "por          " t ", " r "          \n\t"
+
+static void bswap16_SSE2(uint16_t *dst, const uint16_t *src, int n)
+{
+    int n8 = n & ~7;
+    x86_reg x = -n8;
+    if (n8)
+    __asm__ volatile(
+        "1:                                     \n\t"
+        "movdqu (%[s],%[x],2), %%xmm0           \n\t"
+        BSWAP16_SSE2("%%xmm0", "%%xmm1")
+        "movdqu      %%xmm0, (%[d],%[x],2)      \n\t"
+        "add             $8, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n8), [d]"r"(dst + n8)
+        : XMM_CLOBBERS("xmm0", "xmm1",) "memory"
+    );
+    bswap16_C(dst + n8, src + n8, n & 7);
+}
+
+static void bswap32_SSE2(uint32_t *dst, const uint32_t *src, int n)
+{
+    int n4 = n & ~3;
+    x86_reg x = -n4;
+    if (n4)
+    __asm__ volatile(
+        "1:                                     \n\t"
+        "movdqu (%[s],%[x],4), %%xmm0           \n\t"
+        "pshuflw  $0xB1, %%xmm0, %%xmm0         \n\t"
+        "pshufhw  $0xB1, %%xmm0, %%xmm0         \n\t"
+        BSWAP16_SSE2("%%xmm0", "%%xmm1")
+        "movdqu      %%xmm0, (%[d],%[x],4)      \n\t"
+        "add             $4, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n4), [d]"r"(dst + n4)
+        : XMM_CLOBBERS("xmm0", "xmm1",) "memory"
+    );
+    bswap32_C(dst + n4, src + n4, n & 3);
+}
+
+static void gain_clip_SSE2(float *p, float g, int n)
+{
+    int n8 = n & ~7;
+    x86_reg x = -n8;
+    if (n8)
+    __asm__ volatile(
+        "movss         %[g], %%xmm7             \n\t"
+        "shufps  $0, %%xmm7, %%xmm7             \n\t"
+        "movaps       %[hi], %%xmm6             \n\t"
+        "movaps       %[lo], %%xmm5             \n\t"
+        "1:                                     \n\t"
+        "movups   (%[p],%[x],4), %%xmm0         \n\t"
+        "movups 16(%[p],%[x],4), %%xmm1         \n\t"
+        "mulps       %%xmm7, %%xmm0             \n\t"
+        "mulps       %%xmm7, %%xmm1             \n\t"
+        "minps       %%xmm6, %%xmm0             \n\t"
+        "minps       %%xmm6, %%xmm1             \n\t"
+        "maxps       %%xmm5, %%xmm0             \n\t"
+        "maxps       %%xmm5, %%xmm1             \n\t"
+        "movups      %%xmm0,   (%[p],%[x],4)    \n\t"
+        "movups      %%xmm1, 16(%[p],%[x],4)    \n\t"
+        "add             $8, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        : [x]"+r"(x)
+        : [p]"r"(p + n8), [g]"m"(g), [hi]"m"(*ps_1), [lo]"m"(*ps_m1)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm5", "xmm6", "xmm7",) "memory"
+    );
+    gain_clip_C(p + n8, g, n & 7);
+}
+
+static void scale_SSE2(float *dst, const float *src, float g, int n)
+{
+    int n8 = n & ~7;
+    x86_reg x = -n8;
+    if (n8)
+    __asm__ volatile(
+        "movss         %[g], %%xmm7             \n\t"
+        "shufps  $0, %%xmm7, %%xmm7             \n\t"
+        "1:                                     \n\t"
+        "movups   (%[s],%[x],4), %%xmm0         \n\t"
+        "movups 16(%[s],%[x],4), %%xmm1         \n\t"
+        "mulps       %%xmm7, %%xmm0             \n\t"
+        "mulps       %%xmm7, %%xmm1             \n\t"
+        "movups      %%xmm0,   (%[d],%[x],4)    \n\t"
+        "movups      %%xmm1, 16(%[d],%[x],4)    \n\t"
+        "add             $8, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n8), [d]"r"(dst + n8), [g]"m"(g)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm7",) "memory"
+    );
+    scale_C(dst + n8, src + n8, g, n & 7);
+}
+
+static void mac_SSE2(float *dst, const float *src, float g, int n)
+{
+    int n8 = n & ~7;
+    x86_reg x = -n8;
+    if (n8)
+    __asm__ volatile(
+        "movss         %[g], %%xmm7             \n\t"
+        "shufps  $0, %%xmm7, %%xmm7             \n\t"
+        "1:                                     \n\t"
+        "movups   (%[s],%[x],4), %%xmm0         \n\t"
+        "movups 16(%[s],%[x],4), %%xmm1         \n\t"
+        "movups   (%[d],%[x],4), %%xmm2         \n\t"
+        "movups 16(%[d],%[x],4), %%xmm3         \n\t"
+        "mulps       %%xmm7, %%xmm0             \n\t"
+        "mulps       %%xmm7, %%xmm1             \n\t"
+        "addps       %%xmm2, %%xmm0             \n\t"
+        "addps       %%xmm3, %%xmm1             \n\t"
+        "movups      %%xmm0,   (%[d],%[x],4)    \n\t"
+        "movups      %%xmm1, 16(%[d],%[x],4)    \n\t"
+        "add             $8, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n8), [d]"r"(dst + n8), [g]"m"(g)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm7",) "memory"
+    );
+    mac_C(dst + n8, src + n8, g, n & 7);
+}
+
+#if HAVE_6REGS
+/// 4x4 transpose of rows ss floats apart into rows ds floats apart
+static av_always_inline void transpose4_SSE2(float *dst, int ds,
+                                             const float *src, int ss)
+{
+    __asm__ volatile(
+        "movups        (%[s]), %%xmm0           \n\t"
+        "movups (%[s],%[ss]), %%xmm1            \n\t"
+        "movups (%[s],%[ss],2), %%xmm2          \n\t"
+        "movups       (%[s3]), %%xmm3           \n\t"
+        "movaps      %%xmm0, %%xmm4             \n\t"
+        "unpcklps    %%xmm1, %%xmm0             \n\t"
+        "unpckhps    %%xmm1, %%xmm4             \n\t"
+        "movaps      %%xmm2, %%xmm5             \n\t"
+        "unpcklps    %%xmm3, %%xmm2             \n\t"
+        "unpckhps    %%xmm3, %%xmm5             \n\t"
+        "movaps      %%xmm0, %%xmm1             \n\t"
+        "movlhps     %%xmm2, %%xmm0             \n\t"
+        "movhlps     %%xmm1, %%xmm2             \n\t"
+        "movaps      %%xmm4, %%xmm3             \n\t"
+        "movlhps     %%xmm5, %%xmm4             \n\t"
+        "movhlps     %%xmm3, %%xmm5             \n\t"
+        "movups      %%xmm0, (%[d])             \n\t"
+        "movups      %%xmm2, (%[d],%[ds])       \n\t"
+        "movups      %%xmm4, (%[d],%[ds],2)     \n\t"
+        "movups      %%xmm5, (%[d3])            \n\t"
+        :: [s]"r"(src), [ss]"r"((x86_reg)ss*4), [s3]"r"(src + 3*ss),
+           [d]"r"(dst), [ds]"r"((x86_reg)ds*4), [d3]"r"(dst + 3*ds)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5",) "memory"
+    );
+}
+#endif
+
+static void deinterleave_SSE2(float *dst, int stride, const float *src,
+                              int nch, int n)
+{
+    int n4 = n & ~3, ch = 0, i;
+    if (!n4)
+        goto tail;
+    if (nch == 2) {
+        x86_reg x = -n4;
+        __asm__ volatile(
+            "1:                                     \n\t"
+            "movups   (%[s],%[x],8), %%xmm0         \n\t"
+            "movups 16(%[s],%[x],8), %%xmm1         \n\t"
+            "movaps      %%xmm0, %%xmm2             \n\t"
+            "shufps $0x88, %%xmm1, %%xmm0           \n\t"
+            "shufps $0xDD, %%xmm1, %%xmm2           \n\t"
+            "movups      %%xmm0, (%[l],%[x],4)      \n\t"
+            "movups      %%xmm2, (%[r],%[x],4)      \n\t"
+            "add             $4, %[x]               \n\t"
+            "jl 1b                                  \n\t"
+            : [x]"+r"(x)
+            : [s]"r"(src + 2*n4), [l]"r"(dst + n4), [r]"r"(dst + stride + n4)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2",) "memory"
+        );
+        ch = 2;
+    }
+#if HAVE_6REGS
+    for (; ch + 4 <= nch; ch += 4)
+        for (i = 0; i < n4; i += 4)
+            transpose4_SSE2(dst + ch*stride + i, stride, src + i*nch + ch, nch);
+#endif
+    deinterleave_rect(dst, stride, src, nch, ch, 0, n4);
+tail:
+    deinterleave_rect(dst, stride, src, nch, 0, n4, n);
+}
+
+static void interleave_SSE2(float *dst, const float *src, int stride,
+                            int nch, int n)
+{
+    int n4 = n & ~3, ch = 0, i;
+    if (!n4)
+        goto tail;
+    if (nch == 2) {
+        x86_reg x = -n4;
+        __asm__ volatile(
+            "1:                                     \n\t"
+            "movups (%[l],%[x],4), %%xmm0           \n\t"
+            "movups (%[r],%[x],4), %%xmm1           \n\t"
+            "movaps      %%xmm0, %%xmm2             \n\t"
+            "unpcklps    %%xmm1, %%xmm0             \n\t"
+            "unpckhps    %%xmm1, %%xmm2             \n\t"
+            "movups      %%xmm0,   (%[d],%[x],8)    \n\t"
+            "movups      %%xmm2, 16(%[d],%[x],8)    \n\t"
+            "add             $4, %[x]               \n\t"
+            "jl 1b                                  \n\t"
+            : [x]"+r"(x)
+            : [d]"r"(dst + 2*n4), [l]"r"(src + n4), [r]"r"(src + stride + n4)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2",) "memory"
+        );
+        ch = 2;
+    }
+#if HAVE_6REGS
+    for (; ch + 4 <= nch; ch += 4)
+        for (i = 0; i < n4; i += 4)
+            transpose4_SSE2(dst + i*nch + ch, nch, src + ch*stride + i, stride);
+#endif
+    interleave_rect(dst, src, stride, nch, ch, 0, n4);
+tail:
+    interleave_rect(dst, src, stride, nch, 0, n4, n);
+}
+#if HAVE_6REGS
+static void blend_SSE2(float *dst, const float *a, const float *b,
+                       const float *w, int n)
+{
+    int n8 = n & ~7;
+    x86_reg x = -n8;
+    if (n8)
+    __asm__ volatile(
+        "1:                                     \n\t"
+        "movups   (%[a],%[x],4), %%xmm0         \n\t"
+        "movups 16(%[a],%[x],4), %%xmm1         \n\t"
+        "movups   (%[b],%[x],4), %%xmm4         \n\t"
+        "movups 16(%[b],%[x],4), %%xmm5         \n\t"
+        "movaps      %%xmm0, %%xmm2             \n\t"
+        "movaps      %%xmm1, %%xmm3             \n\t"
+        "subps       %%xmm4, %%xmm2             \n\t"
+        "subps       %%xmm5, %%xmm3             \n\t"
+        "movups   (%[w],%[x],4), %%xmm4         \n\t"
+        "movups 16(%[w],%[x],4), %%xmm5         \n\t"
+        "mulps       %%xmm4, %%xmm2             \n\t"
+        "mulps       %%xmm5, %%xmm3             \n\t"
+        "subps       %%xmm2, %%xmm0             \n\t"
+        "subps       %%xmm3, %%xmm1             \n\t"
+        "movups      %%xmm0,   (%[d],%[x],4)    \n\t"
+        "movups      %%xmm1, 16(%[d],%[x],4)    \n\t"
+        "add             $8, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        : [x]"+r"(x)
+        : [a]"r"(a + n8), [b]"r"(b + n8), [w]"r"(w + n8), [d]"r"(dst + n8)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5",)
+          "memory"
+    );
+    blend_C(dst + n8, a + n8, b + n8, w + n8, n & 7);
+}
+
+static void fir16_float_SSE2(float *out, const float *x, int stride,
+                             const float *w, int nch)
+{
+    x86_reg n = nch;
+    __asm__ volatile(
+        "movups   (%[w]), %%xmm4                \n\t"
+        "movups 16(%[w]), %%xmm5                \n\t"
+        "movups 32(%[w]), %%xmm6                \n\t"
+        "movups 48(%[w]), %%xmm7                \n\t"
+        "1:                                     \n\t"
+        "movups   (%[x]), %%xmm0                \n\t"
+        "movups 16(%[x]), %%xmm1                \n\t"
+        "movups 32(%[x]), %%xmm2                \n\t"
+        "movups 48(%[x]), %%xmm3                \n\t"
+        "mulps       %%xmm4, %%xmm0             \n\t"
+        "mulps       %%xmm5, %%xmm1             \n\t"
+        "mulps       %%xmm6, %%xmm2             \n\t"
+        "mulps       %%xmm7, %%xmm3             \n\t"
+        "addps       %%xmm1, %%xmm0             \n\t"
+        "addps       %%xmm3, %%xmm2             \n\t"
+        "addps       %%xmm2, %%xmm0             \n\t"
+        "movhlps     %%xmm0, %%xmm1             \n\t"
+        "addps       %%xmm1, %%xmm0             \n\t"
+        "movaps      %%xmm0, %%xmm1             \n\t"
+        "shufps  $0x55, %%xmm1, %%xmm1          \n\t"
+        "addss       %%xmm1, %%xmm0             \n\t"
+        "movss       %%xmm0, (%[o])             \n\t"
+        "add             $4, %[o]               \n\t"
+        "add           %[s], %[x]               \n\t"
+        "dec           %[n]                     \n\t"
+        "jnz 1b                                 \n\t"
+        : [x]"+r"(x), [o]"+r"(out), [n]"+r"(n)
+        : [w]"r"(w), [s]"r"((x86_reg)stride * 4)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+                       "xmm4", "xmm5", "xmm6", "xmm7",) "memory"
+    );
+}
+
+/* The low 16 bits of the sum are stored like the C version truncates,
+   pmaddwd gives the same sums as long as they do not overflow in C. */
+static void fir16_s16_SSE2(int16_t *out, const int16_t *x, int stride,
+                           const int16_t *w, int nch)
+{
+    x86_reg n = nch, t;
+    __asm__ volatile(
+        "movdqu   (%[w]), %%xmm4                \n\t"
+        "movdqu 16(%[w]), %%xmm5                \n\t"
+        "1:                                     \n\t"
+        "movdqu   (%[x]), %%xmm0                \n\t"
+        "movdqu 16(%[x]), %%xmm1                \n\t"
+        "pmaddwd     %%xmm4, %%xmm0             \n\t"
+        "pmaddwd     %%xmm5, %%xmm1             \n\t"
+        "paddd       %%xmm1, %%xmm0             \n\t"
+        "pshufd $0x4e, %%xmm0, %%xmm1           \n\t"
+        "paddd       %%xmm1, %%xmm0             \n\t"
+        "pshufd $0xb1, %%xmm0, %%xmm1           \n\t"
+        "paddd       %%xmm1, %%xmm0             \n\t"
+        "psrad          $16, %%xmm0             \n\t"
+        "movd        %%xmm0, %k[t]              \n\t"
+        "mov           %w[t], (%[o])            \n\t"
+        "add             $2, %[o]               \n\t"
+        "add           %[s], %[x]               \n\t"
+        "dec           %[n]                     \n\t"
+        "jnz 1b                                 \n\t"
+        : [x]"+r"(x), [o]"+r"(out), [n]"+r"(n), [t]"=&r"(t)
+        : [w]"r"(w), [s]"r"((x86_reg)stride * 2)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm4", "xmm5",) "memory"
+    );
+}
+#endif
+#endif /* HAVE_SSE2_INLINE */
+
+#if HAVE_AVX2_INLINE
+static const uint8_t __attribute__((aligned(16))) pb_bswap16[16] = { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 };
+static const uint8_t __attribute__((aligned(16))) pb_bswap32[16] = { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 };
+
+static void s16_to_float_AVX2(float *dst, const int16_t *src, int n)
+{
+    int n16 = n & ~15;
+    x86_reg x = -n16;
+    if (n16)
+    __asm__ volatile(
+        "vbroadcastss  %[k], %%ymm7             \n\t"
+        "1:                                     \n\t"
+        "vpmovsxwd   (%[s],%[x],2), %%ymm0      \n\t"
+        "vpmovsxwd 16(%[s],%[x],2), %%ymm1      \n\t"
+        "vcvtdq2ps   %%ymm0, %%ymm0             \n\t"
+        "vcvtdq2ps   %%ymm1, %%ymm1             \n\t"
+        "vmulps      %%ymm7, %%ymm0, %%ymm0     \n\t"
+        "vmulps      %%ymm7, %%ymm1, %%ymm1     \n\t"
+        "vmovups     %%ymm0,   (%[d],%[x],4)    \n\t"
+        "vmovups     %%ymm1, 32(%[d],%[x],4)    \n\t"
+        "add            $16, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n16), [d]"r"(dst + n16), [k]"m"(*ps_1_32768)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm7",) "memory"
+    );
+    s16_to_float_C(dst + n16, src + n16, n & 15);
+}
+
+static void s32_to_float_AVX2(float *dst, const int32_t *src, int n)
+{
+    int n16 = n & ~15;
+    x86_reg x = -n16;
+    if (n16)
+    __asm__ volatile(
+        "vbroadcastss  %[k], %%ymm7             \n\t"
+        "1:                                     \n\t"
+        "vcvtdq2ps   (%[s],%[x],4), %%ymm0      \n\t"
+        "vcvtdq2ps 32(%[s],%[x],4), %%ymm1      \n\t"
+        "vmulps      %%ymm7, %%ymm0, %%ymm0     \n\t"
+        "vmulps      %%ymm7, %%ymm1, %%ymm1     \n\t"
+        "vmovups     %%ymm0,   (%[d],%[x],4)    \n\t"
+        "vmovups     %%ymm1, 32(%[d],%[x],4)    \n\t"
+        "add            $16, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n16), [d]"r"(dst + n16), [k]"m"(*ps_1_2p31)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm7",) "memory"
+    );
+    s32_to_float_C(dst + n16, src + n16, n & 15);
+}
+
+static void float_to_s16_AVX2(int16_t *dst, const float *src, int n)
+{
+    int n16 = n & ~15;
+    x86_reg x = -n16;
+    if (n16)
+    __asm__ volatile(
+        "vbroadcastss  %[k], %%ymm7             \n\t"
+        "vbroadcastss %[hi], %%ymm6             \n\t"
+        "vbroadcastss %[lo], %%ymm5             \n\t"
+        "1:                                     \n\t"
+        "vmulps   (%[s],%[x],4), %%ymm7, %%ymm0 \n\t"
+        "vmulps 32(%[s],%[x],4), %%ymm7, %%ymm1 \n\t"
+        "vminps      %%ymm6, %%ymm0, %%ymm0     \n\t"
+        "vminps      %%ymm6, %%ymm1, %%ymm1     \n\t"
+        "vmaxps      %%ymm5, %%ymm0, %%ymm0     \n\t"
+        "vmaxps      %%ymm5, %%ymm1, %%ymm1     \n\t"
+        "vcvtps2dq   %%ymm0, %%ymm0             \n\t"
+        "vcvtps2dq   %%ymm1, %%ymm1             \n\t"
+        "vpackssdw   %%ymm1, %%ymm0, %%ymm0     \n\t"
+        "vpermq $0xD8, %%ymm0, %%ymm0           \n\t"
+        "vmovdqu     %%ymm0, (%[d],%[x],2)      \n\t"
+        "add            $16, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n16), [d]"r"(dst + n16), [k]"m"(*ps_32768),
+          [hi]"m"(*ps_32767), [lo]"m"(*ps_m32768)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm5", "xmm6", "xmm7",) "memory"
+    );
+    float_to_s16_C(dst + n16, src + n16, n & 15);
+}
+
+static void float_to_s32_AVX2(int32_t *dst, const float *src, int n)
+{
+    int n16 = n & ~15;
+    x86_reg x = -n16;
+    if (n16)
+    __asm__ volatile(
+        "vbroadcastss  %[k], %%ymm7             \n\t"
+        "vbroadcastss %[one], %%ymm6            \n\t"
+        "1:                                     \n\t"
+        "vmovups   (%[s],%[x],4), %%ymm0        \n\t"
+        "vmovups 32(%[s],%[x],4), %%ymm1        \n\t"
+        "vcmpleps    %%ymm0, %%ymm6, %%ymm2     \n\t"
+        "vcmpleps    %%ymm1, %%ymm6, %%ymm3     \n\t"
+        "vmulps      %%ymm7, %%ymm0, %%ymm0     \n\t"
+        "vmulps      %%ymm7, %%ymm1, %%ymm1     \n\t"
+        "vcvtps2dq   %%ymm0, %%ymm0             \n\t"
+        "vcvtps2dq   %%ymm1, %%ymm1             \n\t"
+        "vpxor       %%ymm2, %%ymm0, %%ymm0     \n\t"
+        "vpxor       %%ymm3, %%ymm1, %%ymm1     \n\t"
+        "vmovdqu     %%ymm0,   (%[d],%[x],4)    \n\t"
+        "vmovdqu     %%ymm1, 32(%[d],%[x],4)    \n\t"
+        "add            $16, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n16), [d]"r"(dst + n16), [k]"m"(*ps_2p31),
+          [one]"m"(*ps_1)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm6", "xmm7",) "memory"
+    );
+    float_to_s32_C(dst + n16, src + n16, n & 15);
+}
+
+static void bswap16_AVX2(uint16_t *dst, const uint16_t *src, int n)
+{
+    int n16 = n & ~15;
+    x86_reg x = -n16;
+    if (n16)
+    __asm__ volatile(
+        "vbroadcasti128 %[m], %%ymm7            \n\t"
+        "1:                                     \n\t"
+        "vmovdqu (%[s],%[x],2), %%ymm0          \n\t"
+        "vpshufb     %%ymm7, %%ymm0, %%ymm0     \n\t"
+        "vmovdqu     %%ymm0, (%[d],%[x],2)      \n\t"
+        "add            $16, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n16), [d]"r"(dst + n16), [m]"m"(*pb_bswap16)
+        : XMM_CLOBBERS("xmm0", "xmm7",) "memory"
+    );
+    bswap16_C(dst + n16, src + n16, n & 15);
+}
+
+static void bswap32_AVX2(uint32_t *dst, const uint32_t *src, int n)
+{
+    int n8 = n & ~7;
+    x86_reg x = -n8;
+    if (n8)
+    __asm__ volatile(
+        "vbroadcasti128 %[m], %%ymm7            \n\t"
+        "1:                                     \n\t"
+        "vmovdqu (%[s],%[x],4), %%ymm0          \n\t"
+        "vpshufb     %%ymm7, %%ymm0, %%ymm0     \n\t"
+        "vmovdqu     %%ymm0, (%[d],%[x],4)      \n\t"
+        "add             $8, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n8), [d]"r"(dst + n8), [m]"m"(*pb_bswap32)
+        : XMM_CLOBBERS("xmm0", "xmm7",) "memory"
+    );
+    bswap32_C(dst + n8, src + n8, n & 7);
+}
+
+static void gain_clip_AVX2(float *p, float g, int n)
+{
+    int n16 = n & ~15;
+    x86_reg x = -n16;
+    if (n16)
+    __asm__ volatile(
+        "vbroadcastss  %[g], %%ymm7             \n\t"
+        "vbroadcastss %[hi], %%ymm6             \n\t"
+        "vbroadcastss %[lo], %%ymm5             \n\t"
+        "1:                                     \n\t"
+        "vmulps   (%[p],%[x],4), %%ymm7, %%ymm0 \n\t"
+        "vmulps 32(%[p],%[x],4), %%ymm7, %%ymm1 \n\t"
+        "vminps      %%ymm6, %%ymm0, %%ymm0     \n\t"
+        "vminps      %%ymm6, %%ymm1, %%ymm1     \n\t"
+        "vmaxps      %%ymm5, %%ymm0, %%ymm0     \n\t"
+        "vmaxps      %%ymm5, %%ymm1, %%ymm1     \n\t"
+        "vmovups     %%ymm0,   (%[p],%[x],4)    \n\t"
+        "vmovups     %%ymm1, 32(%[p],%[x],4)    \n\t"
+        "add            $16, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x)
+        : [p]"r"(p + n16), [g]"m"(g), [hi]"m"(*ps_1), [lo]"m"(*ps_m1)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm5", "xmm6", "xmm7",) "memory"
+    );
+    gain_clip_C(p + n16, g, n & 15);
+}
+
+static void scale_AVX2(float *dst, const float *src, float g, int n)
+{
+    int n16 = n & ~15;
+    x86_reg x = -n16;
+    if (n16)
+    __asm__ volatile(
+        "vbroadcastss  %[g], %%ymm7             \n\t"
+        "1:                                     \n\t"
+        "vmulps   (%[s],%[x],4), %%ymm7, %%ymm0 \n\t"
+        "vmulps 32(%[s],%[x],4), %%ymm7, %%ymm1 \n\t"
+        "vmovups     %%ymm0,   (%[d],%[x],4)    \n\t"
+        "vmovups     %%ymm1, 32(%[d],%[x],4)    \n\t"
+        "add            $16, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n16), [d]"r"(dst + n16), [g]"m"(g)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm7",) "memory"
+    );
+    scale_C(dst + n16, src + n16, g, n & 15);
+}
+
+/* multiply and add separately instead of vfmadd, so that the result
+   matches the C and SSE2 versions */
+static void mac_AVX2(float *dst, const float *src, float g, int n)
+{
+    int n16 = n & ~15;
+    x86_reg x = -n16;
+    if (n16)
+    __asm__ volatile(
+        "vbroadcastss  %[g], %%ymm7             \n\t"
+        "1:                                     \n\t"
+        "vmulps   (%[s],%[x],4), %%ymm7, %%ymm0 \n\t"
+        "vmulps 32(%[s],%[x],4), %%ymm7, %%ymm1 \n\t"
+        "vaddps   (%[d],%[x],4), %%ymm0, %%ymm0 \n\t"
+        "vaddps 32(%[d],%[x],4), %%ymm1, %%ymm1 \n\t"
+        "vmovups     %%ymm0,   (%[d],%[x],4)    \n\t"
+        "vmovups     %%ymm1, 32(%[d],%[x],4)    \n\t"
+        "add            $16, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x)
+        : [s]"r"(src + n16), [d]"r"(dst + n16), [g]"m"(g)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm7",) "memory"
+    );
+    mac_C(dst + n16, src + n16, g, n & 15);
+}
+#if HAVE_6REGS
+static void blend_AVX2(float *dst, const float *a, const float *b,
+                       const float *w, int n)
+{
+    int n16 = n & ~15;
+    x86_reg x = -n16;
+    if (n16)
+    __asm__ volatile(
+        "1:                                     \n\t"
+        "vmovups  (%[a],%[x],4), %%ymm0         \n\t"
+        "vmovups 32(%[a],%[x],4), %%ymm1        \n\t"
+        "vsubps   (%[b],%[x],4), %%ymm0, %%ymm2 \n\t"
+        "vsubps 32(%[b],%[x],4), %%ymm1, %%ymm3 \n\t"
+        "vmulps   (%[w],%[x],4), %%ymm2, %%ymm2 \n\t"
+        "vmulps 32(%[w],%[x],4), %%ymm3, %%ymm3 \n\t"
+        "vsubps      %%ymm2, %%ymm0, %%ymm0     \n\t"
+        "vsubps      %%ymm3, %%ymm1, %%ymm1     \n\t"
+        "vmovups     %%ymm0,   (%[d],%[x],4)    \n\t"
+        "vmovups     %%ymm1, 32(%[d],%[x],4)    \n\t"
+        "add            $16, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x)
+        : [a]"r"(a + n16), [b]"r"(b + n16), [w]"r"(w + n16), [d]"r"(dst + n16)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",) "memory"
+    );
+    blend_C(dst + n16, a + n16, b + n16, w + n16, n & 15);
+}
+
+/* vpmulld wraps like the 32 bit multiply in C, and the result is
+   truncated to 16 bits by sign extending the low half before packing */
+static void blend_s16_AVX2(int16_t *dst, const int16_t *a, const int16_t *b,
+                           const int32_t *w, int n)
+{
+    int n16 = n & ~15;
+    x86_reg x = -n16;
+    if (n16)
+    __asm__ volatile(
+        "1:                                     \n\t"
+        "vpmovsxwd   (%[a],%[x],2), %%ymm0      \n\t"
+        "vpmovsxwd 16(%[a],%[x],2), %%ymm1      \n\t"
+        "vpmovsxwd   (%[b],%[x],2), %%ymm2      \n\t"
+        "vpmovsxwd 16(%[b],%[x],2), %%ymm3      \n\t"
+        "vpsubd      %%ymm2, %%ymm0, %%ymm2     \n\t"
+        "vpsubd      %%ymm3, %%ymm1, %%ymm3     \n\t"
+        "vpmulld  (%[w],%[x],4), %%ymm2, %%ymm2 \n\t"
+        "vpmulld 32(%[w],%[x],4), %%ymm3, %%ymm3\n\t"
+        "vpsrad         $16, %%ymm2, %%ymm2     \n\t"
+        "vpsrad         $16, %%ymm3, %%ymm3     \n\t"
+        "vpsubd      %%ymm2, %%ymm0, %%ymm0     \n\t"
+        "vpsubd      %%ymm3, %%ymm1, %%ymm1     \n\t"
+        "vpslld         $16, %%ymm0, %%ymm0     \n\t"
+        "vpslld         $16, %%ymm1, %%ymm1     \n\t"
+        "vpsrad         $16, %%ymm0, %%ymm0     \n\t"
+        "vpsrad         $16, %%ymm1, %%ymm1     \n\t"
+        "vpackssdw   %%ymm1, %%ymm0, %%ymm0     \n\t"
+        "vpermq   $0xd8, %%ymm0, %%ymm0         \n\t"
+        "vmovdqu     %%ymm0, (%[d],%[x],2)      \n\t"
+        "add            $16, %[x]               \n\t"
+        "jl 1b                                  \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x)
+        : [a]"r"(a + n16), [b]"r"(b + n16), [w]"r"(w + n16), [d]"r"(dst + n16)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",) "memory"
+    );
+    blend_s16_C(dst + n16, a + n16, b + n16, w + n16, n & 15);
+}
+
+static void fir16_float_AVX2(float *out, const float *x, int stride,
+                             const float *w, int nch)
+{
+    x86_reg n = nch;
+    __asm__ volatile(
+        "vmovups   (%[w]), %%ymm4               \n\t"
+        "vmovups 32(%[w]), %%ymm5               \n\t"
+        "1:                                     \n\t"
+        "vmulps   (%[x]), %%ymm4, %%ymm0        \n\t"
+        "vmulps 32(%[x]), %%ymm5, %%ymm1        \n\t"
+        "vaddps      %%ymm1, %%ymm0, %%ymm0     \n\t"
+        "vextractf128 $1, %%ymm0, %%xmm1        \n\t"
+        "vaddps      %%xmm1, %%xmm0, %%xmm0     \n\t"
+        "vmovhlps    %%xmm0, %%xmm0, %%xmm1     \n\t"
+        "vaddps      %%xmm1, %%xmm0, %%xmm0     \n\t"
+        "vshufps $0x55, %%xmm0, %%xmm0, %%xmm1  \n\t"
+        "vaddss      %%xmm1, %%xmm0, %%xmm0     \n\t"
+        "vmovss      %%xmm0, (%[o])             \n\t"
+        "add             $4, %[o]               \n\t"
+        "add           %[s], %[x]               \n\t"
+        "dec           %[n]                     \n\t"
+        "jnz 1b                                 \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x), [o]"+r"(out), [n]"+r"(n)
+        : [w]"r"(w), [s]"r"((x86_reg)stride * 4)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm4", "xmm5",) "memory"
+    );
+}
+
+static void fir16_s16_AVX2(int16_t *out, const int16_t *x, int stride,
+                           const int16_t *w, int nch)
+{
+    x86_reg n = nch, t;
+    __asm__ volatile(
+        "vmovdqu     (%[w]), %%ymm4             \n\t"
+        "1:                                     \n\t"
+        "vpmaddwd    (%[x]), %%ymm4, %%ymm0     \n\t"
+        "vextracti128 $1, %%ymm0, %%xmm1        \n\t"
+        "vpaddd      %%xmm1, %%xmm0, %%xmm0     \n\t"
+        "vpshufd $0x4e, %%xmm0, %%xmm1          \n\t"
+        "vpaddd      %%xmm1, %%xmm0, %%xmm0     \n\t"
+        "vpshufd $0xb1, %%xmm0, %%xmm1          \n\t"
+        "vpaddd      %%xmm1, %%xmm0, %%xmm0     \n\t"
+        "vpsrad         $16, %%xmm0, %%xmm0     \n\t"
+        "vmovd       %%xmm0, %k[t]              \n\t"
+        "mov           %w[t], (%[o])            \n\t"
+        "add             $2, %[o]               \n\t"
+        "add           %[s], %[x]               \n\t"
+        "dec           %[n]                     \n\t"
+        "jnz 1b                                 \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x), [o]"+r"(out), [n]"+r"(n), [t]"=&r"(t)
+        : [w]"r"(w), [s]"r"((x86_reg)stride * 2)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm4",) "memory"
+    );
+}
+#endif
+#endif /* HAVE_AVX2_INLINE */
+
+unsigned int af_dsp_cpu_caps(void)
+{
+    return (gCpuCaps.hasSSE2 ? AF_DSP_CPU_SSE2 : 0) |
+           (gCpuCaps.hasAVX2 ? AF_DSP_CPU_AVX2 : 0);
+}
+
+void af_dsp_init(struct af_dsp *dsp, unsigned int cpu)
+{
+    dsp->s16_to_float = s16_to_float_C;
+    dsp->s32_to_float = s32_to_float_C;
+    dsp->float_to_s16 = float_to_s16_C;
+    dsp->float_to_s32 = float_to_s32_C;
+    dsp->bswap16      = bswap16_C;
+    dsp->bswap32      = bswap32_C;
+    dsp->gain_clip    = gain_clip_C;
+    dsp->scale        = scale_C;
+    dsp->mac          = mac_C;
+    dsp->deinterleave = deinterleave_C;
+    dsp->interleave   = interleave_C;
+    dsp->blend        = blend_C;
+    dsp->blend_s16    = blend_s16_C;
+    dsp->fir16_float  = fir16_float_C;
+    dsp->fir16_s16    = fir16_s16_C;
+#if HAVE_NEON
+    dsp->float_to_s16 = float_to_s16_NEON;
+    dsp->gain_clip    = gain_clip_NEON;
+#endif
+#if HAVE_SSE2_INLINE
+    if (cpu & AF_DSP_CPU_SSE2) {
+        dsp->s16_to_float = s16_to_float_SSE2;
+        dsp->s32_to_float = s32_to_float_SSE2;
+        dsp->float_to_s16 = float_to_s16_SSE2;
+        dsp->float_to_s32 = float_to_s32_SSE2;
+        dsp->bswap16      = bswap16_SSE2;
+        dsp->bswap32      = bswap32_SSE2;
+        dsp->gain_clip    = gain_clip_SSE2;
+        dsp->scale        = scale_SSE2;
+        dsp->mac          = mac_SSE2;
+        dsp->deinterleave = deinterleave_SSE2;
+        dsp->interleave   = interleave_SSE2;
+#if HAVE_6REGS
+        dsp->blend        = blend_SSE2;
+        dsp->fir16_float  = fir16_float_SSE2;
+        dsp->fir16_s16    = fir16_s16_SSE2;
+#endif
+    }
+#endif
+#if HAVE_AVX2_INLINE
+    if (cpu & AF_DSP_CPU_AVX2) {
+        dsp->s16_to_float = s16_to_float_AVX2;
+        dsp->s32_to_float = s32_to_float_AVX2;
+        dsp->float_to_s16 = float_to_s16_AVX2;
+        dsp->float_to_s32 = float_to_s32_AVX2;
+        dsp->bswap16      = bswap16_AVX2;
+        dsp->bswap32      = bswap32_AVX2;
+        dsp->gain_clip    = gain_clip_AVX2;
+        dsp->scale        = scale_AVX2;
+        dsp->mac          = mac_AVX2;
+#if HAVE_6REGS
+        dsp->blend        = blend_AVX2;
+        dsp->blend_s16    = blend_s16_AVX2;
+        dsp->fir16_float  = fir16_float_AVX2;
+        dsp->fir16_s16    = fir16_s16_AVX2;
+#endif
+    }
+#endif
+}
@@ -0,0 +1,73 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_AF_DSP_H
+#define MPLAYER_AF_DSP_H
+
+#include <stdint.h>
+
+#define AF_DSP_CPU_SSE2 1
+#define AF_DSP_CPU_AVX2 2
+
+/**
+ * Sample kernels shared by the format, volume, pan, scaletempo and
+ * resample filters. They need no particular alignment. Except for
+ * fir16_float, which sums in a different order, the x86 versions give
+ * the same results as the C versions.
+ */
+struct af_dsp {
+    /// native endian integer samples to float, scaled to [-1, 1)
+    void (*s16_to_float)(float *dst, const int16_t *src, int n);
+    void (*s32_to_float)(float *dst, const int32_t *src, int n);
+    /// float to native endian integer samples, rounded to nearest and clipped
+    void (*float_to_s16)(int16_t *dst, const float *src, int n);
+    void (*float_to_s32)(int32_t *dst, const float *src, int n);
+    /// byte swap, dst may be src
+    void (*bswap16)(uint16_t *dst, const uint16_t *src, int n);
+    void (*bswap32)(uint32_t *dst, const uint32_t *src, int n);
+    /// p[i] = clip(p[i] * g, -1, 1)
+    void (*gain_clip)(float *p, float g, int n);
+    /// dst[i] = src[i] * g
+    void (*scale)(float *dst, const float *src, float g, int n);
+    /// dst[i] += src[i] * g
+    void (*mac)(float *dst, const float *src, float g, int n);
+    /// n frames of nch interleaved samples to nch planes stride samples apart
+    void (*deinterleave)(float *dst, int stride, const float *src,
+                         int nch, int n);
+    /// n frames from nch planes stride samples apart to interleaved samples
+    void (*interleave)(float *dst, const float *src, int stride,
+                       int nch, int n);
+    /// dst[i] = a[i] - w[i] * (a[i] - b[i])
+    void (*blend)(float *dst, const float *a, const float *b,
+                  const float *w, int n);
+    /// the same with weights in units of 1/65536, truncated like C does
+    void (*blend_s16)(int16_t *dst, const int16_t *a, const int16_t *b,
+                      const int32_t *w, int n);
+    /// 16 tap FIR of nch channels for the resampler: out[c] is the sum of
+    /// w[t] * x[c*stride + t], shifted right by 16 for s16
+    void (*fir16_float)(float *out, const float *x, int stride,
+                        const float *w, int nch);
+    void (*fir16_s16)(int16_t *out, const int16_t *x, int stride,
+                      const int16_t *w, int nch);
+};
+
+/// AF_DSP_CPU_* flags for the CPU found by cpudetect
+unsigned int af_dsp_cpu_caps(void);
+void af_dsp_init(struct af_dsp *dsp, unsigned int cpu);
+
+#endif /* MPLAYER_AF_DSP_H */
@@ -100,7 +100,8 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
 
     af->data->rate   = ((af_data_t*)arg)->rate;
     af->data->nch    = ((af_data_t*)arg)->nch;
-    af->data->format = AF_FORMAT_FLOAT_NE;
+    af->data->format = AF_FORMAT_IS_PLANAR(((af_data_t*)arg)->format) ?
+                       AF_FORMAT_FLOAT_PLANAR : AF_FORMAT_FLOAT_NE;
     af->data->bps    = 4;
 
     // Calculate number of active filters
@@ -194,17 +195,19 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
   af_equalizer_t*  s 	= (af_equalizer_t*)af->setup; 	// Setup
   uint32_t  	   ci  	= af->data->nch; 	    	// Index for channels
   uint32_t	   nch 	= af->data->nch;   	    	// Number of channels
+  int		   planar = AF_FORMAT_IS_PLANAR(c->format);
+  uint32_t	   step = planar ? 1 : nch;		// Distance between samples
 
   while(ci--){
     float*	g   = s->g[ci];      // Gain factor
-    float*	in  = ((float*)c->audio)+ci;
-    float*	out = ((float*)c->audio)+ci;
-    float* 	end = in + c->len/4; // Block loop end
+    float*	in  = ((float*)c->audio)+(planar ? ci*AF_PLANE_LEN(c) : ci);
+    float*	out = in;
+    float* 	end = in + c->len/4/nch*step; // Block loop end
 
     while(in < end){
       register int	k  = 0;		// Frequency band index
       register float 	yt = *in; 	// Current input sample
-      in+=nch;
+      in+=step;
 
       // Run the filters
       for(;k<s->K;k++){
@@ -220,7 +223,7 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
       }
       // Calculate output
       *out=yt*s->gain_factor;
-      out+=nch;
+      out+=step;
     }
   }
   return c;
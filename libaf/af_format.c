@@ -29,6 +29,7 @@
 
 #include "config.h"
 #include "af.h"
+#include "af_dsp.h"
 #include "mp_msg.h"
 #include "mpbswap.h"
 #include "libvo/fastmemcpy.h"
@@ -57,8 +58,18 @@ static void int2float(const void* in, float* out, int len, int bps);
 
 static af_data_t* play(struct af_instance_s* af, af_data_t* data);
 static af_data_t* play_swapendian(struct af_instance_s* af, af_data_t* data);
-static af_data_t* play_float_s16(struct af_instance_s* af, af_data_t* data);
-static af_data_t* play_s16_float(struct af_instance_s* af, af_data_t* data);
+static af_data_t* play_float_int(struct af_instance_s* af, af_data_t* data);
+static af_data_t* play_int_float(struct af_instance_s* af, af_data_t* data);
+static af_data_t* play_planar(struct af_instance_s* af, af_data_t* data);
+
+// Frames converted per step to and from the planar layout
+#define PLANAR_CHUNK 256
+
+// Data for specific instances of this filter
+typedef struct af_format_s
+{
+  struct af_dsp dsp;
+}af_format_t;
 
 // Helper functions to check sanity for input arguments
 
@@ -77,6 +88,8 @@ static int check_bps(int bps)
 static int check_format(int format)
 {
   char buf[256];
+  // Only native endian float may be planar
+  if(!AF_FORMAT_IS_PLANAR(format) || format == AF_FORMAT_FLOAT_PLANAR)
   switch(format & AF_FORMAT_SPECIAL_MASK){
   case 0:
   case AF_FORMAT_MU_LAW:
@@ -139,19 +152,26 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
 	af->play = play_swapendian;
     }
     if ((data->format == AF_FORMAT_FLOAT_NE) &&
-	(af->data->format == AF_FORMAT_S16_NE))
+	(af->data->format == AF_FORMAT_S16_NE ||
+	 af->data->format == AF_FORMAT_S32_NE))
     {
 	mp_msg(MSGT_AFILTER, MSGL_V, "[format] Accelerated %s to %s conversion\n",
 	   buf1, buf2);
-	af->play = play_float_s16;
+	af->play = play_float_int;
     }
-    if ((data->format == AF_FORMAT_S16_NE) &&
+    if ((data->format == AF_FORMAT_S16_NE ||
+	 data->format == AF_FORMAT_S32_NE) &&
 	(af->data->format == AF_FORMAT_FLOAT_NE))
     {
 	mp_msg(MSGT_AFILTER, MSGL_V, "[format] Accelerated %s to %s conversion\n",
 	   buf1, buf2);
-	af->play = play_s16_float;
+	af->play = play_int_float;
     }
+    // The generic conversions do not know about the sample layout
+    if (AF_FORMAT_IS_PLANAR(data->format) ||
+	AF_FORMAT_IS_PLANAR(af->data->format))
+	af->play = play_planar;
+    af->inplace = af->play == play_swapendian || af->play == play_float_int;
     return AF_OK;
   }
   case AF_CONTROL_COMMAND_LINE:{
@@ -184,55 +204,66 @@ static void uninit(struct af_instance_s* af)
   if (af->data)
       free(af->data->audio);
   free(af->data);
+  free(af->setup);
   af->setup = 0;
 }
 
+// Works in place
 static af_data_t* play_swapendian(struct af_instance_s* af, af_data_t* data)
 {
   af_data_t*   l   = af->data;	// Local data
   af_data_t*   c   = data;	// Current working data
   int 	       len = c->len/c->bps; // Length in samples of current audio block
 
-  if(AF_OK != RESIZE_LOCAL_BUFFER(af,data))
-    return NULL;
+  af_format_t* s   = af->setup;
 
-  endian(c->audio,l->audio,len,c->bps);
+  if(c->bps == 2)
+    s->dsp.bswap16(c->audio,c->audio,len);
+  else if(c->bps == 4)
+    s->dsp.bswap32(c->audio,c->audio,len);
+  else
+    endian(c->audio,c->audio,len,c->bps);
 
-  c->audio = l->audio;
   c->format = l->format;
 
   return c;
 }
 
-static af_data_t* play_float_s16(struct af_instance_s* af, af_data_t* data)
+/* Works in place, the kernels only write samples at or before the ones
+   they have read */
+static af_data_t* play_float_int(struct af_instance_s* af, af_data_t* data)
 {
   af_data_t*   l   = af->data;	// Local data
   af_data_t*   c   = data;	// Current working data
+  af_format_t* s   = af->setup;
   int 	       len = c->len/4; // Length in samples of current audio block
 
-  if(AF_OK != RESIZE_LOCAL_BUFFER(af,data))
-    return NULL;
+  if(l->bps == 2)
+    s->dsp.float_to_s16(c->audio, c->audio, len);
+  else
+    s->dsp.float_to_s32(c->audio, c->audio, len);
 
-  float2int(c->audio, l->audio, len, 2);
-
-  c->audio = l->audio;
-  c->len = len*2;
-  c->bps = 2;
+  c->len = len*l->bps;
+  c->bps = l->bps;
   c->format = l->format;
 
   return c;
 }
 
-static af_data_t* play_s16_float(struct af_instance_s* af, af_data_t* data)
+static af_data_t* play_int_float(struct af_instance_s* af, af_data_t* data)
 {
   af_data_t*   l   = af->data;	// Local data
   af_data_t*   c   = data;	// Current working data
-  int 	       len = c->len/2; // Length in samples of current audio block
+  af_format_t* s   = af->setup;
+  int 	       len = c->len/c->bps; // Length in samples of current audio block
 
   if(AF_OK != RESIZE_LOCAL_BUFFER(af,data))
     return NULL;
 
-  int2float(c->audio, l->audio, len, 2);
+  if(c->bps == 2)
+    s->dsp.s16_to_float(l->audio, c->audio, len);
+  else
+    s->dsp.s32_to_float(l->audio, c->audio, len);
 
   c->audio = l->audio;
   c->len = len*4;
@@ -242,6 +273,117 @@ static af_data_t* play_s16_float(struct af_instance_s* af, af_data_t* data)
   return c;
 }
 
+// Convert len samples of any supported interleaved format to native float
+static void to_float(af_format_t* s, void* in, int format, int bps,
+		     float* out, int len)
+{
+  if(format == AF_FORMAT_S16_NE){
+    s->dsp.s16_to_float(out, in, len);
+    return;
+  }
+  if(format == AF_FORMAT_S32_NE){
+    s->dsp.s32_to_float(out, in, len);
+    return;
+  }
+  if((format&AF_FORMAT_END_MASK)!=AF_FORMAT_NE)
+    endian(in,in,len,bps);
+  switch(format&AF_FORMAT_SPECIAL_MASK){
+  case(AF_FORMAT_MU_LAW):
+    from_ulaw(in, out, len, 4, AF_FORMAT_F);
+    break;
+  case(AF_FORMAT_A_LAW):
+    from_alaw(in, out, len, 4, AF_FORMAT_F);
+    break;
+  default:
+    if((format&AF_FORMAT_POINT_MASK) == AF_FORMAT_F)
+      fast_memcpy(out,in,len*4);
+    else{
+      if((format&AF_FORMAT_SIGN_MASK) == AF_FORMAT_US)
+	si2us(in,len,bps);
+      int2float(in, out, len, bps);
+    }
+    break;
+  }
+}
+
+// Convert len native float samples to any supported interleaved format
+static void from_float(af_format_t* s, float* in, void* out, int format,
+		       int bps, int len)
+{
+  if(format == AF_FORMAT_S16_NE){
+    s->dsp.float_to_s16(out, in, len);
+    return;
+  }
+  if(format == AF_FORMAT_S32_NE){
+    s->dsp.float_to_s32(out, in, len);
+    return;
+  }
+  switch(format&AF_FORMAT_SPECIAL_MASK){
+  case(AF_FORMAT_MU_LAW):
+    to_ulaw(in, out, len, 4, AF_FORMAT_F);
+    break;
+  case(AF_FORMAT_A_LAW):
+    to_alaw(in, out, len, 4, AF_FORMAT_F);
+    break;
+  default:
+    if((format&AF_FORMAT_POINT_MASK) == AF_FORMAT_F)
+      fast_memcpy(out,in,len*4);
+    else{
+      float2int(in, out, len, bps);
+      if((format&AF_FORMAT_SIGN_MASK) == AF_FORMAT_US)
+	si2us(out,len,bps);
+    }
+    break;
+  }
+  if((format&AF_FORMAT_END_MASK)!=AF_FORMAT_NE)
+    endian(out,out,len,bps);
+}
+
+/* Conversion to and from planar float. Other formats go through a small
+   interleaved float buffer, so that the block is only read and written
+   once. */
+static af_data_t* play_planar(struct af_instance_s* af, af_data_t* data)
+{
+  af_data_t*   l   = af->data;	// Local data
+  af_data_t*   c   = data;	// Current working data
+  af_format_t* s   = af->setup;
+  int          nch = c->nch;
+  int          frames = c->len/(c->bps*nch); // Also the plane stride
+  float        tmp[PLANAR_CHUNK*AF_NCH];
+  int          i, n;
+
+  if(AF_OK != RESIZE_LOCAL_BUFFER(af,data))
+    return NULL;
+
+  for(i=0;i<frames;i+=n){
+    n = FFMIN(frames-i, PLANAR_CHUNK);
+    if(AF_FORMAT_IS_PLANAR(c->format)){
+      float* in = (float*)c->audio + i;
+      if(l->format == AF_FORMAT_FLOAT_NE)
+	s->dsp.interleave((float*)l->audio + i*nch, in, frames, nch, n);
+      else{
+	s->dsp.interleave(tmp, in, frames, nch, n);
+	from_float(s, tmp, (uint8_t*)l->audio + i*nch*l->bps,
+		   l->format, l->bps, n*nch);
+      }
+    }else{
+      uint8_t* in = (uint8_t*)c->audio + i*nch*c->bps;
+      if(c->format == AF_FORMAT_FLOAT_NE)
+	s->dsp.deinterleave((float*)l->audio + i, frames, (float*)in, nch, n);
+      else{
+	to_float(s, in, c->format, c->bps, tmp, n*nch);
+	s->dsp.deinterleave((float*)l->audio + i, frames, tmp, nch, n);
+      }
+    }
+  }
+
+  c->audio  = l->audio;
+  c->len    = frames*nch*l->bps;
+  c->bps    = l->bps;
+  c->format = l->format;
+  return c;
+}
+
 // Filter data through filter
 static af_data_t* play(struct af_instance_s* af, af_data_t* data)
 {
@@ -325,13 +467,16 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
 
 // Allocate memory and set function pointers
 static int af_open(af_instance_t* af){
+  af_format_t* s;
   af->control=control;
   af->uninit=uninit;
   af->play=play;
   af->mul=1;
   af->data=calloc(1,sizeof(af_data_t));
-  if(af->data == NULL)
+  af->setup=s=calloc(1,sizeof(af_format_t));
+  if(af->data == NULL || af->setup == NULL)
     return AF_ERROR;
+  af_dsp_init(&s->dsp, af_dsp_cpu_caps());
   return AF_OK;
 }
 
@@ -341,7 +486,7 @@ const af_info_t af_info_format = {
   "format",
   "Anders",
   "",
-  AF_FLAGS_REENTRANT,
+  AF_FLAGS_REENTRANT | AF_FLAGS_LOCAL_BUFFER,
   af_open
 };
 
@@ -494,34 +639,8 @@ static void float2int(const float* in, void* out, int len, int bps)
       ((int8_t *)out)[i] = av_clip_int8(lrintf(128.0f * in[i]));
     break;
   case(2):
-#if HAVE_NEON
-    {
-    const float *in_end = in + len;
-    while (in < in_end - 7) {
-      __asm__(
-          "vld1.32 {q0,q1}, [%0]!\n\t"
-          "vcvt.s32.f32 q0, q0, #31\n\t"
-          "vqrshrn.s32  d0, q0, #15\n\t"
-          "vcvt.s32.f32 q1, q1, #31\n\t"
-          "vqrshrn.s32  d1, q1, #15\n\t"
-          "vst1.16 {q0}, [%1]!\n\t"
-      : "+r"(in), "+r"(out)
-      :: "q0", "q1", "memory");
-    }
-    while (in < in_end) {
-      __asm__(
-          "vld1.32 {d0[0]}, [%0]!\n\t"
-          "vcvt.s32.f32 d0, d0, #31\n\t"
-          "vqrshrn.s32  d0, q0, #15\n\t"
-          "vst1.16 {d0[0]}, [%1]!\n\t"
-      : "+r"(in), "+r"(out)
-      :: "d0", "memory");
-    }
-    }
-#else
     for(i=0;i<len;i++)
       ((int16_t*)out)[i] = av_clip_int16(lrintf(32768.0f * in[i]));
-#endif
     break;
   case(3):
     for(i=0;i<len;i++){
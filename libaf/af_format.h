@@ -64,6 +64,13 @@
 #define AF_FORMAT_IEC61937      (6<<6)
 #define AF_FORMAT_SPECIAL_MASK	(7<<6)
 
+// Sample layout, only native endian float may be planar. A planar block
+// holds nch planes of len/nch bytes each, one after the other. The format
+// is internal to the filter chain, it is never handed to an audio driver.
+#define AF_FORMAT_INTERLEAVED	(0<<9)
+#define AF_FORMAT_PLANAR	(1<<9)
+#define AF_FORMAT_LAYOUT_MASK	(1<<9)
+
 // PREDEFINED formats
 
 #define AF_FORMAT_U8		(AF_FORMAT_I|AF_FORMAT_US|AF_FORMAT_8BIT|AF_FORMAT_NE)
@@ -112,10 +119,13 @@
 #define AF_FORMAT_IEC61937_NE AF_FORMAT_IEC61937_LE
 #endif
 
+#define AF_FORMAT_FLOAT_PLANAR (AF_FORMAT_FLOAT_NE|AF_FORMAT_PLANAR)
+
 #define AF_FORMAT_UNKNOWN (-1)
 
 #define AF_FORMAT_IS_AC3(fmt) (((fmt) & AF_FORMAT_SPECIAL_MASK) == AF_FORMAT_AC3)
 #define AF_FORMAT_IS_IEC61937(fmt) (AF_FORMAT_IS_AC3(fmt) || ((fmt) & AF_FORMAT_SPECIAL_MASK) == AF_FORMAT_IEC61937)
+#define AF_FORMAT_IS_PLANAR(fmt) ((fmt) != AF_FORMAT_UNKNOWN && ((fmt) & AF_FORMAT_LAYOUT_MASK) == AF_FORMAT_PLANAR)
 
 int af_str2fmt(const char *str);
 int af_str2fmt_short(const char *str);
@@ -30,11 +30,21 @@
 
 #include "mp_msg.h"
 #include "af.h"
+#include "conv.h"
 #include "dsp.h"
 
 /* HRTF filter coefficients and adjustable parameters */
 #include "af_hrtf.h"
 
+/* Delay line signals that are filtered into the ears */
+enum {
+    CONV_LF, CONV_RF, CONV_LR, CONV_RR, CONV_CF, CONV_CR,
+    CONV_BA_L, CONV_BA_R, CONV_NIN
+};
+
+/* Partition length of the FFT convolution, 2^CONVPARTBITS samples */
+#define CONVPARTBITS 7
+
 typedef struct af_hrtf_s {
     /* Lengths */
     int dlbuflen, hrflen, basslen;
@@ -70,28 +80,13 @@ typedef struct af_hrtf_s {
     /* Cyclic position on the ring buffer */
     int cyc_pos;
     int print_flag;
+    /* FFT convolution of the delay line signals into the two ears, and
+       one block of its input and output signals */
+    struct af_conv *conv;
+    float *conv_in[CONV_NIN];
+    float *conv_out[2];
 } af_hrtf_t;
 
-/* Convolution on a ring buffer
- *    nx:	length of the ring buffer
- *    nk:	length of the convolution kernel
- *    sx:	ring buffer
- *    sk:	convolution kernel
- *    offset:	offset on the ring buffer, can be
- */
-static float conv(const int nx, const int nk, const float *sx, const float *sk,
-		  const int offset)
-{
-    /* k = reminder of offset / nx */
-    int k = offset >= 0 ? offset % nx : nx + (offset % nx);
-
-    if(nk + k <= nx)
-	return af_filter_fir(nk, sx + k, sk);
-    else
-	return af_filter_fir(nk + k - nx, sx, sk + nx - k) +
-	    af_filter_fir(nx - k, sx + k, sk);
-}
-
 /* Detect when the impulse response starts (significantly) */
 static int pulse_detect(const float *sx)
 {
@@ -287,6 +282,53 @@ static inline void update_ch(af_hrtf_t *s, short *in, const int k)
     }
 }
 
+/* Set the filter matrix of the FFT convolution for the decode mode.
+
+The filters of each ear sum up to:
+
+left  = AF * LF + OF * RF + (AR * LR + OR * RR + CR * CR) * g + CF * CF
+right = AF * RF + OF * LF + (AR * RR + OR * LR + CR * CR) * g + CF * CF
+
+with g = -1.76 dB in rear matrix decoding mode and 1 otherwise, only the
+front terms for stereo sources, plus the bass compensation with its
+cross talk. */
+static void setup_filters(af_hrtf_t *s)
+{
+    const float g = s->matrix_mode ? M1_76DB : 1;
+    const float *ir[2][CONV_NIN] = {{ NULL }};
+    int len[2][CONV_NIN] = {{ 0 }}, delay[2][CONV_NIN] = {{ 0 }};
+    float gain[2][CONV_NIN] = {{ 0 }};
+    int ear, i;
+
+#define SET(e, in, filt, o, l, gn) \
+    (ir[e][in] = (filt), delay[e][in] = (o), len[e][in] = (l), gain[e][in] = (gn))
+    for(ear = 0; ear < 2; ear++) {
+	/* same side and opposite side signals of this ear */
+	const int f_a = ear ? CONV_RF : CONV_LF, f_o = ear ? CONV_LF : CONV_RF;
+	const int r_a = ear ? CONV_RR : CONV_LR, r_o = ear ? CONV_LR : CONV_RR;
+	const int b_a = ear ? CONV_BA_R : CONV_BA_L;
+	const int b_o = ear ? CONV_BA_L : CONV_BA_R;
+
+	SET(ear, f_a, s->af_ir, s->af_o, s->hrflen, 1);
+	SET(ear, f_o, s->of_ir, s->of_o, s->hrflen, 1);
+	if(s->decode_mode != HRTF_MIX_STEREO) {
+	    SET(ear, r_a, s->ar_ir, s->ar_o, s->hrflen, g);
+	    SET(ear, r_o, s->or_ir, s->or_o, s->hrflen, g);
+	    SET(ear, CONV_CF, s->cf_ir, s->cf_o, s->hrflen, 1);
+	    if(s->matrix_mode)
+		SET(ear, CONV_CR, s->cr_ir, s->cr_o, s->hrflen, g);
+	}
+	SET(ear, b_a, s->ba_ir, 0, s->basslen, 1 - BASSCROSS);
+	SET(ear, b_o, s->ba_ir, 0, s->basslen, BASSCROSS);
+    }
+#undef SET
+    /* Filters that stay in use keep the past input. */
+    for(i = 0; i < CONV_NIN; i++)
+	for(ear = 0; ear < 2; ear++)
+	    af_conv_set_filter(s->conv, ear, i, ir[ear][i], len[ear][i],
+			       delay[ear][i], gain[ear][i]);
+}
+
 /* Initialization and runtime control */
 static int control(struct af_instance_s *af, int cmd, void* arg)
 {
@@ -322,6 +364,7 @@ static int control(struct af_instance_s *af, int cmd, void* arg)
 	// after testing input set the real output format
 	af->data->nch = 2;
 	s->print_flag = 1;
+	setup_filters(s);
 	return test_output_res;
     case AF_CONTROL_COMMAND_LINE:
 	sscanf((char*)arg, "%c", &mode);
@@ -355,6 +398,7 @@ static void uninit(struct af_instance_s *af)
 {
     if(af->setup) {
 	af_hrtf_t *s = af->setup;
+	int i;
 
 	free(s->lf);
 	free(s->rf);
@@ -369,6 +413,11 @@ static void uninit(struct af_instance_s *af)
 	free(s->fwrbuf_r);
 	free(s->fwrbuf_lr);
 	free(s->fwrbuf_rr);
+	for(i = 0; i < CONV_NIN; i++)
+	    free(s->conv_in[i]);
+	free(s->conv_out[0]);
+	free(s->conv_out[1]);
+	af_conv_free(s->conv);
 	free(af->setup);
     }
     if(af->data)
@@ -393,8 +442,8 @@ static af_data_t* play(struct af_instance_s *af, af_data_t *data)
     short *in = data->audio; // Input audio data
     short *out = NULL; // Output audio data
     short *end = in + data->len / sizeof(short); // Loop end
-    float common, left, right, diff, left_b, right_b;
-    const int dblen = s->dlbuflen, hlen = s->hrflen, blen = s->basslen;
+    float left, right, diff;
+    const int dblen = s->dlbuflen;
 
     if(AF_OK != RESIZE_LOCAL_BUFFER(af, data))
 	return NULL;
@@ -451,122 +500,93 @@ static af_data_t* play(struct af_instance_s *af, af_data_t *data)
      */
 
     while(in < end) {
-	const int k = s->cyc_pos;
+	/* Fill the delay lines up to the end of the convolution block,
+	   then filter the block and mix it down. */
+	short *blk = in;
+	int n = FFMIN((end - in) / data->nch, s->conv->part - s->conv->fill);
+	int t;
 
-	update_ch(s, in, k);
-
-	/* Simulate a 7.5 ms -20 dB echo of the center channel in the
-	   front channels (like reflection from a room wall) - a kind of
-	   psycho-acoustically "cheating" to focus the center front
-	   channel, which is normally hard to be perceived as front */
-	s->lf[k] += CFECHOAMPL * s->cf[(k + CFECHODELAY) % s->dlbuflen];
-	s->rf[k] += CFECHOAMPL * s->cf[(k + CFECHODELAY) % s->dlbuflen];
-
-	switch (s->decode_mode) {
-	case HRTF_MIX_51:
-	case HRTF_MIX_MATRIX2CH:
-	   /* Mixer filter matrix */
-	   common = conv(dblen, hlen, s->cf, s->cf_ir, k + s->cf_o);
-	   if(s->matrix_mode) {
-	      /* In matrix decoding mode, the rear channel gain must be
-		 renormalized, as there is an additional channel. */
-	      matrix_decode(in, k, 2, 3, 0, s->dlbuflen,
-			    s->lr_fwr, s->rr_fwr,
-			    s->lrprr_fwr, s->lrmrr_fwr,
-			    &(s->adapt_lr_gain), &(s->adapt_rr_gain),
-			    &(s->adapt_lrprr_gain), &(s->adapt_lrmrr_gain),
-			    s->lr, s->rr, NULL, NULL, s->cr);
-	      common +=
-		 conv(dblen, hlen, s->cr, s->cr_ir, k + s->cr_o) *
-		 M1_76DB;
-	      left    =
-		 ( conv(dblen, hlen, s->lf, s->af_ir, k + s->af_o) +
-		   conv(dblen, hlen, s->rf, s->of_ir, k + s->of_o) +
-		   (conv(dblen, hlen, s->lr, s->ar_ir, k + s->ar_o) +
-		    conv(dblen, hlen, s->rr, s->or_ir, k + s->or_o)) *
-		   M1_76DB + common);
-	      right   =
-		 ( conv(dblen, hlen, s->rf, s->af_ir, k + s->af_o) +
-		   conv(dblen, hlen, s->lf, s->of_ir, k + s->of_o) +
-		   (conv(dblen, hlen, s->rr, s->ar_ir, k + s->ar_o) +
-		    conv(dblen, hlen, s->lr, s->or_ir, k + s->or_o)) *
-		   M1_76DB + common);
-	   } else {
-	      left    =
-		 ( conv(dblen, hlen, s->lf, s->af_ir, k + s->af_o) +
-		   conv(dblen, hlen, s->rf, s->of_ir, k + s->of_o) +
-		   conv(dblen, hlen, s->lr, s->ar_ir, k + s->ar_o) +
-		   conv(dblen, hlen, s->rr, s->or_ir, k + s->or_o) +
-		   common);
-	      right   =
-		 ( conv(dblen, hlen, s->rf, s->af_ir, k + s->af_o) +
-		   conv(dblen, hlen, s->lf, s->of_ir, k + s->of_o) +
-		   conv(dblen, hlen, s->rr, s->ar_ir, k + s->ar_o) +
-		   conv(dblen, hlen, s->lr, s->or_ir, k + s->or_o) +
-		   common);
-	   }
-	   break;
-	case HRTF_MIX_STEREO:
-	   left    =
-	      ( conv(dblen, hlen, s->lf, s->af_ir, k + s->af_o) +
-		conv(dblen, hlen, s->rf, s->of_ir, k + s->of_o));
-	   right   =
-	      ( conv(dblen, hlen, s->rf, s->af_ir, k + s->af_o) +
-		conv(dblen, hlen, s->lf, s->of_ir, k + s->of_o));
-	   break;
-	default:
-	    /* make gcc happy */
-	    left = 0.0;
-	    right = 0.0;
+	if(n <= 0)
 	    break;
+	for(t = 0; t < n; t++) {
+	    const int k = s->cyc_pos;
+
+	    update_ch(s, in, k);
+
+	    /* Simulate a 7.5 ms -20 dB echo of the center channel in the
+	       front channels (like reflection from a room wall) - a kind of
+	       psycho-acoustically "cheating" to focus the center front
+	       channel, which is normally hard to be perceived as front */
+	    s->lf[k] += CFECHOAMPL * s->cf[(k + CFECHODELAY) % s->dlbuflen];
+	    s->rf[k] += CFECHOAMPL * s->cf[(k + CFECHODELAY) % s->dlbuflen];
+
+	    if(s->decode_mode != HRTF_MIX_STEREO && s->matrix_mode)
+		/* In matrix decoding mode, the rear channel gain must be
+		   renormalized, as there is an additional channel. */
+		matrix_decode(in, k, 2, 3, 0, s->dlbuflen,
+			      s->lr_fwr, s->rr_fwr,
+			      s->lrprr_fwr, s->lrmrr_fwr,
+			      &(s->adapt_lr_gain), &(s->adapt_rr_gain),
+			      &(s->adapt_lrprr_gain), &(s->adapt_lrmrr_gain),
+			      s->lr, s->rr, NULL, NULL, s->cr);
+
+	    s->conv_in[CONV_LF][t]   = s->lf[k];
+	    s->conv_in[CONV_RF][t]   = s->rf[k];
+	    s->conv_in[CONV_LR][t]   = s->lr[k];
+	    s->conv_in[CONV_RR][t]   = s->rr[k];
+	    s->conv_in[CONV_CF][t]   = s->cf[k];
+	    s->conv_in[CONV_CR][t]   = s->cr[k];
+	    s->conv_in[CONV_BA_L][t] = s->ba_l[k];
+	    s->conv_in[CONV_BA_R][t] = s->ba_r[k];
+
+	    in = &in[data->nch];
+	    (s->cyc_pos)--;
+	    if(s->cyc_pos < 0)
+		s->cyc_pos += dblen;
 	}
 
-	/* Bass compensation for the lower frequency cut of the HRTF.  A
-	   cross talk of the left and right channel is introduced to
-	   match the directional characteristics of higher frequencies.
-	   The bass will not have any real 3D perception, but that is
-	   OK (note at 180 Hz, the wavelength is about 2 m, and any
-	   spatial perception is impossible). */
-	left_b  = conv(dblen, blen, s->ba_l, s->ba_ir, k);
-	right_b = conv(dblen, blen, s->ba_r, s->ba_ir, k);
-	left  += (1 - BASSCROSS) * left_b  + BASSCROSS * right_b;
-	right += (1 - BASSCROSS) * right_b + BASSCROSS * left_b;
-	/* Also mix the LFE channel (if available) */
-	if(data->nch >= 6) {
-	    left  += in[5] * M3_01DB;
-	    right += in[5] * M3_01DB;
-	}
+	/* HRTF mixer filter matrix and the bass compensation for the
+	   lower frequency cut of the HRTF, see setup_filters(). */
+	af_conv_process(s->conv, s->conv_out,
+			(const float *const *)s->conv_in, n);
 
-	/* Amplitude renormalization. */
-	left  *= AMPLNORM;
-	right *= AMPLNORM;
+	for(t = 0; t < n; t++, blk += data->nch) {
+	    left  = s->conv_out[0][t];
+	    right = s->conv_out[1][t];
 
-	switch (s->decode_mode) {
-	case HRTF_MIX_51:
-	case HRTF_MIX_STEREO:
-	   /* "Cheating": linear stereo expansion to amplify the 3D
-	      perception.  Note: Too much will destroy the acoustic space
-	      and may even result in headaches. */
-	   diff = STEXPAND2 * (left - right);
-	   out[0] = av_clip_int16(left  + diff);
-	   out[1] = av_clip_int16(right - diff);
-	   break;
-	case HRTF_MIX_MATRIX2CH:
-	   /* Do attempt any stereo expansion with matrix encoded
-	      sources.  The L, R channels are already stereo expanded
-	      by the steering, any further stereo expansion will sound
-	      very unnatural. */
-	   out[0] = av_clip_int16(left);
-	   out[1] = av_clip_int16(right);
-	   break;
-	}
+	    /* Also mix the LFE channel (if available) */
+	    if(data->nch >= 6) {
+		left  += blk[5] * M3_01DB;
+		right += blk[5] * M3_01DB;
+	    }
 
-	/* Next sample... */
-	in = &in[data->nch];
-	out = &out[af->data->nch];
-	(s->cyc_pos)--;
-	if(s->cyc_pos < 0)
-	    s->cyc_pos += dblen;
+	    /* Amplitude renormalization. */
+	    left  *= AMPLNORM;
+	    right *= AMPLNORM;
+
+	    switch (s->decode_mode) {
+	    case HRTF_MIX_51:
+	    case HRTF_MIX_STEREO:
+		/* "Cheating": linear stereo expansion to amplify the 3D
+		   perception.  Note: Too much will destroy the acoustic
+		   space and may even result in headaches. */
+		diff = STEXPAND2 * (left - right);
+		out[0] = av_clip_int16(left  + diff);
+		out[1] = av_clip_int16(right - diff);
+		break;
+	    case HRTF_MIX_MATRIX2CH:
+		/* Do attempt any stereo expansion with matrix encoded
+		   sources.  The L, R channels are already stereo expanded
+		   by the steering, any further stereo expansion will sound
+		   very unnatural. */
+		out[0] = av_clip_int16(left);
+		out[1] = av_clip_int16(right);
+		break;
+	    }
+
+	    /* Next sample... */
+	    out = &out[af->data->nch];
+	}
     }
 
     /* Set output data */
@@ -662,6 +682,20 @@ static int af_open(af_instance_t* af)
     for(i = 0; i < s->basslen; i++)
 	s->ba_ir[i] *= BASSGAIN;
 
+    s->conv = af_conv_init(CONVPARTBITS, CONV_NIN, 2,
+			   FFMAX(128, s->basslen));
+    if(!s->conv) {
+ 	mp_msg(MSGT_AFILTER, MSGL_ERR, "[hrtf] Memory allocation error.\n");
+	return AF_ERROR;
+    }
+    for(i = 0; i < CONV_NIN; i++)
+	if(!(s->conv_in[i] = malloc(s->conv->part * sizeof(float))))
+	    return AF_ERROR;
+    for(i = 0; i < 2; i++)
+	if(!(s->conv_out[i] = malloc(s->conv->part * sizeof(float))))
+	    return AF_ERROR;
+    setup_filters(s);
+
     return AF_OK;
 }
 
@@ -671,6 +705,6 @@ const af_info_t af_info_hrtf = {
     "hrtf",
     "ylai",
     "",
-    AF_FLAGS_REENTRANT,
+    AF_FLAGS_REENTRANT | AF_FLAGS_LOCAL_BUFFER,
     af_open
 };
@@ -188,6 +188,6 @@ const af_info_t af_info_lavcresample = {
   "lavcresample",
   "Michael Niedermayer",
   "",
-  AF_FLAGS_REENTRANT,
+  AF_FLAGS_REENTRANT | AF_FLAGS_LOCAL_BUFFER,
   af_open
 };
@@ -20,6 +20,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <inttypes.h>
 #include <math.h>
@@ -28,14 +29,19 @@
 #include "libavutil/common.h"
 #include "mp_msg.h"
 #include "af.h"
+#include "af_dsp.h"
 
 // Data for specific instances of this filter
 typedef struct af_pan_s
 {
   int nch; // Number of output channels; zero means same as input
   float level[AF_NCH][AF_NCH];	// Gain level for each channel
+  struct af_dsp dsp;
 }af_pan_t;
 
+// Frames mixed per step when the output overwrites the input
+#define PAN_CHUNK 256
+
 // Initialization and runtime control
 static int control(struct af_instance_s* af, int cmd, void* arg)
 {
@@ -47,10 +53,13 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
     if(!arg) return AF_ERROR;
 
     af->data->rate   = ((af_data_t*)arg)->rate;
-    af->data->format = AF_FORMAT_FLOAT_NE;
+    // Mix whole planes, the input is converted once in front of the filter
+    af->data->format = AF_FORMAT_FLOAT_PLANAR;
     af->data->bps    = 4;
     af->data->nch    = s->nch ? s->nch: ((af_data_t*)arg)->nch;
     af->mul          = (double)af->data->nch / ((af_data_t*)arg)->nch;
+    // The output planes fit into the input buffer
+    af->inplace      = af->data->nch <= ((af_data_t*)arg)->nch;
 
     if((af->data->format != ((af_data_t*)arg)->format) ||
        (af->data->bps != ((af_data_t*)arg)->bps)){
@@ -149,6 +158,25 @@ static void uninit(struct af_instance_s* af)
   free(af->setup);
 }
 
+/* Mix len samples of output channel j from the input planes spaced
+   stride apart, skipping the unused inputs of sparse downmix matrices */
+static void mix(af_pan_t* s, float* out, const float* in, int stride,
+		int nchi, int j, int len)
+{
+  int k,n;
+
+  for(n=0,k=0;k<nchi;k++){
+    if(s->level[j][k] == 0.0)
+      continue;
+    if(n++)
+      s->dsp.mac(out, in + k*stride, s->level[j][k], len);
+    else
+      s->dsp.scale(out, in + k*stride, s->level[j][k], len);
+  }
+  if(!n)
+    memset(out, 0, len*sizeof(float));
+}
+
 // Filter data through filter
 static af_data_t* play(struct af_instance_s* af, af_data_t* data)
 {
@@ -156,32 +184,30 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
   af_data_t*	l    = af->data;	// Local data
   af_pan_t*  	s    = af->setup; 	// Setup for this instance
   float*   	in   = c->audio;	// Input audio data
-  float*   	out  = NULL;		// Output audio data
-  float*	end  = in+c->len/4; 	// End of loop
+  int		len  = AF_PLANE_LEN(c);	// Samples per channel
   int		nchi = c->nch;		// Number of input channels
   int		ncho = l->nch;		// Number of output channels
-  register int  j,k;
-
-  if(AF_OK != RESIZE_LOCAL_BUFFER(af,data))
-    return NULL;
-
-  out = l->audio;
-  // Execute panning
-  // FIXME: Too slow
-  while(in < end){
-    for(j=0;j<ncho;j++){
-      register float  x   = 0.0;
-      register float* tin = in;
-      for(k=0;k<nchi;k++)
-	x += tin[k] * s->level[j][k];
-      out[j] = x;
+  int		i,j,n;
+
+  if(af->inplace){
+    // Every output needs all inputs, so mix a chunk before storing it
+    float tmp[AF_NCH][PAN_CHUNK];
+    for(i=0;i<len;i+=n){
+      n = FFMIN(len-i, PAN_CHUNK);
+      for(j=0;j<ncho;j++)
+	mix(s, tmp[j], in + i, len, nchi, j, n);
+      for(j=0;j<ncho;j++)
+	memcpy(in + j*len + i, tmp[j], n*sizeof(float));
     }
-    out+= ncho;
-    in+= nchi;
+  }else{
+    if(AF_OK != RESIZE_LOCAL_BUFFER(af,data))
+      return NULL;
+    for(j=0;j<ncho;j++)
+      mix(s, (float*)l->audio + j*len, in, len, nchi, j, len);
+    c->audio = l->audio;
   }
 
   // Set output data
-  c->audio = l->audio;
   c->len   = c->len / c->nch * l->nch;
   c->nch   = l->nch;
 
@@ -198,6 +224,7 @@ static int af_open(af_instance_t* af){
   af->setup=calloc(1,sizeof(af_pan_t));
   if(af->data == NULL || af->setup == NULL)
     return AF_ERROR;
+  af_dsp_init(&((af_pan_t*)af->setup)->dsp, af_dsp_cpu_caps());
   return AF_OK;
 }
 
@@ -207,6 +234,6 @@ const af_info_t af_info_pan = {
     "pan",
     "Anders",
     "",
-    AF_FLAGS_REENTRANT,
+    AF_FLAGS_REENTRANT | AF_FLAGS_LOCAL_BUFFER,
     af_open
 };
@@ -22,12 +22,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 
 #include "libavutil/common.h"
 #include "libavutil/mathematics.h"
 #include "mp_msg.h"
 #include "af.h"
+#include "af_dsp.h"
 #include "dsp.h"
 
 /* Below definition selects the length of each poly phase component.
@@ -63,8 +65,9 @@
 // local data
 typedef struct af_resample_s
 {
-  void*  	w;	// Current filter weights
-  void** 	xq; 	// Circular buffers
+  void*  	w;	// Current filter weights, in the order they are used
+  uint8_t*	extra;	// Polyphase steps that take one more sample
+  void* 	xq; 	// Circular buffers, 2*L samples per channel
   uint32_t	xi; 	// Index for circular buffers
   uint32_t	wi;	// Index for w
   uint32_t	i; 	// Number of new samples to put in x queue
@@ -73,6 +76,7 @@ typedef struct af_resample_s
   uint64_t	step;	// Step size for linear interpolation
   uint64_t	pt;	// Pointer remainder for linear interpolation
   int		setup;	// Setup parameters cmdline or through postcreate
+  struct af_dsp	dsp;
 } af_resample_t;
 
 // Fast linear interpolation resample with modest audio quality
@@ -181,11 +185,8 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
     int 	   rv  = AF_OK;
 
     // Free space for circular buffers
-    if(s->xq){
-      free(s->xq[0]);
-      free(s->xq);
-      s->xq = NULL;
-    }
+    free(s->xq);
+    s->xq = NULL;
 
     if(AF_DETACH == (rv = set_types(af,n)))
       return AF_DETACH;
@@ -216,17 +217,18 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
     }
 
     // Create space for circular buffers
-    s->xq = malloc(n->nch*sizeof(void*));
-    s->xq[0] = calloc(n->nch, 2*L*af->data->bps);
-    for(i=1;i<n->nch;i++)
-      s->xq[i] = (uint8_t *)s->xq[i-1] + 2*L*af->data->bps;
+    s->xq = calloc(n->nch, 2*L*af->data->bps);
+    if(!s->xq)
+      return AF_ERROR;
     s->xi = 0;
 
     // Check if the design needs to be redone
     if(s->up != af->data->rate/d || s->dn != n->rate/d){
       float* w;
       float* wt;
+      uint8_t* wp;
       float fc;
+      uint32_t level;
       int j;
       s->up = af->data->rate/d;
       s->dn = n->rate/d;
@@ -237,14 +239,18 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
       fc = 1/(float)(FFMAX(s->up,s->dn));
       // Allocate space for polyphase filter bank and prototype filter
       w = malloc(sizeof(float) * s->up *L);
+      wp = malloc(L*s->up*af->data->bps);
       free(s->w);
       s->w = malloc(L*s->up*af->data->bps);
+      free(s->extra);
+      s->extra = malloc(s->up);
 
       // Design prototype filter type using Kaiser window with beta = 10
-      if(NULL == w || NULL == s->w ||
+      if(NULL == w || NULL == wp || NULL == s->w || NULL == s->extra ||
 	 -1 == af_filter_design_fir(s->up*L, w, &fc, LP|KAISER , 10.0)){
 	mp_msg(MSGT_AFILTER, MSGL_ERR, "[resample] Unable to design prototype filter.\n");
 	free(w);
+	free(wp);
 	return AF_ERROR;
       }
       // Copy data from prototype to polyphase filter
@@ -253,13 +259,24 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
 	for(i=0;i<s->up;i++){//Rows
 	  if((s->setup & RSMP_MASK) == RSMP_INT){
 	    float t=(float)s->up*32767.0*(*wt);
-	    ((int16_t*)s->w)[i*L+j] = (int16_t)((t>=0.0)?(t+0.5):(t-0.5));
+	    ((int16_t*)wp)[i*L+j] = (int16_t)((t>=0.0)?(t+0.5):(t-0.5));
 	  }
 	  else
-	    ((float*)s->w)[i*L+j] = (float)s->up*(*wt);
+	    ((float*)wp)[i*L+j] = (float)s->up*(*wt);
 	  wt++;
 	}
       }
+      /* Store the polyphase components in the order play() steps
+         through them, (wi+dn)%up, so that the filter bank is read
+         sequentially and no division is needed per output sample. */
+      level = (s->up > s->dn) ? s->up % s->dn : s->dn % s->up;
+      for(i=0;i<s->up;i++){
+	uint32_t k = (uint64_t)i*s->dn % s->up;
+	memcpy((uint8_t*)s->w + i*L*af->data->bps,
+	       wp + k*L*af->data->bps, L*af->data->bps);
+	s->extra[i] = k < level;
+      }
+      free(wp);
       free(w);
       mp_msg(MSGT_AFILTER, MSGL_V, "[resample] New filter designed up: %i "
 	     "down: %i\n", s->up, s->dn);
@@ -308,9 +325,9 @@ static void uninit(struct af_instance_s* af)
 {
   af_resample_t *s = af->setup;
   if (s) {
-    if (s->xq) free(s->xq[0]);
     free(s->xq);
     free(s->w);
+    free(s->extra);
     free(s);
   }
   if(af->data)
@@ -382,6 +399,7 @@ static int af_open(af_instance_t* af){
   if(af->data == NULL || af->setup == NULL)
     return AF_ERROR;
   ((af_resample_t*)af->setup)->setup = RSMP_INT | FREQ_SLOPPY;
+  af_dsp_init(&((af_resample_t*)af->setup)->dsp, af_dsp_cpu_caps());
   return AF_OK;
 }
 
@@ -391,6 +409,6 @@ const af_info_t af_info_resample = {
   "resample",
   "Anders",
   "",
-  AF_FLAGS_REENTRANT,
+  AF_FLAGS_REENTRANT | AF_FLAGS_LOCAL_BUFFER,
   af_open
 };
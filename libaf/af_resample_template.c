@@ -29,6 +29,7 @@
 #undef FORMAT
 #undef FIR
 #undef ADDQUE
+#undef FIR_FRAME
 
 /* The length Lxx definition selects the length of each poly phase
    component. Valid definitions are L8 and L16 where the number
@@ -74,49 +75,57 @@
 
 #endif /* L8/L16 */
 
-// Macro to add data to circular que
+// Macro to add data to circular que, xi is moved on once for all channels
 #define ADDQUE(xi,xq,in)\
-  xq[xi]=xq[(xi)+L]=*(in);\
-  xi=((xi)-1)&(L-1);
+  xq[xi]=xq[(xi)+L]=*(in);
+
+/* FIR_FRAME runs the filter for all channels of one output frame, the
+   queues of the channels are 2*L samples apart. */
+#if L == 16 && defined(FORMAT_I)
+#define FIR_FRAME(x,w,out) s->dsp.fir16_s16(out,x,2*L,w,nch)
+#elif L == 16
+#define FIR_FRAME(x,w,out) s->dsp.fir16_float(out,x,2*L,w,nch)
+#else
+#define FIR_FRAME(x,w,out) \
+  for(ci=0;ci<nch;ci++){ FIR((&(x)[ci*2*L]),(w),(&(out)[ci])); }
+#endif
+
+/* The polyphase components in w are stored in the order they are used,
+   wi counts through them and extra[wi] tells if the step that follows
+   takes one more sample than inc. */
 
 #if defined(UP)
 
-  uint32_t		ci    = l->nch; 	// Index for channels
+  uint32_t		ci;			// Index for channels
   uint32_t		nch   = l->nch;   	// Number of channels
   uint32_t		inc   = s->up/s->dn;
-  uint32_t		level = s->up%s->dn;
   uint32_t		up    = s->up;
-  uint32_t		dn    = s->dn;
   uint32_t		ns    = c->len/l->bps;
   register FORMAT*	w     = s->w;
+  const uint8_t*	extra = s->extra;
+  FORMAT*		x     = s->xq;
+  register FORMAT*	in    = (FORMAT*)c->audio;
+  register FORMAT*	out   = (FORMAT*)l->audio;
+  FORMAT* 		end   = in+ns; // Block loop end
 
-  register uint32_t	wi    = 0;
-  register uint32_t	xi    = 0;
-
-  // Index current channel
-  while(ci--){
-    // Temporary pointers
-    register FORMAT*	x     = s->xq[ci];
-    register FORMAT*	in    = ((FORMAT*)c->audio)+ci;
-    register FORMAT*	out   = ((FORMAT*)l->audio)+ci;
-    FORMAT* 		end   = in+ns; // Block loop end
-    wi = s->wi; xi = s->xi;
-
-    while(in < end){
-      register uint32_t	i = inc;
-      if(wi<level) i++;
-
-      ADDQUE(xi,x,in);
-      in+=nch;
-      while(i--){
-	// Run the FIR filter
-	FIR((&x[xi]),(&w[wi*L]),out);
-	len++; out+=nch;
-	// Update wi to point at the correct polyphase component
-	wi=(wi+dn)%up;
-      }
-    }
+  register uint32_t	wi    = s->wi;
+  register uint32_t	xi    = s->xi;
+
+  while(in < end){
+    register uint32_t	i = inc + extra[wi];
 
+    for(ci=0;ci<nch;ci++){
+      ADDQUE(xi,(&x[ci*2*L]),(&in[ci]));
+    }
+    xi=(xi-1)&(L-1);
+    in+=nch;
+    while(i--){
+      // Run the FIR filter
+      FIR_FRAME((&x[xi]),(&w[wi*L]),out);
+      len+=nch; out+=nch;
+      // Update wi to point at the next polyphase component
+      if(++wi == up) wi = 0;
+    }
   }
   // Save values that needs to be kept for next time
   s->wi = wi;
@@ -124,44 +133,39 @@
 #endif /* UP */
 
 #if defined(DN) /* DN */
-  uint32_t		ci    = l->nch; 	// Index for channels
+  uint32_t		ci;			// Index for channels
   uint32_t		nch   = l->nch;   	// Number of channels
   uint32_t		inc   = s->dn/s->up;
-  uint32_t		level = s->dn%s->up;
   uint32_t		up    = s->up;
-  uint32_t		dn    = s->dn;
   uint32_t		ns    = c->len/l->bps;
   FORMAT*		w     = s->w;
+  const uint8_t*	extra = s->extra;
+  FORMAT*		x     = s->xq;
+  register FORMAT*	in    = (FORMAT*)c->audio;
+  register FORMAT*	out   = (FORMAT*)l->audio;
+  register FORMAT* 	end   = in+ns;    // Block loop end
+
+  register int32_t	i     = s->i;
+  register uint32_t	wi    = s->wi;
+  register uint32_t	xi    = s->xi;
 
-  register int32_t	i     = 0;
-  register uint32_t	wi    = 0;
-  register uint32_t	xi    = 0;
-
-  // Index current channel
-  while(ci--){
-    // Temporary pointers
-    register FORMAT*	x     = s->xq[ci];
-    register FORMAT*	in    = ((FORMAT*)c->audio)+ci;
-    register FORMAT*	out   = ((FORMAT*)l->audio)+ci;
-    register FORMAT* 	end   = in+ns;    // Block loop end
-    i = s->i; wi = s->wi; xi = s->xi;
-
-    while(in < end){
-
-      ADDQUE(xi,x,in);
-      in+=nch;
-      if((--i)<=0){
-	// Run the FIR filter
-	FIR((&x[xi]),(&w[wi*L]),out);
-	len++;	out+=nch;
-
-	// Update wi to point at the correct polyphase component
-	wi=(wi+dn)%up;
-
-	// Insert i number of new samples in queue
-	i = inc;
-	if(wi<level) i++;
-      }
+  while(in < end){
+
+    for(ci=0;ci<nch;ci++){
+      ADDQUE(xi,(&x[ci*2*L]),(&in[ci]));
+    }
+    xi=(xi-1)&(L-1);
+    in+=nch;
+    if((--i)<=0){
+      // Run the FIR filter
+      FIR_FRAME((&x[xi]),(&w[wi*L]),out);
+      len+=nch;	out+=nch;
+
+      // Update wi to point at the next polyphase component
+      if(++wi == up) wi = 0;
+
+      // Insert i number of new samples in queue
+      i = inc + extra[wi];
     }
   }
   // Save values that needs to be kept for next time
@@ -36,6 +36,8 @@
 #include <limits.h>
 
 #include "af.h"
+#include "af_dsp.h"
+#include "fft.h"
 #include "libavutil/common.h"
 #include "mp_msg.h"
 #include "subopt-helper.h"
@@ -70,6 +72,10 @@ typedef struct af_scaletempo_s
   void*   buf_pre_corr;
   void*   table_window;
   int     (*best_overlap_offset)(struct af_scaletempo_s* s);
+  // cross correlation by FFT
+  struct af_fft* fft;
+  float*  buf_fft;
+  struct af_dsp dsp;
   // command line
   float   scale_nominal;
   float   ms_stride;
@@ -77,8 +83,13 @@ typedef struct af_scaletempo_s
   float   ms_search;
   short   speed_tempo;
   short   speed_pitch;
+  int     corr_mode;
 } af_scaletempo_t;
 
+#define CORR_AUTO   0
+#define CORR_DIRECT 1
+#define CORR_FFT    2
+
 static int fill_queue(struct af_instance_s* af, af_data_t* data, int offset)
 {
   af_scaletempo_t* s = af->setup;
@@ -193,29 +204,125 @@ static int best_overlap_offset_s16(af_scaletempo_t* s)
   return best_off * 2 * s->num_channels;
 }
 
-static void output_overlap_float(af_scaletempo_t* s, void* buf_out,
-				  int bytes_off)
+/**
+ * \brief best_overlap_offset_* search done as a frequency domain product
+ *
+ * Cross correlates every channel of buf_pre_corr with the search window
+ * of buf_queue, sums the spectra over the channels and does a single
+ * inverse transform. The FFT is large enough that the circular
+ * correlation does not wrap for any offset that is searched.
+ * \return best offset in frames
+ */
+static int best_frame_fft(af_scaletempo_t* s, int use_int)
+{
+  int nch = s->num_channels;
+  int n = s->fft->n;
+  int frames_pre = s->samples_overlap / nch - 1;
+  int frames_in  = s->frames_search + frames_pre - 1;
+  float* acc = s->buf_fft;
+  float* pp  = acc + n;
+  float* pq  = pp + n;
+  float best_corr;
+  int best_off = 0;
+  int c, i;
+
+  memset(acc, 0, n * sizeof(float));
+  for (c=0; c<nch; c++) {
+    if (use_int) {
+      int32_t* ppc = (int32_t*)s->buf_pre_corr + c;
+      int16_t* ps  = (int16_t*)s->buf_queue + nch + c;
+      for (i=0; i<frames_pre; i++)
+        pp[i] = ppc[i*nch];
+      for (i=0; i<frames_in; i++)
+        pq[i] = ps[i*nch];
+    } else {
+      float* ppc = (float*)s->buf_pre_corr + c;
+      float* ps  = (float*)s->buf_queue + nch + c;
+      for (i=0; i<frames_pre; i++)
+        pp[i] = ppc[i*nch];
+      for (i=0; i<frames_in; i++)
+        pq[i] = ps[i*nch];
+    }
+    memset(pp + frames_pre, 0, (n - frames_pre) * sizeof(float));
+    memset(pq + frames_in,  0, (n - frames_in)  * sizeof(float));
+    af_fft_r2c(s->fft, pp);
+    af_fft_r2c(s->fft, pq);
+    af_fft_mul_conj_acc(acc, pq, pp, n);
+  }
+  af_fft_c2r(s->fft, acc);
+
+  best_corr = acc[0];
+  for (i=1; i<s->frames_search; i++) {
+    if (acc[i] > best_corr) {
+      best_corr = acc[i];
+      best_off  = i;
+    }
+  }
+  return best_off;
+}
+
+static int best_overlap_offset_float_fft(af_scaletempo_t* s)
 {
-  float* pout = buf_out;
-  float* pb   = s->table_blend;
-  float* po   = s->buf_overlap;
-  float* pin  = (float*)(s->buf_queue + bytes_off);
+  float *pw, *po, *ppc;
   int i;
-  for (i=0; i<s->samples_overlap; i++) {
-    *pout++ = *po - *pb++ * ( *po - *pin++ ); po++;
+
+  pw  = s->table_window;
+  po  = s->buf_overlap;
+  po += s->num_channels;
+  ppc = s->buf_pre_corr;
+  for (i=s->num_channels; i<s->samples_overlap; i++) {
+    *ppc++ = *pw++ * *po++;
   }
+
+  return best_frame_fft(s, 0) * 4 * s->num_channels;
 }
-static void output_overlap_s16(af_scaletempo_t* s, void* buf_out,
-			       int bytes_off)
+
+static int best_overlap_offset_s16_fft(af_scaletempo_t* s)
 {
-  int16_t* pout = buf_out;
-  int32_t* pb   = s->table_blend;
-  int16_t* po   = s->buf_overlap;
-  int16_t* pin  = (int16_t*)(s->buf_queue + bytes_off);
+  int32_t *pw, *ppc;
+  int16_t *po;
   int i;
-  for (i=0; i<s->samples_overlap; i++) {
-    *pout++ = *po - ( ( *pb++ * ( *po - *pin++ ) ) >> 16 ); po++;
+
+  pw  = s->table_window;
+  po  = s->buf_overlap;
+  po += s->num_channels;
+  ppc = s->buf_pre_corr;
+  for (i=s->num_channels; i<s->samples_overlap; i++) {
+    *ppc++ = ( *pw++ * *po++ ) >> 15;
   }
+
+  return best_frame_fft(s, 1) * 2 * s->num_channels;
+}
+
+/**
+ * \brief choose between the direct and the FFT cross correlation
+ *
+ * The direct search costs frames_search multiply-adds per overlap sample,
+ * the FFT search 2 * nch + 1 transforms of roughly n * log2(n) operations.
+ */
+static int use_fft_search(af_scaletempo_t* s, int frames_overlap, int bits)
+{
+  int64_t direct, fft;
+  if (s->corr_mode != CORR_AUTO)
+    return s->corr_mode == CORR_FFT;
+  direct = (int64_t)s->frames_search * (frames_overlap - 1) * s->num_channels;
+  fft    = (int64_t)(2 * s->num_channels + 1) * (1 << bits) * bits;
+  return direct > fft;
+}
+
+static void output_overlap_float(af_scaletempo_t* s, void* buf_out,
+				  int bytes_off)
+{
+  float* pin = (float*)(s->buf_queue + bytes_off);
+  s->dsp.blend(buf_out, s->buf_overlap, pin, s->table_blend,
+               s->samples_overlap);
+}
+static void output_overlap_s16(af_scaletempo_t* s, void* buf_out,
+			       int bytes_off)
+{
+  int16_t* pin = (int16_t*)(s->buf_queue + bytes_off);
+  s->dsp.blend_s16(buf_out, s->buf_overlap, pin, s->table_blend,
+                   s->samples_overlap);
 }
 
 // Filter data through filter
@@ -372,9 +479,12 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
     }
 
     s->frames_search = (frames_overlap > 1) ? srate * s->ms_search : 0;
+    s->num_channels  = nch;
     if (s->frames_search <= 0) {
       s->best_overlap_offset = NULL;
     } else {
+      int bits = af_fft_bits(s->frames_search + frames_overlap - 2);
+      int use_fft = use_fft_search(s, frames_overlap, FFMAX(bits, 2));
       if (use_int) {
         int64_t t = frames_overlap;
         int32_t n = 8589934588LL / (t * t);  // 4 * (2^31 - 1) / t^2
@@ -393,7 +503,8 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
             *pw++ = v;
           }
         }
-        s->best_overlap_offset = best_overlap_offset_s16;
+        s->best_overlap_offset = use_fft ? best_overlap_offset_s16_fft
+                                         : best_overlap_offset_s16;
       } else {
         float* pw;
         s->buf_pre_corr = realloc(s->buf_pre_corr, s->bytes_overlap);
@@ -409,12 +520,24 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
             *pw++ = v;
           }
         }
-        s->best_overlap_offset = best_overlap_offset_float;
+        s->best_overlap_offset = use_fft ? best_overlap_offset_float_fft
+                                         : best_overlap_offset_float;
+      }
+      if (use_fft) {
+        bits = FFMAX(bits, 2);
+        if (!s->fft || s->fft->bits != bits) {
+          af_fft_free(s->fft);
+          s->fft = af_fft_init(bits);
+          s->buf_fft = realloc(s->buf_fft, 3 * sizeof(float) << bits);
+          if (!s->fft || !s->buf_fft) {
+            mp_msg(MSGT_AFILTER, MSGL_FATAL, "[scaletempo] Out of memory\n");
+            return AF_ERROR;
+          }
+        }
       }
     }
 
     s->bytes_per_frame = bps * nch;
-    s->num_channels    = nch;
 
     s->bytes_queue
       = (s->frames_search + frames_stride + frames_overlap) * bps * nch;
@@ -426,12 +549,15 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
 
     mp_msg (MSGT_AFILTER, MSGL_DBG2, "[scaletempo] "
             "%.2f stride_in, %i stride_out, %i standing, "
-            "%i overlap, %i search, %i queue, %s mode\n",
+            "%i overlap, %i search%s, %i queue, %s mode\n",
             s->frames_stride_scaled,
             (int)(s->bytes_stride / nch / bps),
             (int)(s->bytes_standing / nch / bps),
             (int)(s->bytes_overlap / nch / bps),
             s->frames_search,
+            (s->best_overlap_offset == best_overlap_offset_s16_fft ||
+             s->best_overlap_offset == best_overlap_offset_float_fft) ?
+              " (fft)" : "",
             (int)(s->bytes_queue / nch / bps),
             (use_int?"s16":"float"));
 
@@ -462,12 +588,14 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
     return AF_OK;
   case AF_CONTROL_COMMAND_LINE:{
     strarg_t speed = {};
+    strarg_t corr = {};
     opt_t subopts[] = {
       {"scale",   OPT_ARG_FLOAT, &s->scale_nominal, NULL},
       {"stride",  OPT_ARG_FLOAT, &s->ms_stride, NULL},
       {"overlap", OPT_ARG_FLOAT, &s->percent_overlap, NULL},
       {"search",  OPT_ARG_FLOAT, &s->ms_search, NULL},
       {"speed",   OPT_ARG_STR,   &speed, NULL},
+      {"corr",    OPT_ARG_STR,   &corr, NULL},
       {NULL},
     };
     if (subopt_parse(arg, subopts) != 0) {
@@ -517,6 +645,20 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
         return AF_ERROR;
       }
     }
+    if (corr.len > 0) {
+      if (strcmp(corr.str, "auto") == 0) {
+        s->corr_mode = CORR_AUTO;
+      } else if (strcmp(corr.str, "direct") == 0) {
+        s->corr_mode = CORR_DIRECT;
+      } else if (strcmp(corr.str, "fft") == 0) {
+        s->corr_mode = CORR_FFT;
+      } else {
+        mp_msg(MSGT_AFILTER, MSGL_ERR, "[scaletempo] "
+               MSGTR_ErrorParsingCommandLine ": " MSGTR_AF_ValueOutOfRange
+               ": corr=[auto|direct|fft]\n");
+        return AF_ERROR;
+      }
+    }
     s->scale = s->speed * s->scale_nominal;
     mp_msg(MSGT_AFILTER, MSGL_DBG2, "[scaletempo] %6.3f scale, %6.2f stride, %6.2f overlap, %6.2f search, speed = %s\n", s->scale_nominal, s->ms_stride, s->percent_overlap, s->ms_search, (s->speed_tempo?(s->speed_pitch?"tempo and speed":"tempo"):(s->speed_pitch?"pitch":"none")));
     return AF_OK;
@@ -536,6 +678,8 @@ static void uninit(struct af_instance_s* af)
   free(s->buf_pre_corr);
   free(s->table_blend);
   free(s->table_window);
+  free(s->buf_fft);
+  af_fft_free(s->fft);
   free(af->setup);
 }
 
@@ -559,6 +703,8 @@ static int af_open(af_instance_t* af){
   s->ms_stride = 60;
   s->percent_overlap = .20;
   s->ms_search = 14;
+  s->corr_mode = CORR_AUTO;
+  af_dsp_init(&s->dsp, af_dsp_cpu_caps());
 
   return AF_OK;
 }
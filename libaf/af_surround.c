@@ -269,6 +269,6 @@ const af_info_t af_info_surround =
         "surround",
         "Steve Davies <steve@daviesfam.org>",
         "",
-        AF_FLAGS_NOT_REENTRANT,
+        AF_FLAGS_NOT_REENTRANT | AF_FLAGS_LOCAL_BUFFER,
         af_open
 };
@@ -94,6 +94,10 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
     if(((af_data_t*)arg)->format == (AF_FORMAT_S16_NE)){
       af->data->format = AF_FORMAT_S16_NE;
       af->data->bps    = 2;
+    }else if(AF_FORMAT_IS_PLANAR(((af_data_t*)arg)->format)){
+      // The gain is the same for all samples, the layout does not matter
+      af->data->format = AF_FORMAT_FLOAT_PLANAR;
+      af->data->bps    = 4;
     }else{
       af->data->format = AF_FORMAT_FLOAT_NE;
       af->data->bps    = 4;
@@ -308,7 +312,7 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
     else
 	method1_int16(s, data);
   }
-  else if(af->data->format == (AF_FORMAT_FLOAT_NE))
+  else
   {
     if (s->method)
 	method2_float(s, data);
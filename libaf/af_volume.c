@@ -39,6 +39,7 @@
 #include "libavutil/common.h"
 #include "mp_msg.h"
 #include "af.h"
+#include "af_dsp.h"
 
 // Data for specific instances of this filter
 typedef struct af_volume_s
@@ -47,6 +48,7 @@ typedef struct af_volume_s
   float level[AF_NCH];		// Gain level for each channel
   int soft;			// Enable/disable soft clipping
   int fast;			// Use fix-point volume control
+  struct af_dsp dsp;
 }af_volume_t;
 
 // Initialization and runtime control
@@ -62,7 +64,11 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
     af->data->rate   = ((af_data_t*)arg)->rate;
     af->data->nch    = ((af_data_t*)arg)->nch;
 
-    if(s->fast && (((af_data_t*)arg)->format != (AF_FORMAT_FLOAT_NE))){
+    if(AF_FORMAT_IS_PLANAR(((af_data_t*)arg)->format)){
+      af->data->format = AF_FORMAT_FLOAT_PLANAR;
+      af->data->bps    = 4;
+    }
+    else if(s->fast && (((af_data_t*)arg)->format != (AF_FORMAT_FLOAT_NE))){
       af->data->format = AF_FORMAT_S16_NE;
       af->data->bps    = 2;
     }
@@ -125,27 +131,6 @@ static av_always_inline void s16_inner_loop(int16_t *data, int len, int offset,
 static av_always_inline void float_inner_loop(float *data, int len, int offset, int step, float level, int softclip)
 {
   int i;
-#if HAVE_NEON
-  if (offset == 0 && step == 1 && !softclip && len >= 8)
-  {
-    __asm__(
-      "vmov.32 d2[0], %2\n\t"
-      "vdup.32 q8, %3\n\t"
-      "vneg.f32 q9, q8\n\t"
-"0:\n\t"
-      "vld1.32 {q0}, [%0]\n\t"
-      "vmul.f32 q0, q0, d2[0]\n\t"
-      "cmp %0, %1\n\t"
-      "vmin.f32 q0, q0, q8\n\t"
-      "vmax.f32 q0, q0, q9\n\t"
-      "vst1.32 {q0}, [%0]!\n\t"
-      "blo 0b\n\t"
-    : "+&r"(data)
-    : "r"(data + len - 7), "r"(level), "r"(0x3f800000)
-    : "cc", "q0", "d2", "q8", "q9", "memory");
-    len &= 3;
-  }
-#endif
   for (i = offset; i < len; i += step)
   {
     register float x = data[i];
@@ -186,7 +171,7 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
       s16_inner_loop(a, len, ch, nch, s->level[ch]);
   }
   // Machine is fast and data is floating point
-  else if(af->data->format == (AF_FORMAT_FLOAT_NE)){
+  else{
     float*   	a   	= (float*)c->audio;	// Audio data
     int       	len 	= c->len/4;		// Number of samples
     for (i = 0; !s->fast && i < len; i++)
@@ -195,7 +180,16 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
     if (same_vol && s->soft)
       float_inner_loop(a, len, 0, 1, s->level[0], 1);
     else if (same_vol)
-      float_inner_loop(a, len, 0, 1, s->level[0], 0);
+      s->dsp.gain_clip(a, s->level[0], len);
+    // Every channel is a plane of its own
+    else if (AF_FORMAT_IS_PLANAR(af->data->format)){
+      len /= nch;
+      for (ch = 0; ch < nch; ch++, a += len)
+        if (s->soft)
+          float_inner_loop(a, len, 0, 1, s->level[ch], 1);
+        else
+          s->dsp.gain_clip(a, s->level[ch], len);
+    }
     else for (ch = 0; ch < nch; ch++)
       float_inner_loop(a, len, ch, nch, s->level[ch], s->soft);
   }
@@ -213,6 +207,7 @@ static int af_open(af_instance_t* af){
   af->setup=calloc(1,sizeof(af_volume_t));
   if(af->data == NULL || af->setup == NULL)
     return AF_ERROR;
+  af_dsp_init(&((af_volume_t*)af->setup)->dsp, af_dsp_cpu_caps());
   // Enable volume control and set initial volume to 0dB.
   for(i=0;i<AF_NCH;i++){
     ((af_volume_t*)af->setup)->level[i]  = 1.0;
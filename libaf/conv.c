@@ -0,0 +1,196 @@
+/*
+ * uniformly partitioned FFT convolution
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "conv.h"
+
+/* Overlap-save: every block is transformed together with the block
+   before it, the second half of the inverse transform of the summed
+   spectrum products is the output of the block. The spectra of the
+   last nparts blocks of every input are kept in a ring, the products
+   with the older blocks do not change while a block fills up and are
+   summed once per block into hist. */
+
+#define SPEC(c, i, p)      ((c)->fdl  + ((i) * (c)->nparts + (p)) * 2 * (c)->part)
+#define FILT(c, o, i, p)   ((c)->filt + (((o) * (c)->nin + (i)) * (c)->nparts + (p)) * 2 * (c)->part)
+
+struct af_conv *af_conv_init(int part_bits, int nin, int nout, int max_len)
+{
+    struct af_conv *c = calloc(1, sizeof(*c));
+    int n;
+
+    if (!c)
+        return NULL;
+    c->part   = 1 << part_bits;
+    c->nparts = (max_len + c->part - 1) / c->part;
+    if (c->nparts < 1)
+        c->nparts = 1;
+    c->nin  = nin;
+    c->nout = nout;
+    n = 2 * c->part;
+    c->fft     = af_fft_init(part_bits + 1);
+    c->in      = calloc(nin * n, sizeof(float));
+    c->fdl     = calloc(nin * c->nparts * n, sizeof(float));
+    c->filt    = calloc(nout * nin * c->nparts * n, sizeof(float));
+    c->used    = calloc(nout * nin, 1);
+    c->in_used = calloc(nin, 1);
+    c->hist    = calloc(nout * n, sizeof(float));
+    c->tmp     = malloc(n * sizeof(float));
+    if (!c->fft || !c->in || !c->fdl || !c->filt || !c->used ||
+        !c->in_used || !c->hist || !c->tmp) {
+        af_conv_free(c);
+        return NULL;
+    }
+    return c;
+}
+
+void af_conv_free(struct af_conv *c)
+{
+    if (!c)
+        return;
+    af_fft_free(c->fft);
+    free(c->in);
+    free(c->fdl);
+    free(c->filt);
+    free(c->used);
+    free(c->in_used);
+    free(c->hist);
+    free(c->tmp);
+    free(c);
+}
+
+void af_conv_reset(struct af_conv *c)
+{
+    int n = 2 * c->part;
+    memset(c->in,  0, c->nin * n * sizeof(float));
+    memset(c->fdl, 0, c->nin * c->nparts * n * sizeof(float));
+    c->fill = 0;
+    c->pos  = 0;
+    c->hist_valid = 0;
+}
+
+int af_conv_set_filter(struct af_conv *c, int out, int in, const float *h,
+                       int len, int delay, float gain)
+{
+    int n = 2 * c->part;
+    int p, i, o;
+
+    if (len > 0 && delay + len > c->nparts * c->part)
+        return -1;
+    c->used[out * c->nin + in] = len > 0;
+    c->hist_valid = 0;
+    if (len > 0 && !c->in_used[in]) {
+        // its past blocks were not transformed while it was unused
+        memset(SPEC(c, in, 0), 0, c->nparts * n * sizeof(float));
+        c->in_used[in] = 1;
+    }
+    if (len <= 0) {
+        c->in_used[in] = 0;
+        for (o = 0; o < c->nout; o++)
+            c->in_used[in] |= c->used[o * c->nin + in];
+        return 0;
+    }
+
+    // the inverse transform scales by n
+    gain /= n;
+    for (p = 0; p < c->nparts; p++) {
+        float *f = FILT(c, out, in, p);
+        memset(f, 0, n * sizeof(float));
+        for (i = 0; i < c->part; i++) {
+            int t = p * c->part + i - delay;
+            if (t >= 0 && t < len)
+                f[i] = h[t] * gain;
+        }
+        af_fft_r2c(c->fft, f);
+    }
+    return 0;
+}
+
+/// sums of the products of the blocks before the current one
+static void update_hist(struct af_conv *c)
+{
+    int n = 2 * c->part;
+    int o, i, p;
+
+    for (o = 0; o < c->nout; o++) {
+        float *acc = c->hist + o * n;
+        memset(acc, 0, n * sizeof(float));
+        for (p = 1; p < c->nparts; p++) {
+            int slot = (c->pos - p + c->nparts) % c->nparts;
+            for (i = 0; i < c->nin; i++)
+                if (c->used[o * c->nin + i])
+                    af_fft_mul_acc(acc, FILT(c, o, i, p), SPEC(c, i, slot), n);
+        }
+    }
+    c->hist_valid = 1;
+}
+
+void af_conv_process(struct af_conv *c, float *const *out,
+                     const float *const *in, int n)
+{
+    int b = c->part;
+    int done = 0;
+    int i, o;
+
+    while (done < n) {
+        int m = FFMIN(n - done, b - c->fill);
+
+        for (i = 0; i < c->nin; i++)
+            memcpy(c->in + i * 2 * b + b + c->fill, in[i] + done,
+                   m * sizeof(float));
+        if (!c->hist_valid)
+            update_hist(c);
+
+        // the samples after fill + m are still zero
+        for (i = 0; i < c->nin; i++) {
+            float *x;
+            if (!c->in_used[i])
+                continue;
+            x = SPEC(c, i, c->pos);
+            memcpy(x, c->in + i * 2 * b, 2 * b * sizeof(float));
+            af_fft_r2c(c->fft, x);
+        }
+        for (o = 0; o < c->nout; o++) {
+            memcpy(c->tmp, c->hist + o * 2 * b, 2 * b * sizeof(float));
+            for (i = 0; i < c->nin; i++)
+                if (c->used[o * c->nin + i])
+                    af_fft_mul_acc(c->tmp, FILT(c, o, i, 0),
+                                   SPEC(c, i, c->pos), 2 * b);
+            af_fft_c2r(c->fft, c->tmp);
+            memcpy(out[o] + done, c->tmp + b + c->fill, m * sizeof(float));
+        }
+
+        c->fill += m;
+        done    += m;
+        if (c->fill == b) {
+            for (i = 0; i < c->nin; i++) {
+                float *x = c->in + i * 2 * b;
+                memcpy(x, x + b, b * sizeof(float));
+                memset(x + b, 0, b * sizeof(float));
+            }
+            c->pos  = (c->pos + 1) % c->nparts;
+            c->fill = 0;
+            c->hist_valid = 0;
+        }
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_CONV_H
+#define MPLAYER_CONV_H
+
+#include "fft.h"
+
+/**
+ * Uniformly partitioned FFT convolution of nin input signals with a
+ * matrix of FIR filters, summed into nout output signals.
+ *
+ * The filters are cut into partitions of part samples, each output block
+ * of part samples costs one forward FFT of 2*part points per input, one
+ * inverse FFT per output and a spectrum product per filter partition.
+ * There is no added latency: a block that is not complete yet is
+ * evaluated with the samples it has, and again when more arrive.
+ */
+struct af_conv {
+    struct af_fft *fft;
+    int part;           ///< partition and block length
+    int nparts;         ///< partitions of the longest filter
+    int nin, nout;
+    int fill;           ///< samples already in the current block
+    int pos;            ///< delay line slot of the current block
+    int hist_valid;     ///< hist holds the sums for the current block
+    float *in;          ///< per input the previous and the current block
+    float *fdl;         ///< per input nparts spectra of past blocks
+    float *filt;        ///< per output and input nparts filter spectra
+    unsigned char *used;    ///< per output and input, filter is set
+    unsigned char *in_used; ///< per input, any filter is set
+    float *hist;        ///< per output, sum over the older partitions
+    float *tmp;
+};
+
+/// \return NULL on failure, filters up to max_len taps are accepted
+struct af_conv *af_conv_init(int part_bits, int nin, int nout, int max_len);
+void af_conv_free(struct af_conv *c);
+
+/**
+ * \brief set the filter from input in to output out
+ *
+ * Tap i of h is applied with a delay of delay + i samples and scaled
+ * by gain. len 0 removes the filter.
+ * \return -1 if the filter is longer than max_len
+ */
+int af_conv_set_filter(struct af_conv *c, int out, int in, const float *h,
+                       int len, int delay, float gain);
+
+/// forget the past input, the filters are kept
+void af_conv_reset(struct af_conv *c);
+
+/// convolve n samples of every input signal into n samples of every output
+void af_conv_process(struct af_conv *c, float *const *out,
+                     const float *const *in, int n);
+
+#endif /* MPLAYER_CONV_H */
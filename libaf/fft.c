@@ -0,0 +1,189 @@
+/*
+ * real FFT for the audio filters
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "fft.h"
+
+/* The real transform of n points is done as a complex transform of the
+   n/2 points x[2k] + i*x[2k+1], followed (forward) or preceded (inverse)
+   by a pass that separates the spectra of the even and odd samples. */
+
+struct af_fft *af_fft_init(int bits)
+{
+    struct af_fft *f;
+    int n, m, i, j;
+
+    if (bits < 2 || bits > 24)
+        return NULL;
+    f = calloc(1, sizeof(*f));
+    if (!f)
+        return NULL;
+    n = 1 << bits;
+    m = n >> 1;
+    f->bits = bits;
+    f->n    = n;
+    f->tw   = malloc(sizeof(float) * m);
+    f->rtw  = malloc(sizeof(float) * 2 * (n / 4 + 1));
+    f->rev  = malloc(sizeof(unsigned int) * m);
+    if (!f->tw || !f->rtw || !f->rev) {
+        af_fft_free(f);
+        return NULL;
+    }
+    for (i = 0; i < m / 2; i++) {
+        f->tw[2 * i]     =  cos(2 * M_PI * i / m);
+        f->tw[2 * i + 1] = -sin(2 * M_PI * i / m);
+    }
+    for (i = 0; i <= n / 4; i++) {
+        f->rtw[2 * i]     = cos(2 * M_PI * i / n);
+        f->rtw[2 * i + 1] = sin(2 * M_PI * i / n);
+    }
+    for (i = 0; i < m; i++) {
+        unsigned int r = 0;
+        for (j = 0; j < bits - 1; j++)
+            r |= ((i >> j) & 1) << (bits - 2 - j);
+        f->rev[i] = r;
+    }
+    return f;
+}
+
+void af_fft_free(struct af_fft *f)
+{
+    if (!f)
+        return;
+    free(f->tw);
+    free(f->rtw);
+    free(f->rev);
+    free(f);
+}
+
+int af_fft_bits(int n)
+{
+    int bits = 0;
+    while ((1 << bits) < n)
+        bits++;
+    return bits;
+}
+
+/// radix-2 decimation in time, sign selects the inverse transform
+static void fft_complex(const struct af_fft *f, float *z, int inverse)
+{
+    int m = f->n >> 1;
+    int len, i, j;
+
+    for (i = 0; i < m; i++) {
+        int r = f->rev[i];
+        if (i < r) {
+            float tr = z[2 * i], ti = z[2 * i + 1];
+            z[2 * i]     = z[2 * r];
+            z[2 * i + 1] = z[2 * r + 1];
+            z[2 * r]     = tr;
+            z[2 * r + 1] = ti;
+        }
+    }
+    for (len = 2; len <= m; len <<= 1) {
+        int half = len >> 1, step = m / len;
+        for (j = 0; j < half; j++) {
+            float wr = f->tw[2 * j * step];
+            float wi = inverse ? -f->tw[2 * j * step + 1]
+                               :  f->tw[2 * j * step + 1];
+            for (i = j; i < m; i += len) {
+                float *a = z + 2 * i, *b = a + 2 * half;
+                float tr = b[0] * wr - b[1] * wi;
+                float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+void af_fft_r2c(const struct af_fft *f, float *data)
+{
+    int m = f->n >> 1;
+    int k;
+    float t;
+
+    fft_complex(f, data, 0);
+    t       = data[0];
+    data[0] = t + data[1];
+    data[1] = t - data[1];
+    for (k = 1; k <= m / 2; k++) {
+        float *a = data + 2 * k, *b = data + 2 * (m - k);
+        float c  = f->rtw[2 * k], s = f->rtw[2 * k + 1];
+        float er = 0.5f * (a[0] + b[0]), ei = 0.5f * (a[1] - b[1]);
+        float or = 0.5f * (a[1] + b[1]), oi = 0.5f * (b[0] - a[0]);
+        // W * O with W = exp(-2*pi*i*k/n)
+        float wr = c * or + s * oi, wi = c * oi - s * or;
+        a[0] = er + wr;
+        a[1] = ei + wi;
+        b[0] = er - wr;
+        b[1] = wi - ei;
+    }
+}
+
+void af_fft_c2r(const struct af_fft *f, float *data)
+{
+    int m = f->n >> 1;
+    int k;
+    float t;
+
+    t       = data[0];
+    data[0] = t + data[1];
+    data[1] = t - data[1];
+    for (k = 1; k <= m / 2; k++) {
+        float *a = data + 2 * k, *b = data + 2 * (m - k);
+        float c  = f->rtw[2 * k], s = f->rtw[2 * k + 1];
+        float er = a[0] + b[0], ei = a[1] - b[1];
+        float dr = a[0] - b[0], di = a[1] + b[1];
+        // O = D * conj(W), Z = E + i*O
+        float or = c * dr - s * di, oi = c * di + s * dr;
+        a[0] = er - oi;
+        a[1] = ei + or;
+        b[0] = er + oi;
+        b[1] = or - ei;
+    }
+    fft_complex(f, data, 1);
+}
+
+void af_fft_mul_acc(float *dst, const float *a, const float *b, int n)
+{
+    int i;
+    dst[0] += a[0] * b[0];
+    dst[1] += a[1] * b[1];
+    for (i = 2; i < n; i += 2) {
+        dst[i]     += a[i] * b[i]     - a[i + 1] * b[i + 1];
+        dst[i + 1] += a[i + 1] * b[i] + a[i] * b[i + 1];
+    }
+}
+
+void af_fft_mul_conj_acc(float *dst, const float *a, const float *b, int n)
+{
+    int i;
+    dst[0] += a[0] * b[0];
+    dst[1] += a[1] * b[1];
+    for (i = 2; i < n; i += 2) {
+        dst[i]     += a[i] * b[i]     + a[i + 1] * b[i + 1];
+        dst[i + 1] += a[i + 1] * b[i] - a[i] * b[i + 1];
+    }
+}
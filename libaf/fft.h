@@ -0,0 +1,53 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_FFT_H
+#define MPLAYER_FFT_H
+
+/**
+ * In place real FFT of n = 2^bits floats.
+ *
+ * The spectrum is packed into the same n floats: data[0] is the DC
+ * term, data[1] the (real) term at n/2, and data[2k], data[2k+1] are
+ * the real and imaginary part of bin k for 0 < k < n/2.
+ * The transforms are not normalized, af_fft_c2r(af_fft_r2c(x)) gives
+ * n * x.
+ */
+struct af_fft {
+    int bits;
+    int n;
+    float *tw;          ///< n/4 complex twiddles of the n/2 point complex FFT
+    float *rtw;         ///< cos and sin of 2*pi*k/n for 0 <= k <= n/4
+    unsigned int *rev;  ///< bit reversal of the n/2 complex points
+};
+
+/// \return NULL on failure, 2 <= bits <= 24
+struct af_fft *af_fft_init(int bits);
+void af_fft_free(struct af_fft *f);
+void af_fft_r2c(const struct af_fft *f, float *data);
+void af_fft_c2r(const struct af_fft *f, float *data);
+
+/// smallest bits with 2^bits >= n
+int af_fft_bits(int n);
+
+/// dst += a * b, all three packed spectra of n floats
+void af_fft_mul_acc(float *dst, const float *a, const float *b, int n);
+/// dst += a * conj(b)
+void af_fft_mul_conj_acc(float *dst, const float *a, const float *b, int n);
+
+#endif /* MPLAYER_FFT_H */
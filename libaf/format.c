@@ -149,6 +149,8 @@ char* af_fmt2str(int format, char* str, int size)
 
       i+=snprintf(&str[i],size-i,"int ");
     }
+    if(AF_FORMAT_IS_PLANAR(format))
+      i+=snprintf(&str[i],size-i,"planar ");
   }
   // remove trailing space
   if (i > 0 && str[i - 1] == ' ')
@@ -195,6 +197,7 @@ static struct {
     { "floatle", AF_FORMAT_FLOAT_LE },
     { "floatbe", AF_FORMAT_FLOAT_BE },
     { "floatne", AF_FORMAT_FLOAT_NE },
+    { "floatp", AF_FORMAT_FLOAT_PLANAR },
 
     { NULL, 0 }
 };
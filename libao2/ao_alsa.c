@@ -27,7 +27,9 @@
  */
 
 #include <errno.h>
+#include <stdint.h>
 #include <sys/time.h>
+#include <time.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <ctype.h>
@@ -67,6 +69,12 @@ static size_t bytes_per_sample;
 static int alsa_can_pause;
 static int prepause_space;
 
+static int alsa_mmap;       // written through snd_pcm_mmap_begin/commit
+static snd_pcm_uframes_t alsa_bufsize;
+static snd_pcm_uframes_t alsa_start_threshold;
+static unsigned int alsa_period_us;
+static int alsa_tstamp_monotonic; // status timestamps use CLOCK_MONOTONIC
+
 #define ALSA_DEVICE_SIZE 256
 
 static void alsa_error_handler(const char *file, int line, const char *function,
@@ -340,10 +348,14 @@ static int try_open_device(const char *device, int open_mode, int try_ac3)
 */
 static int init(int rate_hz, int channels, int format, int flags)
 {
-    unsigned int alsa_buffer_time = 500000; /* 0.5 s */
+    unsigned int alsa_buffer_time;
+    unsigned int alsa_period_time;
     unsigned int alsa_fragcount = 16;
     int err;
     int block;
+    int use_mmap;
+    int buffer_ms;
+    int period_ms;
     strarg_t device;
     snd_pcm_uframes_t chunk_size;
     snd_pcm_uframes_t bufsize;
@@ -351,6 +363,9 @@ static int init(int rate_hz, int channels, int format, int flags)
     const opt_t subopts[] = {
       {"block", OPT_ARG_BOOL, &block, NULL},
       {"device", OPT_ARG_STR, &device, str_maxlen},
+      {"mmap", OPT_ARG_BOOL, &use_mmap, NULL},
+      {"buffer_time", OPT_ARG_INT, &buffer_ms, int_pos},
+      {"period_time", OPT_ARG_INT, &period_ms, int_pos},
       {NULL}
     };
 
@@ -442,6 +457,9 @@ static int init(int rate_hz, int channels, int format, int flags)
     //subdevice parsing
     // set defaults
     block = 1;
+    use_mmap = 0;
+    buffer_ms = 500;
+    period_ms = 0; // 16 periods per buffer
     /* switch for spdif
      * sets opening sequence for SPDIF
      * sets also the playback and other switches 'on the fly'
@@ -533,8 +551,19 @@ static int init(int rate_hz, int channels, int format, int flags)
 	  return 0;
 	}
 
-      err = snd_pcm_hw_params_set_access(alsa_handler, alsa_hwparams,
-					 SND_PCM_ACCESS_RW_INTERLEAVED);
+      alsa_mmap = 0;
+      if (use_mmap) {
+	err = snd_pcm_hw_params_set_access(alsa_handler, alsa_hwparams,
+					   SND_PCM_ACCESS_MMAP_INTERLEAVED);
+	if (err < 0)
+	  mp_msg(MSGT_AO,MSGL_WARN,MSGTR_AO_ALSA_MmapNotSupported,
+		 snd_strerror(err));
+	else
+	  alsa_mmap = 1;
+      }
+      if (!alsa_mmap)
+	err = snd_pcm_hw_params_set_access(alsa_handler, alsa_hwparams,
+					   SND_PCM_ACCESS_RW_INTERLEAVED);
       if (err < 0) {
 	mp_msg(MSGT_AO,MSGL_ERR,MSGTR_AO_ALSA_UnableToSetAccessType,
 	       snd_strerror(err));
@@ -598,6 +627,7 @@ static int init(int rate_hz, int channels, int format, int flags)
       bytes_per_sample *= ao_data.channels;
       ao_data.bps = ao_data.samplerate * bytes_per_sample;
 
+	alsa_buffer_time = buffer_ms * 1000;
 	if ((err = snd_pcm_hw_params_set_buffer_time_near(alsa_handler, alsa_hwparams,
 							  &alsa_buffer_time, NULL)) < 0)
 	  {
@@ -606,8 +636,14 @@ static int init(int rate_hz, int channels, int format, int flags)
 	    return 0;
 	  }
 
-	if ((err = snd_pcm_hw_params_set_periods_near(alsa_handler, alsa_hwparams,
-						      &alsa_fragcount, NULL)) < 0) {
+	if (period_ms) {
+	  alsa_period_time = period_ms * 1000;
+	  err = snd_pcm_hw_params_set_period_time_near(alsa_handler, alsa_hwparams,
+						       &alsa_period_time, NULL);
+	} else
+	  err = snd_pcm_hw_params_set_periods_near(alsa_handler, alsa_hwparams,
+						   &alsa_fragcount, NULL);
+	if (err < 0) {
 	  mp_msg(MSGT_AO,MSGL_ERR,MSGTR_AO_ALSA_UnableToSetPeriods,
 		 snd_strerror(err));
 	  return 0;
@@ -631,6 +667,7 @@ static int init(int rate_hz, int channels, int format, int flags)
 	}
       else {
 	ao_data.buffersize = bufsize * bytes_per_sample;
+	alsa_bufsize = bufsize;
 	  mp_msg(MSGT_AO,MSGL_V,"alsa-init: got buffersize=%i\n", ao_data.buffersize);
       }
 
@@ -641,6 +678,8 @@ static int init(int rate_hz, int channels, int format, int flags)
 	mp_msg(MSGT_AO,MSGL_V,"alsa-init: got period size %li\n", chunk_size);
       }
       ao_data.outburst = chunk_size * bytes_per_sample;
+      alsa_start_threshold = chunk_size;
+      alsa_period_us = (uint64_t)chunk_size * 1000000 / ao_data.samplerate;
 
       /* setting software parameters */
       if ((err = snd_pcm_sw_params_current(alsa_handler, alsa_swparams)) < 0) {
@@ -677,6 +716,10 @@ static int init(int rate_hz, int channels, int format, int flags)
 	return 0;
       }
 #endif
+      /* timestamp the hardware pointer updates for get_delay() */
+      if ((err = snd_pcm_sw_params_set_tstamp_mode(alsa_handler, alsa_swparams,
+						    SND_PCM_TSTAMP_ENABLE)) < 0)
+	mp_msg(MSGT_AO,MSGL_V,"alsa-init: no timestamps: %s\n", snd_strerror(err));
       if ((err = snd_pcm_sw_params(alsa_handler, alsa_swparams)) < 0) {
 	mp_msg(MSGT_AO,MSGL_ERR,MSGTR_AO_ALSA_UnableToGetSwParameters,
 	       snd_strerror(err));
@@ -684,12 +727,15 @@ static int init(int rate_hz, int channels, int format, int flags)
       }
       /* end setting sw-params */
 
-      mp_msg(MSGT_AO,MSGL_V,"alsa: %d Hz/%d channels/%d bpf/%d bytes buffer/%s\n",
+      mp_msg(MSGT_AO,MSGL_V,"alsa: %d Hz/%d channels/%d bpf/%d bytes buffer/%s/%s\n",
 	     ao_data.samplerate, ao_data.channels, (int)bytes_per_sample, ao_data.buffersize,
-	     snd_pcm_format_description(alsa_format));
+	     snd_pcm_format_description(alsa_format), alsa_mmap ? "mmap" : "rw");
 
     } // end switch alsa_handler (spdif)
     alsa_can_pause = snd_pcm_hw_params_can_pause(alsa_hwparams);
+#if SND_LIB_VERSION >= 0x010010
+    alsa_tstamp_monotonic = snd_pcm_hw_params_is_monotonic(alsa_hwparams) > 0;
+#endif
     return 1;
 } // end init
 
@@ -784,6 +830,49 @@ static void reset(void)
     return;
 }
 
+/*
+    copies num_frames frames into the mmap area of the device, waits for
+    room like snd_pcm_writei() does
+    returns: number of frames written or a negative error code
+*/
+static snd_pcm_sframes_t write_mmap(const void *data, snd_pcm_uframes_t num_frames)
+{
+  const char *src = data;
+  snd_pcm_uframes_t written = 0;
+
+  while (written < num_frames) {
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t offset, frames;
+    snd_pcm_sframes_t avail, res;
+
+    avail = snd_pcm_avail_update(alsa_handler);
+    if (avail < 0)
+      return written ? written : avail;
+    if (avail == 0) {
+      if ((res = snd_pcm_wait(alsa_handler, 1000)) < 0)
+	return written ? written : res;
+      continue;
+    }
+    frames = num_frames - written;
+    if ((res = snd_pcm_mmap_begin(alsa_handler, &areas, &offset, &frames)) < 0)
+      return written ? written : res;
+    /* interleaved: one area, its step is the frame size */
+    memcpy((char *)areas[0].addr + (areas[0].first + offset * areas[0].step) / 8,
+	   src + written * bytes_per_sample, frames * bytes_per_sample);
+    res = snd_pcm_mmap_commit(alsa_handler, offset, frames);
+    if (res < 0)
+      return written ? written : res;
+    written += res;
+
+    /* unlike snd_pcm_writei(), a commit does not check the start threshold */
+    if (snd_pcm_state(alsa_handler) == SND_PCM_STATE_PREPARED &&
+	alsa_bufsize - snd_pcm_avail_update(alsa_handler) >= alsa_start_threshold &&
+	(res = snd_pcm_start(alsa_handler)) < 0)
+      return written;
+  }
+  return written;
+}
+
 /*
     plays 'len' bytes of 'data'
     returns: number of bytes played
@@ -810,7 +899,10 @@ static int play(void* data, int len, int flags)
     return 0;
 
   do {
-    res = snd_pcm_writei(alsa_handler, data, num_frames);
+    if (alsa_mmap)
+      res = write_mmap(data, num_frames);
+    else
+      res = snd_pcm_writei(alsa_handler, data, num_frames);
 
       if (res == -EINTR) {
 	/* nothing to do */
@@ -855,14 +947,59 @@ static int get_space(void)
     return ret;
 }
 
+#if SND_LIB_VERSION >= 0x010010
+/* microseconds from ts to now in the clock of the status timestamps,
+   -1 if that clock cannot be read */
+static int64_t tstamp_age(const snd_htimestamp_t *ts)
+{
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec now;
+    clock_gettime(alsa_tstamp_monotonic ? CLOCK_MONOTONIC : CLOCK_REALTIME, &now);
+    return (int64_t)(now.tv_sec - ts->tv_sec) * 1000000 +
+           (now.tv_nsec - ts->tv_nsec) / 1000;
+#else
+    struct timeval now;
+    if (alsa_tstamp_monotonic)
+        return -1;
+    gettimeofday(&now, NULL);
+    return (int64_t)(now.tv_sec - ts->tv_sec) * 1000000 +
+           now.tv_usec - ts->tv_nsec / 1000;
+#endif
+}
+#endif
+
 /* delay in seconds between first and last sample in buffer */
 static float get_delay(void)
 {
   if (alsa_handler) {
     snd_pcm_sframes_t delay;
+#if SND_LIB_VERSION >= 0x010010 /* snd_pcm_status_get_htstamp() exists since 1.0.16 */
+    snd_pcm_status_t *status;
 
+    snd_pcm_status_alloca(&status);
+    if (snd_pcm_status(alsa_handler, status) < 0)
+      return 0;
+    delay = snd_pcm_status_get_delay(status);
+    if (snd_pcm_status_get_state(status) == SND_PCM_STATE_RUNNING && delay > 0) {
+      /* the delay is that of the last hardware pointer update, count the
+         time since then, at most a period in case the clocks disagree */
+      snd_htimestamp_t ts;
+      int64_t us;
+
+      snd_pcm_status_get_htstamp(status, &ts);
+      us = tstamp_age(&ts);
+      if ((ts.tv_sec || ts.tv_nsec) && us > 0) {
+        if (us > alsa_period_us)
+          us = alsa_period_us;
+        delay -= us * ao_data.samplerate / 1000000;
+        if (delay < 0)
+          delay = 0;
+      }
+    }
+#else
     if (snd_pcm_delay(alsa_handler, &delay) < 0)
       return 0;
+#endif
 
     if (delay < 0) {
       /* underrun - move the application pointer forward to catch up */
@@ -0,0 +1,317 @@
+/*
+ * audio driver fed from its own thread
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "config.h"
+#include "mp_msg.h"
+#include "libavutil/common.h"
+#include "libaf/af_format.h"
+#include "audio_out.h"
+#include "audio_thread.h"
+
+/* The main loop is the only writer of the ring and the thread its only
+   reader, the free running positions are published after the data they
+   cover and need no lock. The lock serializes the calls into the driver,
+   the thread holds it except while it waits. The first MAX_OUTBURST
+   bytes of the ring are repeated behind its end so that the thread can
+   pass any chunk to the driver in one piece. */
+
+#define BARRIER() __sync_synchronize()
+
+/// drivers that stamp or time their output with the ao_data.pts of play()
+static const char * const pts_drivers[] = {
+    "pcm", "mpegpes", "dxr2", "ivtv", "v4l2", NULL
+};
+
+static const ao_functions_t *ao;
+static pthread_t thread;
+static pthread_mutex_t lock    = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  wakeup  = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  drained = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  consumed = PTHREAD_COND_INITIALIZER;
+static int running, quit, paused;
+
+static unsigned char *ring;
+static unsigned int ring_size;  ///< power of 2
+static unsigned int queue_len;  ///< bytes the main loop may queue
+static unsigned int mirror;     ///< bytes repeated behind the end
+static unsigned int frame;
+static volatile unsigned int wpos, rpos;
+static volatile unsigned int final_pos;
+static volatile int final;      ///< the audio up to final_pos is the last
+
+/// wait with lock held until cond is signalled or ms milliseconds have passed
+static void wait_cond_ms(pthread_cond_t *cond, int ms)
+{
+    struct timeval tv;
+    struct timespec ts;
+
+    gettimeofday(&tv, NULL);
+    ts.tv_sec  = tv.tv_sec + ms / 1000;
+    ts.tv_nsec = (tv.tv_usec + ms % 1000 * 1000) * 1000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(cond, &lock, &ts);
+}
+
+static void wait_ms(int ms)
+{
+    wait_cond_ms(&wakeup, ms);
+}
+
+static void *feeder(void *arg)
+{
+    pthread_mutex_lock(&lock);
+    while (!quit) {
+        unsigned int w = wpos;
+        unsigned int avail;
+        int last, space, len;
+
+        BARRIER();
+        avail = w - rpos;
+        last  = final && final_pos == w;
+        if (!avail)
+            pthread_cond_broadcast(&drained);
+        if (paused || !avail) {
+            wait_ms(20);
+            continue;
+        }
+        space = ao->get_space();
+        len = FFMIN(FFMIN(avail, space), mirror);
+        if (!last || len < avail)
+            len -= len % ao_data.outburst;
+        if (len <= 0) {
+            // until the driver has room for an outburst or more is queued
+            int ms = 20;
+            if (space < ao_data.outburst)
+                ms = (int64_t)(ao_data.outburst - space) * 1000 / ao_data.bps;
+            wait_ms(av_clip(ms, 1, 20));
+            continue;
+        }
+        len = ao->play(ring + (rpos & (ring_size - 1)), len,
+                       last && len == avail ? AOPLAY_FINAL_CHUNK : 0);
+        if (len > 0) {
+            BARRIER();
+            rpos += len;
+            pthread_cond_broadcast(&consumed);
+        } else if (last && ao->get_delay() < .04) {
+            // same as the main loop: a driver that refuses the end drops it
+            rpos = w;
+            pthread_cond_broadcast(&consumed);
+        } else
+            wait_ms(5);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static int control(int cmd, void *arg)
+{
+    int r;
+    pthread_mutex_lock(&lock);
+    r = ao->control(cmd, arg);
+    pthread_mutex_unlock(&lock);
+    return r;
+}
+
+static int init(int rate, int channels, int format, int flags)
+{
+    return 0;
+}
+
+static void uninit(int immed)
+{
+    pthread_mutex_lock(&lock);
+    if (!immed && !paused) {
+        // let the queued audio play out, bounded in case the driver stalls
+        int ms = (int64_t)queue_len * 1000 / ao_data.bps + 1000;
+        struct timeval tv;
+        struct timespec ts;
+        gettimeofday(&tv, NULL);
+        ts.tv_sec  = tv.tv_sec + ms / 1000;
+        ts.tv_nsec = (tv.tv_usec + ms % 1000 * 1000) * 1000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        while (wpos != rpos)
+            if (pthread_cond_timedwait(&drained, &lock, &ts))
+                break;
+    }
+    quit = 1;
+    pthread_cond_signal(&wakeup);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+    running = 0;
+    ao->uninit(immed);
+    free(ring);
+    ring = NULL;
+}
+
+static void reset(void)
+{
+    pthread_mutex_lock(&lock);
+    rpos  = wpos;
+    final = 0;
+    ao->reset();
+    pthread_mutex_unlock(&lock);
+}
+
+static int get_space(void)
+{
+    unsigned int queued = wpos - rpos;
+    return queued < queue_len ? queue_len - queued : 0;
+}
+
+static int play(void *data, int len, int flags)
+{
+    unsigned char *src = data;
+    unsigned int w = wpos;
+    unsigned int off = w & (ring_size - 1);
+    int want = len;
+    int first;
+
+    len = FFMIN(len, get_space());
+    len -= len % frame;
+    if (len <= 0)
+        return 0;
+    first = FFMIN(len, ring_size - off);
+    memcpy(ring + off, src, first);
+    memcpy(ring, src + first, len - first);
+    if (off < mirror)
+        memcpy(ring + ring_size + off, src, FFMIN(first, mirror - off));
+    if (len > first)
+        memcpy(ring + ring_size, src + first, FFMIN(len - first, mirror));
+    if ((flags & AOPLAY_FINAL_CHUNK) && len == want) {
+        final_pos = w + len;
+        final     = 1;
+    }
+    BARRIER();
+    wpos = w + len;
+    // under the lock, else the wakeup can fall between the thread reading
+    // wpos and starting to wait
+    pthread_mutex_lock(&lock);
+    pthread_cond_signal(&wakeup);
+    pthread_mutex_unlock(&lock);
+    return len;
+}
+
+static float get_delay(void)
+{
+    unsigned int queued;
+    float delay;
+
+    pthread_mutex_lock(&lock);
+    delay  = ao->get_delay();
+    queued = wpos - rpos;
+    pthread_mutex_unlock(&lock);
+    return delay + (float)queued / ao_data.bps;
+}
+
+static void audio_pause(void)
+{
+    pthread_mutex_lock(&lock);
+    paused = 1;
+    ao->pause();
+    pthread_mutex_unlock(&lock);
+}
+
+static void audio_resume(void)
+{
+    pthread_mutex_lock(&lock);
+    paused = 0;
+    ao->resume();
+    pthread_cond_signal(&wakeup);
+    pthread_mutex_unlock(&lock);
+}
+
+static ao_functions_t audio_out_thread = {
+    NULL,
+    control,
+    init,
+    uninit,
+    reset,
+    get_space,
+    play,
+    get_delay,
+    audio_pause,
+    audio_resume
+};
+
+const ao_functions_t *audio_thread_start(const ao_functions_t *driver, int queue_ms)
+{
+    int i;
+
+    if (queue_ms <= 0 || running || ao_data.bps <= 0)
+        return driver;
+    for (i = 0; pts_drivers[i]; i++)
+        if (!strcmp(driver->info->short_name, pts_drivers[i]))
+            return driver;
+
+    frame = ao_data.channels * (af_fmt2bits(ao_data.format) / 8);
+    if (frame <= 0)
+        frame = 1;
+    queue_len = (int64_t)queue_ms * ao_data.bps / 1000;
+    queue_len = FFMAX(queue_len, 2 * ao_data.outburst);
+    queue_len -= queue_len % frame;
+    if (queue_len > 1 << 28)
+        return driver;
+    ring_size = 1;
+    while (ring_size < queue_len)
+        ring_size <<= 1;
+    mirror = FFMIN(FFMAX(MAX_OUTBURST, ao_data.outburst), ring_size);
+    ring = malloc(ring_size + mirror);
+    if (!ring)
+        return driver;
+
+    ao     = driver;
+    wpos   = rpos = 0;
+    final  = 0;
+    quit   = 0;
+    paused = 0;
+    audio_out_thread.info = driver->info;
+    if (pthread_create(&thread, NULL, feeder, NULL)) {
+        mp_msg(MSGT_AO, MSGL_WARN, "[AO] Cannot start the audio thread.\n");
+        free(ring);
+        ring = NULL;
+        return driver;
+    }
+    running = 1;
+    mp_msg(MSGT_AO, MSGL_V, "[AO] %s is fed from a thread, %u bytes queue.\n",
+           driver->info->short_name, queue_len);
+    return &audio_out_thread;
+}
+
+int audio_thread_wait(int bytes, int ms)
+{
+    if (!running)
+        return 0;
+    pthread_mutex_lock(&lock);
+    if (!paused && get_space() < bytes)
+        wait_cond_ms(&consumed, ms);
+    pthread_mutex_unlock(&lock);
+    return 1;
+}
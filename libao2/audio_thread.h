@@ -0,0 +1,51 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_AUDIO_THREAD_H
+#define MPLAYER_AUDIO_THREAD_H
+
+#include "config.h"
+#include "audio_out.h"
+
+#if HAVE_PTHREADS
+/**
+ * \brief feed an initialized audio driver from its own thread
+ *
+ * The returned driver queues the audio passed to play() in a ring of
+ * queue_ms milliseconds that a thread writes to ao whenever it has room,
+ * get_delay() includes the queued audio. All other calls are passed on
+ * to ao. Uninit of the returned driver also stops the thread.
+ * \return ao itself if queue_ms is 0, the driver times its output by
+ *         ao_data.pts or the thread could not be started
+ */
+const ao_functions_t *audio_thread_start(const ao_functions_t *ao, int queue_ms);
+
+/**
+ * \brief wait until the queue has room for bytes or ms milliseconds passed
+ *
+ * Lets the main loop sleep in audio-only playback until the thread has
+ * passed queued audio on to the driver.
+ * \return 0 without waiting if the current driver is not fed by the thread
+ */
+int audio_thread_wait(int bytes, int ms);
+#else
+#define audio_thread_start(ao, queue_ms) (ao)
+#define audio_thread_wait(bytes, ms) 0
+#endif
+
+#endif /* MPLAYER_AUDIO_THREAD_H */
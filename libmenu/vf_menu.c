@@ -158,11 +158,11 @@ static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
     // last captured frame.
     if(pause_mpi && (mpi->w != pause_mpi->w || mpi->h != pause_mpi->h ||
 		     mpi->imgfmt != pause_mpi->imgfmt)) {
-      free_mp_image(pause_mpi);
+      vf_free_mpi(vf, pause_mpi);
       pause_mpi = NULL;
     }
   if (!pause_mpi) {
-    pause_mpi = alloc_mpi(mpi->w,mpi->h,mpi->imgfmt);
+    pause_mpi = vf_alloc_mpi(vf,mpi->w,mpi->h,mpi->imgfmt);
     copy_mpi(pause_mpi,mpi);
   }
   else if (mpctx_get_osd_function(vf->priv->root->ctx) == OSD_PAUSE)
@@ -208,7 +208,7 @@ static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
 static void uninit(vf_instance_t *vf) {
      vf->priv=NULL;
      if(pause_mpi) {
-       free_mp_image(pause_mpi);
+       vf_free_mpi(vf, pause_mpi);
        pause_mpi = NULL;
      }
 }
@@ -0,0 +1,350 @@
+/*
+ * row kernels for the hqdn3d denoiser
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdint.h>
+
+#include "config.h"
+#include "mpx86asm.h"
+#include "hqdn3d.h"
+
+static void vertical_C(unsigned int *LineAnt, const unsigned int *Horiz,
+                       unsigned short *FrameAnt, unsigned char *FrameDest,
+                       int W, const int *Vertical, const int *Temporal)
+{
+    int X;
+    unsigned int PixelDst;
+
+    if (!Temporal) {
+        for (X = 0; X < W; X++) {
+            PixelDst = LineAnt[X] = LowPassMul(LineAnt[X], Horiz[X], Vertical);
+            FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+        }
+        return;
+    }
+    for (X = 0; X < W; X++) {
+        LineAnt[X] = LowPassMul(LineAnt[X], Horiz[X], Vertical);
+        PixelDst = LowPassMul(FrameAnt[X]<<8, LineAnt[X], Temporal);
+        FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
+        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+    }
+}
+
+static void temporal_C(const unsigned char *Frame, unsigned short *FrameAnt,
+                       unsigned char *FrameDest, int W, const int *Temporal)
+{
+    int X;
+    unsigned int PixelDst;
+
+    for (X = 0; X < W; X++) {
+        PixelDst = LowPassMul(FrameAnt[X]<<8, Frame[X]<<16, Temporal);
+        FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
+        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+    }
+}
+
+/*
+ * The SIMD versions compute LowPassMul() on 4 or 8 pixels at once with
+ * xmm0 = PrevMul - CurrMul and xmm1 = CurrMul, leaving the result in xmm1.
+ * The coefficient table lookups are done with vpgatherdd on AVX2 and one
+ * movd per lane on SSE2. They need more registers than x86_32 offers.
+ */
+#if ARCH_X86_64 && (HAVE_SSE2_INLINE || HAVE_AVX2_INLINE)
+static const int32_t __attribute__((aligned(16))) pd_bias[4] = { 0x10007FF, 0x10007FF, 0x10007FF, 0x10007FF };
+static const int32_t __attribute__((aligned(16))) pd_r8[4]   = { 0x1000007F, 0x1000007F, 0x1000007F, 0x1000007F };
+static const int32_t __attribute__((aligned(16))) pd_r16[4]  = { 0x10007FFF, 0x10007FFF, 0x10007FFF, 0x10007FFF };
+#endif
+
+#if ARCH_X86_64 && HAVE_SSE2_INLINE
+#define LOWPASS_SSE2(coef) \
+    "paddd       %%xmm7, %%xmm0             \n\t" \
+    "psrld          $12, %%xmm0             \n\t" \
+    "movq        %%xmm0, %[t]               \n\t" \
+    "pshufd  $0xEE, %%xmm0, %%xmm0          \n\t" \
+    "movq        %%xmm0, %[u]               \n\t" \
+    "mov          %k[t], %k[v]              \n\t" \
+    "shr            $32, %[t]               \n\t" \
+    "movd   ("coef",%[v],4), %%xmm2         \n\t" \
+    "movd   ("coef",%[t],4), %%xmm3         \n\t" \
+    "mov          %k[u], %k[v]              \n\t" \
+    "shr            $32, %[u]               \n\t" \
+    "movd   ("coef",%[v],4), %%xmm4         \n\t" \
+    "movd   ("coef",%[u],4), %%xmm0         \n\t" \
+    "punpckldq   %%xmm3, %%xmm2             \n\t" \
+    "punpckldq   %%xmm0, %%xmm4             \n\t" \
+    "punpcklqdq  %%xmm4, %%xmm2             \n\t" \
+    "paddd       %%xmm2, %%xmm1             \n\t"
+
+// FrameAnt = PixelDst + 0x1000007F >> 8, truncated to 16 bits
+#define STORE_ANT_SSE2 \
+    "movdqa      %%xmm1, %%xmm0             \n\t" \
+    "paddd       %%xmm6, %%xmm0             \n\t" \
+    "psrld           $8, %%xmm0             \n\t" \
+    "pshuflw $0x08, %%xmm0, %%xmm0          \n\t" \
+    "pshufhw $0x08, %%xmm0, %%xmm0          \n\t" \
+    "pshufd  $0x08, %%xmm0, %%xmm0          \n\t" \
+    "movq        %%xmm0, (%[fa],%[x],2)     \n\t"
+
+// FrameDest = PixelDst + 0x10007FFF >> 16, truncated to 8 bits
+#define STORE_DST_SSE2 \
+    "paddd       %%xmm5, %%xmm1             \n\t" \
+    "pslld           $8, %%xmm1             \n\t" \
+    "psrld          $24, %%xmm1             \n\t" \
+    "packssdw    %%xmm1, %%xmm1             \n\t" \
+    "packuswb    %%xmm1, %%xmm1             \n\t" \
+    "movd        %%xmm1, (%[d],%[x])        \n\t"
+
+#define LOAD_CONSTS_SSE2 \
+    "movdqa   %[bias], %%xmm7               \n\t" \
+    "movdqa     %[r8], %%xmm6               \n\t" \
+    "movdqa    %[r16], %%xmm5               \n\t" \
+    "pxor        %%xmm8, %%xmm8             \n\t"
+
+static void vertical_SSE2(unsigned int *LineAnt, const unsigned int *Horiz,
+                          unsigned short *FrameAnt, unsigned char *FrameDest,
+                          int W, const int *Vertical, const int *Temporal)
+{
+    int n = W & ~3;
+    intptr_t x = -n, t, u, v;
+
+    if (!n)
+        goto tail;
+    if (Temporal) {
+        __asm__ volatile(
+            LOAD_CONSTS_SSE2
+            "1:                                     \n\t"
+            "movdqu (%[la],%[x],4), %%xmm0          \n\t"
+            "movdqu  (%[h],%[x],4), %%xmm1          \n\t"
+            "psubd       %%xmm1, %%xmm0             \n\t"
+            LOWPASS_SSE2("%[vc]")
+            "movdqu      %%xmm1, (%[la],%[x],4)     \n\t"
+            "movq   (%[fa],%[x],2), %%xmm0          \n\t"
+            "punpcklwd   %%xmm8, %%xmm0             \n\t"
+            "pslld           $8, %%xmm0             \n\t"
+            "psubd       %%xmm1, %%xmm0             \n\t"
+            LOWPASS_SSE2("%[tc]")
+            STORE_ANT_SSE2
+            STORE_DST_SSE2
+            "add             $4, %[x]               \n\t"
+            "jl 1b                                  \n\t"
+            : [x]"+&r"(x), [t]"=&r"(t), [u]"=&r"(u), [v]"=&r"(v)
+            : [la]"r"(LineAnt + n), [h]"r"(Horiz + n), [fa]"r"(FrameAnt + n),
+              [d]"r"(FrameDest + n), [vc]"r"(Vertical), [tc]"r"(Temporal),
+              [bias]"m"(*pd_bias), [r8]"m"(*pd_r8), [r16]"m"(*pd_r16)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm4",
+                           "xmm5", "xmm6", "xmm7", "xmm8",) "memory"
+        );
+    } else {
+        __asm__ volatile(
+            LOAD_CONSTS_SSE2
+            "1:                                     \n\t"
+            "movdqu (%[la],%[x],4), %%xmm0          \n\t"
+            "movdqu  (%[h],%[x],4), %%xmm1          \n\t"
+            "psubd       %%xmm1, %%xmm0             \n\t"
+            LOWPASS_SSE2("%[vc]")
+            "movdqu      %%xmm1, (%[la],%[x],4)     \n\t"
+            STORE_DST_SSE2
+            "add             $4, %[x]               \n\t"
+            "jl 1b                                  \n\t"
+            : [x]"+&r"(x), [t]"=&r"(t), [u]"=&r"(u), [v]"=&r"(v)
+            : [la]"r"(LineAnt + n), [h]"r"(Horiz + n),
+              [d]"r"(FrameDest + n), [vc]"r"(Vertical),
+              [bias]"m"(*pd_bias), [r8]"m"(*pd_r8), [r16]"m"(*pd_r16)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm4",
+                           "xmm5", "xmm6", "xmm7", "xmm8",) "memory"
+        );
+    }
+tail:
+    vertical_C(LineAnt + n, Horiz + n, FrameAnt + n, FrameDest + n,
+               W - n, Vertical, Temporal);
+}
+
+static void temporal_SSE2(const unsigned char *Frame, unsigned short *FrameAnt,
+                          unsigned char *FrameDest, int W, const int *Temporal)
+{
+    int n = W & ~3;
+    intptr_t x = -n, t, u, v;
+
+    if (n)
+        __asm__ volatile(
+            LOAD_CONSTS_SSE2
+            "1:                                     \n\t"
+            "movd    (%[s],%[x]), %%xmm1            \n\t"
+            "punpcklbw   %%xmm8, %%xmm1             \n\t"
+            "punpcklwd   %%xmm8, %%xmm1             \n\t"
+            "pslld          $16, %%xmm1             \n\t"
+            "movq   (%[fa],%[x],2), %%xmm0          \n\t"
+            "punpcklwd   %%xmm8, %%xmm0             \n\t"
+            "pslld           $8, %%xmm0             \n\t"
+            "psubd       %%xmm1, %%xmm0             \n\t"
+            LOWPASS_SSE2("%[tc]")
+            STORE_ANT_SSE2
+            STORE_DST_SSE2
+            "add             $4, %[x]               \n\t"
+            "jl 1b                                  \n\t"
+            : [x]"+&r"(x), [t]"=&r"(t), [u]"=&r"(u), [v]"=&r"(v)
+            : [s]"r"(Frame + n), [fa]"r"(FrameAnt + n),
+              [d]"r"(FrameDest + n), [tc]"r"(Temporal),
+              [bias]"m"(*pd_bias), [r8]"m"(*pd_r8), [r16]"m"(*pd_r16)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm4",
+                           "xmm5", "xmm6", "xmm7", "xmm8",) "memory"
+        );
+    temporal_C(Frame + n, FrameAnt + n, FrameDest + n, W - n, Temporal);
+}
+#endif /* ARCH_X86_64 && HAVE_SSE2_INLINE */
+
+#if ARCH_X86_64 && HAVE_AVX2_INLINE
+#define LOWPASS_AVX2(coef) \
+    "vpaddd  %%ymm7, %%ymm0, %%ymm0                 \n\t" \
+    "vpsrld    $12, %%ymm0, %%ymm0                  \n\t" \
+    "vpcmpeqd %%ymm3, %%ymm3, %%ymm3                \n\t" \
+    "vpgatherdd %%ymm3, ("coef",%%ymm0,4), %%ymm2   \n\t" \
+    "vpaddd  %%ymm2, %%ymm1, %%ymm1                 \n\t"
+
+#define STORE_ANT_AVX2 \
+    "vpaddd  %%ymm6, %%ymm1, %%ymm0                 \n\t" \
+    "vpslld     $8, %%ymm0, %%ymm0                  \n\t" \
+    "vpsrld    $16, %%ymm0, %%ymm0                  \n\t" \
+    "vextracti128 $1, %%ymm0, %%xmm3                \n\t" \
+    "vpackusdw %%xmm3, %%xmm0, %%xmm0               \n\t" \
+    "vmovdqu %%xmm0, (%[fa],%[x],2)                 \n\t"
+
+#define STORE_DST_AVX2 \
+    "vpaddd  %%ymm5, %%ymm1, %%ymm1                 \n\t" \
+    "vpslld     $8, %%ymm1, %%ymm1                  \n\t" \
+    "vpsrld    $24, %%ymm1, %%ymm1                  \n\t" \
+    "vextracti128 $1, %%ymm1, %%xmm3                \n\t" \
+    "vpackusdw %%xmm3, %%xmm1, %%xmm1               \n\t" \
+    "vpackuswb %%xmm1, %%xmm1, %%xmm1               \n\t" \
+    "vmovq   %%xmm1, (%[d],%[x])                    \n\t"
+
+#define LOAD_CONSTS_AVX2 \
+    "vpbroadcastd %[bias], %%ymm7                   \n\t" \
+    "vpbroadcastd   %[r8], %%ymm6                   \n\t" \
+    "vpbroadcastd  %[r16], %%ymm5                   \n\t"
+
+static void vertical_AVX2(unsigned int *LineAnt, const unsigned int *Horiz,
+                          unsigned short *FrameAnt, unsigned char *FrameDest,
+                          int W, const int *Vertical, const int *Temporal)
+{
+    int n = W & ~7;
+    intptr_t x = -n;
+
+    if (!n)
+        goto tail;
+    if (Temporal) {
+        __asm__ volatile(
+            LOAD_CONSTS_AVX2
+            "1:                                             \n\t"
+            "vmovdqu (%[la],%[x],4), %%ymm0                 \n\t"
+            "vmovdqu  (%[h],%[x],4), %%ymm1                 \n\t"
+            "vpsubd  %%ymm1, %%ymm0, %%ymm0                 \n\t"
+            LOWPASS_AVX2("%[vc]")
+            "vmovdqu %%ymm1, (%[la],%[x],4)                 \n\t"
+            "vpmovzxwd (%[fa],%[x],2), %%ymm0               \n\t"
+            "vpslld     $8, %%ymm0, %%ymm0                  \n\t"
+            "vpsubd  %%ymm1, %%ymm0, %%ymm0                 \n\t"
+            LOWPASS_AVX2("%[tc]")
+            STORE_ANT_AVX2
+            STORE_DST_AVX2
+            "add        $8, %[x]                            \n\t"
+            "jl 1b                                          \n\t"
+            "vzeroupper                                     \n\t"
+            : [x]"+&r"(x)
+            : [la]"r"(LineAnt + n), [h]"r"(Horiz + n), [fa]"r"(FrameAnt + n),
+              [d]"r"(FrameDest + n), [vc]"r"(Vertical), [tc]"r"(Temporal),
+              [bias]"m"(*pd_bias), [r8]"m"(*pd_r8), [r16]"m"(*pd_r16)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+                           "xmm5", "xmm6", "xmm7",) "memory"
+        );
+    } else {
+        __asm__ volatile(
+            LOAD_CONSTS_AVX2
+            "1:                                             \n\t"
+            "vmovdqu (%[la],%[x],4), %%ymm0                 \n\t"
+            "vmovdqu  (%[h],%[x],4), %%ymm1                 \n\t"
+            "vpsubd  %%ymm1, %%ymm0, %%ymm0                 \n\t"
+            LOWPASS_AVX2("%[vc]")
+            "vmovdqu %%ymm1, (%[la],%[x],4)                 \n\t"
+            STORE_DST_AVX2
+            "add        $8, %[x]                            \n\t"
+            "jl 1b                                          \n\t"
+            "vzeroupper                                     \n\t"
+            : [x]"+&r"(x)
+            : [la]"r"(LineAnt + n), [h]"r"(Horiz + n),
+              [d]"r"(FrameDest + n), [vc]"r"(Vertical),
+              [bias]"m"(*pd_bias), [r8]"m"(*pd_r8), [r16]"m"(*pd_r16)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+                           "xmm5", "xmm6", "xmm7",) "memory"
+        );
+    }
+tail:
+    vertical_C(LineAnt + n, Horiz + n, FrameAnt + n, FrameDest + n,
+               W - n, Vertical, Temporal);
+}
+
+static void temporal_AVX2(const unsigned char *Frame, unsigned short *FrameAnt,
+                          unsigned char *FrameDest, int W, const int *Temporal)
+{
+    int n = W & ~7;
+    intptr_t x = -n;
+
+    if (n)
+        __asm__ volatile(
+            LOAD_CONSTS_AVX2
+            "1:                                             \n\t"
+            "vpmovzxbd (%[s],%[x]), %%ymm1                  \n\t"
+            "vpslld    $16, %%ymm1, %%ymm1                  \n\t"
+            "vpmovzxwd (%[fa],%[x],2), %%ymm0               \n\t"
+            "vpslld     $8, %%ymm0, %%ymm0                  \n\t"
+            "vpsubd  %%ymm1, %%ymm0, %%ymm0                 \n\t"
+            LOWPASS_AVX2("%[tc]")
+            STORE_ANT_AVX2
+            STORE_DST_AVX2
+            "add        $8, %[x]                            \n\t"
+            "jl 1b                                          \n\t"
+            "vzeroupper                                     \n\t"
+            : [x]"+&r"(x)
+            : [s]"r"(Frame + n), [fa]"r"(FrameAnt + n),
+              [d]"r"(FrameDest + n), [tc]"r"(Temporal),
+              [bias]"m"(*pd_bias), [r8]"m"(*pd_r8), [r16]"m"(*pd_r16)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+                           "xmm5", "xmm6", "xmm7",) "memory"
+        );
+    temporal_C(Frame + n, FrameAnt + n, FrameDest + n, W - n, Temporal);
+}
+#endif /* ARCH_X86_64 && HAVE_AVX2_INLINE */
+
+void hqdn3d_init_dsp(struct hqdn3d_dsp *dsp, unsigned int cpu)
+{
+    dsp->vertical = vertical_C;
+    dsp->temporal = temporal_C;
+#if ARCH_X86_64 && HAVE_SSE2_INLINE
+    if (cpu & HQDN3D_CPU_SSE2) {
+        dsp->vertical = vertical_SSE2;
+        dsp->temporal = temporal_SSE2;
+    }
+#endif
+#if ARCH_X86_64 && HAVE_AVX2_INLINE
+    if (cpu & HQDN3D_CPU_AVX2) {
+        dsp->vertical = vertical_AVX2;
+        dsp->temporal = temporal_AVX2;
+    }
+#endif
+}
@@ -0,0 +1,54 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_HQDN3D_H
+#define MPLAYER_HQDN3D_H
+
+#define HQDN3D_CPU_SSE2 1
+#define HQDN3D_CPU_AVX2 2
+
+static inline unsigned int LowPassMul(unsigned int PrevMul, unsigned int CurrMul, const int *Coef)
+{
+//    int dMul= (PrevMul&0xFFFFFF)-(CurrMul&0xFFFFFF);
+    int dMul= PrevMul-CurrMul;
+    unsigned int d=((dMul+0x10007FF)>>12);
+    return CurrMul + Coef[d];
+}
+
+/**
+ * Row kernels of the denoiser. The horizontal low-pass is a recursion
+ * along the row and stays scalar; everything after it is independent per
+ * pixel and is what these vectorize.
+ */
+struct hqdn3d_dsp {
+    /**
+     * vertical low-pass of one row against the previous one in LineAnt,
+     * followed by the temporal low-pass against FrameAnt unless Temporal
+     * is NULL
+     */
+    void (*vertical)(unsigned int *LineAnt, const unsigned int *Horiz,
+                     unsigned short *FrameAnt, unsigned char *FrameDest,
+                     int W, const int *Vertical, const int *Temporal);
+    /// temporal low-pass only
+    void (*temporal)(const unsigned char *Frame, unsigned short *FrameAnt,
+                     unsigned char *FrameDest, int W, const int *Temporal);
+};
+
+void hqdn3d_init_dsp(struct hqdn3d_dsp *dsp, unsigned int cpu);
+
+#endif /* MPLAYER_HQDN3D_H */
@@ -0,0 +1,963 @@
+/*
+ * frame metrics for the inverse telecine and scene analysis filters
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "cpudetect.h"
+#include "mpx86asm.h"
+#include "metrics.h"
+
+static void sad8_C(const uint8_t *a, const uint8_t *b, int as, int bs,
+                   int h, int n, int *out)
+{
+    int i, x, y, d;
+    for (i = 0; i < n; i++) {
+        const uint8_t *ap = a + 8*i, *bp = b + 8*i;
+        for (d = 0, y = 0; y < h; y++, ap += as, bp += bs)
+            for (x = 0; x < 8; x++)
+                d += abs(ap[x] - bp[x]);
+        out[i] = d;
+    }
+}
+
+static void comb8_C(const uint8_t *a, const uint8_t *b, int s,
+                    int h, int n, int *out)
+{
+    int i, x, y, d;
+    for (i = 0; i < n; i++) {
+        const uint8_t *ap = a + 8*i, *bp = b + 8*i;
+        for (d = 0, y = 0; y < h; y++, ap += s, bp += s)
+            for (x = 0; x < 8; x++)
+                d += abs((ap[x]<<1) - bp[x-s] - bp[x])
+                   + abs((bp[x]<<1) - ap[x] - ap[x+s]);
+        out[i] = d;
+    }
+}
+
+/*
+ * The MMX code vf_ivtc.c used to have negated a column sum when the pixel
+ * of the last old even line was greater than it, instead of when the sum
+ * was negative, and it took the sums from the 8 lines below the block as
+ * its first asm block advanced the source pointers behind the compiler's
+ * back. field8_mmx keeps those results for that filter.
+ */
+#define MMXABS(a, ref) ((ref) > (a) ? -(a) : (a))
+
+static inline void field8_c(const uint8_t *old, const uint8_t *new,
+                            int os, int ns, int n, struct field_diffs *out,
+                            int mmx_abs)
+{
+    int i, x, y, noise, temp, past;
+    for (i = 0; i < n; i++, out++) {
+        out->even = out->odd = out->noise = out->temp = out->past = 0;
+        for (x = 8*i; x < 8*i + 8; x++) {
+            const uint8_t *oldp = old + x, *newp = new + x;
+            noise = temp = past = 0;
+            for (y = 4; y; y--) {
+                out->even += abs(newp[0] - oldp[0]);
+                out->odd  += abs(newp[ns] - oldp[os]);
+                noise += newp[ns] - newp[0];
+                past  += oldp[os] - oldp[0];
+                temp  += oldp[os] - newp[0];
+                oldp += os<<1;
+                newp += ns<<1;
+            }
+            if (mmx_abs) {
+                int ref = oldp[-(os<<1)];
+                out->noise += MMXABS(noise, ref);
+                out->temp  += MMXABS(temp,  ref);
+                out->past  += MMXABS(past,  ref);
+            } else {
+                out->noise += abs(noise);
+                out->temp  += abs(temp);
+                out->past  += abs(past);
+            }
+        }
+    }
+}
+
+static void field8_C(const uint8_t *old, const uint8_t *new, int os, int ns,
+                     int n, struct field_diffs *out)
+{
+    field8_c(old, new, os, ns, n, out, 0);
+}
+
+static void field8_mmxabs_C(const uint8_t *old, const uint8_t *new,
+                            int os, int ns, int n, struct field_diffs *out)
+{
+    field8_c(old, new, os, ns, n, out, 1);
+}
+
+/// even and odd SAD of the block, the sums from the 8 lines below it
+#define FIELD8_MMX(name, mmxabs, sad8)                                       \
+static void name(const uint8_t *old, const uint8_t *new, int os, int ns,     \
+                 int n, struct field_diffs *out)                             \
+{                                                                            \
+    int e[64], o[64], i, j, k;                                               \
+    mmxabs(old + 8*os, new + 8*ns, os, ns, n, out);                          \
+    for (i = 0; i < n; i += k) {                                             \
+        k = n - i < 64 ? n - i : 64;                                         \
+        sad8(old + 8*i, new + 8*i, 2*os, 2*ns, 4, k, e);                     \
+        sad8(old + os + 8*i, new + ns + 8*i, 2*os, 2*ns, 4, k, o);           \
+        for (j = 0; j < k; j++) {                                            \
+            out[i+j].even = e[j];                                            \
+            out[i+j].odd  = o[j];                                            \
+        }                                                                    \
+    }                                                                        \
+}
+
+FIELD8_MMX(field8_mmx_C, field8_mmxabs_C, sad8_C)
+
+/*
+ * Quarter-pel interpolations built from pavgb the way the MMX2 code in
+ * vf_filmdint.c does them: QAVG(a, b) is about (3*a + b)/4, QAVG2 is the
+ * variant it uses for the next even line.
+ */
+#define AVG(a, b)   (((a) + (b) + 1) >> 1)
+#define SUBS1(a)    ((a) ? (a) - 1 : 0)
+#define QAVG(a, b)  AVG(a, AVG(a, SUBS1(b)))
+#define QAVG2(a, b) AVG(a, AVG(b, SUBS1(a)))
+#define MIN(a, b)   ((a) < (b) ? (a) : (b))
+#define ADDUSW(a, b) ((a) = (a) + (b) > 0xFFFF ? 0xFFFF : (a) + (b))
+
+static void qfield8_C(const uint8_t *a, const uint8_t *b, int as, int bs,
+                      int n, struct field_qdiffs *out)
+{
+    int i, x, y;
+    for (i = 0; i < n; i++, out++) {
+        const uint8_t *ap = a + 8*i - as, *bp = b + 8*i - bs;
+        out->even = out->odd = out->noise = out->temp = 0;
+        for (y = 4; y; y--, ap += 2*as, bp += 2*bs) {
+            int even = 0, odd = 0, noise = 0, temp = 0;
+            for (x = 0; x < 8; x++) {
+                int old_po = ap[x],      po = bp[x];
+                int  old_e = ap[x+as],    e = bp[x+bs];
+                int  old_o = ap[x+2*as],  o = bp[x+2*bs];
+                int                      ne = bp[x+3*bs];
+                int old_no = ap[x+4*as], no = bp[x+4*bs];
+                int odd_diff = abs(o - old_o);
+                int qdown_even = QAVG(e, ne), qup_even = QAVG2(ne, e);
+                even += abs(e - old_e);
+                odd  += odd_diff;
+                temp += MIN(MIN(abs(qdown_even - QAVG(old_o, old_po)),
+                                odd_diff),
+                            abs(qup_even - QAVG(old_o, old_no)));
+                noise += MIN(MIN(abs(qdown_even - QAVG(o, po)), odd_diff),
+                             abs(qup_even - QAVG(o, no)));
+            }
+            ADDUSW(out->even,  even);
+            ADDUSW(out->odd,   odd);
+            ADDUSW(out->noise, noise);
+            ADDUSW(out->temp,  temp);
+        }
+    }
+}
+
+static int interp_ssd_C(const uint8_t *a, int as, const uint8_t *b, int bs,
+                        int n)
+{
+    unsigned int sum = 0;
+    int x, t;
+    for (x = 0; x < n; x++) {
+        t = ((a[x] - b[x+bs]) << 2) + a[x+2*as] - b[x-bs];
+        sum += t*t;
+    }
+    return sum;
+}
+
+static int count_below_C(const uint8_t *p, int n, unsigned int thresh)
+{
+    int x, c = 0;
+    for (x = 0; x < n; x++)
+        c += p[x] < thresh;
+    return c;
+}
+
+static int sum_C(const uint8_t *p, int n)
+{
+    int x, s = 0;
+    for (x = 0; x < n; x++)
+        s += p[x];
+    return s;
+}
+
+#if HAVE_SSE2_INLINE || HAVE_AVX2_INLINE
+static const uint16_t __attribute__((aligned(32))) pw_1[16] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+static const uint8_t __attribute__((aligned(32))) pb_1[32] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+#endif
+
+#if HAVE_SSE2_INLINE
+/*
+ * The block metrics do two blocks at a time, field8 does one since it
+ * keeps three column sums per block and x86_32 only has 8 registers.
+ */
+static void sad8_SSE2(const uint8_t *a, const uint8_t *b, int as, int bs,
+                      int h, int n, int *out)
+{
+    int i;
+    for (i = 0; i + 2 <= n; i += 2) {
+        const uint8_t *ap = a + 8*i, *bp = b + 8*i;
+        x86_reg y = h;
+        __asm__ volatile(
+            "pxor        %%xmm2, %%xmm2         \n\t"
+            "1:                                 \n\t"
+            "movdqu       (%[a]), %%xmm0        \n\t"
+            "movdqu       (%[b]), %%xmm1        \n\t"
+            "psadbw      %%xmm1, %%xmm0         \n\t"
+            "paddd       %%xmm0, %%xmm2         \n\t"
+            "add          %[as], %[a]           \n\t"
+            "add          %[bs], %[b]           \n\t"
+            "dec           %[y]                 \n\t"
+            "jnz 1b                             \n\t"
+            "pshufd $0x08, %%xmm2, %%xmm2       \n\t"
+            "movq        %%xmm2, (%[out])       \n\t"
+            : [a]"+r"(ap), [b]"+r"(bp), [y]"+r"(y)
+            : [as]"r"((x86_reg)as), [bs]"r"((x86_reg)bs), [out]"r"(out + i)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2",) "memory"
+        );
+    }
+    sad8_C(a + 8*i, b + 8*i, as, bs, h, n - i, out + i);
+}
+
+// |2*dbl - sum| for one block of words, accumulated into acc
+#define COMB_TERM_SSE2(dbl, sum, acc) \
+            "movdqa    " dbl ", %%xmm6          \n\t" \
+            "paddw     %%xmm6, %%xmm6           \n\t" \
+            "movdqa    %%xmm6, %%xmm3           \n\t" \
+            "psubusw   " sum ", %%xmm3          \n\t" \
+            "psubusw   %%xmm6, " sum "          \n\t" \
+            "paddw     %%xmm3, " acc "          \n\t" \
+            "paddw     " sum ", " acc "         \n\t"
+
+#define COMB_BLOCK_SSE2(off, acc) \
+            "movq    " off "(%[a]), %%xmm0      \n\t" \
+            "movq    " off "(%[b]), %%xmm1      \n\t" \
+            "movq    " off "(%[b],%[ms]), %%xmm2 \n\t" \
+            "punpcklbw %%xmm7, %%xmm0           \n\t" \
+            "punpcklbw %%xmm7, %%xmm1           \n\t" \
+            "punpcklbw %%xmm7, %%xmm2           \n\t" \
+            "paddw     %%xmm1, %%xmm2           \n\t" \
+            COMB_TERM_SSE2("%%xmm0", "%%xmm2", acc) \
+            "movq    " off "(%[a],%[s]), %%xmm2 \n\t" \
+            "punpcklbw %%xmm7, %%xmm2           \n\t" \
+            "paddw     %%xmm0, %%xmm2           \n\t" \
+            COMB_TERM_SSE2("%%xmm1", "%%xmm2", acc)
+
+static void comb8_SSE2(const uint8_t *a, const uint8_t *b, int s,
+                       int h, int n, int *out)
+{
+    int i;
+    for (i = 0; i + 2 <= n; i += 2) {
+        const uint8_t *ap = a + 8*i, *bp = b + 8*i;
+        x86_reg y = h;
+        __asm__ volatile(
+            "pxor        %%xmm7, %%xmm7         \n\t"
+            "pxor        %%xmm4, %%xmm4         \n\t"
+            "pxor        %%xmm5, %%xmm5         \n\t"
+            "1:                                 \n\t"
+            COMB_BLOCK_SSE2("0", "%%xmm4")
+            COMB_BLOCK_SSE2("8", "%%xmm5")
+            "add           %[s], %[a]           \n\t"
+            "add           %[s], %[b]           \n\t"
+            "dec           %[y]                 \n\t"
+            "jnz 1b                             \n\t"
+            "pmaddwd     %[pw_1], %%xmm4        \n\t"
+            "pmaddwd     %[pw_1], %%xmm5        \n\t"
+            "movdqa      %%xmm4, %%xmm0         \n\t"
+            "punpckldq   %%xmm5, %%xmm0         \n\t"
+            "punpckhdq   %%xmm5, %%xmm4         \n\t"
+            "paddd       %%xmm4, %%xmm0         \n\t"
+            "pshufd $0x4E, %%xmm0, %%xmm1       \n\t"
+            "paddd       %%xmm1, %%xmm0         \n\t"
+            "movq        %%xmm0, (%[out])       \n\t"
+            : [a]"+r"(ap), [b]"+r"(bp), [y]"+r"(y)
+            : [s]"r"((x86_reg)s), [ms]"r"(-(x86_reg)s), [out]"r"(out + i),
+              [pw_1]"m"(*pw_1)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+                           "xmm4", "xmm5", "xmm6", "xmm7",) "memory"
+        );
+    }
+    comb8_C(a + 8*i, b + 8*i, s, h, n - i, out + i);
+}
+
+// |column sums| widened to dwords
+#define ABS_PMADD_SSE2(reg) \
+            "pxor        %%xmm0, %%xmm0         \n\t" \
+            "psubw       " reg ", %%xmm0        \n\t" \
+            "pmaxsw      %%xmm0, " reg "        \n\t" \
+            "pmaddwd     %[pw_1], " reg "       \n\t"
+// the sign test of the old ivtc MMX code, xmm1 holds the last old even line
+#define MMXABS_PMADD_SSE2(reg) \
+            "movdqa      %%xmm1, %%xmm0         \n\t" \
+            "pcmpgtw     " reg ", %%xmm0        \n\t" \
+            "pxor        %%xmm0, " reg "        \n\t" \
+            "psubw       %%xmm0, " reg "        \n\t" \
+            "pmaddwd     %[pw_1], " reg "       \n\t"
+
+#define FIELD8_SSE2(name, ABS)                                                 \
+static void name(const uint8_t *old, const uint8_t *new, int os, int ns,       \
+                 int n, struct field_diffs *out)                               \
+{                                                                              \
+    int __attribute__((aligned(16))) r[4];                                     \
+    int i;                                                                     \
+    for (i = 0; i < n; i++, out++) {                                           \
+        const uint8_t *op = old + 8*i, *np = new + 8*i;                        \
+        x86_reg y = 4;                                                         \
+        __asm__ volatile(                                                      \
+            "pxor        %%xmm7, %%xmm7         \n\t"                          \
+            "pxor        %%xmm3, %%xmm3         \n\t" /* even, odd */          \
+            "pxor        %%xmm4, %%xmm4         \n\t" /* new odd - new even */ \
+            "pxor        %%xmm5, %%xmm5         \n\t" /* old odd - old even */ \
+            "pxor        %%xmm6, %%xmm6         \n\t" /* old odd - new even */ \
+            "1:                                 \n\t"                          \
+            "movq         (%[n]), %%xmm0        \n\t"                          \
+            "movhps  (%[n],%[ns]), %%xmm0       \n\t"                          \
+            "movq         (%[o]), %%xmm1        \n\t"                          \
+            "movhps  (%[o],%[os]), %%xmm1       \n\t"                          \
+            "movdqa      %%xmm0, %%xmm2         \n\t"                          \
+            "psadbw      %%xmm1, %%xmm2         \n\t"                          \
+            "paddd       %%xmm2, %%xmm3         \n\t"                          \
+            "movdqa      %%xmm1, %%xmm2         \n\t"                          \
+            "punpckhbw   %%xmm7, %%xmm2         \n\t"                          \
+            "paddw       %%xmm2, %%xmm5         \n\t"                          \
+            "paddw       %%xmm2, %%xmm6         \n\t"                          \
+            "punpcklbw   %%xmm7, %%xmm1         \n\t"                          \
+            "psubw       %%xmm1, %%xmm5         \n\t"                          \
+            "movdqa      %%xmm0, %%xmm2         \n\t"                          \
+            "punpckhbw   %%xmm7, %%xmm2         \n\t"                          \
+            "paddw       %%xmm2, %%xmm4         \n\t"                          \
+            "punpcklbw   %%xmm7, %%xmm0         \n\t"                          \
+            "psubw       %%xmm0, %%xmm4         \n\t"                          \
+            "psubw       %%xmm0, %%xmm6         \n\t"                          \
+            "add          %[os], %[o]           \n\t"                          \
+            "add          %[ns], %[n]           \n\t"                          \
+            "add          %[os], %[o]           \n\t"                          \
+            "add          %[ns], %[n]           \n\t"                          \
+            "dec           %[y]                 \n\t"                          \
+            "jnz 1b                             \n\t"                          \
+            ABS("%%xmm4")                                                      \
+            ABS("%%xmm5")                                                      \
+            ABS("%%xmm6")                                                      \
+            "movdqa      %%xmm4, %%xmm0         \n\t"                          \
+            "punpckldq   %%xmm5, %%xmm0         \n\t"                          \
+            "punpckhdq   %%xmm5, %%xmm4         \n\t"                          \
+            "paddd       %%xmm4, %%xmm0         \n\t"                          \
+            "pshufd $0x4E, %%xmm0, %%xmm1       \n\t"                          \
+            "paddd       %%xmm1, %%xmm0         \n\t" /* noise, past */        \
+            "pshufd $0x4E, %%xmm6, %%xmm1       \n\t"                          \
+            "paddd       %%xmm1, %%xmm6         \n\t"                          \
+            "pshufd $0xB1, %%xmm6, %%xmm1       \n\t"                          \
+            "paddd       %%xmm1, %%xmm6         \n\t" /* temp */               \
+            "pshufd $0x08, %%xmm3, %%xmm3       \n\t"                          \
+            "punpcklqdq  %%xmm0, %%xmm3         \n\t"                          \
+            "movdqa      %%xmm3, (%[r])         \n\t"                          \
+            "movd        %%xmm6, %[t]           \n\t"                          \
+            : [o]"+r"(op), [n]"+r"(np), [y]"+r"(y), [t]"=m"(out->temp)         \
+            : [os]"r"((x86_reg)os), [ns]"r"((x86_reg)ns), [r]"r"(r),           \
+              [pw_1]"m"(*pw_1)                                                 \
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",                     \
+                           "xmm4", "xmm5", "xmm6", "xmm7",) "memory"           \
+        );                                                                     \
+        out->even  = r[0];                                                     \
+        out->odd   = r[1];                                                     \
+        out->noise = r[2];                                                     \
+        out->past  = r[3];                                                     \
+    }                                                                          \
+}
+
+FIELD8_SSE2(field8_SSE2,        ABS_PMADD_SSE2)
+FIELD8_SSE2(field8_mmxabs_SSE2, MMXABS_PMADD_SSE2)
+FIELD8_MMX(field8_mmx_SSE2, field8_mmxabs_SSE2, sad8_SSE2)
+
+// a = old, b = new, xmm6 = 0, xmm7 accumulates the four sums
+#define PDIFFUB_SSE2(x, y, t) \
+            "movdqa   " x ", " t "              \n\t" \
+            "psubusb  " y ", " t "              \n\t" \
+            "psubusb  " x ", " y "              \n\t" \
+            "paddusb  " t ", " y "              \n\t"
+
+static void qfield8_SSE2(const uint8_t *a, const uint8_t *b, int as, int bs,
+                         int n, struct field_qdiffs *out)
+{
+    int i;
+    for (i = 0; i + 2 <= n; i += 2) {
+        const uint8_t *ap = a + 8*i - as, *bp = b + 8*i - bs;
+        x86_reg y = 4;
+        __asm__ volatile(
+            "pxor        %%xmm6, %%xmm6         \n\t"
+            "pxor        %%xmm7, %%xmm7         \n\t"
+            "1:                                 \n\t"
+            "movdqu  (%[a],%[as]), %%xmm0       \n\t"
+            "movdqu  (%[b],%[bs]), %%xmm1       \n\t" // even
+            "psadbw      %%xmm1, %%xmm0         \n\t"
+            "paddusw     %%xmm0, %%xmm7         \n\t" // even diff
+            "movdqu (%[a],%[as],2), %%xmm0      \n\t" // old odd
+            "movdqu (%[b],%[bs],2), %%xmm2      \n\t" // odd
+            "movdqu       (%[a]), %%xmm3        \n\t"
+            "psubusb    %[pb_1], %%xmm3         \n\t"
+            "pavgb       %%xmm0, %%xmm3         \n\t"
+            "pavgb       %%xmm0, %%xmm3         \n\t" // qup old odd
+            "movdqa      %%xmm0, %%xmm5         \n\t"
+            "psadbw      %%xmm2, %%xmm0         \n\t"
+            "psllq          $16, %%xmm0         \n\t"
+            "paddusw     %%xmm0, %%xmm7         \n\t" // odd diff
+            "movdqu       (%[b]), %%xmm4        \n\t"
+            "psubusb    %[pb_1], %%xmm4         \n\t"
+            "pavgb       %%xmm2, %%xmm4         \n\t"
+            "pavgb       %%xmm2, %%xmm4         \n\t" // qup odd
+            "lea    (%[a],%[as],2), %[a]        \n\t"
+            "lea    (%[b],%[bs],2), %[b]        \n\t"
+            PDIFFUB_SSE2("%%xmm5", "%%xmm2", "%%xmm0") // abs(old odd - odd)
+            "movdqu  (%[b],%[bs]), %%xmm0       \n\t"
+            "movdqa      %%xmm0, %%xmm5         \n\t"
+            "psubusb    %[pb_1], %%xmm5         \n\t"
+            "pavgb       %%xmm1, %%xmm5         \n\t"
+            "pavgb       %%xmm5, %%xmm1         \n\t" // qdown even
+            "pavgb       %%xmm0, %%xmm5         \n\t" // qup next even
+            PDIFFUB_SSE2("%%xmm1", "%%xmm3", "%%xmm0")
+            PDIFFUB_SSE2("%%xmm1", "%%xmm4", "%%xmm0")
+            "pminub      %%xmm2, %%xmm3         \n\t" // limit temp to odd diff
+            "pminub      %%xmm2, %%xmm4         \n\t" // limit noise to odd diff
+            "movdqu (%[b],%[bs],2), %%xmm2      \n\t"
+            "psubusb    %[pb_1], %%xmm2         \n\t"
+            "movdqu       (%[b]), %%xmm1        \n\t"
+            "pavgb       %%xmm1, %%xmm2         \n\t"
+            "pavgb       %%xmm1, %%xmm2         \n\t" // qdown odd
+            "movdqu (%[a],%[as],2), %%xmm1      \n\t"
+            "psubusb    %[pb_1], %%xmm1         \n\t"
+            "movdqu       (%[a]), %%xmm0        \n\t"
+            "pavgb       %%xmm0, %%xmm1         \n\t"
+            "pavgb       %%xmm0, %%xmm1         \n\t" // qdown old odd
+            PDIFFUB_SSE2("%%xmm5", "%%xmm2", "%%xmm0")
+            PDIFFUB_SSE2("%%xmm5", "%%xmm1", "%%xmm0")
+            "pminub      %%xmm4, %%xmm2         \n\t" // current
+            "pminub      %%xmm3, %%xmm1         \n\t" // old
+            "psadbw      %%xmm6, %%xmm2         \n\t"
+            "psadbw      %%xmm6, %%xmm1         \n\t"
+            "psllq          $32, %%xmm2         \n\t"
+            "psllq          $48, %%xmm1         \n\t"
+            "paddusw     %%xmm2, %%xmm7         \n\t"
+            "paddusw     %%xmm1, %%xmm7         \n\t"
+            "dec           %[y]                 \n\t"
+            "jnz 1b                             \n\t"
+            "movdqu      %%xmm7, (%[out])       \n\t"
+            : [a]"+r"(ap), [b]"+r"(bp), [y]"+r"(y)
+            : [as]"r"((x86_reg)as), [bs]"r"((x86_reg)bs), [out]"r"(out + i),
+              [pb_1]"m"(*pb_1)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+                           "xmm4", "xmm5", "xmm6", "xmm7",) "memory"
+        );
+    }
+    qfield8_C(a + 8*i, b + 8*i, as, bs, n - i, out + i);
+}
+
+static int interp_ssd_SSE2(const uint8_t *a, int as, const uint8_t *b, int bs,
+                           int n)
+{
+    x86_reg x = -(x86_reg)(n & ~7);
+    int sum;
+    __asm__ volatile(
+        "pxor        %%xmm7, %%xmm7             \n\t"
+        "pxor        %%xmm6, %%xmm6             \n\t"
+        "test          %[x], %[x]               \n\t"
+        "jz 2f                                  \n\t"
+        "1:                                     \n\t"
+        "movq    (%[a],%[x]), %%xmm0            \n\t"
+        "movq    (%[b],%[x]), %%xmm1            \n\t"
+        "movq    (%[a2],%[x]), %%xmm2           \n\t"
+        "movq    (%[b0],%[x]), %%xmm3           \n\t"
+        "punpcklbw   %%xmm7, %%xmm0             \n\t"
+        "punpcklbw   %%xmm7, %%xmm1             \n\t"
+        "punpcklbw   %%xmm7, %%xmm2             \n\t"
+        "punpcklbw   %%xmm7, %%xmm3             \n\t"
+        "psubw       %%xmm1, %%xmm0             \n\t"
+        "psllw           $2, %%xmm0             \n\t"
+        "paddw       %%xmm2, %%xmm0             \n\t"
+        "psubw       %%xmm3, %%xmm0             \n\t"
+        "pmaddwd     %%xmm0, %%xmm0             \n\t"
+        "paddd       %%xmm0, %%xmm6             \n\t"
+        "add             $8, %[x]               \n\t"
+        "jnz 1b                                 \n\t"
+        "2:                                     \n\t"
+        "pshufd $0x4E, %%xmm6, %%xmm0           \n\t"
+        "paddd       %%xmm0, %%xmm6             \n\t"
+        "pshufd $0xB1, %%xmm6, %%xmm0           \n\t"
+        "paddd       %%xmm0, %%xmm6             \n\t"
+        "movd        %%xmm6, %[sum]             \n\t"
+        : [x]"+r"(x), [sum]"=r"(sum)
+        : [a]"r"(a + (n & ~7)), [b]"r"(b + (n & ~7) + bs),
+          [a2]"r"(a + (n & ~7) + 2*as), [b0]"r"(b + (n & ~7) - bs)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm6", "xmm7",)
+          "memory"
+    );
+    return sum + (unsigned)interp_ssd_C(a + (n & ~7), as, b + (n & ~7), bs,
+                                        n & 7);
+}
+
+static int count_below_SSE2(const uint8_t *p, int n, unsigned int thresh)
+{
+    x86_reg x = -(x86_reg)(n & ~15);
+    unsigned int s;
+    if (thresh - 1 > 254)
+        return thresh ? n : 0;
+    __asm__ volatile(
+        "movd         %[t], %%xmm5              \n\t"
+        "pshufd $0, %%xmm5, %%xmm5              \n\t"
+        "pxor        %%xmm7, %%xmm7             \n\t"
+        "pxor        %%xmm6, %%xmm6             \n\t"
+        "test          %[x], %[x]               \n\t"
+        "jz 2f                                  \n\t"
+        "1:                                     \n\t"
+        "movdqu  (%[p],%[x]), %%xmm0            \n\t"
+        "psubusb     %%xmm5, %%xmm0             \n\t"
+        "pcmpeqb     %%xmm7, %%xmm0             \n\t"
+        "psadbw      %%xmm7, %%xmm0             \n\t"
+        "paddd       %%xmm0, %%xmm6             \n\t"
+        "add            $16, %[x]               \n\t"
+        "jnz 1b                                 \n\t"
+        "2:                                     \n\t"
+        "pshufd $0x4E, %%xmm6, %%xmm0           \n\t"
+        "paddd       %%xmm0, %%xmm6             \n\t"
+        "movd        %%xmm6, %[s]               \n\t"
+        : [x]"+r"(x), [s]"=r"(s)
+        : [p]"r"(p + (n & ~15)), [t]"r"((thresh - 1) * 0x01010101u)
+        : XMM_CLOBBERS("xmm0", "xmm5", "xmm6", "xmm7",) "memory"
+    );
+    return s / 255 + count_below_C(p + (n & ~15), n & 15, thresh);
+}
+
+static int sum_SSE2(const uint8_t *p, int n)
+{
+    x86_reg x = -(x86_reg)(n & ~15);
+    int s;
+    __asm__ volatile(
+        "pxor        %%xmm7, %%xmm7             \n\t"
+        "pxor        %%xmm6, %%xmm6             \n\t"
+        "test          %[x], %[x]               \n\t"
+        "jz 2f                                  \n\t"
+        "1:                                     \n\t"
+        "movdqu  (%[p],%[x]), %%xmm0            \n\t"
+        "psadbw      %%xmm7, %%xmm0             \n\t"
+        "paddd       %%xmm0, %%xmm6             \n\t"
+        "add            $16, %[x]               \n\t"
+        "jnz 1b                                 \n\t"
+        "2:                                     \n\t"
+        "pshufd $0x4E, %%xmm6, %%xmm0           \n\t"
+        "paddd       %%xmm0, %%xmm6             \n\t"
+        "movd        %%xmm6, %[s]               \n\t"
+        : [x]"+r"(x), [s]"=r"(s)
+        : [p]"r"(p + (n & ~15))
+        : XMM_CLOBBERS("xmm0", "xmm6", "xmm7",) "memory"
+    );
+    return s + sum_C(p + (n & ~15), n & 15);
+}
+#endif /* HAVE_SSE2_INLINE */
+
+#if HAVE_AVX2_INLINE
+static void sad8_AVX2(const uint8_t *a, const uint8_t *b, int as, int bs,
+                      int h, int n, int *out)
+{
+    int i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        const uint8_t *ap = a + 8*i, *bp = b + 8*i;
+        x86_reg y = h;
+        __asm__ volatile(
+            "vpxor       %%ymm2, %%ymm2, %%ymm2 \n\t"
+            "1:                                 \n\t"
+            "vmovdqu      (%[a]), %%ymm0        \n\t"
+            "vpsadbw      (%[b]), %%ymm0, %%ymm0 \n\t"
+            "vpaddd      %%ymm0, %%ymm2, %%ymm2 \n\t"
+            "add          %[as], %[a]           \n\t"
+            "add          %[bs], %[b]           \n\t"
+            "dec           %[y]                 \n\t"
+            "jnz 1b                             \n\t"
+            "vpshufd $0x08, %%ymm2, %%ymm2      \n\t"
+            "vpermq  $0x08, %%ymm2, %%ymm2      \n\t"
+            "vmovdqu     %%xmm2, (%[out])       \n\t"
+            "vzeroupper                         \n\t"
+            : [a]"+r"(ap), [b]"+r"(bp), [y]"+r"(y)
+            : [as]"r"((x86_reg)as), [bs]"r"((x86_reg)bs), [out]"r"(out + i)
+            : XMM_CLOBBERS("xmm0", "xmm2",) "memory"
+        );
+    }
+    sad8_C(a + 8*i, b + 8*i, as, bs, h, n - i, out + i);
+}
+
+#define COMB_TERM_AVX2(dbl, sum, acc) \
+            "vpaddw    " dbl ", " dbl ", %%ymm6 \n\t" \
+            "vpsubusw  " sum ", %%ymm6, %%ymm7  \n\t" \
+            "vpsubusw  %%ymm6, " sum ", " sum " \n\t" \
+            "vpaddw    %%ymm7, " acc ", " acc " \n\t" \
+            "vpaddw    " sum ", " acc ", " acc "\n\t"
+
+#define COMB_BLOCK_AVX2(off, acc) \
+            "vpmovzxbw " off "(%[a]), %%ymm0    \n\t" \
+            "vpmovzxbw " off "(%[b]), %%ymm1    \n\t" \
+            "vpmovzxbw " off "(%[b],%[ms]), %%ymm2 \n\t" \
+            "vpaddw    %%ymm1, %%ymm2, %%ymm2   \n\t" \
+            COMB_TERM_AVX2("%%ymm0", "%%ymm2", acc) \
+            "vpmovzxbw " off "(%[a],%[s]), %%ymm2 \n\t" \
+            "vpaddw    %%ymm0, %%ymm2, %%ymm2   \n\t" \
+            COMB_TERM_AVX2("%%ymm1", "%%ymm2", acc)
+
+static void comb8_AVX2(const uint8_t *a, const uint8_t *b, int s,
+                       int h, int n, int *out)
+{
+    int i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        const uint8_t *ap = a + 8*i, *bp = b + 8*i;
+        x86_reg y = h;
+        __asm__ volatile(
+            "vpxor       %%ymm4, %%ymm4, %%ymm4 \n\t"
+            "vpxor       %%ymm5, %%ymm5, %%ymm5 \n\t"
+            "1:                                 \n\t"
+            COMB_BLOCK_AVX2("0", "%%ymm4")
+            COMB_BLOCK_AVX2("16", "%%ymm5")
+            "add           %[s], %[a]           \n\t"
+            "add           %[s], %[b]           \n\t"
+            "dec           %[y]                 \n\t"
+            "jnz 1b                             \n\t"
+            "vpmaddwd   %[pw_1], %%ymm4, %%ymm4 \n\t"
+            "vpmaddwd   %[pw_1], %%ymm5, %%ymm5 \n\t"
+            "vphaddd     %%ymm5, %%ymm4, %%ymm4 \n\t"
+            "vphaddd     %%ymm4, %%ymm4, %%ymm4 \n\t"
+            "vextracti128 $1, %%ymm4, %%xmm5    \n\t"
+            "vpunpckldq  %%xmm5, %%xmm4, %%xmm4 \n\t"
+            "vmovdqu     %%xmm4, (%[out])       \n\t"
+            "vzeroupper                         \n\t"
+            : [a]"+r"(ap), [b]"+r"(bp), [y]"+r"(y)
+            : [s]"r"((x86_reg)s), [ms]"r"(-(x86_reg)s), [out]"r"(out + i),
+              [pw_1]"m"(*(const ymm_reg *)pw_1)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2",
+                           "xmm4", "xmm5", "xmm6", "xmm7",) "memory"
+        );
+    }
+    comb8_C(a + 8*i, b + 8*i, s, h, n - i, out + i);
+}
+
+#define ABS_AVX2(reg) \
+            "vpabsw      " reg ", " reg "       \n\t"
+// the sign test of the old ivtc MMX code, ymm2 holds the last old even line
+#define MMXABS_AVX2(reg) \
+            "vpcmpgtw    " reg ", %%ymm2, %%ymm0 \n\t" \
+            "vpxor       %%ymm0, " reg ", " reg " \n\t" \
+            "vpsubw      %%ymm0, " reg ", " reg " \n\t"
+
+#define FIELD8_AVX2(name, ABS, tail)                                                \
+static void name(const uint8_t *old, const uint8_t *new, int os, int ns,            \
+                 int n, struct field_diffs *out)                                    \
+{                                                                                   \
+    int __attribute__((aligned(32))) r[12];                                         \
+    int i;                                                                          \
+    for (i = 0; i + 2 <= n; i += 2, out += 2) {                                     \
+        const uint8_t *op = old + 8*i, *np = new + 8*i;                             \
+        x86_reg y = 4;                                                              \
+        __asm__ volatile(                                                           \
+            "vpxor       %%ymm3, %%ymm3, %%ymm3 \n\t" /* even, odd */               \
+            "vpxor       %%ymm4, %%ymm4, %%ymm4 \n\t" /* new odd - new even */      \
+            "vpxor       %%ymm5, %%ymm5, %%ymm5 \n\t" /* old odd - old even */      \
+            "vpxor       %%ymm6, %%ymm6, %%ymm6 \n\t" /* old odd - new even */      \
+            "1:                                 \n\t"                               \
+            "vmovdqu      (%[n]), %%xmm0        \n\t"                               \
+            "vinserti128 $1, (%[n],%[ns]), %%ymm0, %%ymm0 \n\t"                     \
+            "vmovdqu      (%[o]), %%xmm1        \n\t"                               \
+            "vinserti128 $1, (%[o],%[os]), %%ymm1, %%ymm1 \n\t"                     \
+            "vpsadbw     %%ymm1, %%ymm0, %%ymm0 \n\t"                               \
+            "vpaddd      %%ymm0, %%ymm3, %%ymm3 \n\t"                               \
+            "vpmovzxbw    (%[n]), %%ymm0        \n\t"                               \
+            "vpmovzxbw (%[n],%[ns]), %%ymm1     \n\t"                               \
+            "vpmovzxbw    (%[o]), %%ymm2        \n\t"                               \
+            "vpaddw      %%ymm1, %%ymm4, %%ymm4 \n\t"                               \
+            "vpsubw      %%ymm0, %%ymm4, %%ymm4 \n\t"                               \
+            "vpsubw      %%ymm0, %%ymm6, %%ymm6 \n\t"                               \
+            "vpmovzxbw (%[o],%[os]), %%ymm1     \n\t"                               \
+            "vpaddw      %%ymm1, %%ymm5, %%ymm5 \n\t"                               \
+            "vpaddw      %%ymm1, %%ymm6, %%ymm6 \n\t"                               \
+            "vpsubw      %%ymm2, %%ymm5, %%ymm5 \n\t"                               \
+            "lea    (%[o],%[os],2), %[o]        \n\t"                               \
+            "lea    (%[n],%[ns],2), %[n]        \n\t"                               \
+            "dec           %[y]                 \n\t"                               \
+            "jnz 1b                             \n\t"                               \
+            ABS("%%ymm4")                                                           \
+            ABS("%%ymm5")                                                           \
+            ABS("%%ymm6")                                                           \
+            "vpmaddwd   %[pw_1], %%ymm4, %%ymm4 \n\t"                               \
+            "vpmaddwd   %[pw_1], %%ymm5, %%ymm5 \n\t"                               \
+            "vpmaddwd   %[pw_1], %%ymm6, %%ymm6 \n\t"                               \
+            "vphaddd     %%ymm5, %%ymm4, %%ymm4 \n\t"                               \
+            "vphaddd     %%ymm6, %%ymm6, %%ymm6 \n\t"                               \
+            "vphaddd     %%ymm6, %%ymm4, %%ymm4 \n\t" /* noise, past, temp, temp */ \
+            "vmovdqa     %%ymm4, (%[r])         \n\t"                               \
+            "vpshufd $0x08, %%ymm3, %%ymm3      \n\t"                               \
+            "vpermq  $0x08, %%ymm3, %%ymm3      \n\t"                               \
+            "vmovdqa     %%xmm3, 32(%[r])       \n\t" /* even, even, odd, odd */    \
+            "vzeroupper                         \n\t"                               \
+            : [o]"+r"(op), [n]"+r"(np), [y]"+r"(y)                                  \
+            : [os]"r"((x86_reg)os), [ns]"r"((x86_reg)ns), [r]"r"(r),                \
+              [pw_1]"m"(*(const ymm_reg *)pw_1)                                     \
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",                          \
+                           "xmm4", "xmm5", "xmm6",) "memory"                        \
+        );                                                                          \
+        out[0].even  = r[8];                                                        \
+        out[1].even  = r[9];                                                        \
+        out[0].odd   = r[10];                                                       \
+        out[1].odd   = r[11];                                                       \
+        out[0].noise = r[0];                                                        \
+        out[1].noise = r[4];                                                        \
+        out[0].past  = r[1];                                                        \
+        out[1].past  = r[5];                                                        \
+        out[0].temp  = r[2];                                                        \
+        out[1].temp  = r[6];                                                        \
+    }                                                                               \
+    tail(old + 8*i, new + 8*i, os, ns, n - i, out);                                 \
+}
+
+FIELD8_AVX2(field8_AVX2,        ABS_AVX2,    field8_C)
+FIELD8_AVX2(field8_mmxabs_AVX2, MMXABS_AVX2, field8_mmxabs_C)
+FIELD8_MMX(field8_mmx_AVX2, field8_mmxabs_AVX2, sad8_AVX2)
+
+#define PDIFFUB_AVX2(x, y, t) \
+            "vpsubusb " y ", " x ", " t "       \n\t" \
+            "vpsubusb " x ", " y ", " y "       \n\t" \
+            "vpaddusb " t ", " y ", " y "       \n\t"
+
+static void qfield8_AVX2(const uint8_t *a, const uint8_t *b, int as, int bs,
+                         int n, struct field_qdiffs *out)
+{
+    int i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        const uint8_t *ap = a + 8*i - as, *bp = b + 8*i - bs;
+        x86_reg y = 4;
+        __asm__ volatile(
+            "vpxor       %%ymm6, %%ymm6, %%ymm6 \n\t"
+            "vpxor       %%ymm7, %%ymm7, %%ymm7 \n\t"
+            "1:                                 \n\t"
+            "vmovdqu (%[b],%[bs]), %%ymm1       \n\t" // even
+            "vpsadbw (%[a],%[as]), %%ymm1, %%ymm0 \n\t"
+            "vpaddusw    %%ymm0, %%ymm7, %%ymm7 \n\t" // even diff
+            "vmovdqu (%[a],%[as],2), %%ymm0     \n\t" // old odd
+            "vmovdqu (%[b],%[bs],2), %%ymm2     \n\t" // odd
+            "vmovdqu      (%[a]), %%ymm3        \n\t"
+            "vpsubusb   %[pb_1], %%ymm3, %%ymm3 \n\t"
+            "vpavgb      %%ymm0, %%ymm3, %%ymm3 \n\t"
+            "vpavgb      %%ymm0, %%ymm3, %%ymm3 \n\t" // qup old odd
+            "vmovdqu      (%[b]), %%ymm4        \n\t"
+            "vpsubusb   %[pb_1], %%ymm4, %%ymm4 \n\t"
+            "vpavgb      %%ymm2, %%ymm4, %%ymm4 \n\t"
+            "vpavgb      %%ymm2, %%ymm4, %%ymm4 \n\t" // qup odd
+            "lea    (%[a],%[as],2), %[a]        \n\t"
+            "lea    (%[b],%[bs],2), %[b]        \n\t"
+            "vpsadbw     %%ymm0, %%ymm2, %%ymm5 \n\t"
+            "vpsllq         $16, %%ymm5, %%ymm5 \n\t"
+            "vpaddusw    %%ymm5, %%ymm7, %%ymm7 \n\t" // odd diff
+            PDIFFUB_AVX2("%%ymm0", "%%ymm2", "%%ymm5") // abs(old odd - odd)
+            "vmovdqu (%[b],%[bs]), %%ymm0       \n\t"
+            "vpsubusb   %[pb_1], %%ymm0, %%ymm5 \n\t"
+            "vpavgb      %%ymm1, %%ymm5, %%ymm5 \n\t"
+            "vpavgb      %%ymm5, %%ymm1, %%ymm1 \n\t" // qdown even
+            "vpavgb      %%ymm0, %%ymm5, %%ymm5 \n\t" // qup next even
+            PDIFFUB_AVX2("%%ymm1", "%%ymm3", "%%ymm0")
+            PDIFFUB_AVX2("%%ymm1", "%%ymm4", "%%ymm0")
+            "vpminub     %%ymm2, %%ymm3, %%ymm3 \n\t" // limit temp to odd diff
+            "vpminub     %%ymm2, %%ymm4, %%ymm4 \n\t" // limit noise to odd diff
+            "vmovdqu (%[b],%[bs],2), %%ymm2     \n\t"
+            "vpsubusb   %[pb_1], %%ymm2, %%ymm2 \n\t"
+            "vpavgb       (%[b]), %%ymm2, %%ymm2 \n\t"
+            "vpavgb       (%[b]), %%ymm2, %%ymm2 \n\t" // qdown odd
+            "vmovdqu (%[a],%[as],2), %%ymm1     \n\t"
+            "vpsubusb   %[pb_1], %%ymm1, %%ymm1 \n\t"
+            "vpavgb       (%[a]), %%ymm1, %%ymm1 \n\t"
+            "vpavgb       (%[a]), %%ymm1, %%ymm1 \n\t" // qdown old odd
+            PDIFFUB_AVX2("%%ymm5", "%%ymm2", "%%ymm0")
+            PDIFFUB_AVX2("%%ymm5", "%%ymm1", "%%ymm0")
+            "vpminub     %%ymm4, %%ymm2, %%ymm2 \n\t" // current
+            "vpminub     %%ymm3, %%ymm1, %%ymm1 \n\t" // old
+            "vpsadbw     %%ymm6, %%ymm2, %%ymm2 \n\t"
+            "vpsadbw     %%ymm6, %%ymm1, %%ymm1 \n\t"
+            "vpsllq         $32, %%ymm2, %%ymm2 \n\t"
+            "vpsllq         $48, %%ymm1, %%ymm1 \n\t"
+            "vpaddusw    %%ymm2, %%ymm7, %%ymm7 \n\t"
+            "vpaddusw    %%ymm1, %%ymm7, %%ymm7 \n\t"
+            "dec           %[y]                 \n\t"
+            "jnz 1b                             \n\t"
+            "vmovdqu     %%ymm7, (%[out])       \n\t"
+            "vzeroupper                         \n\t"
+            : [a]"+r"(ap), [b]"+r"(bp), [y]"+r"(y)
+            : [as]"r"((x86_reg)as), [bs]"r"((x86_reg)bs), [out]"r"(out + i),
+              [pb_1]"m"(*(const ymm_reg *)pb_1)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+                           "xmm4", "xmm5", "xmm6", "xmm7",) "memory"
+        );
+    }
+    qfield8_C(a + 8*i, b + 8*i, as, bs, n - i, out + i);
+}
+
+static int interp_ssd_AVX2(const uint8_t *a, int as, const uint8_t *b, int bs,
+                           int n)
+{
+    x86_reg x = -(x86_reg)(n & ~15);
+    int sum;
+    __asm__ volatile(
+        "vpxor       %%ymm6, %%ymm6, %%ymm6     \n\t"
+        "test          %[x], %[x]               \n\t"
+        "jz 2f                                  \n\t"
+        "1:                                     \n\t"
+        "vpmovzxbw (%[a],%[x]), %%ymm0          \n\t"
+        "vpmovzxbw (%[b],%[x]), %%ymm1          \n\t"
+        "vpmovzxbw (%[a2],%[x]), %%ymm2         \n\t"
+        "vpmovzxbw (%[b0],%[x]), %%ymm3         \n\t"
+        "vpsubw      %%ymm1, %%ymm0, %%ymm0     \n\t"
+        "vpsllw          $2, %%ymm0, %%ymm0     \n\t"
+        "vpaddw      %%ymm2, %%ymm0, %%ymm0     \n\t"
+        "vpsubw      %%ymm3, %%ymm0, %%ymm0     \n\t"
+        "vpmaddwd    %%ymm0, %%ymm0, %%ymm0     \n\t"
+        "vpaddd      %%ymm0, %%ymm6, %%ymm6     \n\t"
+        "add            $16, %[x]               \n\t"
+        "jnz 1b                                 \n\t"
+        "2:                                     \n\t"
+        "vextracti128 $1, %%ymm6, %%xmm0        \n\t"
+        "vpaddd      %%xmm0, %%xmm6, %%xmm6     \n\t"
+        "vpshufd $0x4E, %%xmm6, %%xmm0          \n\t"
+        "vpaddd      %%xmm0, %%xmm6, %%xmm6     \n\t"
+        "vpshufd $0xB1, %%xmm6, %%xmm0          \n\t"
+        "vpaddd      %%xmm0, %%xmm6, %%xmm6     \n\t"
+        "vmovd       %%xmm6, %[sum]             \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x), [sum]"=r"(sum)
+        : [a]"r"(a + (n & ~15)), [b]"r"(b + (n & ~15) + bs),
+          [a2]"r"(a + (n & ~15) + 2*as), [b0]"r"(b + (n & ~15) - bs)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm6",) "memory"
+    );
+    return sum + (unsigned)interp_ssd_C(a + (n & ~15), as, b + (n & ~15), bs,
+                                        n & 15);
+}
+
+static int count_below_AVX2(const uint8_t *p, int n, unsigned int thresh)
+{
+    x86_reg x = -(x86_reg)(n & ~31);
+    unsigned int s;
+    if (thresh - 1 > 254)
+        return thresh ? n : 0;
+    __asm__ volatile(
+        "vmovd        %[t], %%xmm5              \n\t"
+        "vpbroadcastd %%xmm5, %%ymm5            \n\t"
+        "vpxor       %%ymm7, %%ymm7, %%ymm7     \n\t"
+        "vpxor       %%ymm6, %%ymm6, %%ymm6     \n\t"
+        "test          %[x], %[x]               \n\t"
+        "jz 2f                                  \n\t"
+        "1:                                     \n\t"
+        "vmovdqu (%[p],%[x]), %%ymm0            \n\t"
+        "vpsubusb    %%ymm5, %%ymm0, %%ymm0     \n\t"
+        "vpcmpeqb    %%ymm7, %%ymm0, %%ymm0     \n\t"
+        "vpsadbw     %%ymm7, %%ymm0, %%ymm0     \n\t"
+        "vpaddd      %%ymm0, %%ymm6, %%ymm6     \n\t"
+        "add            $32, %[x]               \n\t"
+        "jnz 1b                                 \n\t"
+        "2:                                     \n\t"
+        "vextracti128 $1, %%ymm6, %%xmm0        \n\t"
+        "vpaddd      %%xmm0, %%xmm6, %%xmm6     \n\t"
+        "vpshufd $0x4E, %%xmm6, %%xmm0          \n\t"
+        "vpaddd      %%xmm0, %%xmm6, %%xmm6     \n\t"
+        "vmovd       %%xmm6, %[s]               \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x), [s]"=r"(s)
+        : [p]"r"(p + (n & ~31)), [t]"r"((thresh - 1) * 0x01010101u)
+        : XMM_CLOBBERS("xmm0", "xmm5", "xmm6", "xmm7",) "memory"
+    );
+    return s / 255 + count_below_C(p + (n & ~31), n & 31, thresh);
+}
+
+static int sum_AVX2(const uint8_t *p, int n)
+{
+    x86_reg x = -(x86_reg)(n & ~31);
+    int s;
+    __asm__ volatile(
+        "vpxor       %%ymm7, %%ymm7, %%ymm7     \n\t"
+        "vpxor       %%ymm6, %%ymm6, %%ymm6     \n\t"
+        "test          %[x], %[x]               \n\t"
+        "jz 2f                                  \n\t"
+        "1:                                     \n\t"
+        "vpsadbw (%[p],%[x]), %%ymm7, %%ymm0    \n\t"
+        "vpaddd      %%ymm0, %%ymm6, %%ymm6     \n\t"
+        "add            $32, %[x]               \n\t"
+        "jnz 1b                                 \n\t"
+        "2:                                     \n\t"
+        "vextracti128 $1, %%ymm6, %%xmm0        \n\t"
+        "vpaddd      %%xmm0, %%xmm6, %%xmm6     \n\t"
+        "vpshufd $0x4E, %%xmm6, %%xmm0          \n\t"
+        "vpaddd      %%xmm0, %%xmm6, %%xmm6     \n\t"
+        "vmovd       %%xmm6, %[s]               \n\t"
+        "vzeroupper                             \n\t"
+        : [x]"+r"(x), [s]"=r"(s)
+        : [p]"r"(p + (n & ~31))
+        : XMM_CLOBBERS("xmm0", "xmm6", "xmm7",) "memory"
+    );
+    return s + sum_C(p + (n & ~31), n & 31);
+}
+#endif /* HAVE_AVX2_INLINE */
+
+unsigned int metrics_cpu_caps(void)
+{
+    return (gCpuCaps.hasSSE2 ? METRICS_CPU_SSE2 : 0) |
+           (gCpuCaps.hasAVX2 ? METRICS_CPU_AVX2 : 0);
+}
+
+void metrics_init_dsp(struct metrics_dsp *dsp, unsigned int cpu)
+{
+    dsp->sad8        = sad8_C;
+    dsp->comb8       = comb8_C;
+    dsp->field8      = field8_C;
+    dsp->field8_mmx  = field8_mmx_C;
+    dsp->qfield8     = qfield8_C;
+    dsp->interp_ssd  = interp_ssd_C;
+    dsp->count_below = count_below_C;
+    dsp->sum         = sum_C;
+#if HAVE_SSE2_INLINE
+    if (cpu & METRICS_CPU_SSE2) {
+        dsp->sad8        = sad8_SSE2;
+        dsp->comb8       = comb8_SSE2;
+        dsp->field8      = field8_SSE2;
+        dsp->field8_mmx  = field8_mmx_SSE2;
+        dsp->qfield8     = qfield8_SSE2;
+        dsp->interp_ssd  = interp_ssd_SSE2;
+        dsp->count_below = count_below_SSE2;
+        dsp->sum         = sum_SSE2;
+    }
+#endif
+#if HAVE_AVX2_INLINE
+    if (cpu & METRICS_CPU_AVX2) {
+        dsp->sad8        = sad8_AVX2;
+        dsp->comb8       = comb8_AVX2;
+        dsp->field8      = field8_AVX2;
+        dsp->field8_mmx  = field8_mmx_AVX2;
+        dsp->qfield8     = qfield8_AVX2;
+        dsp->interp_ssd  = interp_ssd_AVX2;
+        dsp->count_below = count_below_AVX2;
+        dsp->sum         = sum_AVX2;
+    }
+#endif
+}
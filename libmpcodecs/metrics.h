@@ -0,0 +1,86 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_METRICS_H
+#define MPLAYER_METRICS_H
+
+#include <stdint.h>
+
+#define METRICS_CPU_SSE2 1
+#define METRICS_CPU_AVX2 2
+
+/// per 8x8 block field differences as used by ivtc and detc
+struct field_diffs {
+    int even, odd;  ///< SAD of the even and of the odd lines
+    int noise;      ///< sum over columns of |sum(new odd - new even)|
+    int temp;       ///< sum over columns of |sum(old odd - new even)|
+    int past;       ///< sum over columns of |sum(old odd - old even)|
+};
+
+/// per 8x8 block quarter-pel field differences as used by filmdint
+struct field_qdiffs {
+    unsigned short even, odd, noise, temp;
+};
+
+/**
+ * Frame metrics shared by the inverse telecine and scene analysis
+ * filters. The block metrics work on a row of n blocks 8 pixels wide
+ * that lie side by side, so that the SIMD versions can do several blocks
+ * per register. All versions return exactly the same values.
+ */
+struct metrics_dsp {
+    /// SAD of h lines per block
+    void (*sad8)(const uint8_t *a, const uint8_t *b, int as, int bs,
+                 int h, int n, int *out);
+    /**
+     * comb of the fields a and b with the field stride s over h lines
+     * (at most 32): sum of |2a - b[-s] - b| + |2b - a - a[s]|
+     */
+    void (*comb8)(const uint8_t *a, const uint8_t *b, int s,
+                  int h, int n, int *out);
+    /// 4 line pairs per block, even lines at old and new
+    void (*field8)(const uint8_t *old, const uint8_t *new, int os, int ns,
+                   int n, struct field_diffs *out);
+    /**
+     * field8 as the former ivtc MMX code computed it: noise, temp and past
+     * come from the 8 lines below the block, and their column sums are
+     * negated when the pixel of the last old even line there is greater
+     * than them, so those lines must exist
+     */
+    void (*field8_mmx)(const uint8_t *old, const uint8_t *new, int os, int ns,
+                       int n, struct field_diffs *out);
+    /// 4 line pairs per block, even lines at old+os and new+ns
+    void (*qfield8)(const uint8_t *old, const uint8_t *new, int os, int ns,
+                    int n, struct field_qdiffs *out);
+    /**
+     * sum of squares of 4*(a[x] - b[x+bs]) + a[x+2*as] - b[x-bs] over n
+     * pixels, wrapping like an int accumulator
+     */
+    int (*interp_ssd)(const uint8_t *a, int as, const uint8_t *b, int bs,
+                      int n);
+    /// number of the n bytes that are below thresh
+    int (*count_below)(const uint8_t *p, int n, unsigned int thresh);
+    /// sum of n bytes, n at most 2^23
+    int (*sum)(const uint8_t *p, int n);
+};
+
+/// METRICS_CPU_* flags for the CPU found by cpudetect
+unsigned int metrics_cpu_caps(void);
+void metrics_init_dsp(struct metrics_dsp *dsp, unsigned int cpu);
+
+#endif /* MPLAYER_METRICS_H */
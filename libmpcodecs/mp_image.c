@@ -32,7 +32,7 @@
 #include "libavutil/mem.h"
 #include "mp_msg.h"
 
-void mp_image_alloc_planes(mp_image_t *mpi) {
+int mp_image_planes_size(mp_image_t *mpi) {
   /* This condition is stricter than needed, but I want to be sure that every
    * calculation step can fit in int32_t. This assumption is true over most of
    * the code, so this acts as a safeguard for other image size calulations. */
@@ -40,19 +40,23 @@ void mp_image_alloc_planes(mp_image_t *mpi) {
       (int64_t)mpi->width*(mpi->height+2) > INT_MAX ||
       (int64_t)mpi->bpp*mpi->width*(mpi->height+2) > INT_MAX) {
       mp_msg(MSGT_DECVIDEO,MSGL_WARN,"mp_image: Unreasonable image parameters\n");
-      return;
+      return 0;
   }
   // IF09 - allocate space for 4. plane delta info - unused
   if (mpi->imgfmt == IMGFMT_IF09) {
     if ((int64_t)mpi->chroma_width*mpi->chroma_height > INT_MAX ||
         mpi->bpp*mpi->width*(mpi->height+2)/8 > INT_MAX - mpi->chroma_width*mpi->chroma_height) {
         mp_msg(MSGT_DECVIDEO,MSGL_WARN,"mp_image: Unreasonable image parameters\n");
-        return;
+        return 0;
+    }
+    return mpi->bpp*mpi->width*(mpi->height+2)/8+
+           mpi->chroma_width*mpi->chroma_height;
   }
-    mpi->planes[0]=av_malloc(mpi->bpp*mpi->width*(mpi->height+2)/8+
-                            mpi->chroma_width*mpi->chroma_height);
-  } else
-    mpi->planes[0]=av_malloc(mpi->bpp*mpi->width*(mpi->height+2)/8);
+  return mpi->bpp*mpi->width*(mpi->height+2)/8;
+}
+
+void mp_image_setup_planes(mp_image_t *mpi, unsigned char *buf) {
+  mpi->planes[0]=buf;
   if (mpi->flags&MP_IMGFLAG_PLANAR) {
     int bpp = IMGFMT_IS_YUVP16(mpi->imgfmt)? 2 : 1;
     // YV12/I420/YVU9/IF09. feel free to add other planar formats here...
@@ -85,6 +89,13 @@ void mp_image_alloc_planes(mp_image_t *mpi) {
   mpi->flags|=MP_IMGFLAG_ALLOCATED;
 }
 
+void mp_image_alloc_planes(mp_image_t *mpi) {
+  int size = mp_image_planes_size(mpi);
+  if (!size)
+    return;
+  mp_image_setup_planes(mpi, av_malloc(size));
+}
+
 mp_image_t* alloc_mpi(int w, int h, unsigned long int fmt) {
   mp_image_t* mpi = new_mp_image(w,h);
 
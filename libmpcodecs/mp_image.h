@@ -138,6 +138,10 @@ void free_mp_image(mp_image_t* mpi);
 
 mp_image_t* alloc_mpi(int w, int h, unsigned long int fmt);
 void mp_image_alloc_planes(mp_image_t *mpi);
+/// size in bytes of the single buffer mp_image_setup_planes() expects, 0 on error
+int mp_image_planes_size(mp_image_t *mpi);
+/// lay the planes out in buf and mark the image as allocated
+void mp_image_setup_planes(mp_image_t *mpi, unsigned char *buf);
 void copy_mpi(mp_image_t *dmpi, mp_image_t *mpi);
 
 #endif /* MPLAYER_MP_IMAGE_H */
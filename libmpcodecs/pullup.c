@@ -20,222 +20,29 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "mpx86asm.h"
 #include "config.h"
 #include "pullup.h"
 
 
 
-#if ARCH_X86
-#if HAVE_MMX_INLINE
-static int diff_y_mmx(unsigned char *a, unsigned char *b, int s)
+/*
+ * The metrics are computed for a whole row of 8x4 blocks at a time, so
+ * that the SIMD versions can work on several blocks per register.
+ */
+static void diff_y(const struct metrics_dsp *dsp, unsigned char *a,
+                   unsigned char *b, int s, int n, int *dest)
 {
-    int ret;
-    __asm__ volatile (
-        "movl $4, %%ecx \n\t"
-        "pxor %%mm4, %%mm4 \n\t"
-        "pxor %%mm7, %%mm7 \n\t"
-
-        "1: \n\t"
-
-        "movq (%%"REG_S"), %%mm0 \n\t"
-        "movq (%%"REG_S"), %%mm2 \n\t"
-        "add  %%"REG_a", %%"REG_S" \n\t"
-        "movq (%%"REG_D"), %%mm1 \n\t"
-        "add  %%"REG_a", %%"REG_D" \n\t"
-        "psubusb %%mm1, %%mm2 \n\t"
-        "psubusb %%mm0, %%mm1 \n\t"
-        "movq %%mm2, %%mm0 \n\t"
-        "movq %%mm1, %%mm3 \n\t"
-        "punpcklbw %%mm7, %%mm0 \n\t"
-        "punpcklbw %%mm7, %%mm1 \n\t"
-        "punpckhbw %%mm7, %%mm2 \n\t"
-        "punpckhbw %%mm7, %%mm3 \n\t"
-        "paddw %%mm0, %%mm4 \n\t"
-        "paddw %%mm1, %%mm4 \n\t"
-        "paddw %%mm2, %%mm4 \n\t"
-        "paddw %%mm3, %%mm4 \n\t"
-
-        "decl %%ecx \n\t"
-        "jnz 1b \n\t"
-
-        "movq %%mm4, %%mm3 \n\t"
-        "punpcklwd %%mm7, %%mm4 \n\t"
-        "punpckhwd %%mm7, %%mm3 \n\t"
-        "paddd %%mm4, %%mm3 \n\t"
-        "movd %%mm3, %%eax \n\t"
-        "psrlq $32, %%mm3 \n\t"
-        "movd %%mm3, %%edx \n\t"
-        "addl %%edx, %%eax \n\t"
-        "emms \n\t"
-        : "=a" (ret)
-        : "S" (a), "D" (b), "a" (s)
-        : "%ecx", "%edx"
-        );
-    return ret;
+    dsp->sad8(a, b, s, s, 4, n, dest);
 }
 
-static int licomb_y_mmx(unsigned char *a, unsigned char *b, int s)
+static void licomb_y(const struct metrics_dsp *dsp, unsigned char *a,
+                     unsigned char *b, int s, int n, int *dest)
 {
-    int ret;
-    __asm__ volatile (
-        "movl $4, %%ecx \n\t"
-        "pxor %%mm6, %%mm6 \n\t"
-        "pxor %%mm7, %%mm7 \n\t"
-        "sub  %%"REG_a", %%"REG_D" \n\t"
-
-        "2: \n\t"
-
-        "movq (%%"REG_S"), %%mm0 \n\t"
-        "movq (%%"REG_D"), %%mm1 \n\t"
-        "punpcklbw %%mm7, %%mm0 \n\t"
-        "movq (%%"REG_D",%%"REG_a"), %%mm2 \n\t"
-        "punpcklbw %%mm7, %%mm1 \n\t"
-        "punpcklbw %%mm7, %%mm2 \n\t"
-        "paddw %%mm0, %%mm0 \n\t"
-        "paddw %%mm2, %%mm1 \n\t"
-        "movq %%mm0, %%mm2 \n\t"
-        "psubusw %%mm1, %%mm0 \n\t"
-        "psubusw %%mm2, %%mm1 \n\t"
-        "paddw %%mm0, %%mm6 \n\t"
-        "paddw %%mm1, %%mm6 \n\t"
-
-        "movq (%%"REG_S"), %%mm0 \n\t"
-        "movq (%%"REG_D"), %%mm1 \n\t"
-        "punpckhbw %%mm7, %%mm0 \n\t"
-        "movq (%%"REG_D",%%"REG_a"), %%mm2 \n\t"
-        "punpckhbw %%mm7, %%mm1 \n\t"
-        "punpckhbw %%mm7, %%mm2 \n\t"
-        "paddw %%mm0, %%mm0 \n\t"
-        "paddw %%mm2, %%mm1 \n\t"
-        "movq %%mm0, %%mm2 \n\t"
-        "psubusw %%mm1, %%mm0 \n\t"
-        "psubusw %%mm2, %%mm1 \n\t"
-        "paddw %%mm0, %%mm6 \n\t"
-        "paddw %%mm1, %%mm6 \n\t"
-
-        "movq (%%"REG_D",%%"REG_a"), %%mm0 \n\t"
-        "movq (%%"REG_S"), %%mm1 \n\t"
-        "punpcklbw %%mm7, %%mm0 \n\t"
-        "movq (%%"REG_S",%%"REG_a"), %%mm2 \n\t"
-        "punpcklbw %%mm7, %%mm1 \n\t"
-        "punpcklbw %%mm7, %%mm2 \n\t"
-        "paddw %%mm0, %%mm0 \n\t"
-        "paddw %%mm2, %%mm1 \n\t"
-        "movq %%mm0, %%mm2 \n\t"
-        "psubusw %%mm1, %%mm0 \n\t"
-        "psubusw %%mm2, %%mm1 \n\t"
-        "paddw %%mm0, %%mm6 \n\t"
-        "paddw %%mm1, %%mm6 \n\t"
-
-        "movq (%%"REG_D",%%"REG_a"), %%mm0 \n\t"
-        "movq (%%"REG_S"), %%mm1 \n\t"
-        "punpckhbw %%mm7, %%mm0 \n\t"
-        "movq (%%"REG_S",%%"REG_a"), %%mm2 \n\t"
-        "punpckhbw %%mm7, %%mm1 \n\t"
-        "punpckhbw %%mm7, %%mm2 \n\t"
-        "paddw %%mm0, %%mm0 \n\t"
-        "paddw %%mm2, %%mm1 \n\t"
-        "movq %%mm0, %%mm2 \n\t"
-        "psubusw %%mm1, %%mm0 \n\t"
-        "psubusw %%mm2, %%mm1 \n\t"
-        "paddw %%mm0, %%mm6 \n\t"
-        "paddw %%mm1, %%mm6 \n\t"
-
-        "add  %%"REG_a", %%"REG_S" \n\t"
-        "add  %%"REG_a", %%"REG_D" \n\t"
-        "decl %%ecx \n\t"
-        "jnz 2b \n\t"
-
-        "movq %%mm6, %%mm5 \n\t"
-        "punpcklwd %%mm7, %%mm6 \n\t"
-        "punpckhwd %%mm7, %%mm5 \n\t"
-        "paddd %%mm6, %%mm5 \n\t"
-        "movd %%mm5, %%eax \n\t"
-        "psrlq $32, %%mm5 \n\t"
-        "movd %%mm5, %%edx \n\t"
-        "addl %%edx, %%eax \n\t"
-
-        "emms \n\t"
-        : "=a" (ret)
-        : "S" (a), "D" (b), "a" (s)
-        : "%ecx", "%edx"
-        );
-    return ret;
+    dsp->comb8(a, b, s, 4, n, dest);
 }
 
-static int var_y_mmx(unsigned char *a, unsigned char *b, int s)
-{
-    int ret;
-    __asm__ volatile (
-        "movl $3, %%ecx \n\t"
-        "pxor %%mm4, %%mm4 \n\t"
-        "pxor %%mm7, %%mm7 \n\t"
-
-        "1: \n\t"
-
-        "movq (%%"REG_S"), %%mm0 \n\t"
-        "movq (%%"REG_S"), %%mm2 \n\t"
-        "movq (%%"REG_S",%%"REG_a"), %%mm1 \n\t"
-        "add  %%"REG_a", %%"REG_S" \n\t"
-        "psubusb %%mm1, %%mm2 \n\t"
-        "psubusb %%mm0, %%mm1 \n\t"
-        "movq %%mm2, %%mm0 \n\t"
-        "movq %%mm1, %%mm3 \n\t"
-        "punpcklbw %%mm7, %%mm0 \n\t"
-        "punpcklbw %%mm7, %%mm1 \n\t"
-        "punpckhbw %%mm7, %%mm2 \n\t"
-        "punpckhbw %%mm7, %%mm3 \n\t"
-        "paddw %%mm0, %%mm4 \n\t"
-        "paddw %%mm1, %%mm4 \n\t"
-        "paddw %%mm2, %%mm4 \n\t"
-        "paddw %%mm3, %%mm4 \n\t"
-
-        "decl %%ecx \n\t"
-        "jnz 1b \n\t"
-
-        "movq %%mm4, %%mm3 \n\t"
-        "punpcklwd %%mm7, %%mm4 \n\t"
-        "punpckhwd %%mm7, %%mm3 \n\t"
-        "paddd %%mm4, %%mm3 \n\t"
-        "movd %%mm3, %%eax \n\t"
-        "psrlq $32, %%mm3 \n\t"
-        "movd %%mm3, %%edx \n\t"
-        "addl %%edx, %%eax \n\t"
-        "emms \n\t"
-        : "=a" (ret)
-        : "S" (a), "a" (s)
-        : "%ecx", "%edx"
-        );
-    return 4*ret;
-}
-#endif
-#endif
-
 #define ABS(a) (((a)^((a)>>31))-((a)>>31))
 
-static int diff_y(unsigned char *a, unsigned char *b, int s)
-{
-    int i, j, diff=0;
-    for (i=4; i; i--) {
-        for (j=0; j<8; j++) diff += ABS(a[j]-b[j]);
-        a+=s; b+=s;
-    }
-    return diff;
-}
-
-static int licomb_y(unsigned char *a, unsigned char *b, int s)
-{
-    int i, j, diff=0;
-    for (i=4; i; i--) {
-        for (j=0; j<8; j++)
-            diff += ABS((a[j]<<1) - b[j-s] - b[j])
-                + ABS((b[j]<<1) - a[j] - a[j+s]);
-        a+=s; b+=s;
-    }
-    return diff;
-}
-
 #if 0
 static int qpcomb_y(unsigned char *a, unsigned char *b, int s)
 {
@@ -247,26 +54,15 @@ static int qpcomb_y(unsigned char *a, unsigned char *b, int s)
     }
     return diff;
 }
-
-static int licomb_y_test(unsigned char *a, unsigned char *b, int s)
-{
-    int c = licomb_y(a,b,s);
-    int m = licomb_y_mmx(a,b,s);
-    if (c != m) printf("%d != %d\n", c, m);
-    return m;
-}
 #endif
 
-static int var_y(unsigned char *a, unsigned char *b, int s)
+static void var_y(const struct metrics_dsp *dsp, unsigned char *a,
+                  unsigned char *b, int s, int n, int *dest)
 {
-    int i, j, var=0;
-    for (i=3; i; i--) {
-        for (j=0; j<8; j++) {
-            var += ABS(a[j]-a[j+s]);
-        }
-        a+=s; b+=s;
-    }
-    return 4*var; /* match comb scaling */
+    int i;
+    dsp->sad8(a, a + s, s, s, 3, n, dest);
+    for (i = 0; i < n; i++)
+        dest[i] *= 4; /* match comb scaling */
 }
 
 
@@ -344,15 +140,14 @@ struct pullup_buffer *pullup_get_buffer(struct pullup_context *c, int parity)
 static void compute_metric(struct pullup_context *c,
     struct pullup_field *fa, int pa,
     struct pullup_field *fb, int pb,
-    int (*func)(unsigned char *, unsigned char *, int), int *dest)
+    void (*func)(const struct metrics_dsp *, unsigned char *, unsigned char *,
+                 int, int, int *), int *dest)
 {
     unsigned char *a, *b;
-    int x, y;
+    int y;
     int mp = c->metric_plane;
-    int xstep = c->bpp[mp];
     int ystep = c->stride[mp]<<3;
     int s = c->stride[mp]<<1; /* field stride */
-    int w = c->metric_w*xstep;
 
     if (!fa->buffer || !fb->buffer) return;
 
@@ -366,9 +161,8 @@ static void compute_metric(struct pullup_context *c,
     b = fb->buffer->planes[mp] + pb * c->stride[mp] + c->metric_offset;
 
     for (y = c->metric_h; y; y--) {
-        for (x = 0; x < w; x += xstep) {
-            *dest++ = func(a + x, b + x, s);
-        }
+        func(&c->metrics, a, b, s, c->metric_w, dest);
+        dest += c->metric_w;
         a += ystep; b += ystep;
     }
 }
@@ -781,18 +575,12 @@ void pullup_init_context(struct pullup_context *c)
 
     switch(c->format) {
     case PULLUP_FMT_Y:
+        metrics_init_dsp(&c->metrics,
+                         (c->cpu & PULLUP_CPU_SSE2 ? METRICS_CPU_SSE2 : 0) |
+                         (c->cpu & PULLUP_CPU_AVX2 ? METRICS_CPU_AVX2 : 0));
         c->diff = diff_y;
         c->comb = licomb_y;
         c->var = var_y;
-#if ARCH_X86
-#if HAVE_MMX_INLINE
-        if (c->cpu & PULLUP_CPU_MMX) {
-            c->diff = diff_y_mmx;
-            c->comb = licomb_y_mmx;
-            c->var = var_y_mmx;
-        }
-#endif
-#endif
         /* c->comb = qpcomb_y; */
         break;
 #if 0
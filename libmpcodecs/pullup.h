@@ -19,12 +19,15 @@
 #ifndef MPLAYER_PULLUP_H
 #define MPLAYER_PULLUP_H
 
+#include "metrics.h"
+
 #define PULLUP_CPU_MMX 1
 #define PULLUP_CPU_MMX2 2
 #define PULLUP_CPU_3DNOW 4
 #define PULLUP_CPU_3DNOWEXT 8
 #define PULLUP_CPU_SSE 16
 #define PULLUP_CPU_SSE2 32
+#define PULLUP_CPU_AVX2 64
 
 #define PULLUP_FMT_Y 1
 #define PULLUP_FMT_YUY2 2
@@ -75,9 +78,11 @@ struct pullup_context
     struct pullup_field *first, *last, *head;
     struct pullup_buffer *buffers;
     int nbuffers;
-    int (*diff)(unsigned char *, unsigned char *, int);
-    int (*comb)(unsigned char *, unsigned char *, int);
-    int (*var)(unsigned char *, unsigned char *, int);
+    struct metrics_dsp metrics;
+    /* metrics of a row of 8x4 blocks of two fields with the given field stride */
+    void (*diff)(const struct metrics_dsp *, unsigned char *, unsigned char *, int, int, int *);
+    void (*comb)(const struct metrics_dsp *, unsigned char *, unsigned char *, int, int, int *);
+    void (*var)(const struct metrics_dsp *, unsigned char *, unsigned char *, int, int, int *);
     int metric_w, metric_h, metric_len, metric_offset;
     struct pullup_frame *frame;
 };
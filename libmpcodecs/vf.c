@@ -38,6 +38,7 @@
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "vf_threads.h"
 
 #include "libvo/fastmemcpy.h"
 #include "libavutil/common.h"
@@ -229,6 +230,196 @@ const m_obj_list_t vf_obj_list = {
   M_ST_OFF(vf_info_t,opts)
 };
 
+//============================================================================
+// image buffer pool, shared by all filters of a chain:
+
+#define VF_POOL_MAX_FREE 16
+// buffers left unused for this many allocations are freed, after a
+// reconfiguration the buffers of the old geometry are not kept around
+#define VF_POOL_MAX_AGE  64
+
+struct vf_pool_buffer {
+    unsigned char *buf;
+    int size;
+    unsigned int fmt;
+    int w, h;
+    int in_use;
+    unsigned last_use;
+};
+
+struct vf_image_pool {
+    int refcount;
+    struct vf_pool_buffer *buffers;
+    int num_buffers;
+    int num_free;
+    int hits, misses;
+    unsigned allocs;
+    int64_t bytes_held, peak_bytes;
+};
+
+static struct vf_image_pool *vf_pool_new(void)
+{
+    struct vf_image_pool *pool = calloc(1, sizeof(*pool));
+    if (pool)
+        pool->refcount = 1;
+    return pool;
+}
+
+static void vf_pool_remove(struct vf_image_pool *pool, int i)
+{
+    av_free(pool->buffers[i].buf);
+    pool->bytes_held -= pool->buffers[i].size;
+    if (!pool->buffers[i].in_use)
+        pool->num_free--;
+    pool->num_buffers--;
+    memmove(pool->buffers + i, pool->buffers + i + 1,
+            (pool->num_buffers - i) * sizeof(*pool->buffers));
+}
+
+// drop the unused buffers that went stale and the oldest ones until at
+// most VF_POOL_MAX_FREE remain
+static void vf_pool_trim(struct vf_image_pool *pool)
+{
+    int i = 0;
+    while (pool->num_free && i < pool->num_buffers) {
+        struct vf_pool_buffer *b = &pool->buffers[i];
+        if (!b->in_use && (pool->num_free > VF_POOL_MAX_FREE ||
+                           pool->allocs - b->last_use > VF_POOL_MAX_AGE))
+            vf_pool_remove(pool, i);
+        else
+            i++;
+    }
+}
+
+static void vf_pool_unref(struct vf_image_pool *pool)
+{
+    if (!pool || --pool->refcount > 0)
+        return;
+    mp_msg(MSGT_VFILTER, MSGL_V,
+           "vf: image pool: %d hits, %d misses, %"PRId64" kB held (peak %"PRId64" kB)\n",
+           pool->hits, pool->misses, pool->bytes_held >> 10, pool->peak_bytes >> 10);
+    while (pool->num_buffers)
+        vf_pool_remove(pool, pool->num_buffers - 1);
+    free(pool->buffers);
+    free(pool);
+}
+
+/**
+ * \brief get a buffer from the filter chain's pool
+ * \param fmt image format the buffer is used for, 0 for raw data
+ * \param w stored width (including stride alignment)
+ * \param h stored height
+ * \param size buffer size in bytes
+ * \return av_malloc()ed buffer, to be released with vf_pool_free()
+ */
+void *vf_pool_alloc(vf_instance_t *vf, unsigned int fmt, int w, int h, int size)
+{
+    struct vf_image_pool *pool = vf->pool;
+    struct vf_pool_buffer *b;
+    unsigned char *buf;
+    int i;
+    if (!pool)
+        return av_malloc(size);
+    pool->allocs++;
+    for (i = pool->num_buffers - 1; i >= 0; i--) {
+        b = &pool->buffers[i];
+        if (!b->in_use && b->fmt == fmt && b->w == w && b->h == h && b->size == size) {
+            b->in_use = 1;
+            pool->num_free--;
+            pool->hits++;
+            return b->buf;
+        }
+    }
+    pool->misses++;
+    vf_pool_trim(pool);
+    mp_msg(MSGT_VFILTER, MSGL_DBG2, "vf: image pool miss in vf_%s: %dx%d %s, %d bytes\n",
+           vf->info->name, w, h, fmt ? vo_format_name(fmt) : "raw", size);
+    buf = av_malloc(size);
+    if (!buf)
+        return NULL;
+    b = realloc(pool->buffers, (pool->num_buffers + 1) * sizeof(*b));
+    if (!b)
+        return buf; // cannot track it, vf_pool_free() will av_free() it
+    pool->buffers = b;
+    b = &pool->buffers[pool->num_buffers++];
+    b->buf    = buf;
+    b->size   = size;
+    b->fmt    = fmt;
+    b->w      = w;
+    b->h      = h;
+    b->in_use = 1;
+    pool->bytes_held += size;
+    pool->peak_bytes = FFMAX(pool->peak_bytes, pool->bytes_held);
+    return buf;
+}
+
+/**
+ * \brief return a buffer to the filter chain's pool
+ *
+ * Buffers not obtained through vf_pool_alloc() are simply av_free()d.
+ */
+void vf_pool_free(vf_instance_t *vf, void *buf)
+{
+    struct vf_image_pool *pool = vf->pool;
+    int i;
+    if (!buf)
+        return;
+    if (pool)
+        for (i = 0; i < pool->num_buffers; i++)
+            if (pool->buffers[i].buf == buf && pool->buffers[i].in_use) {
+                pool->buffers[i].in_use   = 0;
+                pool->buffers[i].last_use = pool->allocs;
+                pool->num_free++;
+                vf_pool_trim(pool);
+                return;
+            }
+    av_free(buf);
+}
+
+static void vf_alloc_mpi_planes(vf_instance_t *vf, mp_image_t *mpi)
+{
+    int size = mp_image_planes_size(mpi);
+    unsigned char *buf;
+    if (!size)
+        return;
+    buf = vf_pool_alloc(vf, mpi->imgfmt, mpi->width, mpi->height, size);
+    if (buf)
+        mp_image_setup_planes(mpi, buf);
+}
+
+static void vf_release_mpi_planes(vf_instance_t *vf, mp_image_t *mpi)
+{
+    if (!mpi || !(mpi->flags & MP_IMGFLAG_ALLOCATED))
+        return;
+    vf_pool_free(vf, mpi->planes[0]);
+    mpi->planes[0] = NULL;
+    if (mpi->flags & MP_IMGFLAG_RGB_PALETTE)
+        av_freep(&mpi->planes[1]);
+    mpi->flags &= ~MP_IMGFLAG_ALLOCATED;
+}
+
+/**
+ * \brief alloc_mpi() replacement taking the planes from the chain's pool
+ */
+mp_image_t *vf_alloc_mpi(vf_instance_t *vf, int w, int h, unsigned int fmt)
+{
+    mp_image_t *mpi = new_mp_image(w, h);
+    if (!mpi)
+        return NULL;
+    mp_image_setfmt(mpi, fmt);
+    vf_alloc_mpi_planes(vf, mpi);
+    return mpi;
+}
+
+/**
+ * \brief free_mp_image() replacement returning the planes to the chain's pool
+ */
+void vf_free_mpi(vf_instance_t *vf, mp_image_t *mpi)
+{
+    vf_release_mpi_planes(vf, mpi);
+    free_mp_image(mpi);
+}
+
 //============================================================================
 // mpi stuff:
 
@@ -369,9 +560,7 @@ mp_image_t* vf_get_image(vf_instance_t* vf, unsigned int outfmt, int mp_imgtype,
         if(mpi->flags&MP_IMGFLAG_ALLOCATED){
             if(mpi->width<w2 || mpi->height<h || mpi->imgfmt != outfmt || missing_palette){
                 // need to re-allocate buffer memory:
-                av_freep(&mpi->planes[0]);
-                if (mpi->flags & MP_IMGFLAG_RGB_PALETTE)
-                    av_freep(&mpi->planes[1]);
+                vf_release_mpi_planes(vf, mpi);
                 mpi->planes[1] = NULL;
                 mpi->planes[2] = NULL;
                 mpi->planes[3] = NULL;
@@ -418,7 +607,7 @@ mp_image_t* vf_get_image(vf_instance_t* vf, unsigned int outfmt, int mp_imgtype,
               }
           }
 
-          mp_image_alloc_planes(mpi);
+          vf_alloc_mpi_planes(vf, mpi);
           if (!(mpi->flags & MP_IMGFLAG_ALLOCATED)) { // allocation failed
               mp_msg(MSGT_DECVIDEO, MSGL_FATAL, "vf_get_image: allocation of image planes failed!\n");
               return NULL;
@@ -459,6 +648,56 @@ mp_image_t* vf_get_image(vf_instance_t* vf, unsigned int outfmt, int mp_imgtype,
   return mpi;
 }
 
+//============================================================================
+// band-parallel processing:
+
+struct vf_bands {
+    vf_band_func func;
+    void *ctx;
+    int h, overlap, align, nbands;
+};
+
+static int band_start(struct vf_bands *b, int band)
+{
+    int y;
+    if (band >= b->nbands)
+        return b->h;
+    y = (int64_t)b->h * band / b->nbands;
+    return y - y % b->align;
+}
+
+static void band_job(void *ctx, int band, int thread)
+{
+    struct vf_bands *b = ctx;
+    int y0 = band_start(b, band);
+    int y1 = band_start(b, band + 1);
+    if (y0 < y1)
+        b->func(b->ctx, FFMAX(y0 - b->overlap, 0), y0, y1, thread);
+}
+
+/**
+ * \brief split rows 0..h-1 into horizontal bands processed in parallel
+ * \param func called once per band with the rows y0..y1-1 it has to write
+ *             and the first row warm_y it should start reading from
+ * \param overlap number of rows above y0 a band needs to replay to build
+ *                up state carried from row to row (0 for stateless filters)
+ * \param align band boundaries are multiples of this (e.g. 2 for fields)
+ *
+ * Bands must only write their own rows; reading any row of a separate
+ * source image is fine. The same helper can split columns instead of rows.
+ */
+void vf_run_bands(vf_band_func func, void *ctx, int h, int overlap, int align)
+{
+    struct vf_bands b = { func, ctx, h, overlap, FFMAX(align, 1), 0 };
+    b.nbands = FFMIN(vf_threads_count(), h / b.align);
+    if (b.nbands <= 1) {
+        if (h > 0)
+            func(ctx, 0, 0, h, 0);
+        return;
+    }
+    vf_threads_execute(band_job, &b, b.nbands);
+}
+
 //============================================================================
 
 // By default vf doesn't accept MPEGPES
@@ -481,6 +720,11 @@ vf_instance_t* vf_open_plugin(const vf_info_t* const* filter_list, vf_instance_t
     memset(vf,0,sizeof(vf_instance_t));
     vf->info=filter_list[i];
     vf->next=next;
+    if (next && next->pool) {
+        vf->pool = next->pool;
+        vf->pool->refcount++;
+    } else
+        vf->pool = vf_pool_new();
     vf->config=vf_next_config;
     vf->control=vf_next_control;
     vf->query_format=vf_default_query_format;
@@ -501,6 +745,7 @@ vf_instance_t* vf_open_plugin(const vf_info_t* const* filter_list, vf_instance_t
       else
         args = NULL;
     if(vf->info->vf_open(vf,(char*)args)>0) return vf; // Success!
+    vf_pool_unref(vf->pool);
     free(vf);
     mp_msg(MSGT_VFILTER,MSGL_ERR,MSGTR_CouldNotOpenVideoFilter,name);
     return NULL;
@@ -770,11 +1015,15 @@ vf_instance_t* append_filters(vf_instance_t* last){
 //============================================================================
 
 void vf_uninit_filter(vf_instance_t* vf){
+    int i;
     if(vf->uninit) vf->uninit(vf);
-    free_mp_image(vf->imgctx.static_images[0]);
-    free_mp_image(vf->imgctx.static_images[1]);
-    free_mp_image(vf->imgctx.temp_images[0]);
-    free_mp_image(vf->imgctx.export_images[0]);
+    vf_free_mpi(vf, vf->imgctx.static_images[0]);
+    vf_free_mpi(vf, vf->imgctx.static_images[1]);
+    vf_free_mpi(vf, vf->imgctx.temp_images[0]);
+    vf_free_mpi(vf, vf->imgctx.export_images[0]);
+    for (i = 0; i < NUM_NUMBERED_MPI; i++)
+        vf_free_mpi(vf, vf->imgctx.numbered_images[i]);
+    vf_pool_unref(vf->pool);
     free(vf);
 }
 
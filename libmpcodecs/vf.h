@@ -27,6 +27,7 @@ extern const m_obj_list_t vf_obj_list;
 
 struct vf_instance;
 struct vf_priv_s;
+struct vf_image_pool;
 
 typedef struct vf_info_s {
     const char *info;
@@ -83,6 +84,7 @@ typedef struct vf_instance {
     vf_format_context_t fmt;
     struct vf_instance *next;
     mp_image_t *dmpi;
+    struct vf_image_pool *pool; // shared by all filters of a chain
     struct vf_priv_s* priv;
 } vf_instance_t;
 
@@ -120,6 +122,10 @@ typedef struct vf_seteq_s
 // functions:
 void vf_mpi_clear(mp_image_t* mpi,int x0,int y0,int w,int h);
 mp_image_t* vf_get_image(vf_instance_t* vf, unsigned int outfmt, int mp_imgtype, int mp_imgflag, int w, int h);
+void *vf_pool_alloc(vf_instance_t *vf, unsigned int fmt, int w, int h, int size);
+void vf_pool_free(vf_instance_t *vf, void *buf);
+mp_image_t *vf_alloc_mpi(vf_instance_t *vf, int w, int h, unsigned int fmt);
+void vf_free_mpi(vf_instance_t *vf, mp_image_t *mpi);
 
 vf_instance_t* vf_open_plugin(const vf_info_t* const* filter_list, vf_instance_t* next, const char *name, char **args);
 vf_instance_t* vf_open_filter(vf_instance_t* next, const char *name, char **args);
@@ -141,6 +147,9 @@ int vf_next_query_format(struct vf_instance *vf, unsigned int fmt);
 int vf_next_put_image(struct vf_instance *vf,mp_image_t *mpi, double pts);
 void vf_next_draw_slice (struct vf_instance *vf, unsigned char** src, int* stride, int w,int h, int x, int y);
 
+typedef void (*vf_band_func)(void *ctx, int warm_y, int y0, int y1, int thread);
+void vf_run_bands(vf_band_func func, void *ctx, int h, int overlap, int align);
+
 vf_instance_t* append_filters(vf_instance_t* last);
 
 void vf_uninit_filter(vf_instance_t* vf);
@@ -87,6 +87,9 @@ static const struct vf_priv_s {
     struct dirty_rows_extent {
         int xmin, xmax;
     } *dirty_rows;
+    // rows [dirty_ymin, dirty_ymax) may have non-empty extents,
+    // all the others are known to be clean
+    int dirty_ymin, dirty_ymax;
 
     // called for every eosd image when subtitle is changed
     void (*draw_image)(vf_instance_t *, struct mp_eosd_image *);
@@ -115,6 +118,11 @@ static void draw_image_yuv(vf_instance_t *vf, struct mp_eosd_image *img)
     uint8_t *src = img->bitmap;
     int i, j;
 
+    if (src_h > 0) {
+        vf->priv->dirty_ymin = FFMIN(vf->priv->dirty_ymin, src_y);
+        vf->priv->dirty_ymax = FFMAX(vf->priv->dirty_ymax, src_y + src_h);
+    }
+
     opacity = MAP_24BIT(opacity);
     for (i = 0; i < src_h; i++) {
         struct dirty_rows_extent *dirty_row = &dirty_rows[src_y + i];
@@ -139,12 +147,11 @@ static void prepare_buffer_422(vf_instance_t *vf)
 {
     uint8_t *dst_u = vf->priv->planes[1],
             *dst_v = vf->priv->planes[2];
-    int outw = vf->priv->outw,
-        outh = vf->priv->outh;
+    int outw = vf->priv->outw;
     struct dirty_rows_extent *dirty_rows = vf->priv->dirty_rows;
     int i, j;
 
-    for (i = 0; i < outh; i++) {
+    for (i = vf->priv->dirty_ymin; i < vf->priv->dirty_ymax; i++) {
         int xmin = dirty_rows[i].xmin & ~1,
             xmax = dirty_rows[i].xmax;
         for (j = xmin; j < xmax; j += 2) {
@@ -162,15 +169,14 @@ static void render_frame_yuv422(vf_instance_t *vf)
     uint8_t *src_y = vf->priv->planes[0],
             *src_u = vf->priv->planes[1],
             *src_v = vf->priv->planes[2];
-    int outw = vf->priv->outw,
-        outh = vf->priv->outh;
+    int outw = vf->priv->outw;
     struct dirty_rows_extent *dirty_rows = vf->priv->dirty_rows;
     uint8_t *dest = vf->dmpi->planes[0];
     int stride = vf->dmpi->stride[0];
     int is_uyvy = vf->priv->outfmt == IMGFMT_UYVY;
     int i, j;
 
-    for (i = 0; i < outh; i++) {
+    for (i = vf->priv->dirty_ymin; i < vf->priv->dirty_ymax; i++) {
         int xmin = dirty_rows[i].xmin & ~1,
             xmax = dirty_rows[i].xmax;
         for (j = xmin; j < xmax; j += 2) {
@@ -213,15 +219,14 @@ static void render_frame_yuv422_sse4(vf_instance_t *vf)
     uint8_t *src_y = vf->priv->planes[0],
             *src_u = vf->priv->planes[1],
             *src_v = vf->priv->planes[2];
-    int outw = vf->priv->outw,
-        outh = vf->priv->outh;
+    int outw = vf->priv->outw;
     struct dirty_rows_extent *dr = vf->priv->dirty_rows;
     uint8_t *dst = vf->dmpi->planes[0];
     int stride = vf->dmpi->stride[0];
     int32_t is_uyvy = vf->priv->outfmt == IMGFMT_UYVY;
     int i;
 
-    for (i = 0; i < outh; i++) {
+    for (i = vf->priv->dirty_ymin; i < vf->priv->dirty_ymax; i++) {
         size_t xmin = dr[i].xmin & ~7,
                xmax = dr[i].xmax;
         __asm__ volatile (
@@ -321,7 +326,8 @@ static void render_frame_yuv422_sse4(vf_instance_t *vf)
 static void prepare_buffer_420p(vf_instance_t *vf)
 {
     int outw = vf->priv->outw,
-        outh = vf->priv->outh;
+        ymin = vf->priv->dirty_ymin & ~1,
+        ymax = vf->priv->dirty_ymax;
     uint8_t *dst_u = vf->priv->planes[1],
             *dst_v = vf->priv->planes[2];
     uint8_t *src_a = vf->priv->alphas[0],
@@ -329,7 +335,7 @@ static void prepare_buffer_420p(vf_instance_t *vf)
     struct dirty_rows_extent *dirty_rows = vf->priv->dirty_rows;
     int i, j;
 
-    for (i = 0; i < outh; i += 2) {
+    for (i = ymin; i < ymax; i += 2) {
         int xmin = FFMIN(dirty_rows[i].xmin, dirty_rows[i + 1].xmin) & ~1,
             xmax = FFMAX(dirty_rows[i].xmax, dirty_rows[i + 1].xmax);
         for (j = xmin; j < xmax; j += 2) {
@@ -348,7 +354,7 @@ static void prepare_buffer_420p(vf_instance_t *vf)
 #if HAVE_SSE4_INLINE
     // for render_frame_yuv420p_sse4
     if (gCpuCaps.hasSSE4 && outw % 32 == 0) {
-        for (i = 0; i < outh; i += 2) {
+        for (i = ymin; i < ymax; i += 2) {
             int xmin = FFMIN(dirty_rows[i].xmin, dirty_rows[i + 1].xmin) & ~1,
                 xmax = FFMAX(dirty_rows[i].xmax, dirty_rows[i + 1].xmax);
             if (xmin >= xmax)
@@ -382,13 +388,14 @@ static void render_frame_yuv420p(vf_instance_t *vf)
             *dst_v = dest[2];
     int stride;
     int outw = vf->priv->outw,
-        outh = vf->priv->outh;
+        ymin = vf->priv->dirty_ymin,
+        ymax = vf->priv->dirty_ymax;
     int i, j;
 
     // y
     alpha  = vf->priv->alphas[0];
     stride = vf->dmpi->stride[0];
-    for (i = 0; i < outh; i++) {
+    for (i = ymin; i < ymax; i++) {
         int xmin = dirty_rows[i].xmin,
             xmax = dirty_rows[i].xmax;
         for (j = xmin; j < xmax; j++) {
@@ -402,7 +409,7 @@ static void render_frame_yuv420p(vf_instance_t *vf)
     // u & v
     alpha  = vf->priv->alphas[1];
     stride = vf->dmpi->stride[1];
-    for (i = 0; i < outh / 2; i++) {
+    for (i = ymin / 2; i < (ymax + 1) / 2; i++) {
         int xmin = FFMIN(dirty_rows[i * 2].xmin, dirty_rows[i * 2 + 1].xmin),
             xmax = FFMAX(dirty_rows[i * 2].xmax, dirty_rows[i * 2 + 1].xmax);
         for (j = xmin / 2; j < (xmax + 1) / 2; j++) {
@@ -482,13 +489,14 @@ static void render_frame_yuv420p_sse4(vf_instance_t *vf)
             *dst_v = vf->dmpi->planes[2];
     int stride;
     int outw = vf->priv->outw,
-        outh = vf->priv->outh;
+        ymin = vf->priv->dirty_ymin,
+        ymax = vf->priv->dirty_ymax;
     int i;
 
     // y
     alpha = vf->priv->alphas[0];
     stride = vf->dmpi->stride[0];
-    for (i = 0; i < outh; i++) {
+    for (i = ymin; i < ymax; i++) {
         size_t xmin = dr[i].xmin & ~15,
                xmax = dr[i].xmax;
         __asm__ volatile (
@@ -519,7 +527,7 @@ static void render_frame_yuv420p_sse4(vf_instance_t *vf)
     // u & v
     alpha = vf->priv->alphas[1];
     stride = vf->dmpi->stride[1];
-    for (i = 0; i < outh / 2; i++) {
+    for (i = ymin / 2; i < (ymax + 1) / 2; i++) {
         size_t xmin = FFMIN(dr[i * 2].xmin, dr[i * 2 + 1].xmin) & ~31,
                xmax = FFMAX(dr[i * 2].xmax, dr[i * 2 + 1].xmax);
         __asm__ volatile (
@@ -562,46 +570,174 @@ static void render_frame_yuv420p_sse4(vf_instance_t *vf)
 
 #endif // HAVE_SSE4_INLINE
 
+#if HAVE_AVX2_INLINE
+
+/**
+ * \brief blend n overlay pixels onto dst, n a nonzero multiple of 32
+ *
+ * The alpha is mapped with 16 bit words as a + ((2 * a + 0x80) >> 8),
+ * which is exactly MAP_16BIT(a), and pixels whose alpha is 0xFF are
+ * left untouched, so the result is the same as in the C version.
+ */
+static void blend_avx2(uint8_t *dst, const uint8_t *src,
+                       const uint8_t *alpha, int n)
+{
+    x86_reg j = -n;
+
+    __asm__ volatile (
+        "vpxor      %%ymm7, %%ymm7, %%ymm7          \n\t"
+        "vpcmpeqw   %%ymm5, %%ymm5, %%ymm5          \n\t"
+        "vpsrlw        $15, %%ymm5, %%ymm5          \n\t"
+        "vpsllw         $7, %%ymm5, %%ymm5          \n\t"
+        "1:                                         \n\t"
+        "vmovdqu    (%[alpha],%[j]), %%ymm0         \n\t"
+        "vpcmpeqb   %%ymm6, %%ymm6, %%ymm6          \n\t"
+        "vpcmpeqb   %%ymm6, %%ymm0, %%ymm4          \n\t"
+        "vptest     %%ymm6, %%ymm4                  \n\t"
+        "jc         2f                              \n\t"
+
+        "vpunpcklbw %%ymm7, %%ymm0, %%ymm1          \n\t"
+        "vpunpckhbw %%ymm7, %%ymm0, %%ymm2          \n\t"
+        "vpaddw     %%ymm1, %%ymm1, %%ymm3          \n\t"
+        "vpaddw     %%ymm2, %%ymm2, %%ymm0          \n\t"
+        "vpaddw     %%ymm5, %%ymm3, %%ymm3          \n\t"
+        "vpaddw     %%ymm5, %%ymm0, %%ymm0          \n\t"
+        "vpsrlw         $8, %%ymm3, %%ymm3          \n\t"
+        "vpsrlw         $8, %%ymm0, %%ymm0          \n\t"
+        "vpaddw     %%ymm3, %%ymm1, %%ymm1          \n\t"
+        "vpaddw     %%ymm0, %%ymm2, %%ymm2          \n\t"
+
+        "vmovdqu    (%[dst],%[j]), %%ymm0           \n\t"
+        "vpunpcklbw %%ymm7, %%ymm0, %%ymm3          \n\t"
+        "vpunpckhbw %%ymm7, %%ymm0, %%ymm6          \n\t"
+        "vpmullw    %%ymm1, %%ymm3, %%ymm3          \n\t"
+        "vpmullw    %%ymm2, %%ymm6, %%ymm6          \n\t"
+        "vpsrlw         $8, %%ymm3, %%ymm3          \n\t"
+        "vpsrlw         $8, %%ymm6, %%ymm6          \n\t"
+        "vpackuswb  %%ymm6, %%ymm3, %%ymm3          \n\t"
+        "vmovdqu    (%[src],%[j]), %%ymm6           \n\t"
+        "vpaddb     %%ymm6, %%ymm3, %%ymm3          \n\t"
+        "vpblendvb  %%ymm4, %%ymm0, %%ymm3, %%ymm3  \n\t"
+        "vmovdqu    %%ymm3, (%[dst],%[j])           \n\t"
+
+        "2:                                         \n\t"
+        "add           $32, %[j]                    \n\t"
+        "jl         1b                              \n\t"
+        "vzeroupper                                 \n\t"
+        : [j] "+&r" (j)
+        : [dst] "r" (dst + n), [src] "r" (src + n), [alpha] "r" (alpha + n)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+                       "xmm4", "xmm5", "xmm6", "xmm7",) "memory"
+    );
+}
+
+static void blend_line_avx2(uint8_t *dst, const uint8_t *src,
+                            const uint8_t *alpha, int n)
+{
+    int j = n & ~31;
+
+    if (j)
+        blend_avx2(dst, src, alpha, j);
+    for (; j < n; j++)
+        if (alpha[j] != 0xFF)
+            dst[j] = ((MAP_16BIT(alpha[j]) * dst[j]) >> 8) + src[j];
+}
+
+/**
+ * Unlike the SSE4 version this one needs neither an aligned width nor
+ * any padding around the dirty extents, the tails are done in C.
+ */
+static void render_frame_yuv420p_avx2(vf_instance_t *vf)
+{
+    struct dirty_rows_extent *dr = vf->priv->dirty_rows;
+    uint8_t *alpha;
+    uint8_t *src_y = vf->priv->planes[0],
+            *src_u = vf->priv->planes[1],
+            *src_v = vf->priv->planes[2];
+    uint8_t *dst_y = vf->dmpi->planes[0],
+            *dst_u = vf->dmpi->planes[1],
+            *dst_v = vf->dmpi->planes[2];
+    int stride;
+    int outw = vf->priv->outw,
+        ymin = vf->priv->dirty_ymin,
+        ymax = vf->priv->dirty_ymax;
+    int i;
+
+    // y
+    alpha = vf->priv->alphas[0];
+    stride = vf->dmpi->stride[0];
+    for (i = ymin; i < ymax; i++) {
+        int xmin = dr[i].xmin,
+            xmax = dr[i].xmax;
+        if (xmin < xmax)
+            blend_line_avx2(dst_y + i * stride + xmin, src_y + i * outw + xmin,
+                            alpha + i * outw + xmin, xmax - xmin);
+    }
+
+    // u & v
+    alpha = vf->priv->alphas[1];
+    stride = vf->dmpi->stride[1];
+    for (i = ymin / 2; i < (ymax + 1) / 2; i++) {
+        int xmin = FFMIN(dr[i * 2].xmin, dr[i * 2 + 1].xmin) / 2,
+            xmax = (FFMAX(dr[i * 2].xmax, dr[i * 2 + 1].xmax) + 1) / 2;
+        size_t s = i * outw + xmin,
+               d = i * stride + xmin;
+        if (xmin >= xmax)
+            continue;
+        blend_line_avx2(dst_u + d, src_u + s, alpha + s, xmax - xmin);
+        blend_line_avx2(dst_v + d, src_v + s, alpha + s, xmax - xmin);
+    }
+}
+
+#endif // HAVE_AVX2_INLINE
+
 static void clean_buffer(vf_instance_t *vf)
 {
     int outw = vf->priv->outw,
-        outh = vf->priv->outh;
+        ymin = vf->priv->dirty_ymin,
+        ymax = vf->priv->dirty_ymax;
     struct dirty_rows_extent *dirty_rows = vf->priv->dirty_rows;
     uint8_t **planes = vf->priv->planes;
     uint8_t *alpha = vf->priv->alphas[0];
     int i, j;
 
+    if (ymin >= ymax)
+        return;
     if (vf->priv->prepare_buffer == prepare_buffer_420p) {
         // HACK: prepare_buffer_420p touched u & v planes
         //       so we want to clean them here.
-        for (i = 0; i < outh; i += 2) {
+        ymin &= ~1;
+        for (i = ymin; i < ymax; i += 2) {
             int xmin = FFMIN(dirty_rows[i].xmin, dirty_rows[i + 1].xmin) & ~1,
                 xmax = FFMAX(dirty_rows[i].xmax, dirty_rows[i + 1].xmax);
             dirty_rows[i / 2].xmin = FFMIN(dirty_rows[i / 2].xmin, xmin / 2);
-            dirty_rows[i / 2].xmax = FFMAX(dirty_rows[i / 2].xmax, xmax / 2);
+            dirty_rows[i / 2].xmax = FFMAX(dirty_rows[i / 2].xmax, (xmax + 1) / 2);
         }
+        ymin /= 2;
     }
     for (i = 0; i < MP_MAX_PLANES; i++) {
         uint8_t *plane = planes[i];
         if (!plane)
             break;
-        for (j = 0; j < outh; j++) {
+        for (j = ymin; j < ymax; j++) {
             int xmin = dirty_rows[j].xmin;
             int width = dirty_rows[j].xmax - xmin;
             if (width > 0)
                 memset(plane + j * outw + xmin, 0, width);
         }
     }
-    for (i = 0; i < outh; i++) {
+    for (i = ymin; i < ymax; i++) {
         int xmin = dirty_rows[i].xmin;
         int width = dirty_rows[i].xmax - xmin;
         if (width > 0)
             memset(alpha + i * outw + xmin, -1, width);
     }
-    for (i = 0; i < outh; i++) {
+    for (i = ymin; i < ymax; i++) {
         dirty_rows[i].xmin = outw;
         dirty_rows[i].xmax = 0;
     }
+    vf->priv->dirty_ymin = vf->priv->outh;
+    vf->priv->dirty_ymax = 0;
 }
 
 static int config(struct vf_instance *vf,
@@ -631,6 +767,10 @@ static int config(struct vf_instance *vf,
 #if HAVE_SSE4_INLINE
         if (gCpuCaps.hasSSE4 && outw % 32 == 0)
             vf->priv->render_frame = render_frame_yuv420p_sse4;
+#endif
+#if HAVE_AVX2_INLINE
+        if (gCpuCaps.hasAVX2)
+            vf->priv->render_frame = render_frame_yuv420p_avx2;
 #endif
         break;
     case IMGFMT_UYVY:
@@ -667,6 +807,8 @@ static int config(struct vf_instance *vf,
         dirty_rows[i].xmax = outw;
     }
     vf->priv->dirty_rows = dirty_rows;
+    vf->priv->dirty_ymin = 0;
+    vf->priv->dirty_ymax = outh;
     clean_buffer(vf);
 
     res.w    = vf->priv->outw;
@@ -35,11 +35,14 @@
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "metrics.h"
 
 struct vf_priv_s {
     unsigned int bamount, bthresh, frame, lastkeyframe;
 };
 
+static struct metrics_dsp metrics;
+
 static int config(struct vf_instance *vf, int width, int height, int d_width,
                     int d_height, unsigned int flags, unsigned int outfmt) {
     return vf_next_config(vf,width,height,d_width,d_height,flags,outfmt);
@@ -68,7 +71,7 @@ static int query_format(struct vf_instance *vf, unsigned fmt) {
 
 static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
     mp_image_t *dmpi;
-    int x, y;
+    int y;
     int nblack=0, pblack=0;
     unsigned char *yplane = mpi->planes[0];
     unsigned int ystride = mpi->stride[0];
@@ -79,8 +82,7 @@ static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
     static const char *const picttypes[4] = { "unknown", "I", "P", "B" };
 
     for (y=1; y<=h; y++) {
-        for (x=0; x<w; x++)
-            nblack += yplane[x] < bthresh;
+        nblack += metrics.count_below(yplane, w, bthresh);
         pblack = nblack*100/(w*y);
         if (pblack < bamount) break;
         yplane += ystride;
@@ -135,6 +137,7 @@ static int vf_open(vf_instance_t *vf, char *args){
 
     if (args)
         sscanf(args, "%u:%u", &vf->priv->bamount, &vf->priv->bthresh);
+    metrics_init_dsp(&metrics, metrics_cpu_caps());
     return 1;
 }
 
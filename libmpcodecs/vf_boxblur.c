@@ -106,25 +106,45 @@ static inline void blur2(uint8_t *dst, uint8_t *src, int w, int radius, int powe
         }
 }
 
-static void hBlur(uint8_t *dst, uint8_t *src, int w, int h, int dstStride, int srcStride, int radius, int power){
+struct blur_plane {
+        uint8_t *dst, *src;
+        int w, h, dstStride, srcStride, radius, power;
+};
+
+static void hBlur_band(void *ctx, int warm_y, int y0, int y1, int thread){
+        struct blur_plane *p= ctx;
         int y;
 
-        if(radius==0 && dst==src) return;
+        for(y=y0; y<y1; y++){
+                blur2(p->dst + y*p->dstStride, p->src + y*p->srcStride, p->w, p->radius, p->power, 1, 1);
+        }
+}
+
+static void vBlur_band(void *ctx, int warm_x, int x0, int x1, int thread){
+        struct blur_plane *p= ctx;
+        int x;
 
-        for(y=0; y<h; y++){
-                blur2(dst + y*dstStride, src + y*srcStride, w, radius, power, 1, 1);
+        for(x=x0; x<x1; x++){
+                blur2(p->dst + x, p->src + x, p->h, p->radius, p->power, p->dstStride, p->srcStride);
         }
 }
 
+static void hBlur(uint8_t *dst, uint8_t *src, int w, int h, int dstStride, int srcStride, int radius, int power){
+        struct blur_plane p= { dst, src, w, h, dstStride, srcStride, radius, power };
+
+        if(radius==0 && dst==src) return;
+
+        vf_run_bands(hBlur_band, &p, h, 0, 1);
+}
+
 //FIXME optimize (x before y !!!)
 static void vBlur(uint8_t *dst, uint8_t *src, int w, int h, int dstStride, int srcStride, int radius, int power){
-        int x;
+        struct blur_plane p= { dst, src, w, h, dstStride, srcStride, radius, power };
 
         if(radius==0 && dst==src) return;
 
-        for(x=0; x<w; x++){
-                blur2(dst + x, src + x, h, radius, power, dstStride, srcStride);
-        }
+        // columns are independent, split them in cache line sized groups
+        vf_run_bands(vBlur_band, &p, w, 0, 16);
 }
 
 static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
@@ -28,6 +28,7 @@
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "metrics.h"
 
 struct vf_priv_s {
     int x1,y1,x2,y2;
@@ -37,18 +38,24 @@ struct vf_priv_s {
     int fno;
 };
 
+static struct metrics_dsp metrics;
+
 static int checkline(unsigned char* src,int stride,int len,int bpp){
     int total=0;
     int div=len;
     switch(bpp){
     case 1:
-        while(--len>=0){
+        if(stride==1) // a line, contiguous
+            total=metrics.sum(src,len);
+        else while(--len>=0){
             total+=src[0]; src+=stride;
         }
         break;
     case 3:
     case 4:
-        while(--len>=0){
+        if(stride==3)
+            total=metrics.sum(src,len*3);
+        else while(--len>=0){
             total+=src[0]+src[1]+src[2]; src+=stride;
         }
         div*=3;
@@ -186,6 +193,7 @@ static int vf_open(vf_instance_t *vf, char *args){
     &vf->priv->limit,
     &vf->priv->round,
     &vf->priv->reset_count);
+    metrics_init_dsp(&metrics, metrics_cpu_caps());
     return 1;
 }
 
@@ -22,12 +22,11 @@
 
 #include "config.h"
 #include "mp_msg.h"
-#include "cpudetect.h"
 
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
-#include "mpx86asm.h"
+#include "metrics.h"
 #include "libvo/fastmemcpy.h"
 
 
@@ -37,75 +36,26 @@ struct vf_priv_s {
     int max, last, cnt;
 };
 
-#if HAVE_MMX_INLINE && HAVE_EBX_AVAILABLE
-static int diff_MMX(unsigned char *old, unsigned char *new, int os, int ns)
-{
-    volatile short out[4];
-    __asm__ (
-        "movl $8, %%ecx \n\t"
-        "pxor %%mm4, %%mm4 \n\t"
-        "pxor %%mm7, %%mm7 \n\t"
-
-        ASMALIGN(4)
-        "1: \n\t"
-
-        "movq (%%"REG_S"), %%mm0 \n\t"
-        "movq (%%"REG_S"), %%mm2 \n\t"
-        "add %%"REG_a", %%"REG_S" \n\t"
-        "movq (%%"REG_D"), %%mm1 \n\t"
-        "add %%"REG_b", %%"REG_D" \n\t"
-        "psubusb %%mm1, %%mm2 \n\t"
-        "psubusb %%mm0, %%mm1 \n\t"
-        "movq %%mm2, %%mm0 \n\t"
-        "movq %%mm1, %%mm3 \n\t"
-        "punpcklbw %%mm7, %%mm0 \n\t"
-        "punpcklbw %%mm7, %%mm1 \n\t"
-        "punpckhbw %%mm7, %%mm2 \n\t"
-        "punpckhbw %%mm7, %%mm3 \n\t"
-        "paddw %%mm0, %%mm4 \n\t"
-        "paddw %%mm1, %%mm4 \n\t"
-        "paddw %%mm2, %%mm4 \n\t"
-        "paddw %%mm3, %%mm4 \n\t"
-
-        "decl %%ecx \n\t"
-        "jnz 1b \n\t"
-        "movq %%mm4, (%%"REG_d") \n\t"
-        "emms \n\t"
-        :
-        : "S" (old), "D" (new), "a" ((long)os), "b" ((long)ns), "d" (out)
-        : "%ecx", "memory"
-        );
-    return out[0]+out[1]+out[2]+out[3];
-}
-#endif
-
-static int diff_C(unsigned char *old, unsigned char *new, int os, int ns)
-{
-    int x, y, d=0;
-    for (y = 0; y < 8; y++) {
-        for (x = 0; x < 8; x++) {
-            d += abs(new[x] - old[x]);
-        }
-        new += ns;
-        old += os;
-    }
-    return d;
-}
-
-static int (*diff)(unsigned char *, unsigned char *, int, int);
+static struct metrics_dsp metrics;
 
 static int diff_to_drop_plane(int hi, int lo, float frac, unsigned char *old, unsigned char *new, int w, int h, int os, int ns)
 {
-    int x, y;
-    int d, c=0;
+    int x, y, i, n;
+    int d[2][32], c=0;
     int t = (w/16)*(h/16)*frac;
     for (y = 0; y < h-7; y += 4) {
-        for (x = 8; x < w-7; x += 4) {
-            d = diff(old+x+y*os, new+x+y*ns, os, ns);
-            if (d > hi) return 0;
-            if (d > lo) {
-                c++;
-                if (c > t) return 0;
+        /* blocks overlap by half, do the even and the odd ones separately */
+        for (x = 8; x < w-7; x += 4*n) {
+            n = (w-7-x+3)/4;
+            if (n > 64) n = 64;
+            metrics.sad8(old+x+y*os, new+x+y*ns, os, ns, 8, (n+1)/2, d[0]);
+            metrics.sad8(old+x+4+y*os, new+x+4+y*ns, os, ns, 8, n/2, d[1]);
+            for (i = 0; i < n; i++) {
+                if (d[i&1][i>>1] > hi) return 0;
+                if (d[i&1][i>>1] > lo) {
+                    c++;
+                    if (c > t) return 0;
+                }
             }
         }
     }
@@ -181,10 +131,7 @@ static int vf_open(vf_instance_t *vf, char *args)
     p->lo = 64*5;
     p->frac = 0.33;
     if (args) sscanf(args, "%d:%d:%d:%f", &p->max, &p->hi, &p->lo, &p->frac);
-    diff = diff_C;
-#if HAVE_MMX_INLINE && HAVE_EBX_AVAILABLE
-    if(gCpuCaps.hasMMX) diff = diff_MMX;
-#endif
+    metrics_init_dsp(&metrics, metrics_cpu_caps());
     return 1;
 }
 
@@ -100,38 +100,41 @@ static void update_sub(struct vf_priv_s *p, double pts)
     fix_band(p);
 }
 
-static void delogo(uint8_t *dst, uint8_t *src, int dstStride, int srcStride, int width, int height,
-                   int logo_x, int logo_y, int logo_w, int logo_h, int band, int show, int direct) {
-    int y, x;
-    int interp, dist;
-    uint8_t *xdst, *xsrc;
-
+struct delogo_plane {
+    uint8_t *dst, *src;
+    int dstStride, srcStride, width;
+    int logo_x, logo_y, logo_w, logo_h, band, show, direct;
     uint8_t *topleft, *botleft, *topright;
-    int xclipl, xclipr, yclipt, yclipb;
+    int xclipl, yclipt;
     int logo_x1, logo_x2, logo_y1, logo_y2;
+};
 
-    xclipl = MAX(-logo_x, 0);
-    xclipr = MAX(logo_x+logo_w-width, 0);
-    yclipt = MAX(-logo_y, 0);
-    yclipb = MAX(logo_y+logo_h-height, 0);
-
-    logo_x1 = logo_x + xclipl;
-    logo_x2 = logo_x + logo_w - xclipr;
-    logo_y1 = logo_y + yclipt;
-    logo_y2 = logo_y + logo_h - yclipb;
-
-    topleft = src+logo_y1*srcStride+logo_x1;
-    topright = src+logo_y1*srcStride+logo_x2-1;
-    botleft = src+(logo_y2-1)*srcStride+logo_x1;
+/**
+ * Interpolate logo rows y0..y1-1 (and copy them first if not in-place).
+ * Only the logo interior is written and the border rows and columns it
+ * interpolates from are never modified, so bands can run concurrently.
+ */
+static void delogo_band(void *ctx, int warm_y, int y0, int y1, int thread) {
+    struct delogo_plane *p = ctx;
+    int y, x;
+    int interp, dist;
+    uint8_t *dst, *src, *xdst, *xsrc;
+    uint8_t *topleft = p->topleft, *botleft = p->botleft, *topright = p->topright;
+    int srcStride = p->srcStride;
+    int logo_x = p->logo_x, logo_y = p->logo_y, logo_w = p->logo_w, logo_h = p->logo_h;
+    int band = p->band, xclipl = p->xclipl, yclipt = p->yclipt;
 
-    if (!direct) memcpy_pic(dst, src, width, height, dstStride, srcStride);
+    if (!p->direct) memcpy_pic(p->dst+y0*p->dstStride, p->src+y0*srcStride,
+                               p->width, y1-y0, p->dstStride, srcStride);
 
-    dst += (logo_y1+1)*dstStride;
-    src += (logo_y1+1)*srcStride;
+    y0 = MAX(y0, p->logo_y1+1);
+    y1 = MIN(y1, p->logo_y2-1);
+    dst = p->dst + y0*p->dstStride;
+    src = p->src + y0*srcStride;
 
-    for(y = logo_y1+1; y < logo_y2-1; y++)
+    for(y = y0; y < y1; y++)
     {
-        for (x = logo_x1+1, xdst = dst+logo_x1+1, xsrc = src+logo_x1+1; x < logo_x2-1; x++, xdst++, xsrc++) {
+        for (x = p->logo_x1+1, xdst = dst+p->logo_x1+1, xsrc = src+p->logo_x1+1; x < p->logo_x2-1; x++, xdst++, xsrc++) {
             interp = ((topleft[srcStride*(y-logo_y-yclipt)]
                        + topleft[srcStride*(y-logo_y-1-yclipt)]
                        + topleft[srcStride*(y-logo_y+1-yclipt)])*(logo_w-(x-logo_x))/logo_w
@@ -159,15 +162,40 @@ static void delogo(uint8_t *dst, uint8_t *src, int dstStride, int srcStride, int
                 if (y < logo_y+band) dist = MAX(dist, logo_y-y+band);
                 else if (y >= logo_y+logo_h-band) dist = MAX(dist, y-(logo_y+logo_h-1-band));
                 *xdst = (*xsrc*dist + interp*(band-dist))/band;
-                if (show && (dist == band-1)) *xdst = 0;
+                if (p->show && (dist == band-1)) *xdst = 0;
             }
         }
 
-        dst+= dstStride;
+        dst+= p->dstStride;
         src+= srcStride;
     }
 }
 
+static void delogo(uint8_t *dst, uint8_t *src, int dstStride, int srcStride, int width, int height,
+                   int logo_x, int logo_y, int logo_w, int logo_h, int band, int show, int direct) {
+    struct delogo_plane p = {
+        dst, src, dstStride, srcStride, width,
+        logo_x, logo_y, logo_w, logo_h, band, show, direct
+    };
+    int xclipr, yclipb;
+
+    p.xclipl = MAX(-logo_x, 0);
+    xclipr = MAX(logo_x+logo_w-width, 0);
+    p.yclipt = MAX(-logo_y, 0);
+    yclipb = MAX(logo_y+logo_h-height, 0);
+
+    p.logo_x1 = logo_x + p.xclipl;
+    p.logo_x2 = logo_x + logo_w - xclipr;
+    p.logo_y1 = logo_y + p.yclipt;
+    p.logo_y2 = logo_y + logo_h - yclipb;
+
+    p.topleft = src+p.logo_y1*srcStride+p.logo_x1;
+    p.topright = src+p.logo_y1*srcStride+p.logo_x2-1;
+    p.botleft = src+(p.logo_y2-1)*srcStride+p.logo_x1;
+
+    vf_run_bands(delogo_band, &p, height, 0, 1);
+}
+
 static int config(struct vf_instance *vf,
                   int width, int height, int d_width, int d_height,
                   unsigned int flags, unsigned int outfmt){
@@ -26,6 +26,7 @@
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "metrics.h"
 
 #include "libvo/fastmemcpy.h"
 
@@ -71,41 +72,23 @@ enum {
         TC_IL2
 };
 
-static void block_diffs(struct metrics *m, unsigned char *old, unsigned char *new, int os, int ns)
-{
-        int x, y, even=0, odd=0, noise, temp;
-        unsigned char *oldp, *newp;
-        m->noise = m->temp = 0;
-        for (x = 8; x; x--) {
-                oldp = old++;
-                newp = new++;
-                noise = temp = 0;
-                for (y = 4; y; y--) {
-                        even += abs(newp[0]-oldp[0]);
-                        odd += abs(newp[ns]-oldp[os]);
-                        noise += newp[ns]-newp[0];
-                        temp += oldp[os]-newp[0];
-                        oldp += os<<1;
-                        newp += ns<<1;
-                }
-                m->noise += abs(noise);
-                m->temp += abs(temp);
-        }
-        m->even = even;
-        m->odd = odd;
-}
+static struct metrics_dsp metrics;
 
 static void diff_planes(struct metrics *m, unsigned char *old, unsigned char *new, int w, int h, int os, int ns)
 {
-        int x, y, me=0, mo=0, mn=0, mt=0;
-        struct metrics l;
+        int x, y, i, n, me=0, mo=0, mn=0, mt=0;
+        struct field_diffs l[64];
         for (y = 0; y < h-7; y += 8) {
-                for (x = 0; x < w-7; x += 8) {
-                        block_diffs(&l, old+x+y*os, new+x+y*ns, os, ns);
-                        if (l.even > me) me = l.even;
-                        if (l.odd > mo) mo = l.odd;
-                        if (l.noise > mn) mn = l.noise;
-                        if (l.temp > mt) mt = l.temp;
+                for (x = 0; x < w-7; x += 8*n) {
+                        n = (w-x)/8;
+                        if (n > 64) n = 64;
+                        metrics.field8(old+x+y*os, new+x+y*ns, os, ns, n, l);
+                        for (i = 0; i < n; i++) {
+                                if (l[i].even > me) me = l[i].even;
+                                if (l[i].odd > mo) mo = l[i].odd;
+                                if (l[i].noise > mn) mn = l[i].noise;
+                                if (l[i].temp > mt) mt = l[i].temp;
+                        }
                 }
         }
         m->even = me;
@@ -440,6 +423,7 @@ static int vf_open(vf_instance_t *vf, char *args)
         if (args) parse_args(p, args);
         p->analyze = anal_funcs[p->mode].func;
         p->needread = anal_funcs[p->mode].needread;
+        metrics_init_dsp(&metrics, metrics_cpu_caps());
         return 1;
 }
 
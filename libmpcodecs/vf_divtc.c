@@ -26,12 +26,12 @@
 #include "mp_msg.h"
 #include "cpudetect.h"
 #include "libavutil/common.h"
-#include "mpx86asm.h"
 #include "mpbswap.h"
 
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "metrics.h"
 
 #include "libvo/fastmemcpy.h"
 
@@ -48,78 +48,29 @@ struct vf_priv_s
    int *history;
    };
 
-/*
- * diff_MMX and diff_C stolen from vf_decimate.c
- */
-
-#if HAVE_MMX_INLINE && HAVE_EBX_AVAILABLE
-static int diff_MMX(unsigned char *old, unsigned char *new, int os, int ns)
-   {
-   volatile short out[4];
-   __asm__ (
-        "movl $8, %%ecx \n\t"
-        "pxor %%mm4, %%mm4 \n\t"
-        "pxor %%mm7, %%mm7 \n\t"
-
-        ASMALIGN(4)
-        "1: \n\t"
-
-        "movq (%%"REG_S"), %%mm0 \n\t"
-        "movq (%%"REG_S"), %%mm2 \n\t"
-        "add %%"REG_a", %%"REG_S" \n\t"
-        "movq (%%"REG_D"), %%mm1 \n\t"
-        "add %%"REG_b", %%"REG_D" \n\t"
-        "psubusb %%mm1, %%mm2 \n\t"
-        "psubusb %%mm0, %%mm1 \n\t"
-        "movq %%mm2, %%mm0 \n\t"
-        "movq %%mm1, %%mm3 \n\t"
-        "punpcklbw %%mm7, %%mm0 \n\t"
-        "punpcklbw %%mm7, %%mm1 \n\t"
-        "punpckhbw %%mm7, %%mm2 \n\t"
-        "punpckhbw %%mm7, %%mm3 \n\t"
-        "paddw %%mm0, %%mm4 \n\t"
-        "paddw %%mm1, %%mm4 \n\t"
-        "paddw %%mm2, %%mm4 \n\t"
-        "paddw %%mm3, %%mm4 \n\t"
-
-        "decl %%ecx \n\t"
-        "jnz 1b \n\t"
-        "movq %%mm4, (%%"REG_d") \n\t"
-        "emms \n\t"
-        :
-        : "S" (old), "D" (new), "a" ((long)os), "b" ((long)ns), "d" (out)
-        : "%ecx", "memory"
-        );
-   return out[0]+out[1]+out[2]+out[3];
-   }
-#endif
-
-static int diff_C(unsigned char *old, unsigned char *new, int os, int ns)
-   {
-   int x, y, d=0;
-
-   for(y=8; y; y--, new+=ns, old+=os)
-      for(x=8; x; x--)
-         d+=abs(new[x]-old[x]);
-
-   return d;
-   }
-
-static int (*diff)(unsigned char *, unsigned char *, int, int);
+static struct metrics_dsp metrics;
+// the C version of this filter compared columns 1..8 of each block
+static int diff_offset;
 
 static int diff_plane(unsigned char *old, unsigned char *new,
                       int w, int h, int os, int ns, int arg)
    {
-   int x, y, d, max=0, sum=0, n=0;
+   int x, y, i, nb, d[64], max=0, sum=0, n=0;
 
    for(y=0; y<h-7; y+=8)
       {
-      for(x=0; x<w-7; x+=8)
+      for(x=0; x<w-7; x+=8*nb)
          {
-         d=diff(old+x+y*os, new+x+y*ns, os, ns);
-         if(d>max) max=d;
-         sum+=d;
-         n++;
+         nb=(w-x)/8;
+         if(nb>64) nb=64;
+         metrics.sad8(old+x+y*os+diff_offset, new+x+y*ns+diff_offset,
+                      os, ns, 8, nb, d);
+         for(i=0; i<nb; i++)
+            {
+            if(d[i]>max) max=d[i];
+            sum+=d[i];
+            }
+         n+=nb;
          }
       }
 
@@ -702,9 +653,10 @@ static int vf_open(vf_instance_t *vf, char *args)
    if(!(p->history=calloc(sizeof *p->history, p->window)))
       goto nomem;
 
-   diff = diff_C;
+   metrics_init_dsp(&metrics, metrics_cpu_caps());
+   diff_offset = 1;
 #if HAVE_MMX_INLINE && HAVE_EBX_AVAILABLE
-   if(gCpuCaps.hasMMX) diff = diff_MMX;
+   if(gCpuCaps.hasMMX) diff_offset = 0;
 #endif
 
    free(args);
@@ -237,6 +237,21 @@ void apply_lut (eq2_param_t *par, unsigned char *dst, unsigned char *src,
   }
 }
 
+struct eq2_band {
+  eq2_param_t   *par;
+  unsigned char *dst, *src;
+  unsigned      w, dstride, sstride;
+};
+
+static
+void adjust_band (void *ctx, int warm_y, int y0, int y1, int thread)
+{
+  struct eq2_band *b = ctx;
+
+  b->par->adjust (b->par, b->dst + y0 * b->dstride, b->src + y0 * b->sstride,
+    b->w, y1 - y0, b->dstride, b->sstride);
+}
+
 static
 int put_image (vf_instance_t *vf, mp_image_t *src, double pts)
 {
@@ -266,11 +281,23 @@ int put_image (vf_instance_t *vf, mp_image_t *src, double pts)
 
   for (i = 0; i < ((src->num_planes>1)?3:1); i++) {
     if (eq2->param[i].adjust != NULL) {
+      struct eq2_band b;
+
       dst->planes[i] = eq2->buf[i];
       dst->stride[i] = eq2->buf_w[i];
 
-      eq2->param[i].adjust (&eq2->param[i], dst->planes[i], src->planes[i],
-        eq2->buf_w[i], eq2->buf_h[i], dst->stride[i], src->stride[i]);
+      /* build the LUT once here instead of racing on it from every band */
+      if (eq2->param[i].adjust == apply_lut && !eq2->param[i].lut_clean) {
+        create_lut (&eq2->param[i]);
+      }
+
+      b.par = &eq2->param[i];
+      b.dst = dst->planes[i];
+      b.src = src->planes[i];
+      b.w = eq2->buf_w[i];
+      b.dstride = dst->stride[i];
+      b.sstride = src->stride[i];
+      vf_run_bands (adjust_band, &b, eq2->buf_h[i], 0, 1);
     }
     else {
       dst->planes[i] = src->planes[i];
@@ -30,6 +30,7 @@
 #include "vd.h"
 #include "vf.h"
 #include "cmmx.h"
+#include "metrics.h"
 #include "mpx86asm.h"
 #include "libvo/fastmemcpy.h"
 
@@ -85,6 +86,8 @@ struct vf_priv_s {
     long prev_fields;
     long notout;
     long mmx2;
+    int simd;
+    struct metrics_dsp metrics;
     unsigned small_bytes[2];
     unsigned mmx_temp[2];
     struct frame_stats stats[2];
@@ -777,7 +780,9 @@ static void diff_planes(struct vf_priv_s *p, struct frame_stats *s,
                         unsigned char *of, unsigned char *nf,
                         int w, int h, int os, int ns, int swapped)
 {
-    int i, y;
+    int i, k, n, y;
+    struct field_qdiffs qd[64];
+    struct metrics tm;
     int align = -(long)nf & 7;
     of += align;
     nf += align;
@@ -793,7 +798,20 @@ static void diff_planes(struct vf_priv_s *p, struct frame_stats *s,
     memset(s, 0, sizeof(*s));
 
     for (y = (h-8) >> 3; y; y--) {
-        if (p->mmx2 == 1) {
+        if (p->simd) {
+            for (i = 0; i < w; i += 8*n) {
+                n = (w - i + 7) >> 3;
+                if (n > 64) n = 64;
+                p->metrics.qfield8(of+i, nf+i, os, ns, n, qd);
+                for (k = 0; k < n; k++) {
+                    tm.even  = qd[k].even;
+                    tm.odd   = qd[k].odd;
+                    tm.noise = qd[k].noise;
+                    tm.temp  = qd[k].temp;
+                    get_block_stats(&tm, p, s);
+                }
+            }
+        } else if (p->mmx2 == 1) {
             for (i = 0; i < w; i += 8)
                 block_metrics_mmx2(of+i, nf+i, os, ns, 4, p, s);
         } else if (p->mmx2 == 2) {
@@ -1444,6 +1462,9 @@ static int vf_open(vf_instance_t *vf, char *args)
 #if !HAVE_AMD3DNOW_INLINE
     p->mmx2 &= 1;
 #endif
+    /* same metrics as the MMX2 code, several blocks at a time */
+    metrics_init_dsp(&p->metrics, metrics_cpu_caps());
+    p->simd = p->mmx2 == 1 && metrics_cpu_caps();
     p->thres.odd  = p->thres.even;
     p->thres.temp = p->thres.noise;
     p->diff_time = 0;
@@ -45,6 +45,7 @@
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "vf_threads.h"
 #include "av_helpers.h"
 #include "libvo/fastmemcpy.h"
 
@@ -85,19 +86,26 @@ DECLARE_ASM_CONST(32, uint8_t, dither)[8][8]={
     { 42,  26,  38,  22,  41,  25,  37,  21, },
 };
 
-struct vf_priv_s { //align 16 !
+/// per thread state, the row bands of a plane are split between the threads
+struct fspp_thread { //align 16 !
     uint64_t threshold_mtx_noq[8*2];
     uint64_t threshold_mtx[8*2];//used in both C & MMX (& later SSE2) versions
+    int prev_q;
+    int16_t *temp;
+};
+
+struct vf_priv_s { //align 16 !
+    uint64_t threshold_mtx_noq[8*2];
 
     int log2_count;
     int temp_stride;
     int qp;
     int mpeg2;
-    int prev_q;
     uint8_t *src;
-    int16_t *temp;
     int bframes;
     char *non_b_qp;
+    int nthreads;
+    struct fspp_thread *thread[VF_MAX_THREADS];
 };
 
 
@@ -157,7 +165,7 @@ static void store_slice2_c(uint8_t *dst, int16_t *src, int dst_stride, int src_s
     }
 }
 
-static void mul_thrmat_c(struct vf_priv_s *p,int q)
+static void mul_thrmat_c(struct fspp_thread *p,int q)
 {
     int a;
     for(a=0;a<64;a++)
@@ -314,7 +322,7 @@ static void store_slice2_mmx(uint8_t *dst, int16_t *src, long dst_stride, long s
         );
 }
 
-static void mul_thrmat_mmx(struct vf_priv_s *p, int q)
+static void mul_thrmat_mmx(struct fspp_thread *p, int q)
 {
     uint64_t *adr=&p->threshold_mtx_noq[0];
     __asm__ volatile(
@@ -411,60 +419,68 @@ static void column_fidct_mmx(int16_t* thr_adr,  int16_t *data,  int16_t *output,
 #define column_fidct_s column_fidct_mmx
 #endif
 
-static void filter(struct vf_priv_s *p, uint8_t *dst, uint8_t *src,
-                   int dst_stride, int src_stride,
-                   int width, int height,
-                   uint8_t *qp_store, int qp_stride, int is_luma)
+struct filter_job {
+    struct vf_priv_s *p;
+    uint8_t *dst;
+    int dst_stride;
+    int stride;
+    int width, height;
+    uint8_t *qp_store;
+    int qp_stride;
+    int is_luma;
+    int nrows;      ///< rows of 8 lines that are stored
+    int nbands;
+};
+
+/**
+ * \brief filter the rows of 8 lines first..last-1 of a plane
+ *
+ * A line adds to the 8 lines of temp below it, so a band starts with the
+ * lines that still add to the last row of the previous band, but does not
+ * store that row.
+ */
+static void filter_band(void *ctx, int band, int thread)
 {
+    struct filter_job *j = ctx;
+    struct vf_priv_s *p = j->p;
+    struct fspp_thread *th = p->thread[thread];
+    int16_t *temp = th->temp;
     int x, x0, y, es, qy, t;
-    const int stride= is_luma ? p->temp_stride : (width+16);//((width+16+15)&(~15))
+    const int stride= j->stride;
+    const int width= j->width, height= j->height;
+    const int first= j->nrows* band   /j->nbands;
+    const int last = j->nrows*(band+1)/j->nbands;
     const int step=6-p->log2_count;
-    const int qps= 3 + is_luma;
+    const int qps= 3 + j->is_luma;
+    uint8_t *dst= j->dst;
+    const int dst_stride= j->dst_stride;
     DECLARE_ALIGNED(32, int32_t, block_align)[4*8*BLOCKSZ+ 4*8*BLOCKSZ];
     int16_t *block= (int16_t *)block_align;
     int16_t *block3=(int16_t *)(block_align+4*8*BLOCKSZ);
 
     memset(block3, 0, 4*8*BLOCKSZ);
+    memset(temp, 0, 3*8*stride*sizeof(int16_t));
 
-    //p->src=src-src_stride*8-8;//!
-    if (!src || !dst) return; // HACK avoid crash for Y8 colourspace
-    for(y=0; y<height; y++){
-        int index= 8 + 8*stride + y*stride;
-        fast_memcpy(p->src + index, src + y*src_stride, width);//this line can be avoided by using DR & user fr.buffers
-        for(x=0; x<8; x++){
-            p->src[index         - x - 1]= p->src[index +         x    ];
-            p->src[index + width + x    ]= p->src[index + width - x - 1];
-        }
-    }
-    for(y=0; y<8; y++){
-        fast_memcpy(p->src + (      7-y)*stride, p->src + (      y+8)*stride, stride);
-        fast_memcpy(p->src + (height+8+y)*stride, p->src + (height-y+7)*stride, stride);
-    }
-    //FIXME (try edge emu)
-
-    for(y=8; y<24; y++)
-        memset(p->temp+ 8 +y*stride, 0,width*sizeof(int16_t));
-
-    for(y=step; y<height+8; y+=step){    //step= 1,2
+    for(y=8*first+step; y<height+8 && y<8*last+8; y+=step){    //step= 1,2
         qy=y-4;
         if (qy>height-1) qy=height-1;
         if (qy<0) qy=0;
-        qy=(qy>>qps)*qp_stride;
+        qy=(qy>>qps)*j->qp_stride;
         row_fdct_s(block, p->src + y*stride +2-(y&1), stride, 2);
         for(x0=0; x0<width+8-8*(BLOCKSZ-1); x0+=8*(BLOCKSZ-1)){
             row_fdct_s(block+8*8, p->src + y*stride+8+x0 +2-(y&1), stride, 2*(BLOCKSZ-1));
             if(p->qp)
-                column_fidct_s((int16_t*)(&p->threshold_mtx[0]), block+0*8, block3+0*8, 8*(BLOCKSZ-1)); //yes, this is a HOTSPOT
+                column_fidct_s((int16_t*)(&th->threshold_mtx[0]), block+0*8, block3+0*8, 8*(BLOCKSZ-1)); //yes, this is a HOTSPOT
             else
                 for (x=0; x<8*(BLOCKSZ-1); x+=8) {
                     t=x+x0-2; //correct t=x+x0-2-(y&1), but its the same
                     if (t<0) t=0;//t always < width-2
-                    t=qp_store[qy+(t>>qps)];
+                    t=j->qp_store[qy+(t>>qps)];
                     t=norm_qscale(t, p->mpeg2);
-                    if (t!=p->prev_q) p->prev_q=t, mul_thrmat_s(p, t);
-                    column_fidct_s((int16_t*)(&p->threshold_mtx[0]), block+x*8, block3+x*8, 8); //yes, this is a HOTSPOT
+                    if (t!=th->prev_q) th->prev_q=t, mul_thrmat_s(th, t);
+                    column_fidct_s((int16_t*)(&th->threshold_mtx[0]), block+x*8, block3+x*8, 8); //yes, this is a HOTSPOT
                 }
-            row_idct_s(block3+0*8, p->temp + (y&15)*stride+x0+2-(y&1), stride, 2*(BLOCKSZ-1));
+            row_idct_s(block3+0*8, temp + (y&15)*stride+x0+2-(y&1), stride, 2*(BLOCKSZ-1));
             memmove(block, block+(BLOCKSZ-1)*64, 8*8*sizeof(int16_t)); //cycling
             memmove(block3, block3+(BLOCKSZ-1)*64, 6*8*sizeof(int16_t));
         }
@@ -472,33 +488,88 @@ static void filter(struct vf_priv_s *p, uint8_t *dst, uint8_t *src,
         es=width+8-x0; //  8, ...
         if (es>8)
             row_fdct_s(block+8*8, p->src + y*stride+8+x0 +2-(y&1), stride, (es-4)>>2);
-        column_fidct_s((int16_t*)(&p->threshold_mtx[0]), block, block3, es&(~1));
-        row_idct_s(block3+0*8, p->temp + (y&15)*stride+x0+2-(y&1), stride, es>>2);
+        column_fidct_s((int16_t*)(&th->threshold_mtx[0]), block, block3, es&(~1));
+        row_idct_s(block3+0*8, temp + (y&15)*stride+x0+2-(y&1), stride, es>>2);
         {const int y1=y-8+step;//l5-7  l4-6
-            if (!(y1&7) && y1) {
-                if (y1&8) store_slice_s(dst + (y1-8)*dst_stride, p->temp+ 8 +8*stride,
+            if (!(y1&7) && y1 > 8*first) {
+                if (y1&8) store_slice_s(dst + (y1-8)*dst_stride, temp+ 8 +8*stride,
                                         dst_stride, stride, width, 8, 5-p->log2_count);
-                else store_slice2_s(dst + (y1-8)*dst_stride, p->temp+ 8 +0*stride,
+                else store_slice2_s(dst + (y1-8)*dst_stride, temp+ 8 +0*stride,
                                     dst_stride, stride, width, 8, 5-p->log2_count);
+            } else if (!(y1&7) && y1) {
+                // row of the previous band, only clear what its store would
+                if (y1&8) memset(temp,            0, 16*stride*sizeof(int16_t));
+                else      memset(temp+16*stride,  0,  8*stride*sizeof(int16_t));
             } }
     }
 
-    if (y&7) {  // == height & 7
-        if (y&8) store_slice_s(dst + ((y-8)&~7)*dst_stride, p->temp+ 8 +8*stride,
+    if (y >= height+8 && (y&7)) {  // == height & 7
+        if (y&8) store_slice_s(dst + ((y-8)&~7)*dst_stride, temp+ 8 +8*stride,
                                dst_stride, stride, width, y&7, 5-p->log2_count);
-        else store_slice2_s(dst + ((y-8)&~7)*dst_stride, p->temp+ 8 +0*stride,
+        else store_slice2_s(dst + ((y-8)&~7)*dst_stride, temp+ 8 +0*stride,
                             dst_stride, stride, width, y&7, 5-p->log2_count);
     }
+#if HAVE_MMX_INLINE
+    if(gCpuCaps.hasMMX) __asm__ volatile ("emms\n\t");
+#endif
+}
+
+static void filter(struct vf_priv_s *p, uint8_t *dst, uint8_t *src,
+                   int dst_stride, int src_stride,
+                   int width, int height,
+                   uint8_t *qp_store, int qp_stride, int is_luma)
+{
+    int x, y;
+    const int stride= is_luma ? p->temp_stride : (width+16);//((width+16+15)&(~15))
+    struct filter_job job;
+
+    //p->src=src-src_stride*8-8;//!
+    if (!src || !dst) return; // HACK avoid crash for Y8 colourspace
+    for(y=0; y<height; y++){
+        int index= 8 + 8*stride + y*stride;
+        fast_memcpy(p->src + index, src + y*src_stride, width);//this line can be avoided by using DR & user fr.buffers
+        for(x=0; x<8; x++){
+            p->src[index         - x - 1]= p->src[index +         x    ];
+            p->src[index + width + x    ]= p->src[index + width - x - 1];
+        }
+    }
+    for(y=0; y<8; y++){
+        fast_memcpy(p->src + (      7-y)*stride, p->src + (      y+8)*stride, stride);
+        fast_memcpy(p->src + (height+8+y)*stride, p->src + (height-y+7)*stride, stride);
+    }
+    //FIXME (try edge emu)
+
+    job.p= p;
+    job.dst= dst;
+    job.dst_stride= dst_stride;
+    job.stride= stride;
+    job.width= width;
+    job.height= height;
+    job.qp_store= qp_store;
+    job.qp_stride= qp_stride;
+    job.is_luma= is_luma;
+    job.nrows= (height+7)>>3;
+    // the lead-in of 2 rows is wasted work, keep the bands large
+    job.nbands= FFMIN(p->nthreads, job.nrows>>3);
+    if (job.nbands < 1) job.nbands= 1;
+    vf_threads_execute(filter_band, &job, job.nbands);
 }
 
 static int config(struct vf_instance *vf,
                   int width, int height, int d_width, int d_height,
                   unsigned int flags, unsigned int outfmt)
 {
-    int h= (height+16+15)&(~15);
+    int i, h= (height+16+15)&(~15);
 
     vf->priv->temp_stride= (width+16+15)&(~15);
-    vf->priv->temp= (int16_t*)av_mallocz(vf->priv->temp_stride*3*8*sizeof(int16_t));
+    vf->priv->nthreads= vf_threads_count();
+    for(i=0; i<vf->priv->nthreads; i++){
+        struct fspp_thread *t= av_mallocz(sizeof(struct fspp_thread));//assumes align 16 !
+        memcpy(t->threshold_mtx_noq, vf->priv->threshold_mtx_noq, sizeof(t->threshold_mtx_noq));
+        if (vf->priv->qp) t->prev_q=vf->priv->qp, mul_thrmat_s(t, vf->priv->qp);
+        t->temp= (int16_t*)av_mallocz(vf->priv->temp_stride*3*8*sizeof(int16_t));
+        vf->priv->thread[i]= t;
+    }
     //this can also be avoided, see above
     vf->priv->src = (uint8_t*)av_malloc(vf->priv->temp_stride*h*sizeof(uint8_t));
 
@@ -579,10 +650,13 @@ static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts)
 
 static void uninit(struct vf_instance *vf)
 {
+    int i;
     if(!vf->priv) return;
 
-    av_free(vf->priv->temp);
-    vf->priv->temp= NULL;
+    for(i=0; i<vf->priv->nthreads; i++){
+        av_free(vf->priv->thread[i]->temp);
+        av_freep(&vf->priv->thread[i]);
+    }
     av_free(vf->priv->src);
     vf->priv->src= NULL;
     //free(vf->priv->avctx);
@@ -664,7 +738,6 @@ static int vf_open(vf_instance_t *vf, char *args)
     if (i > 32) i = 32;
 
     bias= (1<<4)+i; //regulable
-    vf->priv->prev_q=0;
     //
     for(i=0;i<64;i++) //FIXME: tune custom_threshold[] and remove this !
         custom_threshold_m[i]=(int)(custom_threshold[i]*(bias/71.)+ 0.5);
@@ -679,8 +752,6 @@ static int vf_open(vf_instance_t *vf, char *args)
             |(((uint64_t)custom_threshold_m[i*8+7])<<48);
     }
 
-    if (vf->priv->qp) vf->priv->prev_q=vf->priv->qp, mul_thrmat_s(vf->priv, vf->priv->qp);
-
     return 1;
 }
 
@@ -27,7 +27,10 @@
 #include "mp_msg.h"
 #include "img_format.h"
 #include "mp_image.h"
+#include "cpudetect.h"
 #include "vf.h"
+#include "vf_threads.h"
+#include "hqdn3d.h"
 
 #define PARAM1_DEFAULT 4.0
 #define PARAM2_DEFAULT 3.0
@@ -38,7 +41,10 @@
 struct vf_priv_s {
         int Coefs[4][512*16];
         unsigned int *Line;
+        unsigned int *Horiz; // horizontally filtered line, whole plane if threaded
         unsigned short *Frame[3];
+        int threaded;
+        struct hqdn3d_dsp dsp;
 };
 
 
@@ -47,11 +53,13 @@ struct vf_priv_s {
 static void uninit(struct vf_instance *vf)
 {
         free(vf->priv->Line);
+        free(vf->priv->Horiz);
         free(vf->priv->Frame[0]);
         free(vf->priv->Frame[1]);
         free(vf->priv->Frame[2]);
 
         vf->priv->Line     = NULL;
+        vf->priv->Horiz    = NULL;
         vf->priv->Frame[0] = NULL;
         vf->priv->Frame[1] = NULL;
         vf->priv->Frame[2] = NULL;
@@ -62,95 +70,118 @@ static int config(struct vf_instance *vf,
         unsigned int flags, unsigned int outfmt){
 
         uninit(vf);
+        vf->priv->threaded = vf_threads_count() > 1;
         vf->priv->Line = malloc(width*sizeof(int));
+        vf->priv->Horiz = malloc(width*(vf->priv->threaded ? height : 1)*sizeof(int));
 
         return vf_next_config(vf,width,height,d_width,d_height,flags,outfmt);
 }
 
-static inline unsigned int LowPassMul(unsigned int PrevMul, unsigned int CurrMul, int* Coef){
-//    int dMul= (PrevMul&0xFFFFFF)-(CurrMul&0xFFFFFF);
-    int dMul= PrevMul-CurrMul;
-    unsigned int d=((dMul+0x10007FF)>>12);
-    return CurrMul + Coef[d];
+static void deNoiseHorizontal(const unsigned char *Frame, unsigned int *Horiz,
+                              int W, int *Horizontal, int spatial_first_line)
+{
+    long X;
+    unsigned int PixelAnt = Horiz[0] = Frame[0]<<16;
+
+    /* The spatial only filter filters the whole first line against its
+     * first pixel. */
+    if (spatial_first_line){
+        for (X = 1; X < W; X++)
+            Horiz[X] = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
+        return;
+    }
+    for (X = 1; X < W; X++)
+        Horiz[X] = PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
 }
 
-static void deNoiseTemporal(
-                    unsigned char *Frame,        // mpi->planes[x]
-                    unsigned char *FrameDest,    // dmpi->planes[x]
-                    unsigned short *FrameAnt,
-                    int W, int H, int sStride, int dStride,
-                    int *Temporal)
+/* First line has no top neighbor, LineAnt holds its horizontal result. */
+static void deNoiseFirstLine(const unsigned int *LineAnt, unsigned short *FrameAnt,
+                             unsigned char *FrameDest, int W, int *Temporal)
 {
-    long X, Y;
+    long X;
     unsigned int PixelDst;
 
-    for (Y = 0; Y < H; Y++){
-        for (X = 0; X < W; X++){
-            PixelDst = LowPassMul(FrameAnt[X]<<8, Frame[X]<<16, Temporal);
+    for (X = 0; X < W; X++){
+        PixelDst = LineAnt[X];
+        if (Temporal){
+            PixelDst = LowPassMul(FrameAnt[X]<<8, PixelDst, Temporal);
             FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
-            FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
         }
-        Frame += sStride;
-        FrameDest += dStride;
-        FrameAnt += W;
+        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
     }
 }
 
-static void deNoiseSpacial(
-                    unsigned char *Frame,        // mpi->planes[x]
-                    unsigned char *FrameDest,    // dmpi->planes[x]
-                    unsigned int *LineAnt,       // vf->priv->Line (width bytes)
-                    int W, int H, int sStride, int dStride,
-                    int *Horizontal, int *Vertical)
+/*
+ * The horizontal pass is independent per row and the vertical and temporal
+ * passes are independent per column, so in threaded mode the plane is
+ * first filtered horizontally in row bands into Horiz and then vertically
+ * in column strips, each strip owning its part of LineAnt. The arithmetic
+ * is exactly that of the single threaded code.
+ */
+struct denoise_plane {
+    const struct hqdn3d_dsp *dsp;
+    unsigned char *Frame, *FrameDest;
+    unsigned int *LineAnt, *Horiz;
+    unsigned short *FrameAnt;
+    int W, H, sStride, dStride;
+    int *Horizontal, *Vertical, *Temporal;
+};
+
+static void deNoiseTemporal_band(void *ctx, int warm_y, int y0, int y1, int thread)
 {
-    long X, Y;
-    long sLineOffs = 0, dLineOffs = 0;
-    unsigned int PixelAnt;
-    unsigned int PixelDst;
+    struct denoise_plane *p = ctx;
+    long Y;
 
-    /* First pixel has no left nor top neighbor. */
-    PixelDst = LineAnt[0] = PixelAnt = Frame[0]<<16;
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+    for (Y = y0; Y < y1; Y++)
+        p->dsp->temporal(p->Frame + Y*p->sStride, p->FrameAnt + Y*p->W,
+                         p->FrameDest + Y*p->dStride, p->W, p->Temporal);
+}
 
-    /* First line has no top neighbor, only left. */
-    for (X = 1; X < W; X++){
-        PixelDst = LineAnt[X] = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
-    }
+static void deNoiseHorizontal_band(void *ctx, int warm_y, int y0, int y1, int thread)
+{
+    struct denoise_plane *p = ctx;
+    long Y;
 
-    for (Y = 1; Y < H; Y++){
-        unsigned int PixelAnt;
-        sLineOffs += sStride, dLineOffs += dStride;
-        /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        PixelDst = LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
-
-        for (X = 1; X < W; X++){
-            unsigned int PixelDst;
-            /* The rest are normal */
-            PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
-            PixelDst = LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
-            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
-        }
-    }
+    for (Y = y0; Y < y1; Y++)
+        deNoiseHorizontal(p->Frame + Y*p->sStride, p->Horiz + Y*p->W, p->W,
+                          p->Horizontal, Y == 0 && !p->Temporal);
+}
+
+static void deNoiseVertical_band(void *ctx, int warm_x, int x0, int x1, int thread)
+{
+    struct denoise_plane *p = ctx;
+    long Y;
+
+    memcpy(p->LineAnt + x0, p->Horiz + x0, (x1 - x0)*sizeof(int));
+    deNoiseFirstLine(p->LineAnt + x0, p->FrameAnt + x0, p->FrameDest + x0,
+                     x1 - x0, p->Temporal);
+    for (Y = 1; Y < p->H; Y++)
+        p->dsp->vertical(p->LineAnt + x0, p->Horiz + Y*p->W + x0,
+                         p->FrameAnt + Y*p->W + x0,
+                         p->FrameDest + Y*p->dStride + x0,
+                         x1 - x0, p->Vertical, p->Temporal);
 }
 
-static void deNoise(unsigned char *Frame,        // mpi->planes[x]
+static void deNoise(const struct hqdn3d_dsp *dsp,
+                    unsigned char *Frame,        // mpi->planes[x]
                     unsigned char *FrameDest,    // dmpi->planes[x]
-                    unsigned int *LineAnt,      // vf->priv->Line (width bytes)
+                    unsigned int *LineAnt,      // vf->priv->Line (width ints)
+                    unsigned int *Horiz,        // vf->priv->Horiz (width ints, width*height if threaded)
+                    int threaded,
                     unsigned short **FrameAntPtr,
                     int W, int H, int sStride, int dStride,
                     int *Horizontal, int *Vertical, int *Temporal)
 {
     long X, Y;
-    long sLineOffs = 0, dLineOffs = 0;
-    unsigned int PixelAnt;
-    unsigned int PixelDst;
     unsigned short* FrameAnt=(*FrameAntPtr);
+    struct denoise_plane p = {
+        dsp, Frame, FrameDest, LineAnt, Horiz, FrameAnt,
+        W, H, sStride, dStride, Horizontal, Vertical,
+        Temporal[0] ? Temporal : NULL
+    };
 
     if(!FrameAnt){
-        (*FrameAntPtr)=FrameAnt=malloc(W*H*sizeof(unsigned short));
+        (*FrameAntPtr)=p.FrameAnt=FrameAnt=malloc(W*H*sizeof(unsigned short));
         for (Y = 0; Y < H; Y++){
             unsigned short* dst=&FrameAnt[Y*W];
             unsigned char* src=Frame+Y*sStride;
@@ -159,51 +190,25 @@ static void deNoise(unsigned char *Frame,        // mpi->planes[x]
     }
 
     if(!Horizontal[0] && !Vertical[0]){
-        deNoiseTemporal(Frame, FrameDest, FrameAnt,
-                        W, H, sStride, dStride, Temporal);
+        p.Temporal = Temporal;
+        if (threaded)
+            vf_run_bands(deNoiseTemporal_band, &p, H, 0, 1);
+        else
+            deNoiseTemporal_band(&p, 0, 0, H, 0);
         return;
     }
-    if(!Temporal[0]){
-        deNoiseSpacial(Frame, FrameDest, LineAnt,
-                       W, H, sStride, dStride, Horizontal, Vertical);
+    if (threaded){
+        vf_run_bands(deNoiseHorizontal_band, &p, H, 0, 1);
+        vf_run_bands(deNoiseVertical_band, &p, W, 0, 16);
         return;
     }
 
-    /* First pixel has no left nor top neighbor. Only previous frame */
-    LineAnt[0] = PixelAnt = Frame[0]<<16;
-    PixelDst = LowPassMul(FrameAnt[0]<<8, PixelAnt, Temporal);
-    FrameAnt[0] = ((PixelDst+0x1000007F)>>8);
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
-
-    /* First line has no top neighbor. Only left one for each pixel and
-     * last frame */
-    for (X = 1; X < W; X++){
-        LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        PixelDst = LowPassMul(FrameAnt[X]<<8, PixelAnt, Temporal);
-        FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
-    }
-
+    deNoiseHorizontal(Frame, LineAnt, W, Horizontal, !p.Temporal);
+    deNoiseFirstLine(LineAnt, FrameAnt, FrameDest, W, p.Temporal);
     for (Y = 1; Y < H; Y++){
-        unsigned int PixelAnt;
-        unsigned short* LinePrev=&FrameAnt[Y*W];
-        sLineOffs += sStride, dLineOffs += dStride;
-        /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-        PixelDst = LowPassMul(LinePrev[0]<<8, LineAnt[0], Temporal);
-        LinePrev[0] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
-
-        for (X = 1; X < W; X++){
-            unsigned int PixelDst;
-            /* The rest are normal */
-            PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
-            LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
-            PixelDst = LowPassMul(LinePrev[X]<<8, LineAnt[X], Temporal);
-            LinePrev[X] = ((PixelDst+0x1000007F)>>8);
-            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
-        }
+        deNoiseHorizontal(Frame + Y*sStride, Horiz, W, Horizontal, 0);
+        dsp->vertical(LineAnt, Horiz, FrameAnt + Y*W, FrameDest + Y*dStride,
+                      W, Vertical, p.Temporal);
     }
 }
 
@@ -219,20 +224,23 @@ static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
 
         if(!dmpi) return 0;
 
-        deNoise(mpi->planes[0], dmpi->planes[0],
-                vf->priv->Line, &vf->priv->Frame[0], W, H,
+        deNoise(&vf->priv->dsp, mpi->planes[0], dmpi->planes[0],
+                vf->priv->Line, vf->priv->Horiz, vf->priv->threaded,
+                &vf->priv->Frame[0], W, H,
                 mpi->stride[0], dmpi->stride[0],
                 vf->priv->Coefs[0],
                 vf->priv->Coefs[0],
                 vf->priv->Coefs[1]);
-        deNoise(mpi->planes[1], dmpi->planes[1],
-                vf->priv->Line, &vf->priv->Frame[1], cw, ch,
+        deNoise(&vf->priv->dsp, mpi->planes[1], dmpi->planes[1],
+                vf->priv->Line, vf->priv->Horiz, vf->priv->threaded,
+                &vf->priv->Frame[1], cw, ch,
                 mpi->stride[1], dmpi->stride[1],
                 vf->priv->Coefs[2],
                 vf->priv->Coefs[2],
                 vf->priv->Coefs[3]);
-        deNoise(mpi->planes[2], dmpi->planes[2],
-                vf->priv->Line, &vf->priv->Frame[2], cw, ch,
+        deNoise(&vf->priv->dsp, mpi->planes[2], dmpi->planes[2],
+                vf->priv->Line, vf->priv->Horiz, vf->priv->threaded,
+                &vf->priv->Frame[2], cw, ch,
                 mpi->stride[2], dmpi->stride[2],
                 vf->priv->Coefs[2],
                 vf->priv->Coefs[2],
@@ -358,6 +366,10 @@ static int vf_open(vf_instance_t *vf, char *args){
         PrecalcCoefs(vf->priv->Coefs[2], ChromSpac);
         PrecalcCoefs(vf->priv->Coefs[3], ChromTmp);
 
+        hqdn3d_init_dsp(&vf->priv->dsp,
+                        (gCpuCaps.hasSSE2 ? HQDN3D_CPU_SSE2 : 0) |
+                        (gCpuCaps.hasAVX2 ? HQDN3D_CPU_AVX2 : 0));
+
         return 1;
 }
 
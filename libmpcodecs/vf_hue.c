@@ -76,6 +76,21 @@ static void (*process)(uint8_t *udst, uint8_t *vdst, uint8_t *usrc, uint8_t *vsr
 
 /* FIXME: add packed yuv version of process */
 
+struct hue_bands {
+        mp_image_t *dmpi, *mpi;
+        float hue, sat;
+};
+
+static void process_band(void *ctx, int warm_y, int y0, int y1, int thread)
+{
+        struct hue_bands *b = ctx;
+        int ds = b->dmpi->stride[1], ss = b->mpi->stride[1];
+        process(b->dmpi->planes[1] + y0 * ds, b->dmpi->planes[2] + y0 * ds,
+                b->mpi->planes[1] + y0 * ss, b->mpi->planes[2] + y0 * ss,
+                ds, ss, b->mpi->w >> b->mpi->chroma_x_shift, y1 - y0,
+                b->hue, b->sat);
+}
+
 static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts)
 {
         mp_image_t *dmpi;
@@ -98,13 +113,10 @@ static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts)
                 dmpi->planes[1] = mpi->planes[1];
                 dmpi->planes[2] = mpi->planes[2];
         }else {
+                struct hue_bands b = { dmpi, mpi, vf->priv->hue, vf->priv->saturation };
                 dmpi->planes[1] = vf->priv->buf[0];
                 dmpi->planes[2] = vf->priv->buf[1];
-                process(dmpi->planes[1], dmpi->planes[2],
-                        mpi->planes[1], mpi->planes[2],
-                        dmpi->stride[1],mpi->stride[1],
-                        mpi->w>> mpi->chroma_x_shift, mpi->h>> mpi->chroma_y_shift,
-                        vf->priv->hue, vf->priv->saturation);
+                vf_run_bands(process_band, &b, mpi->h >> mpi->chroma_y_shift, 0, 1);
         }
 
         return vf_next_put_image(vf,dmpi, pts);
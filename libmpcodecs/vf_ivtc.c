@@ -27,7 +27,7 @@
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
-#include "mpx86asm.h"
+#include "metrics.h"
 #include "libvo/fastmemcpy.h"
 
 
@@ -58,258 +58,56 @@ enum {
     F_SHOW
 };
 
-#if HAVE_MMX_INLINE && HAVE_EBX_AVAILABLE
-static void block_diffs_MMX(struct metrics *m, unsigned char *old, unsigned char *new, int os, int ns)
-{
-    int i;
-    short out[24]; // output buffer for the partial metrics from the mmx code
-
-    __asm__ (
-        "movl $4, %%ecx \n\t"
-        "pxor %%mm4, %%mm4 \n\t" // 4 even difference sums
-        "pxor %%mm5, %%mm5 \n\t" // 4 odd difference sums
-        "pxor %%mm7, %%mm7 \n\t" // all zeros
-
-        ASMALIGN(4)
-        "1: \n\t"
-
-        // Even difference
-        "movq (%%"REG_S"), %%mm0 \n\t"
-        "movq (%%"REG_S"), %%mm2 \n\t"
-        "add %%"REG_a", %%"REG_S" \n\t"
-        "movq (%%"REG_D"), %%mm1 \n\t"
-        "add %%"REG_b", %%"REG_D" \n\t"
-        "psubusb %%mm1, %%mm2 \n\t"
-        "psubusb %%mm0, %%mm1 \n\t"
-        "movq %%mm2, %%mm0 \n\t"
-        "movq %%mm1, %%mm3 \n\t"
-        "punpcklbw %%mm7, %%mm0 \n\t"
-        "punpcklbw %%mm7, %%mm1 \n\t"
-        "punpckhbw %%mm7, %%mm2 \n\t"
-        "punpckhbw %%mm7, %%mm3 \n\t"
-        "paddw %%mm0, %%mm4 \n\t"
-        "paddw %%mm1, %%mm4 \n\t"
-        "paddw %%mm2, %%mm4 \n\t"
-        "paddw %%mm3, %%mm4 \n\t"
-
-        // Odd difference
-        "movq (%%"REG_S"), %%mm0 \n\t"
-        "movq (%%"REG_S"), %%mm2 \n\t"
-        "add %%"REG_a", %%"REG_S" \n\t"
-        "movq (%%"REG_D"), %%mm1 \n\t"
-        "add %%"REG_b", %%"REG_D" \n\t"
-        "psubusb %%mm1, %%mm2 \n\t"
-        "psubusb %%mm0, %%mm1 \n\t"
-        "movq %%mm2, %%mm0 \n\t"
-        "movq %%mm1, %%mm3 \n\t"
-        "punpcklbw %%mm7, %%mm0 \n\t"
-        "punpcklbw %%mm7, %%mm1 \n\t"
-        "punpckhbw %%mm7, %%mm2 \n\t"
-        "punpckhbw %%mm7, %%mm3 \n\t"
-        "paddw %%mm0, %%mm5 \n\t"
-        "paddw %%mm1, %%mm5 \n\t"
-        "paddw %%mm2, %%mm5 \n\t"
-        "paddw %%mm3, %%mm5 \n\t"
-
-        "decl %%ecx \n\t"
-        "jnz 1b \n\t"
-        "movq %%mm4, (%%"REG_d") \n\t"
-        "movq %%mm5, 8(%%"REG_d") \n\t"
-        :
-        : "S" (old), "D" (new), "a" (os), "b" (ns), "d" (out)
-        : "memory"
-        );
-    m->e = out[0]+out[1]+out[2]+out[3];
-    m->o = out[4]+out[5]+out[6]+out[7];
-    m->d = m->e + m->o;
-
-    __asm__ (
-        // First loop to measure first four columns
-        "movl $4, %%ecx \n\t"
-        "pxor %%mm4, %%mm4 \n\t" // Past spacial noise
-        "pxor %%mm5, %%mm5 \n\t" // Temporal noise
-        "pxor %%mm6, %%mm6 \n\t" // Current spacial noise
-
-        ASMALIGN(4)
-        "2: \n\t"
-
-        "movq (%%"REG_S"), %%mm0 \n\t"
-        "movq (%%"REG_S",%%"REG_a"), %%mm1 \n\t"
-        "add %%"REG_a", %%"REG_S" \n\t"
-        "add %%"REG_a", %%"REG_S" \n\t"
-        "movq (%%"REG_D"), %%mm2 \n\t"
-        "movq (%%"REG_D",%%"REG_b"), %%mm3 \n\t"
-        "add %%"REG_b", %%"REG_D" \n\t"
-        "add %%"REG_b", %%"REG_D" \n\t"
-        "punpcklbw %%mm7, %%mm0 \n\t"
-        "punpcklbw %%mm7, %%mm1 \n\t"
-        "punpcklbw %%mm7, %%mm2 \n\t"
-        "punpcklbw %%mm7, %%mm3 \n\t"
-        "paddw %%mm1, %%mm4 \n\t"
-        "paddw %%mm1, %%mm5 \n\t"
-        "paddw %%mm3, %%mm6 \n\t"
-        "psubw %%mm0, %%mm4 \n\t"
-        "psubw %%mm2, %%mm5 \n\t"
-        "psubw %%mm2, %%mm6 \n\t"
-
-        "decl %%ecx \n\t"
-        "jnz 2b \n\t"
-
-        "movq %%mm0, %%mm1 \n\t"
-        "movq %%mm0, %%mm2 \n\t"
-        "movq %%mm0, %%mm3 \n\t"
-        "pcmpgtw %%mm4, %%mm1 \n\t"
-        "pcmpgtw %%mm5, %%mm2 \n\t"
-        "pcmpgtw %%mm6, %%mm3 \n\t"
-        "pxor %%mm1, %%mm4 \n\t"
-        "pxor %%mm2, %%mm5 \n\t"
-        "pxor %%mm3, %%mm6 \n\t"
-        "psubw %%mm1, %%mm4 \n\t"
-        "psubw %%mm2, %%mm5 \n\t"
-        "psubw %%mm3, %%mm6 \n\t"
-        "movq %%mm4, (%%"REG_d") \n\t"
-        "movq %%mm5, 16(%%"REG_d") \n\t"
-        "movq %%mm6, 32(%%"REG_d") \n\t"
-
-        "mov %%"REG_a", %%"REG_c" \n\t"
-        "shl $3, %%"REG_c" \n\t"
-        "sub %%"REG_c", %%"REG_S" \n\t"
-        "mov %%"REG_b", %%"REG_c" \n\t"
-        "shl $3, %%"REG_c" \n\t"
-        "sub %%"REG_c", %%"REG_D" \n\t"
-
-        // Second loop for the last four columns
-        "movl $4, %%ecx \n\t"
-        "pxor %%mm4, %%mm4 \n\t"
-        "pxor %%mm5, %%mm5 \n\t"
-        "pxor %%mm6, %%mm6 \n\t"
-
-        ASMALIGN(4)
-        "3: \n\t"
-
-        "movq (%%"REG_S"), %%mm0 \n\t"
-        "movq (%%"REG_S",%%"REG_a"), %%mm1 \n\t"
-        "add %%"REG_a", %%"REG_S" \n\t"
-        "add %%"REG_a", %%"REG_S" \n\t"
-        "movq (%%"REG_D"), %%mm2 \n\t"
-        "movq (%%"REG_D",%%"REG_b"), %%mm3 \n\t"
-        "add %%"REG_b", %%"REG_D" \n\t"
-        "add %%"REG_b", %%"REG_D" \n\t"
-        "punpckhbw %%mm7, %%mm0 \n\t"
-        "punpckhbw %%mm7, %%mm1 \n\t"
-        "punpckhbw %%mm7, %%mm2 \n\t"
-        "punpckhbw %%mm7, %%mm3 \n\t"
-        "paddw %%mm1, %%mm4 \n\t"
-        "paddw %%mm1, %%mm5 \n\t"
-        "paddw %%mm3, %%mm6 \n\t"
-        "psubw %%mm0, %%mm4 \n\t"
-        "psubw %%mm2, %%mm5 \n\t"
-        "psubw %%mm2, %%mm6 \n\t"
-
-        "decl %%ecx \n\t"
-        "jnz 3b \n\t"
-
-        "movq %%mm0, %%mm1 \n\t"
-        "movq %%mm0, %%mm2 \n\t"
-        "movq %%mm0, %%mm3 \n\t"
-        "pcmpgtw %%mm4, %%mm1 \n\t"
-        "pcmpgtw %%mm5, %%mm2 \n\t"
-        "pcmpgtw %%mm6, %%mm3 \n\t"
-        "pxor %%mm1, %%mm4 \n\t"
-        "pxor %%mm2, %%mm5 \n\t"
-        "pxor %%mm3, %%mm6 \n\t"
-        "psubw %%mm1, %%mm4 \n\t"
-        "psubw %%mm2, %%mm5 \n\t"
-        "psubw %%mm3, %%mm6 \n\t"
-        "movq %%mm4, 8(%%"REG_d") \n\t"
-        "movq %%mm5, 24(%%"REG_d") \n\t"
-        "movq %%mm6, 40(%%"REG_d") \n\t"
-
-        "emms \n\t"
-        :
-        : "S" (old), "D" (new), "a" ((long)os), "b" ((long)ns), "d" (out)
-        : "memory"
-        );
-    m->p = m->t = m->s = 0;
-    for (i=0; i<8; i++) {
-        m->p += out[i];
-        m->t += out[8+i];
-        m->s += out[16+i];
-    }
-    //printf("e=%d o=%d d=%d p=%d t=%d s=%d\n", m->e, m->o, m->d, m->p, m->t, m->s);
-}
-#endif
-
-//#define MAG(a) ((a)*(a))
-//#define MAG(a) (abs(a))
-#define MAG(a) (((a)^((a)>>31))-((a)>>31))
-
-//#define LOWPASS(s) (((s)[-2] + 4*(s)[-1] + 6*(s)[0] + 4*(s)[1] + (s)[2])>>4)
-//#define LOWPASS(s) (((s)[-1] + 2*(s)[0] + (s)[1])>>2)
-#define LOWPASS(s) ((s)[0])
-
-
-static void block_diffs_C(struct metrics *m, unsigned char *old, unsigned char *new, int os, int ns)
-{
-    int x, y, e=0, o=0, s=0, p=0, t=0;
-    unsigned char *oldp, *newp;
-    m->s = m->p = m->t = 0;
-    for (x = 8; x; x--) {
-        oldp = old++;
-        newp = new++;
-        s = p = t = 0;
-        for (y = 4; y; y--) {
-            e += MAG(newp[0]-oldp[0]);
-            o += MAG(newp[ns]-oldp[os]);
-            s += newp[ns]-newp[0];
-            p += oldp[os]-oldp[0];
-            t += oldp[os]-newp[0];
-            oldp += os<<1;
-            newp += ns<<1;
-        }
-        m->s += MAG(s);
-        m->p += MAG(p);
-        m->t += MAG(t);
-    }
-    m->e = e;
-    m->o = o;
-    m->d = e+o;
-}
-
-static void (*block_diffs)(struct metrics *, unsigned char *, unsigned char *, int, int);
+static struct metrics_dsp metrics;
+static int mmx_metrics;
 
 #define MAXUP(a,b) ((a) = ((a)>(b)) ? (a) : (b))
 
 static void diff_planes(struct frameinfo *fi,
     unsigned char *old, unsigned char *new, int w, int h, int os, int ns)
 {
-    int x, y;
+    int x, y, i, n;
+    struct field_diffs fd[64];
     struct metrics l;
     struct metrics *peak=&fi->p, *rel=&fi->r, *mean=&fi->m;
     memset(peak, 0, sizeof(struct metrics));
     memset(rel, 0, sizeof(struct metrics));
     memset(mean, 0, sizeof(struct metrics));
     for (y = 0; y < h-7; y += 8) {
-        for (x = 8; x < w-8-7; x += 8) {
-            block_diffs(&l, old+x+y*os, new+x+y*ns, os, ns);
-            mean->d += l.d;
-            mean->e += l.e;
-            mean->o += l.o;
-            mean->s += l.s;
-            mean->p += l.p;
-            mean->t += l.t;
-            MAXUP(peak->d, l.d);
-            MAXUP(peak->e, l.e);
-            MAXUP(peak->o, l.o);
-            MAXUP(peak->s, l.s);
-            MAXUP(peak->p, l.p);
-            MAXUP(peak->t, l.t);
-            MAXUP(rel->e, l.e-l.o);
-            MAXUP(rel->o, l.o-l.e);
-            MAXUP(rel->s, l.s-l.t);
-            MAXUP(rel->p, l.p-l.t);
-            MAXUP(rel->t, l.t-l.p);
-            MAXUP(rel->d, l.t-l.s); /* hack */
+        for (x = 8; x < w-8-7; x += 8*n) {
+            n = (w-8-x)/8;
+            if (n > 64) n = 64;
+            // the MMX variant reads the 8 lines below the block
+            if (mmx_metrics && y+15 < h)
+                metrics.field8_mmx(old+x+y*os, new+x+y*ns, os, ns, n, fd);
+            else
+                metrics.field8(old+x+y*os, new+x+y*ns, os, ns, n, fd);
+            for (i = 0; i < n; i++) {
+                l.e = fd[i].even;
+                l.o = fd[i].odd;
+                l.d = l.e + l.o;
+                l.s = fd[i].noise;
+                l.p = fd[i].past;
+                l.t = fd[i].temp;
+                mean->d += l.d;
+                mean->e += l.e;
+                mean->o += l.o;
+                mean->s += l.s;
+                mean->p += l.p;
+                mean->t += l.t;
+                MAXUP(peak->d, l.d);
+                MAXUP(peak->e, l.e);
+                MAXUP(peak->o, l.o);
+                MAXUP(peak->s, l.s);
+                MAXUP(peak->p, l.p);
+                MAXUP(peak->t, l.t);
+                MAXUP(rel->e, l.e-l.o);
+                MAXUP(rel->o, l.o-l.e);
+                MAXUP(rel->s, l.s-l.t);
+                MAXUP(rel->p, l.p-l.t);
+                MAXUP(rel->t, l.t-l.p);
+                MAXUP(rel->d, l.t-l.s); /* hack */
+            }
         }
     }
     x = (w/8-2)*(h/8);
@@ -533,9 +331,10 @@ static int vf_open(vf_instance_t *vf, char *args)
     p->drop = 0;
     p->first = 1;
     if (args) sscanf(args, "%d", &p->drop);
-    block_diffs = block_diffs_C;
+    metrics_init_dsp(&metrics, metrics_cpu_caps());
 #if HAVE_MMX_INLINE && HAVE_EBX_AVAILABLE
-    if(gCpuCaps.hasMMX) block_diffs = block_diffs_MMX;
+    // the metrics the MMX code of this filter used to produce
+    mmx_metrics = gCpuCaps.hasMMX;
 #endif
     return 1;
 }
@@ -51,30 +51,45 @@ static void buf_mpi_free(AVFilterBuffer *buf)
     av_free(buf);
 }
 
+static void buf_wrap_free(AVFilterBuffer *buf)
+{
+    av_free(buf);
+}
+
 static AVFilterBufferRef *mpi_to_bufref(mp_image_t *mpi, enum AVPixelFormat fmt,
-                                        AVRational sar)
+                                        AVRational sar,
+                                        void (*free_buf)(AVFilterBuffer *))
 {
     AVFilterBufferRef *buf;
     int perms = AV_PERM_READ;
+    int i;
 
     if ((mpi->flags & MP_IMGFLAG_ALLOCATED))
         perms |= AV_PERM_REUSE2;
     if (!(mpi->flags & MP_IMGFLAG_PRESERVE))
         perms |= AV_PERM_WRITE;
+    for (i = 0; i < MP_MAX_PLANES; i++)
+        if (mpi->stride[i] < 0)
+            perms |= AV_PERM_NEG_LINESIZES;
     buf = avfilter_get_video_buffer_ref_from_arrays(mpi->planes, mpi->stride,
                                                     perms,
                                                     mpi->w, mpi->h,
                                                     fmt);
+    if (!buf)
+        return NULL;
     buf->video->sample_aspect_ratio = sar;
     buf->buf->priv = mpi;
-    buf->buf->free = buf_mpi_free;
+    buf->buf->free = free_buf;
     return buf;
 }
 
 static void bufref_to_mpi(AVFilterBufferRef *ref, mp_image_t *mpi)
 {
-    memcpy(mpi->planes, ref->data, sizeof(ref->data));
-    memcpy(mpi->stride, ref->linesize, sizeof(ref->linesize));
+    int i;
+    for (i = 0; i < MP_MAX_PLANES; i++) {
+        mpi->planes[i] = ref->data[i];
+        mpi->stride[i] = ref->linesize[i];
+    }
 }
 
 struct mpsink_priv {
@@ -134,7 +149,8 @@ static AVFilterBufferRef *mpsink_get_video_buffer(AVFilterLink *link,
         vf->priv->in_mpi = NULL;
     }
     dmpi = vf_get_image(vf->next, vf->priv->out_imgfmt, type, flags, w, h);
-    return mpi_to_bufref(dmpi, vf->priv->out_pixfmt, vf->priv->out_sar);
+    return mpi_to_bufref(dmpi, vf->priv->out_pixfmt, vf->priv->out_sar,
+                         buf_mpi_free);
 }
 
 static void mpsink_end_frame(AVFilterLink *link)
@@ -145,6 +161,17 @@ static void mpsink_end_frame(AVFilterLink *link)
     mp_image_t *mpi = buf->buf->priv;
     double pts;
 
+    /* Unless the frame was rendered into an image of the next filter and
+     * covers all of it, export it from wherever it is, e.g. the input
+     * image passed through or a cropped part of a buffer of the graph. */
+    if (buf->buf->free != buf_mpi_free ||
+        memcmp(mpi->planes, buf->data, sizeof(mpi->planes)) ||
+        mpi->w != buf->video->w || mpi->h != buf->video->h) {
+        mpi = vf_get_image(vf->next, vf->priv->out_imgfmt, MP_IMGTYPE_EXPORT,
+                           0, buf->video->w, buf->video->h);
+        bufref_to_mpi(buf, mpi);
+    }
+
     pts = buf->pts == (int64_t)AV_NOPTS_VALUE ? MP_NOPTS_VALUE :
           buf->pts * av_q2d(link->time_base);
     mpi->pict_type = buf->video->pict_type;
@@ -303,14 +330,17 @@ static void get_image(struct vf_instance *vf, mp_image_t *mpi)
 static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts)
 {
     AVFilterBufferRef *buf;
-    mp_image_t *cmpi = NULL;
+    AVFilterBufferRef *wrapped = NULL;
 
     if (!(mpi->flags & MP_IMGFLAG_DIRECT)) {
-        cmpi = vf_get_image(vf, mpi->imgfmt, MP_IMGTYPE_TEMP,
-                            MP_IMGFLAG_PREFER_ALIGNED_STRIDE,
-                            mpi->w, mpi->h);
-        copy_mpi(cmpi, mpi);
-        buf = cmpi->priv;
+        /* Hand the image to the graph as it is. It is only valid during
+         * this call, so it does not get AV_PERM_PRESERVE: filters that keep
+         * frames around or need other permissions get a copy from lavfi. */
+        buf = wrapped = mpi_to_bufref(mpi, vf->priv->in_pixfmt,
+                                      vf->priv->in_sar, buf_wrap_free);
+        if (!buf)
+            return 0;
+        buf->perms &= ~AV_PERM_REUSE2;
     } else {
         buf = mpi->priv;
     }
@@ -325,6 +355,10 @@ static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts)
         if (avfilter_request_frame(vf->priv->out->inputs[0]))
             break;
     }
+    if (wrapped) {
+        vf->priv->in_buf = NULL;
+        avfilter_unref_buffer(wrapped);
+    }
     return 1;
 }
 
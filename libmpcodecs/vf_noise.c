@@ -61,6 +61,7 @@ typedef struct FilterParam{
         int shiftptr;
         int8_t *noise;
         int8_t *prev_shift[MAX_RES][3];
+        int shift[MAX_RES];
 }FilterParam;
 
 struct vf_priv_s {
@@ -273,6 +274,42 @@ static inline void lineNoiseAvg_C(uint8_t *dst, uint8_t *src, int len, int8_t **
 
 /***************************************************************************/
 
+struct noise_plane {
+        uint8_t *dst, *src;
+        int dstStride, srcStride, width;
+        FilterParam *fp;
+};
+
+static void noise_band(void *ctx, int warm_y, int y0, int y1, int thread){
+        struct noise_plane *p= ctx;
+        FilterParam *fp= p->fp;
+        uint8_t *dst= p->dst + y0*p->dstStride;
+        uint8_t *src= p->src + y0*p->srcStride;
+        int y;
+
+        for(y=y0; y<y1; y++)
+        {
+                if (fp->averaged) {
+                    lineNoiseAvg(dst, src, p->width, fp->prev_shift[y]);
+                    fp->prev_shift[y][fp->shiftptr] = fp->noise + fp->shift[y];
+                } else {
+                    lineNoise(dst, src, fp->noise, p->width, fp->shift[y]);
+                }
+                dst+= p->dstStride;
+                src+= p->srcStride;
+        }
+
+        // the caller's emms/sfence in put_image only covers its own thread
+        if(thread){
+#if HAVE_MMX_INLINE
+                if(gCpuCaps.hasMMX) __asm__ volatile ("emms\n\t");
+#endif
+#if HAVE_MMXEXT_INLINE
+                if(gCpuCaps.hasMMX2) __asm__ volatile ("sfence\n\t");
+#endif
+        }
+}
+
 static void noise(uint8_t *dst, uint8_t *src, int dstStride, int srcStride, int width, int height, FilterParam *fp){
         int8_t *noise= fp->noise;
         int y;
@@ -295,20 +332,20 @@ static void noise(uint8_t *dst, uint8_t *src, int dstStride, int srcStride, int
                 return;
         }
 
+        /* draw the shifts up front so the rand() sequence does not depend
+         * on how the rows get split between threads */
         for(y=0; y<height; y++)
         {
                 if(fp->temporal)        shift=  rand()&(MAX_SHIFT  -1);
                 else                        shift= nonTempRandShift[y];
 
                 if(fp->quality==0) shift&= ~7;
-                if (fp->averaged) {
-                    lineNoiseAvg(dst, src, width, fp->prev_shift[y]);
-                    fp->prev_shift[y][fp->shiftptr] = noise + shift;
-                } else {
-                    lineNoise(dst, src, noise, width, shift);
-                }
-                dst+= dstStride;
-                src+= srcStride;
+                fp->shift[y]= shift;
+        }
+
+        {
+                struct noise_plane p= { dst, src, dstStride, srcStride, width, fp };
+                vf_run_bands(noise_band, &p, height, 0, 1);
         }
         fp->shiftptr++;
         if (fp->shiftptr == 3) fp->shiftptr = 0;
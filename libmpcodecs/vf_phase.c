@@ -27,6 +27,7 @@
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "metrics.h"
 
 #include "libvo/fastmemcpy.h"
 
@@ -68,16 +69,18 @@ static void do_plane(unsigned char *to, unsigned char *from,
       }
    }
 
+static struct metrics_dsp metrics;
+
 /*
  * This macro interpolates the value of both fields at a point halfway
- * between lines and takes the squared difference. In field resolution
- * the point is a quarter pixel below a line in one field and a quarter
- * pixel above a line in other.
+ * between lines and takes the squared difference summed over the line.
+ * In field resolution the point is a quarter pixel below a line in one
+ * field and a quarter pixel above a line in other.
  *
  * (the result is actually multiplied by 25)
  */
 
-#define diff(a, as, b, bs) (t=((*a-b[bs])<<2)+a[as<<1]-b[-bs], t*t)
+#define diff(a, as, b, bs) metrics.interp_ssd(a, as, b, bs, w)
 
 /*
  * Find which field combination has the smallest average squared difference
@@ -90,8 +93,8 @@ static enum mode analyze_plane(unsigned char *old, unsigned char *new,
    {
    double bdiff, pdiff, tdiff, scale;
    int bdif, tdif, pdif;
-   int top, t;
-   unsigned char *end, *rend;
+   int top;
+   unsigned char *end;
 
    if(mode==AUTO)
       mode=fields&MP_IMGFIELD_ORDERED?fields&MP_IMGFIELD_TOP_FIRST?
@@ -107,56 +110,31 @@ static enum mode analyze_plane(unsigned char *old, unsigned char *new,
       bdiff=pdiff=tdiff=0.0;
 
       for(end=new+(h-2)*ns, new+=ns, old+=os, top=0;
-          new<end; new+=ns-w, old+=os-w, top^=1)
+          new<end; new+=ns, old+=os, top^=1)
          {
          pdif=tdif=bdif=0;
 
          switch(mode)
             {
             case TOP_FIRST_ANALYZE:
-               if(top)
-                  for(rend=new+w; new<rend; new++, old++)
-                     pdif+=diff(new, ns, new, ns),
-                     tdif+=diff(new, ns, old, os);
-               else
-                  for(rend=new+w; new<rend; new++, old++)
-                     pdif+=diff(new, ns, new, ns),
-                     tdif+=diff(old, os, new, ns);
+               pdif=diff(new, ns, new, ns);
+               tdif=top?diff(new, ns, old, os):diff(old, os, new, ns);
                break;
 
             case BOTTOM_FIRST_ANALYZE:
-               if(top)
-                  for(rend=new+w; new<rend; new++, old++)
-                     pdif+=diff(new, ns, new, ns),
-                     bdif+=diff(old, os, new, ns);
-               else
-                  for(rend=new+w; new<rend; new++, old++)
-                     pdif+=diff(new, ns, new, ns),
-                     bdif+=diff(new, ns, old, os);
+               pdif=diff(new, ns, new, ns);
+               bdif=top?diff(old, os, new, ns):diff(new, ns, old, os);
                break;
 
             case ANALYZE:
-               if(top)
-                  for(rend=new+w; new<rend; new++, old++)
-                     tdif+=diff(new, ns, old, os),
-                     bdif+=diff(old, os, new, ns);
-               else
-                  for(rend=new+w; new<rend; new++, old++)
-                     bdif+=diff(new, ns, old, os),
-                     tdif+=diff(old, os, new, ns);
+               tdif=top?diff(new, ns, old, os):diff(old, os, new, ns);
+               bdif=top?diff(old, os, new, ns):diff(new, ns, old, os);
                break;
 
             default: /* FULL_ANALYZE */
-               if(top)
-                  for(rend=new+w; new<rend; new++, old++)
-                     pdif+=diff(new, ns, new, ns),
-                     tdif+=diff(new, ns, old, os),
-                     bdif+=diff(old, os, new, ns);
-               else
-                  for(rend=new+w; new<rend; new++, old++)
-                     pdif+=diff(new, ns, new, ns),
-                     bdif+=diff(new, ns, old, os),
-                     tdif+=diff(old, os, new, ns);
+               pdif=diff(new, ns, new, ns);
+               tdif=top?diff(new, ns, old, os):diff(old, os, new, ns);
+               bdif=top?diff(old, os, new, ns):diff(new, ns, old, os);
             }
 
          pdiff+=(double)pdif;
@@ -264,6 +242,7 @@ static int vf_open(vf_instance_t *vf, char *args)
 
    vf->priv->mode=AUTO_ANALYZE;
    vf->priv->verbose=0;
+   metrics_init_dsp(&metrics, metrics_cpu_caps());
 
    while(args && *args)
       {
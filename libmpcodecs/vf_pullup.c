@@ -69,6 +69,7 @@ static void init_pullup(struct vf_instance *vf, mp_image_t *mpi)
     if (gCpuCaps.has3DNowExt) c->cpu |= PULLUP_CPU_3DNOWEXT;
     if (gCpuCaps.hasSSE) c->cpu |= PULLUP_CPU_SSE;
     if (gCpuCaps.hasSSE2) c->cpu |= PULLUP_CPU_SSE2;
+    if (gCpuCaps.hasAVX2) c->cpu |= PULLUP_CPU_AVX2;
 
     pullup_init_context(c);
 
@@ -173,19 +173,21 @@ static void uninit(struct vf_instance *vf){
     vf->priv=NULL;
 }
 
-static inline void blur(uint8_t *dst, uint8_t *src, int w, int h, int dstStride, int srcStride, FilterParam *fp){
+struct sab_plane {
+    uint8_t *dst, *src;
+    int w, h, dstStride, srcStride;
+    FilterParam *fp;
+};
+
+static void blur_band(void *ctx, int warm_y, int y0, int y1, int thread){
+    struct sab_plane *p= ctx;
+    uint8_t *dst= p->dst, *src= p->src;
+    const int w= p->w, h= p->h, dstStride= p->dstStride, srcStride= p->srcStride;
     int x, y;
-    FilterParam f= *fp;
+    FilterParam f= *p->fp;
     const int radius= f.distWidth/2;
-    const uint8_t* const srcArray[MP_MAX_PLANES] = {src};
-    uint8_t *dstArray[MP_MAX_PLANES]= {f.preFilterBuf};
-    int srcStrideArray[MP_MAX_PLANES]= {srcStride};
-    int dstStrideArray[MP_MAX_PLANES]= {f.preFilterStride};
 
-//    f.preFilterContext->swScale(f.preFilterContext, srcArray, srcStrideArray, 0, h, dstArray, dstStrideArray);
-    sws_scale(f.preFilterContext, srcArray, srcStrideArray, 0, h, dstArray, dstStrideArray);
-
-    for(y=0; y<h; y++){
+    for(y=y0; y<y1; y++){
         for(x=0; x<w; x++){
             int sum=0;
             int div=0;
@@ -241,6 +243,20 @@ if((x/32)&1){
     }
 }
 
+static void blur(uint8_t *dst, uint8_t *src, int w, int h, int dstStride, int srcStride, FilterParam *fp){
+    struct sab_plane p= { dst, src, w, h, dstStride, srcStride, fp };
+    const uint8_t* const srcArray[MP_MAX_PLANES] = {src};
+    uint8_t *dstArray[MP_MAX_PLANES]= {fp->preFilterBuf};
+    int srcStrideArray[MP_MAX_PLANES]= {srcStride};
+    int dstStrideArray[MP_MAX_PLANES]= {fp->preFilterStride};
+
+//    f.preFilterContext->swScale(f.preFilterContext, srcArray, srcStrideArray, 0, h, dstArray, dstStrideArray);
+    sws_scale(fp->preFilterContext, srcArray, srcStrideArray, 0, h, dstArray, dstStrideArray);
+
+    // the prefiltered plane is complete, the weighting only reads it
+    vf_run_bands(blur_band, &p, h, 0, 1);
+}
+
 static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
     int cw= mpi->w >> mpi->chroma_x_shift;
     int ch= mpi->h >> mpi->chroma_y_shift;
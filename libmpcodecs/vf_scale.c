@@ -29,15 +29,49 @@
 #include "mp_image.h"
 #include "vd.h"
 #include "vf.h"
+#include "vf_threads.h"
 #include "fmt-conversion.h"
 #include "mpbswap.h"
+#include "libvo/fastmemcpy.h"
 
+#include "libavutil/mathematics.h"
 #include "libswscale/swscale.h"
 #include "vf_scale.h"
 
 #include "m_option.h"
 #include "m_struct.h"
 
+#define SCALE_CACHE_SIZE 4
+
+/// everything that goes into sws_getContext()
+struct scale_key {
+    int src_w, src_h, dst_w, dst_h;
+    enum AVPixelFormat sfmt, dfmt;
+    int flags;
+    int interlaced;
+    double param[2];
+    float lum_gblur, chr_gblur, lum_sharpen, chr_sharpen;
+    int chr_hshift, chr_vshift;
+};
+
+/// one horizontal band of the output in slice-parallel mode
+struct scale_slice {
+    struct SwsContext *ctx;
+    mp_image_t *tmp;        ///< output of the window, band rows get copied out
+    int src_y;              ///< first source row of the window
+    int tmp_y;              ///< first output row of the window
+    int y0, y1;             ///< output rows owned by this band
+};
+
+struct scale_cache {
+    struct scale_key key;
+    struct SwsContext *ctx;
+    struct SwsContext *ctx2; //for interlaced slices only
+    int nslices;
+    struct scale_slice slice[VF_MAX_THREADS];
+    unsigned last_use;
+};
+
 static struct vf_priv_s {
     int w,h;
     int v_chr_drop;
@@ -49,6 +83,11 @@ static struct vf_priv_s {
     int interlaced;
     int noup;
     int accurate_rnd;
+    struct scale_cache cache[SCALE_CACHE_SIZE];
+    struct scale_cache *cur;
+    unsigned use_count;
+    int eq_set;
+    int brightness, contrast, saturation;
 } const vf_priv_dflt = {
   -1,-1,
   0,
@@ -210,6 +249,153 @@ static unsigned int find_best_out(vf_instance_t *vf, int in_format){
     return best;
 }
 
+//===========================================================================//
+// SwsContext cache and slice-parallel scaling
+
+static void set_equalizer(struct SwsContext *ctx, int brightness, int contrast, int saturation)
+{
+    int *table, *inv_table;
+    int srcRange, dstRange, b, c, s;
+    if (ctx && sws_getColorspaceDetails(ctx, &inv_table, &srcRange, &table, &dstRange, &b, &c, &s) >= 0)
+        sws_setColorspaceDetails(ctx, inv_table, srcRange, table, dstRange, brightness, contrast, saturation);
+}
+
+static void cache_set_equalizer(struct vf_priv_s *priv, struct scale_cache *c)
+{
+    int i;
+    if (!priv->eq_set)
+        return;
+    set_equalizer(c->ctx,  priv->brightness, priv->contrast, priv->saturation);
+    set_equalizer(c->ctx2, priv->brightness, priv->contrast, priv->saturation);
+    for (i = 0; i < c->nslices; i++)
+        set_equalizer(c->slice[i].ctx, priv->brightness, priv->contrast, priv->saturation);
+}
+
+static void cache_free_entry(struct vf_instance *vf, struct scale_cache *c)
+{
+    int i;
+    if (c->ctx) sws_freeContext(c->ctx);
+    if (c->ctx2) sws_freeContext(c->ctx2);
+    for (i = 0; i < c->nslices; i++) {
+        sws_freeContext(c->slice[i].ctx);
+        vf_free_mpi(vf, c->slice[i].tmp);
+    }
+    memset(c, 0, sizeof(*c));
+}
+
+/**
+ * \brief split the output into bands scaled by separate contexts
+ *
+ * Every band scales a window of whole filter periods (rows where source
+ * and destination grids line up) extended by enough rows for the vertical
+ * filter, so all windows keep the scale ratio and the band edges only see
+ * interior filter taps. The output is not bit-identical to a single
+ * context: the fixed-point filter positions and the dithering start over in
+ * every window, which may round some rows slightly differently. Gives up
+ * for sizes without such a period small enough to make splitting
+ * worthwhile.
+ */
+static void cache_init_slices(struct vf_instance *vf, struct scale_cache *c,
+                              unsigned int dst_imgfmt,
+                              SwsFilter *srcFilter, SwsFilter *dstFilter)
+{
+    const struct scale_key *k = &c->key;
+    int n = vf_threads_count();
+    int g, unit_s, unit_d, units, pad, i;
+
+    if (n < 2 || k->interlaced)
+        return;
+    // keep windows aligned to the coarsest (4:1) chroma subsampling
+    g = av_gcd(k->src_h, k->dst_h);
+    if (g % 4)
+        return;
+    unit_s = k->src_h / g * 4;
+    unit_d = k->dst_h / g * 4;
+    units  = g / 4;
+    // filter reach in source rows, generous for the widest kernels
+    pad = 24 * FFMAX(1, (k->src_h + k->dst_h - 1) / k->dst_h) + 16;
+    pad = (pad + unit_s - 1) / unit_s;
+    // not worth it unless each band is clearly less work than the frame
+    if (units < 2 * n || units / n + 2 * pad >= units * 3 / 4)
+        return;
+
+    for (i = 0; i < n; i++) {
+        struct scale_slice *sl = &c->slice[i];
+        int u0 = units * i / n, u1 = units * (i + 1) / n;
+        int w0 = FFMAX(u0 - pad, 0), w1 = FFMIN(u1 + pad, units);
+        sl->ctx = sws_getContext(k->src_w, (w1 - w0) * unit_s, k->sfmt,
+                                 k->dst_w, (w1 - w0) * unit_d, k->dfmt,
+                                 k->flags, srcFilter, dstFilter, k->param);
+        sl->tmp = sl->ctx ? vf_alloc_mpi(vf, k->dst_w, (w1 - w0) * unit_d, dst_imgfmt) : NULL;
+        c->nslices = i + 1;
+        if (!sl->tmp || !sl->tmp->planes[0]) {
+            mp_msg(MSGT_VFILTER, MSGL_WARN, "SwScale: could not set up slice threading\n");
+            while (c->nslices) {
+                sl = &c->slice[--c->nslices];
+                if (sl->ctx) sws_freeContext(sl->ctx);
+                vf_free_mpi(vf, sl->tmp);
+                memset(sl, 0, sizeof(*sl));
+            }
+            return;
+        }
+        sl->src_y = w0 * unit_s;
+        sl->tmp_y = w0 * unit_d;
+        sl->y0    = u0 * unit_d;
+        sl->y1    = u1 * unit_d;
+    }
+    mp_msg(MSGT_VFILTER, MSGL_V, "SwScale: scaling in %d slices\n", c->nslices);
+}
+
+/**
+ * \brief return the cached contexts for key, creating them if needed
+ *
+ * Keeps the SCALE_CACHE_SIZE most recently used setups so that switching
+ * back and forth between known geometries does not rebuild the filters.
+ */
+static struct scale_cache *cache_get(struct vf_instance *vf, const struct scale_key *key,
+                                     int flags, unsigned int dst_imgfmt,
+                                     SwsFilter *srcFilter, SwsFilter *dstFilter)
+{
+    struct vf_priv_s *priv = vf->priv;
+    struct scale_cache *c = NULL;
+    int i;
+
+    for (i = 0; i < SCALE_CACHE_SIZE; i++)
+        if (priv->cache[i].ctx && !memcmp(&priv->cache[i].key, key, sizeof(*key))) {
+            c = &priv->cache[i];
+            mp_msg(MSGT_VFILTER, MSGL_V, "SwScale: reusing cached context\n");
+            break;
+        }
+
+    if (!c) {
+        // take a free entry or evict the least recently used one
+        c = &priv->cache[0];
+        for (i = 1; i < SCALE_CACHE_SIZE && c->ctx; i++)
+            if (!priv->cache[i].ctx || priv->cache[i].last_use < c->last_use)
+                c = &priv->cache[i];
+        cache_free_entry(vf, c);
+        c->key = *key;
+        c->ctx = sws_getContext(key->src_w, key->src_h >> key->interlaced, key->sfmt,
+                                key->dst_w, key->dst_h >> key->interlaced, key->dfmt,
+                                flags, srcFilter, dstFilter, key->param);
+        if (!c->ctx)
+            return NULL;
+        if (key->interlaced)
+            c->ctx2 = sws_getContext(key->src_w, key->src_h >> 1, key->sfmt,
+                                     key->dst_w, key->dst_h >> 1, key->dfmt,
+                                     flags, srcFilter, dstFilter, key->param);
+        cache_init_slices(vf, c, dst_imgfmt, srcFilter, dstFilter);
+    }
+
+    cache_set_equalizer(priv, c);
+    c->last_use = ++priv->use_count;
+    return c;
+}
+
+static void start_slice(struct vf_instance *vf, mp_image_t *mpi);
+static void draw_slice(struct vf_instance *vf,
+        unsigned char** src, int* stride, int w,int h, int x, int y);
+
 static int config(struct vf_instance *vf,
         int width, int height, int d_width, int d_height,
         unsigned int flags, unsigned int outfmt){
@@ -220,6 +406,7 @@ static int config(struct vf_instance *vf,
     int i;
     SwsFilter *srcFilter, *dstFilter;
     enum AVPixelFormat dfmt, sfmt;
+    struct scale_key key;
 
     if(!best){
         mp_msg(MSGT_VFILTER,MSGL_WARN,"SwScale: no supported outfmt found :(\n");
@@ -320,32 +507,40 @@ static int config(struct vf_instance *vf,
         width,height,vo_format_name(outfmt),
         vf->priv->w,vf->priv->h,vo_format_name(best));
 
-    // free old ctx:
-    if(vf->priv->ctx) sws_freeContext(vf->priv->ctx);
-    if(vf->priv->ctx2)sws_freeContext(vf->priv->ctx2);
-
-    // new swscaler:
+    // new swscaler, or a cached one for the same setup:
     sws_getFlagsAndFilterFromCmdLine(&int_sws_flags, &srcFilter, &dstFilter);
     int_sws_flags|= vf->priv->v_chr_drop << SWS_SRC_V_CHR_DROP_SHIFT;
     int_sws_flags|= vf->priv->accurate_rnd * SWS_ACCURATE_RND;
-    vf->priv->ctx=sws_getContext(width, height >> vf->priv->interlaced,
-            sfmt,
-                  vf->priv->w, vf->priv->h >> vf->priv->interlaced,
-            dfmt,
-            int_sws_flags, srcFilter, dstFilter, vf->priv->param);
-    if(vf->priv->interlaced){
-        vf->priv->ctx2=sws_getContext(width, height >> 1,
-            sfmt,
-                  vf->priv->w, vf->priv->h >> 1,
-            dfmt,
-            int_sws_flags, srcFilter, dstFilter, vf->priv->param);
-    }
+    memset(&key, 0, sizeof(key));
+    key.src_w       = width;
+    key.src_h       = height;
+    key.dst_w       = vf->priv->w;
+    key.dst_h       = vf->priv->h;
+    key.sfmt        = sfmt;
+    key.dfmt        = dfmt;
+    key.flags       = int_sws_flags & ~SWS_PRINT_INFO; // does not change the result
+    key.interlaced  = vf->priv->interlaced;
+    key.param[0]    = vf->priv->param[0];
+    key.param[1]    = vf->priv->param[1];
+    key.lum_gblur   = sws_lum_gblur;
+    key.chr_gblur   = sws_chr_gblur;
+    key.lum_sharpen = sws_lum_sharpen;
+    key.chr_sharpen = sws_chr_sharpen;
+    key.chr_hshift  = sws_chr_hshift;
+    key.chr_vshift  = sws_chr_vshift;
+    vf->priv->cur=cache_get(vf, &key, int_sws_flags, best, srcFilter, dstFilter);
+    vf->priv->ctx =vf->priv->cur ? vf->priv->cur->ctx  : NULL;
+    vf->priv->ctx2=vf->priv->cur ? vf->priv->cur->ctx2 : NULL;
     if(!vf->priv->ctx){
         // error...
         mp_msg(MSGT_VFILTER,MSGL_WARN,"Couldn't init SwScaler for this setup\n");
         return 0;
     }
     vf->priv->fmt=best;
+    // slices arrive one after the other from the decoder, so when the
+    // scaling is split into bands rather take whole frames
+    vf->start_slice=vf->priv->cur->nslices ? NULL : start_slice;
+    vf->draw_slice =vf->priv->cur->nslices ? NULL : draw_slice;
 
     free(vf->priv->palette);
     vf->priv->palette=NULL;
@@ -448,6 +643,35 @@ static void scale(struct SwsContext *sws1, struct SwsContext *sws2, uint8_t *src
     }
 }
 
+struct scale_job {
+    struct scale_cache *c;
+    mp_image_t *mpi, *dmpi;
+};
+
+static void scale_slice(void *ctx, int n, int thread){
+    struct scale_job *job = ctx;
+    struct scale_slice *sl = &job->c->slice[n];
+    mp_image_t *mpi = job->mpi, *dmpi = job->dmpi, *tmp = sl->tmp;
+    uint8_t *src[MP_MAX_PLANES];
+    int i;
+
+    for(i=0; i<MP_MAX_PLANES; i++){
+        src[i] = mpi->planes[i];
+        if(src[i] && (i == 0 || (mpi->flags&MP_IMGFLAG_PLANAR)))
+            src[i] += (sl->src_y >> (i == 1 || i == 2 ? mpi->chroma_y_shift : 0)) * mpi->stride[i];
+    }
+    scale(sl->ctx, sl->ctx, src, mpi->stride, 0, tmp->h, tmp->planes, tmp->stride, 0);
+
+    // copy out the rows this band owns, the rest of the window belongs to others
+    for(i=0; i<((tmp->flags&MP_IMGFLAG_PLANAR) ? tmp->num_planes : 1); i++){
+        int shift = i == 1 || i == 2 ? tmp->chroma_y_shift : 0;
+        memcpy_pic(dmpi->planes[i] + (sl->y0 >> shift) * dmpi->stride[i],
+                   tmp->planes[i] + ((sl->y0 - sl->tmp_y) >> shift) * tmp->stride[i],
+                   tmp->stride[i], (sl->y1 - sl->y0) >> shift,
+                   dmpi->stride[i], tmp->stride[i]);
+    }
+}
+
 static void draw_slice(struct vf_instance *vf,
         unsigned char** src, int* stride, int w,int h, int x, int y){
     mp_image_t *dmpi=vf->dmpi;
@@ -472,6 +696,10 @@ static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
         MP_IMGTYPE_TEMP, MP_IMGFLAG_ACCEPT_STRIDE | MP_IMGFLAG_PREFER_ALIGNED_STRIDE,
         vf->priv->w, vf->priv->h);
 
+    if(vf->priv->cur->nslices){
+      struct scale_job job = { vf->priv->cur, mpi, dmpi };
+      vf_threads_execute(scale_slice, &job, job.c->nslices);
+    }else
       scale(vf->priv->ctx, vf->priv->ctx, mpi->planes,mpi->stride,0,mpi->h,dmpi->planes,dmpi->stride, vf->priv->interlaced);
   }
 
@@ -536,6 +764,13 @@ static int control(struct vf_instance *vf, int request, void* data){
             r= sws_setColorspaceDetails(vf->priv->ctx2, inv_table, srcRange, table, dstRange, brightness, contrast, saturation);
             if(r<0) break;
         }
+        // remember it for the slice contexts and contexts taken from the cache later
+        vf->priv->eq_set= 1;
+        vf->priv->brightness= brightness;
+        vf->priv->contrast= contrast;
+        vf->priv->saturation= saturation;
+        for(r=0; r<vf->priv->cur->nslices; r++)
+            set_equalizer(vf->priv->cur->slice[r].ctx, brightness, contrast, saturation);
 
         return CONTROL_TRUE;
     default:
@@ -565,8 +800,9 @@ static int query_format(struct vf_instance *vf, unsigned int fmt){
 }
 
 static void uninit(struct vf_instance *vf){
-    if(vf->priv->ctx) sws_freeContext(vf->priv->ctx);
-    if(vf->priv->ctx2) sws_freeContext(vf->priv->ctx2);
+    int i;
+    for(i=0; i<SCALE_CACHE_SIZE; i++)
+        cache_free_entry(vf, &vf->priv->cache[i]);
     free(vf->priv->palette);
     free(vf->priv);
 }
@@ -26,6 +26,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #include "mp_msg.h"
 
@@ -33,35 +36,79 @@
 #include "mp_image.h"
 #include "vf.h"
 #include "vf_scale.h"
+#include "m_option.h"
+#include "m_struct.h"
 
 #include "libavutil/mem.h"
 #include "libswscale/swscale.h"
 #include "libavcodec/avcodec.h"
 
-struct vf_priv_s {
-    int frameno;
+/// one RGB24 screenshot, queued for writing and recycled afterwards
+struct shot {
+    struct shot *next;
+    uint8_t *buf;
+    int w, h, stride;
     char fname[PATH_MAX];
+};
+
+static const struct vf_priv_s {
     char *prefix;
+    char *format;
+    /// maximum number of screenshots waiting to be written
+    int queue;
+    int ppm;
+    int frameno;
+    char fname[PATH_MAX];
     /// shot stores current screenshot mode:
     /// 0: don't take screenshots
     /// 1: take single screenshot, reset to 0 afterwards
     /// 2: take screenshots of each frame
     int shot, store_slices;
     int dw, dh;
-    AVFrame *pic;
+    /// screenshot the current frame is scaled into
+    struct shot *cur;
     struct SwsContext *ctx;
+    // only used by the encoder
+    AVFrame *pic;
     AVCodecContext *avctx;
     uint8_t *outbuffer;
-    int outbuffer_size;
+    unsigned int outbuffer_size;
+    // the fields below are protected by lock when the encoder thread runs
+    struct shot *queued, **queued_tail;
+    /// written screenshots, their buffers are reused or freed by the filter
+    struct shot *done;
+    int pending;  ///< screenshots queued or being written
+    int dropped;  ///< only used by the filter
+#if HAVE_PTHREADS
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int thread_running;
+    int quit;
+#endif
+} vf_priv_dflt = {
+    "shot",
+    "png",
+    4,
 };
 
+#if HAVE_PTHREADS
+#define LOCK(p)   pthread_mutex_lock(&(p)->lock)
+#define UNLOCK(p) pthread_mutex_unlock(&(p)->lock)
+#else
+#define LOCK(p)
+#define UNLOCK(p)
+#endif
+
 //===========================================================================//
 
 static void draw_slice(struct vf_instance *vf, unsigned char** src,
                        int* stride, int w,int h, int x, int y)
 {
     if (vf->priv->store_slices) {
-        sws_scale(vf->priv->ctx, src, stride, y, h, vf->priv->pic->data, vf->priv->pic->linesize);
+        uint8_t *dst[4] = { vf->priv->cur->buf };
+        int dst_stride[4] = { vf->priv->cur->stride };
+        sws_scale(vf->priv->ctx, src, stride, y, h, dst, dst_stride);
     }
     vf_next_draw_slice(vf,src,stride,w,h,x,y);
 }
@@ -75,25 +122,8 @@ static int config(struct vf_instance *vf,
     vf->priv->ctx=sws_getContextFromCmdLine(width, height, outfmt,
                                  d_width, d_height, IMGFMT_RGB24);
 
-    av_fast_malloc(&vf->priv->outbuffer, &vf->priv->outbuffer_size, d_width * d_height * 3 * 2);
-    if (!vf->priv->avctx) {
-        vf->priv->avctx = avcodec_alloc_context3(NULL);
-        vf->priv->avctx->pix_fmt = AV_PIX_FMT_RGB24;
-        vf->priv->avctx->width = d_width;
-        vf->priv->avctx->height = d_height;
-        vf->priv->avctx->time_base.num = 1;
-        vf->priv->avctx->time_base.den = 1;
-        vf->priv->avctx->compression_level = 0;
-        if (avcodec_open2(vf->priv->avctx, avcodec_find_encoder(AV_CODEC_ID_PNG), NULL)) {
-            mp_msg(MSGT_VFILTER, MSGL_FATAL, "Could not open libavcodec PNG encoder\n");
-            return 0;
-        }
-    }
     vf->priv->dw = d_width;
     vf->priv->dh = d_height;
-    vf->priv->pic->linesize[0] = (3*vf->priv->dw+15)&~15;
-
-    av_freep(&vf->priv->pic->data[0]); // probably reconfigured
 
     res = vf_next_config(vf,width,height,d_width,d_height,flags,outfmt);
     // Our draw_slice only works properly if the
@@ -102,16 +132,44 @@ static int config(struct vf_instance *vf,
     return res;
 }
 
-static void write_png(struct vf_priv_s *priv)
+static int open_encoder(struct vf_priv_s *priv, int w, int h)
+{
+    if (priv->avctx && priv->avctx->width == w && priv->avctx->height == h)
+        return 1;
+    if (priv->avctx) {
+        avcodec_close(priv->avctx);
+        av_freep(&priv->avctx);
+    }
+    priv->avctx = avcodec_alloc_context3(NULL);
+    priv->avctx->pix_fmt = AV_PIX_FMT_RGB24;
+    priv->avctx->width = w;
+    priv->avctx->height = h;
+    priv->avctx->time_base.num = 1;
+    priv->avctx->time_base.den = 1;
+    priv->avctx->compression_level = 0;
+    if (avcodec_open2(priv->avctx, avcodec_find_encoder(AV_CODEC_ID_PNG), NULL)) {
+        mp_msg(MSGT_VFILTER, MSGL_ERR, "Could not open libavcodec PNG encoder\n");
+        av_freep(&priv->avctx);
+        return 0;
+    }
+    return 1;
+}
+
+static void write_png(struct vf_priv_s *priv, struct shot *shot)
 {
-    char *fname = priv->fname;
+    char *fname = shot->fname;
     FILE * fp;
     AVPacket pkt;
     int res, got_pkt;
 
+    if (!open_encoder(priv, shot->w, shot->h))
+        return;
+    av_fast_malloc(&priv->outbuffer, &priv->outbuffer_size, shot->w * shot->h * 3 * 2);
     av_init_packet(&pkt);
     pkt.data = priv->outbuffer;
     pkt.size = priv->outbuffer_size;
+    priv->pic->data[0] = shot->buf;
+    priv->pic->linesize[0] = shot->stride;
     priv->pic->width = priv->avctx->width;
     priv->pic->height = priv->avctx->height;
     priv->pic->format = priv->avctx->pix_fmt;
@@ -130,7 +188,120 @@ static void write_png(struct vf_priv_s *priv)
     fwrite(priv->outbuffer, pkt.size, 1, fp);
 
     fclose (fp);
-    mp_msg(MSGT_VFILTER,MSGL_INFO,"*** screenshot '%s' ***\n",priv->fname);
+    mp_msg(MSGT_VFILTER,MSGL_INFO,"*** screenshot '%s' ***\n",fname);
+}
+
+static void write_ppm(struct shot *shot)
+{
+    FILE *fp = fopen(shot->fname, "wb");
+    int y;
+
+    if (fp == NULL) {
+        mp_msg(MSGT_VFILTER,MSGL_ERR,"\nPPM Error opening %s for writing!\n", shot->fname);
+        return;
+    }
+    fprintf(fp, "P6\n%d %d\n255\n", shot->w, shot->h);
+    for (y = 0; y < shot->h; y++)
+        fwrite(shot->buf + y * shot->stride, shot->w * 3, 1, fp);
+    if (fclose(fp))
+        mp_msg(MSGT_VFILTER,MSGL_ERR,"\nError writing screenshot %s!\n", shot->fname);
+    else
+        mp_msg(MSGT_VFILTER,MSGL_INFO,"*** screenshot '%s' ***\n",shot->fname);
+}
+
+static void write_shot(struct vf_priv_s *priv, struct shot *shot)
+{
+    if (priv->ppm)
+        write_ppm(shot);
+    else
+        write_png(priv, shot);
+}
+
+// called with lock held
+static void shot_done(struct vf_priv_s *priv, struct shot *shot)
+{
+    shot->next = priv->done;
+    priv->done = shot;
+    priv->pending--;
+}
+
+#if HAVE_PTHREADS
+static void *encoder_thread(void *arg)
+{
+    struct vf_priv_s *priv = arg;
+
+    pthread_mutex_lock(&priv->lock);
+    while (1) {
+        struct shot *shot = priv->queued;
+        if (!shot) {
+            // queued screenshots are always written before quitting
+            if (priv->quit)
+                break;
+            pthread_cond_wait(&priv->cond, &priv->lock);
+            continue;
+        }
+        priv->queued = shot->next;
+        if (!priv->queued)
+            priv->queued_tail = &priv->queued;
+        pthread_mutex_unlock(&priv->lock);
+
+        write_shot(priv, shot);
+
+        pthread_mutex_lock(&priv->lock);
+        shot_done(priv, shot);
+        pthread_cond_broadcast(&priv->cond);
+    }
+    pthread_mutex_unlock(&priv->lock);
+    return NULL;
+}
+#endif
+
+/**
+ * \brief hand the current screenshot over to the encoder
+ * \param wait if the queue is full, wait for a free slot instead of
+ *             dropping the screenshot
+ */
+static void queue_shot(struct vf_priv_s *priv, int wait)
+{
+    struct shot *shot = priv->cur;
+
+    strcpy(shot->fname, priv->fname);
+#if HAVE_PTHREADS
+    if (priv->queue && !priv->thread_running)
+        priv->thread_running =
+            !pthread_create(&priv->thread, NULL, encoder_thread, priv);
+    if (priv->thread_running) {
+        LOCK(priv);
+        while (wait && priv->pending >= priv->queue)
+            pthread_cond_wait(&priv->cond, &priv->lock);
+        if (priv->pending < priv->queue) {
+            shot->next = NULL;
+            *priv->queued_tail = shot;
+            priv->queued_tail = &shot->next;
+            priv->pending++;
+            priv->cur = NULL;
+            pthread_cond_broadcast(&priv->cond);
+        }
+        UNLOCK(priv);
+        if (priv->cur) {
+            priv->dropped++;
+            mp_msg(MSGT_VFILTER, MSGL_V,
+                   "Screenshot queue full, dropped %s\n", shot->fname);
+        }
+        return;
+    }
+#endif
+    write_shot(priv, shot);
+}
+
+/// no screenshot can be queued without waiting
+static int queue_full(struct vf_priv_s *priv)
+{
+    int full;
+    LOCK(priv);
+    full = priv->queue && priv->pending >= priv->queue;
+    UNLOCK(priv);
+    return full;
 }
 
 static int fexists(char *fname)
@@ -142,7 +313,8 @@ static int fexists(char *fname)
 static void gen_fname(struct vf_priv_s* priv)
 {
     do {
-        snprintf(priv->fname, sizeof(priv->fname), "%s%04d.png", priv->prefix, ++priv->frameno);
+        snprintf(priv->fname, sizeof(priv->fname), "%s%04d.%s", priv->prefix,
+                 ++priv->frameno, priv->ppm ? "ppm" : "png");
     } while (fexists(priv->fname) && priv->frameno < 100000);
     if (fexists(priv->fname)) {
         priv->fname[0] = '\0';
@@ -150,12 +322,57 @@ static void gen_fname(struct vf_priv_s* priv)
     }
 }
 
-static void scale_image(struct vf_priv_s* priv, mp_image_t *mpi)
+static void free_shots(struct vf_instance *vf, struct shot *shot)
+{
+    while (shot) {
+        struct shot *next = shot->next;
+        vf_pool_free(vf, shot->buf);
+        free(shot);
+        shot = next;
+    }
+}
+
+/// get a buffer of the current size for the next screenshot
+static int alloc_pic(struct vf_instance *vf)
 {
-    if (!priv->pic->data[0])
-        priv->pic->data[0] = av_malloc(priv->pic->linesize[0]*priv->dh);
+    struct vf_priv_s *priv = vf->priv;
+    struct shot *shot = priv->cur;
+
+    if (!shot) {
+        LOCK(priv);
+        if ((shot = priv->done))
+            priv->done = shot->next;
+        UNLOCK(priv);
+        if (!shot && !(shot = calloc(1, sizeof(*shot))))
+            return 0;
+        priv->cur = shot;
+    }
+    if (shot->buf && (shot->w != priv->dw || shot->h != priv->dh)) {
+        vf_pool_free(vf, shot->buf);
+        shot->buf = NULL;
+    }
+    if (!shot->buf) {
+        shot->w = priv->dw;
+        shot->h = priv->dh;
+        shot->stride = (3*priv->dw+15)&~15;
+        shot->buf = vf_pool_alloc(vf, IMGFMT_RGB24, priv->dw, priv->dh,
+                                  shot->stride*priv->dh);
+    }
+    return shot->buf != NULL;
+}
 
-    sws_scale(priv->ctx, mpi->planes, mpi->stride, 0, mpi->height, priv->pic->data, priv->pic->linesize);
+static int scale_image(struct vf_instance *vf, mp_image_t *mpi)
+{
+    struct vf_priv_s *priv = vf->priv;
+    uint8_t *dst[4];
+    int dst_stride[4] = { 0 };
+
+    if (!alloc_pic(vf))
+        return 0;
+    dst[0] = priv->cur->buf;
+    dst_stride[0] = priv->cur->stride;
+    sws_scale(priv->ctx, mpi->planes, mpi->stride, 0, mpi->height, dst, dst_stride);
+    return 1;
 }
 
 static void start_slice(struct vf_instance *vf, mp_image_t *mpi)
@@ -163,11 +380,9 @@ static void start_slice(struct vf_instance *vf, mp_image_t *mpi)
     mpi->priv=
     vf->dmpi=vf_get_image(vf->next,mpi->imgfmt,
         mpi->type, mpi->flags, mpi->width, mpi->height);
-    if (vf->priv->shot) {
-        vf->priv->store_slices = 1;
-        if (!vf->priv->pic->data[0])
-            vf->priv->pic->data[0] = av_malloc(vf->priv->pic->linesize[0]*vf->priv->dh);
-    }
+    // in the each frame mode, frames the encoder has no room for are dropped
+    if (vf->priv->shot && (vf->priv->shot & 1 || !queue_full(vf->priv)))
+        vf->priv->store_slices = alloc_pic(vf);
 
 }
 
@@ -214,12 +429,16 @@ static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts)
     }
 
     if(vf->priv->shot) {
+        int single = vf->priv->shot & 1;
         vf->priv->shot &= ~1;
-        gen_fname(vf->priv);
-        if (vf->priv->fname[0]) {
-            if (!vf->priv->store_slices)
-              scale_image(vf->priv, dmpi);
-            write_png(vf->priv);
+        if (!single && !vf->priv->store_slices && queue_full(vf->priv)) {
+            vf->priv->dropped++;
+            mp_msg(MSGT_VFILTER, MSGL_V, "Screenshot queue full, frame dropped\n");
+        } else {
+            gen_fname(vf->priv);
+            if (vf->priv->fname[0] &&
+                (vf->priv->store_slices || scale_image(vf, dmpi)))
+                queue_shot(vf->priv, single);
         }
         vf->priv->store_slices = 0;
     }
@@ -276,14 +495,33 @@ static int query_format(struct vf_instance *vf, unsigned int fmt)
 
 static void uninit(vf_instance_t *vf)
 {
-    avcodec_close(vf->priv->avctx);
-    av_freep(&vf->priv->avctx);
-    if(vf->priv->ctx) sws_freeContext(vf->priv->ctx);
-    av_freep(&vf->priv->pic->data[0]);
-    av_frame_free(&vf->priv->pic);
-    av_freep(&vf->priv->outbuffer);
-    free(vf->priv->prefix);
-    free(vf->priv);
+    struct vf_priv_s *priv = vf->priv;
+#if HAVE_PTHREADS
+    if (priv->thread_running) {
+        LOCK(priv);
+        priv->quit = 1;
+        pthread_cond_broadcast(&priv->cond);
+        UNLOCK(priv);
+        pthread_join(priv->thread, NULL);
+    }
+    pthread_cond_destroy(&priv->cond);
+    pthread_mutex_destroy(&priv->lock);
+#endif
+    if (priv->dropped)
+        mp_msg(MSGT_VFILTER, MSGL_INFO,
+               "%d screenshots dropped, writing them could not keep up.\n",
+               priv->dropped);
+    free_shots(vf, priv->cur);
+    free_shots(vf, priv->done);
+    if (priv->avctx)
+        avcodec_close(priv->avctx);
+    av_freep(&priv->avctx);
+    if(priv->ctx) sws_freeContext(priv->ctx);
+    av_frame_free(&priv->pic);
+    av_freep(&priv->outbuffer);
+    free(priv->prefix);
+    free(priv->format);
+    free(priv);
 }
 
 static int vf_open(vf_instance_t *vf, char *args)
@@ -296,17 +534,43 @@ static int vf_open(vf_instance_t *vf, char *args)
     vf->draw_slice=draw_slice;
     vf->get_image=get_image;
     vf->uninit=uninit;
-    vf->priv = calloc(1, sizeof(struct vf_priv_s));
     vf->priv->pic = av_frame_alloc();
-    vf->priv->prefix = strdup(args ? args : "shot");
-    avcodec_register_all();
-    if (!avcodec_find_encoder(AV_CODEC_ID_PNG)) {
-        mp_msg(MSGT_VFILTER, MSGL_FATAL, "Could not find libavcodec PNG encoder\n");
+    vf->priv->queued_tail = &vf->priv->queued;
+#if HAVE_PTHREADS
+    pthread_mutex_init(&vf->priv->lock, NULL);
+    pthread_cond_init(&vf->priv->cond, NULL);
+#endif
+    vf->priv->ppm = vf->priv->format && !strcmp(vf->priv->format, "ppm");
+    if (!vf->priv->ppm && (!vf->priv->format || strcmp(vf->priv->format, "png"))) {
+        // an empty format= leaves no string
+        mp_msg(MSGT_VFILTER, MSGL_FATAL, "Unknown screenshot format '%s'\n",
+               vf->priv->format ? vf->priv->format : "");
         return 0;
     }
+    if (!vf->priv->ppm) {
+        avcodec_register_all();
+        if (!avcodec_find_encoder(AV_CODEC_ID_PNG)) {
+            mp_msg(MSGT_VFILTER, MSGL_FATAL, "Could not find libavcodec PNG encoder\n");
+            return 0;
+        }
+    }
     return 1;
 }
 
+#define ST_OFF(f) M_ST_OFF(struct vf_priv_s,f)
+static const m_option_t vf_opts_fields[] = {
+    { "prefix", ST_OFF(prefix), CONF_TYPE_STRING, 0, 0, 0, NULL },
+    { "format", ST_OFF(format), CONF_TYPE_STRING, 0, 0, 0, NULL },
+    { "queue",  ST_OFF(queue),  CONF_TYPE_INT, M_OPT_RANGE, 0, 64, NULL },
+    { NULL, NULL, 0, 0, 0, 0, NULL }
+};
+
+static const m_struct_t vf_opts = {
+    "screenshot",
+    sizeof(struct vf_priv_s),
+    &vf_priv_dflt,
+    vf_opts_fields
+};
 
 const vf_info_t vf_info_screenshot = {
     "screenshot to file",
@@ -314,7 +578,7 @@ const vf_info_t vf_info_screenshot = {
     "A'rpi, Jindrich Makovicka",
     "",
     vf_open,
-    NULL
+    &vf_opts
 };
 
 //===========================================================================//
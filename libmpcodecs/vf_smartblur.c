@@ -26,9 +26,11 @@
 
 #include "mp_msg.h"
 #include "libavutil/avutil.h"
+#include "libavutil/mem.h"
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "vf_threads.h"
 #include "libswscale/swscale.h"
 #include "vf_scale.h"
 
@@ -40,6 +42,12 @@ typedef struct FilterParam{
     int threshold;
     float quality;
     struct SwsContext *filterContext;
+    // band threading: every thread filters a window of bandH rows
+    int bands;
+    int bandH;
+    int bandStride;
+    struct SwsContext *bandContext[VF_MAX_THREADS];
+    uint8_t *bandBuf[VF_MAX_THREADS];
 }FilterParam;
 
 struct vf_priv_s {
@@ -82,6 +90,8 @@ static void getSubSampleFactors(int *h, int *v, int format){
 static int allocStuff(FilterParam *f, int width, int height){
     SwsVector *vec;
     SwsFilter swsF;
+    int threads= vf_threads_count();
+    int i;
 
     vec = sws_getGaussianVec(f->radius, f->quality);
     sws_scaleVec(vec, f->strength);
@@ -91,6 +101,23 @@ static int allocStuff(FilterParam *f, int width, int height){
     f->filterContext= sws_getContext(
         width, height, AV_PIX_FMT_GRAY8, width, height, AV_PIX_FMT_GRAY8, SWS_BICUBIC, &swsF, NULL, NULL);
 
+    /* Each band is filtered as a separate window that extends the band by
+     * more than the vertical filter reach on both sides (or ends at the
+     * image edge), so the rows that are kept come out exactly as with a
+     * single context. All windows have the same height so that one
+     * context per thread suffices. */
+    f->bands= 0;
+    f->bandH= height/threads + 2 + 2*(vec->length/2 + 8);
+    if(threads > 1 && f->bandH < height){
+        f->bands= threads;
+        f->bandStride= (width+15)&~15;
+        for(i=0; i<threads; i++){
+            f->bandContext[i]= sws_getContext(
+                width, f->bandH, AV_PIX_FMT_GRAY8, width, f->bandH, AV_PIX_FMT_GRAY8, SWS_BICUBIC, &swsF, NULL, NULL);
+            f->bandBuf[i]= av_malloc(f->bandStride*f->bandH);
+        }
+    }
+
     sws_freeVec(vec);
 
     return 0;
@@ -111,8 +138,17 @@ static int config(struct vf_instance *vf,
 }
 
 static void freeBuffers(FilterParam *f){
+    int i;
+
     if(f->filterContext) sws_freeContext(f->filterContext);
     f->filterContext=NULL;
+
+    for(i=0; i<f->bands; i++){
+        sws_freeContext(f->bandContext[i]);
+        f->bandContext[i]=NULL;
+        av_freep(&f->bandBuf[i]);
+    }
+    f->bands=0;
 }
 
 static void uninit(struct vf_instance *vf){
@@ -125,55 +161,49 @@ static void uninit(struct vf_instance *vf){
     vf->priv=NULL;
 }
 
-static inline void blur(uint8_t *dst, uint8_t *src, int w, int h, int dstStride, int srcStride, FilterParam *fp){
+static void threshold(uint8_t *dst, uint8_t *src, int w, int y0, int y1, int dstStride, int srcStride, FilterParam *fp){
     int x, y;
-    FilterParam f= *fp;
-    const uint8_t* const srcArray[MP_MAX_PLANES] = {src};
-    uint8_t *dstArray[MP_MAX_PLANES]= {dst};
-    int srcStrideArray[MP_MAX_PLANES]= {srcStride};
-    int dstStrideArray[MP_MAX_PLANES]= {dstStride};
+    const int thresh= fp->threshold;
 
-    sws_scale(f.filterContext, srcArray, srcStrideArray, 0, h, dstArray, dstStrideArray);
-
-    if(f.threshold > 0){
-        for(y=0; y<h; y++){
+    if(thresh > 0){
+        for(y=y0; y<y1; y++){
             for(x=0; x<w; x++){
                 const int orig= src[x + y*srcStride];
                 const int filtered= dst[x + y*dstStride];
                 const int diff= orig - filtered;
 
                 if(diff > 0){
-                    if(diff > 2*f.threshold){
+                    if(diff > 2*thresh){
                         dst[x + y*dstStride]= orig;
-                    }else if(diff > f.threshold){
-                        dst[x + y*dstStride]= filtered + diff - f.threshold;
+                    }else if(diff > thresh){
+                        dst[x + y*dstStride]= filtered + diff - thresh;
                     }
                 }else{
-                    if(-diff > 2*f.threshold){
+                    if(-diff > 2*thresh){
                         dst[x + y*dstStride]= orig;
-                    }else if(-diff > f.threshold){
-                        dst[x + y*dstStride]= filtered + diff + f.threshold;
+                    }else if(-diff > thresh){
+                        dst[x + y*dstStride]= filtered + diff + thresh;
                     }
                 }
             }
         }
-    }else if(f.threshold < 0){
-        for(y=0; y<h; y++){
+    }else if(thresh < 0){
+        for(y=y0; y<y1; y++){
             for(x=0; x<w; x++){
                 const int orig= src[x + y*srcStride];
                 const int filtered= dst[x + y*dstStride];
                 const int diff= orig - filtered;
 
                 if(diff > 0){
-                    if(diff > -2*f.threshold){
-                    }else if(diff > -f.threshold){
-                        dst[x + y*dstStride]= orig - diff - f.threshold;
+                    if(diff > -2*thresh){
+                    }else if(diff > -thresh){
+                        dst[x + y*dstStride]= orig - diff - thresh;
                     }else
                         dst[x + y*dstStride]= orig;
                 }else{
-                    if(diff < 2*f.threshold){
-                    }else if(diff < f.threshold){
-                        dst[x + y*dstStride]= orig - diff + f.threshold;
+                    if(diff < 2*thresh){
+                    }else if(diff < thresh){
+                        dst[x + y*dstStride]= orig - diff + thresh;
                     }else
                         dst[x + y*dstStride]= orig;
                 }
@@ -182,6 +212,46 @@ static inline void blur(uint8_t *dst, uint8_t *src, int w, int h, int dstStride,
     }
 }
 
+struct blur_plane {
+    uint8_t *dst, *src;
+    int w, h, dstStride, srcStride;
+    FilterParam *fp;
+};
+
+static void blur_band(void *ctx, int warm_y, int y0, int y1, int thread){
+    struct blur_plane *p= ctx;
+    FilterParam *f= p->fp;
+    int start= av_clip(warm_y - (f->bandH - (y1 - y0))/2, 0, p->h - f->bandH);
+    const uint8_t* const srcArray[MP_MAX_PLANES] = {p->src + start*p->srcStride};
+    uint8_t *dstArray[MP_MAX_PLANES]= {f->bandBuf[thread]};
+    int srcStrideArray[MP_MAX_PLANES]= {p->srcStride};
+    int dstStrideArray[MP_MAX_PLANES]= {f->bandStride};
+    int y;
+
+    sws_scale(f->bandContext[thread], srcArray, srcStrideArray, 0, f->bandH, dstArray, dstStrideArray);
+    for(y=y0; y<y1; y++)
+        memcpy(p->dst + y*p->dstStride, f->bandBuf[thread] + (y-start)*f->bandStride, p->w);
+
+    threshold(p->dst, p->src, p->w, y0, y1, p->dstStride, p->srcStride, f);
+}
+
+static void blur(uint8_t *dst, uint8_t *src, int w, int h, int dstStride, int srcStride, FilterParam *fp){
+    const uint8_t* const srcArray[MP_MAX_PLANES] = {src};
+    uint8_t *dstArray[MP_MAX_PLANES]= {dst};
+    int srcStrideArray[MP_MAX_PLANES]= {srcStride};
+    int dstStrideArray[MP_MAX_PLANES]= {dstStride};
+
+    if(fp->bands){
+        struct blur_plane p= { dst, src, w, h, dstStride, srcStride, fp };
+        vf_run_bands(blur_band, &p, h, 0, 1);
+        return;
+    }
+
+    sws_scale(fp->filterContext, srcArray, srcStrideArray, 0, h, dstArray, dstStrideArray);
+
+    threshold(dst, src, w, 0, h, dstStride, srcStride, fp);
+}
+
 static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
     int cw= mpi->w >> mpi->chroma_x_shift;
     int ch= mpi->h >> mpi->chroma_y_shift;
@@ -52,6 +52,7 @@
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "vf_threads.h"
 #include "av_helpers.h"
 #include "libvo/fastmemcpy.h"
 
@@ -100,7 +101,8 @@ struct vf_priv_s {
         int mpeg2;
         int temp_stride;
         uint8_t *src;
-        int16_t *temp;
+        int nthreads;
+        int16_t *temp[VF_MAX_THREADS];     ///< accumulator per thread
         AVCodecContext *avctx;
         IDCTDSPContext idsp;
         FDCTDSPContext fdsp;
@@ -379,39 +381,49 @@ static void (*store_slice)(uint8_t *dst, int16_t *src, int dst_stride, int src_s
 
 static void (*requantize)(int16_t dst[64], int16_t src[64], int qp, uint8_t *permutation)= hardthresh_c;
 
-static void filter(struct vf_priv_s *p, uint8_t *dst, uint8_t *src, int dst_stride, int src_stride, int width, int height, uint8_t *qp_store, int qp_stride, int is_luma){
-        int x, y, i;
+struct filter_job {
+        struct vf_priv_s *p;
+        uint8_t *dst;
+        int dst_stride;
+        int stride;
+        int width, height;
+        uint8_t *qp_store;
+        int qp_stride;
+        int is_luma;
+        int nrows;      ///< rows of 8 lines that are stored
+        int nbands;
+};
+
+/**
+ * \brief filter the rows of 8 lines first..last-1 of a plane
+ *
+ * The blocks of a row also add to the following 8 lines, so every band
+ * starts one row early, with that row only contributing to the next one.
+ */
+static void filter_band(void *ctx, int band, int thread){
+        struct filter_job *j= ctx;
+        struct vf_priv_s *p= j->p;
         const int count= 1<<p->log2_count;
-        const int stride= is_luma ? p->temp_stride : ((width+16+15)&(~15));
+        const int stride= j->stride;
+        const int width= j->width, height= j->height;
+        const int first= j->nrows* band   /j->nbands;
+        const int last = j->nrows*(band+1)/j->nbands;
+        int16_t *temp= p->temp[thread];
+        int x, y, i;
         uint64_t __attribute__((aligned(16))) block_align[32];
         int16_t *block = (int16_t *)block_align;
         int16_t *block2= (int16_t *)(block_align+16);
 
-        if (!src || !dst) return; // HACK avoid crash for Y8 colourspace
-        for(y=0; y<height; y++){
-                int index= 8 + 8*stride + y*stride;
-                fast_memcpy(p->src + index, src + y*src_stride, width);
-                for(x=0; x<8; x++){
-                        p->src[index         - x - 1]= p->src[index +         x    ];
-                        p->src[index + width + x    ]= p->src[index + width - x - 1];
-                }
-        }
-        for(y=0; y<8; y++){
-                fast_memcpy(p->src + (      7-y)*stride, p->src + (      y+8)*stride, stride);
-                fast_memcpy(p->src + (height+8+y)*stride, p->src + (height-y+7)*stride, stride);
-        }
-        //FIXME (try edge emu)
-
-        for(y=0; y<height+8; y+=8){
-                memset(p->temp + (8+y)*stride, 0, 8*stride*sizeof(int16_t));
+        for(y=8*first; y<=8*last; y+=8){
+                memset(temp + (8+y)*stride, 0, 8*stride*sizeof(int16_t));
                 for(x=0; x<width+8; x+=8){
-                        const int qps= 3 + is_luma;
+                        const int qps= 3 + j->is_luma;
                         int qp;
 
                         if(p->qp)
                                 qp= p->qp;
                         else{
-                                qp= qp_store[ (XMIN(x, width-1)>>qps) + (XMIN(y, height-1)>>qps) * qp_stride];
+                                qp= j->qp_store[ (XMIN(x, width-1)>>qps) + (XMIN(y, height-1)>>qps) * j->qp_stride];
                                 qp = FFMAX(1, norm_qscale(qp, p->mpeg2));
                         }
                         for(i=0; i<count; i++){
@@ -422,12 +434,49 @@ static void filter(struct vf_priv_s *p, uint8_t *dst, uint8_t *src, int dst_stri
                                 p->fdsp.fdct(block);
                                 requantize(block2, block, qp, p->idsp.idct_permutation);
                                 p->idsp.idct(block2);
-                                add_block(p->temp + index, stride, block2);
+                                add_block(temp + index, stride, block2);
                         }
                 }
-                if(y)
-                        store_slice(dst + (y-8)*dst_stride, p->temp + 8 + y*stride, dst_stride, stride, width, XMIN(8, height+8-y), 6-p->log2_count);
+                if(y > 8*first)
+                        store_slice(j->dst + (y-8)*j->dst_stride, temp + 8 + y*stride, j->dst_stride, stride, width, XMIN(8, height+8-y), 6-p->log2_count);
+        }
+#if HAVE_MMX_INLINE
+        if(gCpuCaps.hasMMX) __asm__ volatile ("emms\n\t");
+#endif
+}
+
+static void filter(struct vf_priv_s *p, uint8_t *dst, uint8_t *src, int dst_stride, int src_stride, int width, int height, uint8_t *qp_store, int qp_stride, int is_luma){
+        int x, y;
+        const int stride= is_luma ? p->temp_stride : ((width+16+15)&(~15));
+        struct filter_job job;
+
+        if (!src || !dst) return; // HACK avoid crash for Y8 colourspace
+        for(y=0; y<height; y++){
+                int index= 8 + 8*stride + y*stride;
+                fast_memcpy(p->src + index, src + y*src_stride, width);
+                for(x=0; x<8; x++){
+                        p->src[index         - x - 1]= p->src[index +         x    ];
+                        p->src[index + width + x    ]= p->src[index + width - x - 1];
+                }
+        }
+        for(y=0; y<8; y++){
+                fast_memcpy(p->src + (      7-y)*stride, p->src + (      y+8)*stride, stride);
+                fast_memcpy(p->src + (height+8+y)*stride, p->src + (height-y+7)*stride, stride);
         }
+        //FIXME (try edge emu)
+
+        job.p= p;
+        job.dst= dst;
+        job.dst_stride= dst_stride;
+        job.stride= stride;
+        job.width= width;
+        job.height= height;
+        job.qp_store= qp_store;
+        job.qp_stride= qp_stride;
+        job.is_luma= is_luma;
+        job.nrows= (height+7)>>3;
+        job.nbands= XMIN(p->nthreads, (job.nrows+3)>>2);
+        vf_threads_execute(filter_band, &job, job.nbands);
 #if 0
         for(y=0; y<height; y++){
                 for(x=0; x<width; x++){
@@ -444,10 +493,12 @@ static void filter(struct vf_priv_s *p, uint8_t *dst, uint8_t *src, int dst_stri
 static int config(struct vf_instance *vf,
         int width, int height, int d_width, int d_height,
         unsigned int flags, unsigned int outfmt){
-        int h= (height+16+15)&(~15);
+        int i, h= (height+16+15)&(~15);
 
         vf->priv->temp_stride= (width+16+15)&(~15);
-        vf->priv->temp= malloc(vf->priv->temp_stride*h*sizeof(int16_t));
+        vf->priv->nthreads= vf_threads_count();
+        for(i=0; i<vf->priv->nthreads; i++)
+                vf->priv->temp[i]= malloc(vf->priv->temp_stride*h*sizeof(int16_t));
         vf->priv->src = malloc(vf->priv->temp_stride*h*sizeof(uint8_t));
 
         return vf_next_config(vf,width,height,d_width,d_height,flags,outfmt);
@@ -523,10 +574,13 @@ static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
 }
 
 static void uninit(struct vf_instance *vf){
+        int i;
         if(!vf->priv) return;
 
-        free(vf->priv->temp);
-        vf->priv->temp= NULL;
+        for(i=0; i<vf->priv->nthreads; i++){
+                free(vf->priv->temp[i]);
+                vf->priv->temp[i]= NULL;
+        }
         free(vf->priv->src);
         vf->priv->src= NULL;
         free(vf->priv->avctx);
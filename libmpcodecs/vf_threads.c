@@ -0,0 +1,186 @@
+/*
+ * worker thread pool shared by the video filters
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "mp_msg.h"
+#include "vf_threads.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+int vf_threads = 1;
+
+#if HAVE_PTHREADS
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  work_cond;
+    pthread_cond_t  done_cond;
+    pthread_t       threads[VF_MAX_THREADS];
+    int             nthreads;   ///< worker threads, the caller not counted
+    int             initialized;
+    int             quit;
+    int             busy;
+    vf_thread_func  func;
+    void           *ctx;
+    int             njobs;
+    int             next_job;
+    int             jobs_done;
+} pool = {
+    .lock      = PTHREAD_MUTEX_INITIALIZER,
+    .work_cond = PTHREAD_COND_INITIALIZER,
+    .done_cond = PTHREAD_COND_INITIALIZER,
+};
+
+// called and returns with pool.lock held
+static void run_jobs(int thread)
+{
+    while (pool.next_job < pool.njobs) {
+        vf_thread_func func = pool.func;
+        void *ctx = pool.ctx;
+        int job = pool.next_job++;
+        pthread_mutex_unlock(&pool.lock);
+        func(ctx, job, thread);
+        pthread_mutex_lock(&pool.lock);
+        if (++pool.jobs_done == pool.njobs)
+            pthread_cond_signal(&pool.done_cond);
+    }
+}
+
+static void *worker(void *arg)
+{
+    int thread = (intptr_t)arg;
+    pthread_mutex_lock(&pool.lock);
+    while (1) {
+        while (!pool.quit && pool.next_job >= pool.njobs)
+            pthread_cond_wait(&pool.work_cond, &pool.lock);
+        if (pool.quit)
+            break;
+        run_jobs(thread);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+static int cpu_count(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0)
+        return n;
+#endif
+    return 1;
+}
+
+static void pool_init(void)
+{
+    int i, n = vf_threads > 0 ? vf_threads : cpu_count();
+    if (n > VF_MAX_THREADS)
+        n = VF_MAX_THREADS;
+    pool.quit = 0;
+    for (i = 0; i < n - 1; i++)
+        if (pthread_create(&pool.threads[i], NULL, worker, (void *)(intptr_t)(i + 1)))
+            break;
+    pool.nthreads    = i;
+    pool.initialized = 1;
+    if (n > 1)
+        mp_msg(MSGT_VFILTER, MSGL_V, "vf: using %d threads\n", pool.nthreads + 1);
+}
+
+int vf_threads_count(void)
+{
+    if (!pool.initialized)
+        pool_init();
+    return pool.nthreads + 1;
+}
+
+/**
+ * \brief run func for jobs 0..njobs-1 on the pool and wait for completion
+ *
+ * The calling thread takes part in the work. Must not be called from
+ * within a job; concurrent callers fall back to running serially.
+ */
+void vf_threads_execute(vf_thread_func func, void *ctx, int njobs)
+{
+    int i;
+    if (!pool.initialized)
+        pool_init();
+    pthread_mutex_lock(&pool.lock);
+    if (!pool.nthreads || njobs <= 1 || pool.busy) {
+        pthread_mutex_unlock(&pool.lock);
+        for (i = 0; i < njobs; i++)
+            func(ctx, i, 0);
+        return;
+    }
+    pool.busy      = 1;
+    pool.func      = func;
+    pool.ctx       = ctx;
+    pool.njobs     = njobs;
+    pool.next_job  = 0;
+    pool.jobs_done = 0;
+    pthread_cond_broadcast(&pool.work_cond);
+    run_jobs(0);
+    while (pool.jobs_done < pool.njobs)
+        pthread_cond_wait(&pool.done_cond, &pool.lock);
+    pool.busy = 0;
+    pthread_mutex_unlock(&pool.lock);
+}
+
+void vf_threads_uninit(void)
+{
+    int i;
+    if (!pool.initialized)
+        return;
+    pthread_mutex_lock(&pool.lock);
+    pool.quit = 1;
+    pthread_cond_broadcast(&pool.work_cond);
+    pthread_mutex_unlock(&pool.lock);
+    for (i = 0; i < pool.nthreads; i++)
+        pthread_join(pool.threads[i], NULL);
+    pool.nthreads    = 0;
+    pool.njobs       = 0;
+    pool.next_job    = 0;
+    pool.initialized = 0;
+}
+
+#else /* HAVE_PTHREADS */
+
+int vf_threads_count(void)
+{
+    return 1;
+}
+
+void vf_threads_execute(vf_thread_func func, void *ctx, int njobs)
+{
+    int i;
+    for (i = 0; i < njobs; i++)
+        func(ctx, i, 0);
+}
+
+void vf_threads_uninit(void)
+{
+}
+
+#endif /* HAVE_PTHREADS */
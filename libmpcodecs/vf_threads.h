@@ -0,0 +1,38 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_VF_THREADS_H
+#define MPLAYER_VF_THREADS_H
+
+#define VF_MAX_THREADS 64
+
+/// number of threads video filters may use, 0 means one per CPU
+extern int vf_threads;
+
+/**
+ * Job callback. thread is 0 for the calling thread and 1..count-1 for the
+ * workers, so it can be used to index per-thread scratch buffers.
+ */
+typedef void (*vf_thread_func)(void *ctx, int job, int thread);
+
+int vf_threads_count(void);
+void vf_threads_execute(vf_thread_func func, void *ctx, int njobs);
+/// stop the workers, they are shared by all filter chains until exit
+void vf_threads_uninit(void);
+
+#endif /* MPLAYER_VF_THREADS_H */
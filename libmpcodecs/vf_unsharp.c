@@ -35,6 +35,7 @@
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "vf_threads.h"
 #include "libvo/fastmemcpy.h"
 #include "libavutil/common.h"
 
@@ -46,7 +47,7 @@
 typedef struct FilterParam {
     int msizeX, msizeY;
     double amount;
-    uint32_t *SC[MAX_MATRIX_SIZE-1];
+    uint32_t *SC[VF_MAX_THREADS][MAX_MATRIX_SIZE-1];
 } FilterParam;
 
 struct vf_priv_s {
@@ -68,11 +69,24 @@ Originally published Boston, Nov 98
 
 */
 
-static void unsharp( uint8_t *dst, uint8_t *src, int dstStride, int srcStride, int width, int height, FilterParam *fp ) {
+struct unsharp_plane {
+    uint8_t *dst, *src;
+    int dstStride, srcStride, width, height;
+    FilterParam *fp;
+};
 
-    uint32_t **SC = fp->SC;
+/* The column state SC only holds the last 2*stepsY rows, so a band can
+ * start from a cleared state stepsY rows above its first output row and
+ * reproduce exactly what a single pass over the whole plane computes. */
+static void unsharp_band( void *ctx, int warm_y, int y0, int y1, int thread ) {
+
+    struct unsharp_plane *p = ctx;
+    FilterParam *fp = p->fp;
+    uint32_t **SC = fp->SC[thread];
     uint32_t SR[MAX_MATRIX_SIZE-1], Tmp1, Tmp2;
-    uint8_t* src2 = src; // avoid gcc warning
+    uint8_t *dst = p->dst, *src = p->src, *src2;
+    int dstStride = p->dstStride, srcStride = p->srcStride;
+    int width = p->width, height = p->height;
 
     int32_t res;
     int x, y, z;
@@ -82,22 +96,11 @@ static void unsharp( uint8_t *dst, uint8_t *src, int dstStride, int srcStride, i
     int scalebits = (stepsX+stepsY)*2;
     int32_t halfscale = 1 << ((stepsX+stepsY)*2-1);
 
-    if( !fp->amount ) {
-        if( src == dst )
-            return;
-        if( dstStride == srcStride )
-            fast_memcpy( dst, src, srcStride*height );
-        else
-            for( y=0; y<height; y++, dst+=dstStride, src+=srcStride )
-                fast_memcpy( dst, src, width );
-        return;
-    }
-
     for( y=0; y<2*stepsY; y++ )
         memset( SC[y], 0, sizeof(SC[y][0]) * (width+2*stepsX) );
 
-    for( y=-stepsY; y<height+stepsY; y++ ) {
-        if( y < height ) src2 = src;
+    for( y=y0-stepsY; y<y1+stepsY; y++ ) {
+        src2 = src + av_clip( y, 0, height-1 ) * srcStride;
         memset( SR, 0, sizeof(SR[0]) * (2*stepsX-1) );
         for( x=-stepsX; x<width+stepsX; x++ ) {
             Tmp1 = x<=0 ? src2[0] : x>=width ? src2[width-1] : src2[x];
@@ -109,28 +112,44 @@ static void unsharp( uint8_t *dst, uint8_t *src, int dstStride, int srcStride, i
                 Tmp2 = SC[z+0][x+stepsX] + Tmp1; SC[z+0][x+stepsX] = Tmp1;
                 Tmp1 = SC[z+1][x+stepsX] + Tmp2; SC[z+1][x+stepsX] = Tmp2;
             }
-            if( x>=stepsX && y>=stepsY ) {
-                uint8_t* srx = src - stepsY*srcStride + x - stepsX;
-                uint8_t* dsx = dst - stepsY*dstStride + x - stepsX;
+            if( x>=stepsX && y>=y0+stepsY ) {
+                uint8_t* srx = src + (y-stepsY)*srcStride + x - stepsX;
+                uint8_t* dsx = dst + (y-stepsY)*dstStride + x - stepsX;
 
                 res = (int32_t)*srx + ( ( ( (int32_t)*srx - (int32_t)((Tmp1+halfscale) >> scalebits) ) * amount ) >> 16 );
                 *dsx = res>255 ? 255 : res<0 ? 0 : (uint8_t)res;
             }
         }
-        if( y >= 0 ) {
-            dst += dstStride;
-            src += srcStride;
-        }
     }
 }
 
+static void unsharp( uint8_t *dst, uint8_t *src, int dstStride, int srcStride, int width, int height, FilterParam *fp ) {
+
+    struct unsharp_plane p = { dst, src, dstStride, srcStride, width, height, fp };
+    int y;
+
+    if( !fp->amount ) {
+        if( src == dst )
+            return;
+        if( dstStride == srcStride )
+            fast_memcpy( dst, src, srcStride*height );
+        else
+            for( y=0; y<height; y++, dst+=dstStride, src+=srcStride )
+                fast_memcpy( dst, src, width );
+        return;
+    }
+
+    vf_run_bands( unsharp_band, &p, height, 0, 1 );
+}
+
 //===========================================================================//
 
 static int config( struct vf_instance *vf,
                    int width, int height, int d_width, int d_height,
                    unsigned int flags, unsigned int outfmt ) {
 
-    int z, stepsX, stepsY;
+    int z, t, stepsX, stepsY;
+    int threads = vf_threads_count();
     FilterParam *fp;
     const char *effect;
 
@@ -142,8 +161,9 @@ static int config( struct vf_instance *vf,
     memset( fp->SC, 0, sizeof( fp->SC ) );
     stepsX = fp->msizeX/2;
     stepsY = fp->msizeY/2;
-    for( z=0; z<2*stepsY; z++ )
-        fp->SC[z] = av_malloc(sizeof(*(fp->SC[z])) * (width+2*stepsX));
+    for( t=0; t<threads; t++ )
+        for( z=0; z<2*stepsY; z++ )
+            fp->SC[t][z] = av_malloc(sizeof(*(fp->SC[t][z])) * (width+2*stepsX));
 
     fp = &vf->priv->chromaParam;
     effect = fp->amount == 0 ? "don't touch" : fp->amount < 0 ? "blur" : "sharpen";
@@ -151,8 +171,9 @@ static int config( struct vf_instance *vf,
     memset( fp->SC, 0, sizeof( fp->SC ) );
     stepsX = fp->msizeX/2;
     stepsY = fp->msizeY/2;
-    for( z=0; z<2*stepsY; z++ )
-        fp->SC[z] = av_malloc(sizeof(*(fp->SC[z])) * (width+2*stepsX));
+    for( t=0; t<threads; t++ )
+        for( z=0; z<2*stepsY; z++ )
+            fp->SC[t][z] = av_malloc(sizeof(*(fp->SC[t][z])) * (width+2*stepsX));
 
     return vf_next_config( vf, width, height, d_width, d_height, flags, outfmt );
 }
@@ -206,21 +227,19 @@ static int put_image( struct vf_instance *vf, mp_image_t *mpi, double pts) {
 }
 
 static void uninit( struct vf_instance *vf ) {
-    unsigned int z;
+    unsigned int t, z;
     FilterParam *fp;
 
     if( !vf->priv ) return;
 
     fp = &vf->priv->lumaParam;
-    for( z=0; z<sizeof(fp->SC)/sizeof(fp->SC[0]); z++ ) {
-        av_free( fp->SC[z] );
-        fp->SC[z] = NULL;
-    }
+    for( t=0; t<VF_MAX_THREADS; t++ )
+        for( z=0; z<MAX_MATRIX_SIZE-1; z++ )
+            av_freep( &fp->SC[t][z] );
     fp = &vf->priv->chromaParam;
-    for( z=0; z<sizeof(fp->SC)/sizeof(fp->SC[0]); z++ ) {
-        av_free( fp->SC[z] );
-        fp->SC[z] = NULL;
-    }
+    for( t=0; t<VF_MAX_THREADS; t++ )
+        for( z=0; z<MAX_MATRIX_SIZE-1; z++ )
+            av_freep( &fp->SC[t][z] );
 
     free( vf->priv );
     vf->priv = NULL;
@@ -274,7 +293,10 @@ static const unsigned int fmt_list[] = {
 static int vf_open( vf_instance_t *vf, char *args ) {
     vf->config       = config;
     vf->put_image    = put_image;
-    vf->get_image    = get_image;
+    // in-place filtering reads rows below the ones already written,
+    // which other bands would overwrite concurrently
+    if( vf_threads_count() == 1 )
+        vf->get_image = get_image;
     vf->query_format = query_format;
     vf->uninit       = uninit;
     vf->priv         = malloc( sizeof(struct vf_priv_s) );
@@ -36,6 +36,7 @@
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "vf_threads.h"
 #include "av_helpers.h"
 #include "libvo/fastmemcpy.h"
 
@@ -105,12 +106,25 @@ struct vf_priv_s {
     int mpeg2;
     int temp_stride[3];
     uint8_t *src[3];
-    int16_t *temp[3];
     int outbuf_size;
-    uint8_t *outbuf;
+    int nthreads;
+    /// per job state, the passes of a frame are split between the jobs
+    struct uspp_thread {
+        int16_t *temp[3];
+        uint8_t *outbuf;
+        AVFrame *frame;
+    } thread[VF_MAX_THREADS];
     AVCodecContext *avctx_enc[BLOCK*BLOCK];
-    AVFrame *frame;
-    AVFrame *frame_dec;
+};
+
+struct filter_job {
+    struct vf_priv_s *p;
+    uint8_t **dst;
+    int *dst_stride;
+    int width, height;
+    int quality;
+    int njobs;
+    int nbands;
 };
 
 static void store_slice_c(uint8_t *dst, int16_t *src, int dst_stride, int src_stride, int width, int height, int log2_scale){
@@ -137,86 +151,137 @@ static void store_slice_c(uint8_t *dst, int16_t *src, int dst_stride, int src_st
         }
 }
 
-static void filter(struct vf_priv_s *p, uint8_t *dst[3], uint8_t *src[3], int dst_stride[3], int src_stride[3], int width, int height, uint8_t *qp_store, int qp_stride){
-    int x, y, i, j;
+/**
+ * \brief run the passes job, job+njobs, ... and sum them into the
+ * accumulator of the job
+ *
+ * Every pass has its own encoder so the passes are independent.
+ */
+static void filter_passes(void *ctx, int job, int thread){
+    struct filter_job *j= ctx;
+    struct vf_priv_s *p= j->p;
+    struct uspp_thread *t= &p->thread[job];
     const int count= 1<<p->log2_count;
+    const int width= j->width, height= j->height;
+    int x, y, i;
 
     for(i=0; i<3; i++){
         int is_chroma= !!i;
-        int w= width >>is_chroma;
         int h= height>>is_chroma;
-        int stride= p->temp_stride[i];
         int block= BLOCK>>is_chroma;
-
-        if (!src[i] || !dst[i])
-            continue; // HACK avoid crash for Y8 colourspace
-        for(y=0; y<h; y++){
-            int index= block + block*stride + y*stride;
-            fast_memcpy(p->src[i] + index, src[i] + y*src_stride[i], w);
-            for(x=0; x<block; x++){
-                p->src[i][index     - x - 1]= p->src[i][index +     x    ];
-                p->src[i][index + w + x    ]= p->src[i][index + w - x - 1];
-            }
-        }
-        for(y=0; y<block; y++){
-            fast_memcpy(p->src[i] + (  block-1-y)*stride, p->src[i] + (  y+block  )*stride, stride);
-            fast_memcpy(p->src[i] + (h+block  +y)*stride, p->src[i] + (h-y+block-1)*stride, stride);
-        }
-
-        p->frame->linesize[i]= stride;
-        memset(p->temp[i], 0, (h+2*block)*stride*sizeof(int16_t));
+        t->frame->linesize[i]= p->temp_stride[i];
+        memset(t->temp[i], 0, (h+2*block)*p->temp_stride[i]*sizeof(int16_t));
     }
+    t->frame->quality= j->quality;
 
-    if(p->qp)
-        p->frame->quality= p->qp * FF_QP2LAMBDA;
-    else
-        p->frame->quality= norm_qscale(qp_store[0], p->mpeg2) * FF_QP2LAMBDA;
-//    init per MB qscale stuff FIXME
-
-    for(i=0; i<count; i++){
+    for(i=job; i<count; i+=j->njobs){
         const int x1= offset[i+count-1][0];
         const int y1= offset[i+count-1][1];
         int offset;
         AVPacket pkt;
-        int ret, got_pkt;
-        p->frame->data[0]= p->src[0] + x1 + y1 * p->frame->linesize[0];
-        p->frame->data[1]= p->src[1] + x1/2 + y1/2 * p->frame->linesize[1];
-        p->frame->data[2]= p->src[2] + x1/2 + y1/2 * p->frame->linesize[2];
+        int got_pkt;
+        AVFrame *frame_dec;
+        t->frame->data[0]= p->src[0] + x1 + y1 * t->frame->linesize[0];
+        t->frame->data[1]= p->src[1] + x1/2 + y1/2 * t->frame->linesize[1];
+        t->frame->data[2]= p->src[2] + x1/2 + y1/2 * t->frame->linesize[2];
 
         av_init_packet(&pkt);
-        pkt.data = p->outbuf;
+        pkt.data = t->outbuf;
         pkt.size = p->outbuf_size;
-        avcodec_encode_video2(p->avctx_enc[i], &pkt, p->frame, &got_pkt);
-        p->frame_dec = p->avctx_enc[i]->coded_frame;
+        avcodec_encode_video2(p->avctx_enc[i], &pkt, t->frame, &got_pkt);
+        frame_dec = p->avctx_enc[i]->coded_frame;
 
-        offset= (BLOCK-x1) + (BLOCK-y1)*p->frame_dec->linesize[0];
+        offset= (BLOCK-x1) + (BLOCK-y1)*frame_dec->linesize[0];
         //FIXME optimize
         for(y=0; y<height; y++){
             for(x=0; x<width; x++){
-                p->temp[0][ x + y*p->temp_stride[0] ] += p->frame_dec->data[0][ x + y*p->frame_dec->linesize[0] + offset ];
+                t->temp[0][ x + y*p->temp_stride[0] ] += frame_dec->data[0][ x + y*frame_dec->linesize[0] + offset ];
             }
         }
-        offset= (BLOCK/2-x1/2) + (BLOCK/2-y1/2)*p->frame_dec->linesize[1];
+        offset= (BLOCK/2-x1/2) + (BLOCK/2-y1/2)*frame_dec->linesize[1];
         for(y=0; y<height/2; y++){
             for(x=0; x<width/2; x++){
-                p->temp[1][ x + y*p->temp_stride[1] ] += p->frame_dec->data[1][ x + y*p->frame_dec->linesize[1] + offset ];
-                p->temp[2][ x + y*p->temp_stride[2] ] += p->frame_dec->data[2][ x + y*p->frame_dec->linesize[2] + offset ];
+                t->temp[1][ x + y*p->temp_stride[1] ] += frame_dec->data[1][ x + y*frame_dec->linesize[1] + offset ];
+                t->temp[2][ x + y*p->temp_stride[2] ] += frame_dec->data[2][ x + y*frame_dec->linesize[2] + offset ];
             }
         }
     }
+}
+
+/// add up the accumulators of all jobs for a band of one plane and store it
+static void store_band(void *ctx, int job, int thread){
+    struct filter_job *j= ctx;
+    struct vf_priv_s *p= j->p;
+    int plane= job / j->nbands;
+    int band = job % j->nbands;
+    int is_chroma= !!plane;
+    int w= j->width >>is_chroma;
+    int h= j->height>>is_chroma;
+    int stride= p->temp_stride[plane];
+    // bands start on a multiple of 8 lines to keep the dither pattern
+    int y0= (h* band   /j->nbands)&~7;
+    int y1= band+1 == j->nbands ? h : (h*(band+1)/j->nbands)&~7;
+    int16_t *temp= p->thread[0].temp[plane] + y0*stride;
+    int i, x;
+
+    if (!j->dst[plane] || y0 >= y1)
+        return; // HACK avoid crash for Y8 colourspace
+    for(i=1; i<j->njobs; i++){
+        const int16_t *src= p->thread[i].temp[plane] + y0*stride;
+        for(x=0; x<(y1-y0)*stride; x++)
+            temp[x] += src[x];
+    }
+    store_slice_c(j->dst[plane] + y0*j->dst_stride[plane], temp, j->dst_stride[plane], stride, w, y1-y0, 8-p->log2_count);
+}
+
+static void filter(struct vf_priv_s *p, uint8_t *dst[3], uint8_t *src[3], int dst_stride[3], int src_stride[3], int width, int height, uint8_t *qp_store, int qp_stride){
+    int x, y, i;
+    struct filter_job job;
 
-    for(j=0; j<3; j++){
-        int is_chroma= !!j;
-        if (!dst[j])
+    for(i=0; i<3; i++){
+        int is_chroma= !!i;
+        int w= width >>is_chroma;
+        int h= height>>is_chroma;
+        int stride= p->temp_stride[i];
+        int block= BLOCK>>is_chroma;
+
+        if (!src[i] || !dst[i])
             continue; // HACK avoid crash for Y8 colourspace
-        store_slice_c(dst[j], p->temp[j], dst_stride[j], p->temp_stride[j], width>>is_chroma, height>>is_chroma, 8-p->log2_count);
+        for(y=0; y<h; y++){
+            int index= block + block*stride + y*stride;
+            fast_memcpy(p->src[i] + index, src[i] + y*src_stride[i], w);
+            for(x=0; x<block; x++){
+                p->src[i][index     - x - 1]= p->src[i][index +     x    ];
+                p->src[i][index + w + x    ]= p->src[i][index + w - x - 1];
+            }
+        }
+        for(y=0; y<block; y++){
+            fast_memcpy(p->src[i] + (  block-1-y)*stride, p->src[i] + (  y+block  )*stride, stride);
+            fast_memcpy(p->src[i] + (h+block  +y)*stride, p->src[i] + (h-y+block-1)*stride, stride);
+        }
     }
+
+    job.p= p;
+    job.dst= dst;
+    job.dst_stride= dst_stride;
+    job.width= width;
+    job.height= height;
+    if(p->qp)
+        job.quality= p->qp * FF_QP2LAMBDA;
+    else
+        job.quality= norm_qscale(qp_store[0], p->mpeg2) * FF_QP2LAMBDA;
+//    init per MB qscale stuff FIXME
+    job.njobs= XMIN(p->nthreads, 1<<p->log2_count);
+    job.nbands= XMIN(vf_threads_count(), (height>>1)/8 + 1);
+
+    vf_threads_execute(filter_passes, &job, job.njobs);
+    vf_threads_execute(store_band, &job, 3*job.nbands);
 }
 
 static int config(struct vf_instance *vf,
         int width, int height, int d_width, int d_height,
         unsigned int flags, unsigned int outfmt){
-        int i;
+        int i, j;
         AVCodec *enc= avcodec_find_encoder(AV_CODEC_ID_SNOW);
 
         for(i=0; i<3; i++){
@@ -225,9 +290,20 @@ static int config(struct vf_instance *vf,
             int h= ((height + 4*BLOCK-1) & (~(2*BLOCK-1)))>>is_chroma;
 
             vf->priv->temp_stride[i]= w;
-            vf->priv->temp[i]= malloc(vf->priv->temp_stride[i]*h*sizeof(int16_t));
             vf->priv->src [i]= malloc(vf->priv->temp_stride[i]*h*sizeof(uint8_t));
         }
+        vf->priv->nthreads= XMIN(vf_threads_count(), 1<<vf->priv->log2_count);
+        vf->priv->outbuf_size= (width + BLOCK)*(height + BLOCK)*10;
+        for(j=0; j<vf->priv->nthreads; j++){
+            struct uspp_thread *t= &vf->priv->thread[j];
+            for(i=0; i<3; i++){
+                int is_chroma= !!i;
+                int h= ((height + 4*BLOCK-1) & (~(2*BLOCK-1)))>>is_chroma;
+                t->temp[i]= malloc(vf->priv->temp_stride[i]*h*sizeof(int16_t));
+            }
+            t->frame= av_frame_alloc();
+            t->outbuf= malloc(vf->priv->outbuf_size);
+        }
         for(i=0; i< (1<<vf->priv->log2_count); i++){
             AVCodecContext *avctx_enc;
             AVDictionary *opts = NULL;
@@ -249,12 +325,6 @@ static int config(struct vf_instance *vf,
             av_dict_free(&opts);
             assert(avctx_enc->codec);
         }
-        vf->priv->frame= av_frame_alloc();
-        vf->priv->frame_dec= av_frame_alloc();
-
-        vf->priv->outbuf_size= (width + BLOCK)*(height + BLOCK)*10;
-        vf->priv->outbuf= malloc(vf->priv->outbuf_size);
-
         return vf_next_config(vf,width,height,d_width,d_height,flags,outfmt);
 }
 
@@ -311,15 +381,20 @@ static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
 }
 
 static void uninit(struct vf_instance *vf){
-    int i;
+    int i, j;
     if(!vf->priv) return;
 
     for(i=0; i<3; i++){
-        free(vf->priv->temp[i]);
-        vf->priv->temp[i]= NULL;
         free(vf->priv->src[i]);
         vf->priv->src[i]= NULL;
     }
+    for(j=0; j<vf->priv->nthreads; j++){
+        struct uspp_thread *t= &vf->priv->thread[j];
+        for(i=0; i<3; i++)
+            free(t->temp[i]);
+        free(t->outbuf);
+        av_frame_free(&t->frame);
+    }
     for(i=0; i<BLOCK*BLOCK; i++){
         av_freep(&vf->priv->avctx_enc[i]);
     }
@@ -48,10 +48,10 @@ struct vf_priv_s {
     int stride[3];
     uint8_t *ref[4][3];
     int do_deinterlace;
+    int bpp; // bytes per sample, 2 for the high bit depth formats
+    void (*filter_line)(struct vf_priv_s *p, uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int refs, int parity);
 };
 
-static void (*filter_line)(struct vf_priv_s *p, uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int refs, int parity);
-
 static void store_ref(struct vf_priv_s *p, uint8_t *src[3], int src_stride[3], int width, int height){
     int i;
 
@@ -60,7 +60,7 @@ static void store_ref(struct vf_priv_s *p, uint8_t *src[3], int src_stride[3], i
 
     for(i=0; i<3; i++){
         int is_chroma= !!i;
-        int pn_width  = width >>is_chroma;
+        int pn_width  = (width>>is_chroma) * p->bpp;
         int pn_height = height>>is_chroma;
 
 
@@ -76,6 +76,70 @@ static void store_ref(struct vf_priv_s *p, uint8_t *src[3], int src_stride[3], i
     }
 }
 
+#define CHECK(j)\
+    {   int score= FFABS(cur[-refs-1+j] - cur[+refs-1-j])\
+                 + FFABS(cur[-refs  +j] - cur[+refs  -j])\
+                 + FFABS(cur[-refs+1+j] - cur[+refs+1-j]);\
+        if(score < spatial_score){\
+            spatial_score= score;\
+            spatial_pred= (cur[-refs  +j] + cur[+refs  -j])>>1;\
+
+#define FILTER_LINE_C(name, pixel)\
+static void name(struct vf_priv_s *p, uint8_t *dst8, uint8_t *prev8, uint8_t *cur8, uint8_t *next8, int w, int refs, int parity){\
+    int x;\
+    pixel *dst = (pixel *)dst8;\
+    pixel *prev= (pixel *)prev8;\
+    pixel *cur = (pixel *)cur8;\
+    pixel *next= (pixel *)next8;\
+    pixel *prev2= parity ? prev : cur ;\
+    pixel *next2= parity ? cur  : next;\
+    refs /= sizeof(pixel);\
+    for(x=0; x<w; x++){\
+        int c= cur[-refs];\
+        int d= (prev2[0] + next2[0])>>1;\
+        int e= cur[+refs];\
+        int temporal_diff0= FFABS(prev2[0] - next2[0]);\
+        int temporal_diff1=( FFABS(prev[-refs] - c) + FFABS(prev[+refs] - e) )>>1;\
+        int temporal_diff2=( FFABS(next[-refs] - c) + FFABS(next[+refs] - e) )>>1;\
+        int diff= FFMAX3(temporal_diff0>>1, temporal_diff1, temporal_diff2);\
+        int spatial_pred= (c+e)>>1;\
+        int spatial_score= FFABS(cur[-refs-1] - cur[+refs-1]) + FFABS(c-e)\
+                         + FFABS(cur[-refs+1] - cur[+refs+1]) - 1;\
+\
+        CHECK(-1) CHECK(-2) }} }}\
+        CHECK( 1) CHECK( 2) }} }}\
+\
+        if(p->mode<2){\
+            int b= (prev2[-2*refs] + next2[-2*refs])>>1;\
+            int f= (prev2[+2*refs] + next2[+2*refs])>>1;\
+            int max= FFMAX3(d-e, d-c, FFMIN(b-c, f-e));\
+            int min= FFMIN3(d-e, d-c, FFMAX(b-c, f-e));\
+\
+            diff= FFMAX3(diff, min, -max);\
+        }\
+\
+        if(spatial_pred > d + diff)\
+           spatial_pred = d + diff;\
+        else if(spatial_pred < d - diff)\
+           spatial_pred = d - diff;\
+\
+        dst[0] = spatial_pred;\
+\
+        dst++;\
+        cur++;\
+        prev++;\
+        next++;\
+        prev2++;\
+        next2++;\
+    }\
+}
+
+FILTER_LINE_C(filter_line_c,   uint8_t)
+FILTER_LINE_C(filter_line_c16, uint16_t)
+
+#undef CHECK
+#undef FILTER_LINE_C
+
 #if HAVE_MMX_INLINE
 
 #define LOAD4(mem,dst) \
@@ -140,10 +204,10 @@ static void filter_line_mmx2(struct vf_priv_s *p, uint8_t *dst, uint8_t *prev, u
     static const uint64_t pb_1 = 0x0101010101010101ULL;
     const int mode = p->mode;
     uint64_t tmp0, tmp1, tmp2, tmp3;
-    int x;
+    int x, n = w & ~3;
 
 #define FILTER\
-    for(x=0; x<w; x+=4){\
+    for(x=0; x<n; x+=4){\
         __asm__ volatile(\
             "pxor      %%mm7, %%mm7 \n\t"\
             LOAD4("(%[cur],%[mrefs])", %%mm0) /* c = cur[x-refs] */\
@@ -281,6 +345,7 @@ static void filter_line_mmx2(struct vf_priv_s *p, uint8_t *dst, uint8_t *prev, u
 #undef prev2
 #undef next2
     }
+    filter_line_c(p, dst, prev, cur, next, w - n, refs, parity);
 }
 #undef LOAD4
 #undef PABS
@@ -291,99 +356,107 @@ static void filter_line_mmx2(struct vf_priv_s *p, uint8_t *dst, uint8_t *prev, u
 
 #endif /* HAVE_MMX_INLINE */
 
-static void filter_line_c(struct vf_priv_s *p, uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int refs, int parity){
-    int x;
-    uint8_t *prev2= parity ? prev : cur ;
-    uint8_t *next2= parity ? cur  : next;
-    for(x=0; x<w; x++){
-        int c= cur[-refs];
-        int d= (prev2[0] + next2[0])>>1;
-        int e= cur[+refs];
-        int temporal_diff0= FFABS(prev2[0] - next2[0]);
-        int temporal_diff1=( FFABS(prev[-refs] - c) + FFABS(prev[+refs] - e) )>>1;
-        int temporal_diff2=( FFABS(next[-refs] - c) + FFABS(next[+refs] - e) )>>1;
-        int diff= FFMAX3(temporal_diff0>>1, temporal_diff1, temporal_diff2);
-        int spatial_pred= (c+e)>>1;
-        int spatial_score= FFABS(cur[-refs-1] - cur[+refs-1]) + FFABS(c-e)
-                         + FFABS(cur[-refs+1] - cur[+refs+1]) - 1;
-
-#define CHECK(j)\
-    {   int score= FFABS(cur[-refs-1+j] - cur[+refs-1-j])\
-                 + FFABS(cur[-refs  +j] - cur[+refs  -j])\
-                 + FFABS(cur[-refs+1+j] - cur[+refs+1-j]);\
-        if(score < spatial_score){\
-            spatial_score= score;\
-            spatial_pred= (cur[-refs  +j] + cur[+refs  -j])>>1;\
+#if HAVE_SSE2_INLINE && HAVE_6REGS
+static const uint16_t __attribute__((aligned(32))) pw_1[16] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+static const uint8_t __attribute__((aligned(32))) pb_0[32];
+
+#define TEMPLATE_AVX2 0
+#define TEMPLATE_BPP  1
+#define TEMPLATE_TAIL filter_line_c
+#define RENAME(a) a ## _sse2
+#include "vf_yadif_template.c"
+#undef TEMPLATE_BPP
+#undef TEMPLATE_TAIL
+#undef RENAME
+#define TEMPLATE_BPP  2
+#define TEMPLATE_TAIL filter_line_c16
+#define RENAME(a) a ## _sse2_16
+#include "vf_yadif_template.c"
+#undef TEMPLATE_AVX2
+#undef TEMPLATE_BPP
+#undef TEMPLATE_TAIL
+#undef RENAME
+
+#if HAVE_AVX2_INLINE
+#define TEMPLATE_AVX2 1
+#define TEMPLATE_BPP  1
+#define TEMPLATE_TAIL filter_line_c
+#define RENAME(a) a ## _avx2
+#include "vf_yadif_template.c"
+#undef TEMPLATE_BPP
+#undef TEMPLATE_TAIL
+#undef RENAME
+#define TEMPLATE_BPP  2
+#define TEMPLATE_TAIL filter_line_c16
+#define RENAME(a) a ## _avx2_16
+#include "vf_yadif_template.c"
+#undef TEMPLATE_AVX2
+#undef TEMPLATE_BPP
+#undef TEMPLATE_TAIL
+#undef RENAME
+#endif /* HAVE_AVX2_INLINE */
+#endif /* HAVE_SSE2_INLINE && HAVE_6REGS */
 
-        CHECK(-1) CHECK(-2) }} }}
-        CHECK( 1) CHECK( 2) }} }}
-
-        if(p->mode<2){
-            int b= (prev2[-2*refs] + next2[-2*refs])>>1;
-            int f= (prev2[+2*refs] + next2[+2*refs])>>1;
-#if 0
-            int a= cur[-3*refs];
-            int g= cur[+3*refs];
-            int max= FFMAX3(d-e, d-c, FFMIN3(FFMAX(b-c,f-e),FFMAX(b-c,b-a),FFMAX(f-g,f-e)) );
-            int min= FFMIN3(d-e, d-c, FFMAX3(FFMIN(b-c,f-e),FFMIN(b-c,b-a),FFMIN(f-g,f-e)) );
-#else
-            int max= FFMAX3(d-e, d-c, FFMIN(b-c, f-e));
-            int min= FFMIN3(d-e, d-c, FFMAX(b-c, f-e));
-#endif
+/*
+ * Lines only read the reference planes and write their own row of dst, so
+ * the rows of a plane can be split into bands freely; the field parity of a
+ * row depends on its absolute position only.
+ */
+struct yadif_plane {
+    struct vf_priv_s *p;
+    uint8_t *dst;
+    int dst_stride;
+    int plane, w, parity, tff;
+};
 
-            diff= FFMAX3(diff, min, -max);
+static void filter_band(void *ctx, int warm_y, int y0, int y1, int thread){
+    struct yadif_plane *b = ctx;
+    struct vf_priv_s *p = b->p;
+    int i = b->plane;
+    int refs= p->stride[i];
+    int y;
+
+    for(y=y0; y<y1; y++){
+        if((y ^ b->parity) & 1){
+            uint8_t *prev= &p->ref[0][i][y*refs];
+            uint8_t *cur = &p->ref[1][i][y*refs];
+            uint8_t *next= &p->ref[2][i][y*refs];
+            uint8_t *dst2= &b->dst[y*b->dst_stride];
+            p->filter_line(p, dst2, prev, cur, next, b->w, refs, b->parity ^ b->tff);
+        }else{
+            fast_memcpy(&b->dst[y*b->dst_stride], &p->ref[1][i][y*refs], b->w*p->bpp);
         }
-
-        if(spatial_pred > d + diff)
-           spatial_pred = d + diff;
-        else if(spatial_pred < d - diff)
-           spatial_pred = d - diff;
-
-        dst[0] = spatial_pred;
-
-        dst++;
-        cur++;
-        prev++;
-        next++;
-        prev2++;
-        next2++;
     }
+#if HAVE_MMX_INLINE
+    if(gCpuCaps.hasMMX2) __asm__ volatile("emms \n\t" : : : "memory");
+#endif
 }
 
 static void filter(struct vf_priv_s *p, uint8_t *dst[3], int dst_stride[3], int width, int height, int parity, int tff){
-    int y, i;
+    int i;
 
     for(i=0; i<3; i++){
         int is_chroma= !!i;
-        int w= width >>is_chroma;
-        int h= height>>is_chroma;
-        int refs= p->stride[i];
-
-        for(y=0; y<h; y++){
-            if((y ^ parity) & 1){
-                uint8_t *prev= &p->ref[0][i][y*refs];
-                uint8_t *cur = &p->ref[1][i][y*refs];
-                uint8_t *next= &p->ref[2][i][y*refs];
-                uint8_t *dst2= &dst[i][y*dst_stride[i]];
-                filter_line(p, dst2, prev, cur, next, w, refs, parity ^ tff);
-            }else{
-                fast_memcpy(&dst[i][y*dst_stride[i]], &p->ref[1][i][y*refs], w);
-            }
-        }
+        struct yadif_plane b = {
+            p, dst[i], dst_stride[i], i, width>>is_chroma, parity, tff
+        };
+        vf_run_bands(filter_band, &b, height>>is_chroma, 0, 1);
     }
-#if HAVE_MMX_INLINE
-    if(gCpuCaps.hasMMX2) __asm__ volatile("emms \n\t" : : : "memory");
-#endif
 }
 
 static int config(struct vf_instance *vf,
         int width, int height, int d_width, int d_height,
 	unsigned int flags, unsigned int outfmt){
-        int i, j;
+        int i, j, bits;
+
+        mp_get_chroma_shift(outfmt, NULL, NULL, &bits);
+        vf->priv->bpp = (bits + 7) >> 3;
 
         for(i=0; i<3; i++){
             int is_chroma= !!i;
-            int w= ((width   + 31) & (~31))>>is_chroma;
+            int w= (((width   + 31) & (~31))>>is_chroma) * vf->priv->bpp;
             int h=(((height  +  1) & ( ~1))>>is_chroma) + 6;
 
             vf->priv->stride[i]= w;
@@ -391,6 +464,28 @@ static int config(struct vf_instance *vf,
                 vf->priv->ref[j][i]= (uint8_t *)malloc(w*h*sizeof(uint8_t))+3*w;
         }
 
+        if(vf->priv->bpp == 1){
+            vf->priv->filter_line = filter_line_c;
+#if HAVE_MMX_INLINE
+            if(gCpuCaps.hasMMX2) vf->priv->filter_line = filter_line_mmx2;
+#endif
+#if HAVE_SSE2_INLINE && HAVE_6REGS
+            if(gCpuCaps.hasSSE2) vf->priv->filter_line = filter_line_sse2;
+#if HAVE_AVX2_INLINE
+            if(gCpuCaps.hasAVX2) vf->priv->filter_line = filter_line_avx2;
+#endif
+#endif
+        }else{
+            vf->priv->filter_line = filter_line_c16;
+            // the SIMD versions keep the scores in signed words
+#if HAVE_SSE2_INLINE && HAVE_6REGS
+            if(bits <= 12 && gCpuCaps.hasSSE2) vf->priv->filter_line = filter_line_sse2_16;
+#if HAVE_AVX2_INLINE
+            if(bits <= 12 && gCpuCaps.hasAVX2) vf->priv->filter_line = filter_line_avx2_16;
+#endif
+#endif
+        }
+
 	return vf_next_config(vf,width,height,d_width,d_height,flags,outfmt);
 }
 
@@ -474,6 +569,11 @@ static int query_format(struct vf_instance *vf, unsigned int fmt){
 	case IMGFMT_IYUV:
 	case IMGFMT_Y800:
 	case IMGFMT_Y8:
+	case IMGFMT_420P16:
+	case IMGFMT_420P14:
+	case IMGFMT_420P12:
+	case IMGFMT_420P10:
+	case IMGFMT_420P9:
 	    return vf_next_query_format(vf,fmt);
     }
     return 0;
@@ -507,11 +607,6 @@ static int vf_open(vf_instance_t *vf, char *args){
 
     if (args) sscanf(args, "%d:%d", &vf->priv->mode, &vf->priv->parity);
 
-    filter_line = filter_line_c;
-#if HAVE_MMX_INLINE
-    if(gCpuCaps.hasMMX2) filter_line = filter_line_mmx2;
-#endif
-
     return 1;
 }
 
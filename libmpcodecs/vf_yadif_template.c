@@ -0,0 +1,273 @@
+/*
+ * SSE2/AVX2 line filter for yadif, included from vf_yadif.c
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Parameters:
+ * RENAME(a)      name of the generated function
+ * TEMPLATE_AVX2  1 for 16 pixels per ymm register, 0 for 8 per xmm
+ * TEMPLATE_BPP   bytes per pixel, 1 or 2; 2 needs at most 12 bit samples
+ *                so that the scores plus the CHECK2 penalty fit in a word
+ * TEMPLATE_TAIL  C line filter for the pixels that do not fill a register
+ *
+ * Works on words like the MMX2 version, but loads the neighbours from
+ * memory instead of shifting them into place, which lanes do not allow.
+ */
+
+#if TEMPLATE_AVX2
+#define R(n)          "%%ymm" #n
+#define OP(op, a, b)  "v" #op " " a ", " b ", " b " \n\t"
+#define OPI(op, i, b) "v" #op " $" #i ", " b ", " b " \n\t"
+#define MOV(a, b)     "vmovdqa " a ", " b " \n\t"
+#define MOVU(a, b)    "vmovdqu " a ", " b " \n\t"
+#define ABS(tmp, dst) "vpabsw " dst ", " dst " \n\t"
+#define STEP 16
+#else
+#define R(n)          "%%xmm" #n
+#define OP(op, a, b)  #op " " a ", " b " \n\t"
+#define OPI(op, i, b) #op " $" #i ", " b " \n\t"
+#define MOV(a, b)     "movdqa " a ", " b " \n\t"
+#define MOVU(a, b)    "movdqu " a ", " b " \n\t"
+#define ABS(tmp, dst) OP(pxor, tmp, tmp) OP(psubw, dst, tmp) OP(pmaxsw, tmp, dst)
+#define STEP 8
+#endif
+
+#if TEMPLATE_BPP == 2
+#define PX(k) #k "*2"
+#define LOAD(mem, dst) MOVU(mem, dst)
+#define STORE MOVU(R(1), "(%[dst])")
+#elif TEMPLATE_AVX2
+#define PX(k) #k
+#define LOAD(mem, dst) "vpmovzxbw " mem ", " dst " \n\t"
+#define STORE \
+            "vextracti128 $1, %%ymm1, %%xmm2 \n\t"\
+            "vpackuswb %%xmm2, %%xmm1, %%xmm1 \n\t"\
+            "vmovdqu   %%xmm1, (%[dst])       \n\t"
+#else
+#define PX(k) #k
+#define LOAD(mem, dst) "movq " mem ", " dst " \n\t" OP(punpcklbw, "%[zero]", dst)
+#define STORE \
+            "packuswb  %%xmm1, %%xmm1 \n\t"\
+            "movq      %%xmm1, (%[dst]) \n\t"
+#endif
+
+#define TOP(k) PX(k) "(%[cur],%[mrefs])" /* cur[x-refs+k] */
+#define BOT(k) PX(k) "(%[cur],%[prefs])" /* cur[x+refs+k] */
+
+#define ABSDIFF(a, b, dst, tmp) \
+            LOAD(a, dst)\
+            LOAD(b, tmp)\
+            OP(psubw, tmp, dst)\
+            ABS(tmp, dst)
+
+/* score and spatial_pred for direction j, the top pixels are j-1, j, j+1
+ * and the bottom ones -j-1, -j, -j+1 */
+#define CHECK(t0, t1, t2, b0, b1, b2) \
+            ABSDIFF(TOP(t0), BOT(b0), R(2), R(3))\
+            ABSDIFF(TOP(t1), BOT(b1), R(3), R(4))\
+            OP(paddw,  R(3), R(2))\
+            ABSDIFF(TOP(t2), BOT(b2), R(3), R(4))\
+            OP(paddw,  R(3), R(2)) /* score */\
+            LOAD(TOP(t1), R(5))\
+            LOAD(BOT(b1), R(4))\
+            OP(paddw,  R(4), R(5))\
+            OPI(psrlw, 1, R(5))    /* (cur[x-refs+j] + cur[x+refs-j])>>1 */
+
+#define CHECK1 \
+            MOV(R(0), R(3))\
+            OP(pcmpgtw, R(2), R(3)) /* if(score < spatial_score) */\
+            OP(pminsw,  R(2), R(0)) /* spatial_score= score; */\
+            MOV(R(3), R(6))\
+            OP(pand,    R(3), R(5))\
+            OP(pandn,   R(1), R(3))\
+            OP(por,     R(5), R(3))\
+            MOV(R(3), R(1))         /* spatial_pred= (cur[x-refs+j] + cur[x+refs-j])>>1; */
+
+#define CHECK2 /* pretend not to have checked dir=2 if dir=1 was bad, as in the C version */\
+            OP(paddw,  "%[pw1]", R(6))\
+            OPI(psllw, 14, R(6))\
+            OP(paddsw,  R(6), R(2))\
+            MOV(R(0), R(3))\
+            OP(pcmpgtw, R(2), R(3))\
+            OP(pminsw,  R(2), R(0))\
+            OP(pand,    R(3), R(5))\
+            OP(pandn,   R(1), R(3))\
+            OP(por,     R(5), R(3))\
+            MOV(R(3), R(1))
+
+#define FILTER\
+    for(x=0; x<n; x+=STEP){\
+        __asm__ volatile(\
+            LOAD(TOP(0), R(0))                 /* c = cur[x-refs] */\
+            LOAD(BOT(0), R(1))                 /* e = cur[x+refs] */\
+            LOAD("(%["prev2"])", R(2))         /* prev2[x] */\
+            LOAD("(%["next2"])", R(3))         /* next2[x] */\
+            MOV(R(3), R(4))\
+            OP(paddw,  R(2), R(3))\
+            OPI(psrlw, 1, R(3))                /* d = (prev2[x] + next2[x])>>1 */\
+            MOVU(R(0), "%[tmp0]")              /* c */\
+            MOVU(R(3), "%[tmp1]")              /* d */\
+            MOVU(R(1), "%[tmp2]")              /* e */\
+            OP(psubw,  R(4), R(2))\
+            ABS(R(4), R(2))                    /* temporal_diff0 */\
+            LOAD("(%[prev],%[mrefs])", R(3))   /* prev[x-refs] */\
+            LOAD("(%[prev],%[prefs])", R(4))   /* prev[x+refs] */\
+            OP(psubw,  R(0), R(3))\
+            OP(psubw,  R(1), R(4))\
+            ABS(R(5), R(3))\
+            ABS(R(5), R(4))\
+            OP(paddw,  R(4), R(3))             /* temporal_diff1 */\
+            OPI(psrlw, 1, R(2))\
+            OPI(psrlw, 1, R(3))\
+            OP(pmaxsw, R(3), R(2))\
+            LOAD("(%[next],%[mrefs])", R(3))   /* next[x-refs] */\
+            LOAD("(%[next],%[prefs])", R(4))   /* next[x+refs] */\
+            OP(psubw,  R(0), R(3))\
+            OP(psubw,  R(1), R(4))\
+            ABS(R(5), R(3))\
+            ABS(R(5), R(4))\
+            OP(paddw,  R(4), R(3))             /* temporal_diff2 */\
+            OPI(psrlw, 1, R(3))\
+            OP(pmaxsw, R(3), R(2))\
+            MOVU(R(2), "%[tmp3]")              /* diff */\
+\
+            OP(paddw,  R(0), R(1))\
+            OP(paddw,  R(0), R(0))\
+            OP(psubw,  R(1), R(0))\
+            OPI(psrlw, 1, R(1))                /* spatial_pred */\
+            ABS(R(2), R(0))                    /* ABS(c-e) */\
+            ABSDIFF(TOP(-1), BOT(-1), R(2), R(3))\
+            OP(paddw,  R(2), R(0))\
+            ABSDIFF(TOP(1), BOT(1), R(2), R(3))\
+            OP(paddw,  R(2), R(0))\
+            OP(psubw,  "%[pw1]", R(0))         /* spatial_score */\
+\
+            CHECK(-2, -1, 0,  0, 1, 2)\
+            CHECK1\
+            CHECK(-3, -2, -1, 1, 2, 3)\
+            CHECK2\
+            CHECK(0, 1, 2,  -2, -1, 0)\
+            CHECK1\
+            CHECK(1, 2, 3,  -3, -2, -1)\
+            CHECK2\
+\
+            /* if(p->mode<2) ... */\
+            MOVU("%[tmp3]", R(6))              /* diff */\
+            "cmpl      $2, %[mode] \n\t"\
+            "jge       1f \n\t"\
+            LOAD("(%["prev2"],%[mrefs],2)", R(2)) /* prev2[x-2*refs] */\
+            LOAD("(%["next2"],%[mrefs],2)", R(4)) /* next2[x-2*refs] */\
+            LOAD("(%["prev2"],%[prefs],2)", R(3)) /* prev2[x+2*refs] */\
+            LOAD("(%["next2"],%[prefs],2)", R(5)) /* next2[x+2*refs] */\
+            OP(paddw,  R(4), R(2))\
+            OP(paddw,  R(5), R(3))\
+            OPI(psrlw, 1, R(2))                /* b */\
+            OPI(psrlw, 1, R(3))                /* f */\
+            MOVU("%[tmp0]", R(4))              /* c */\
+            MOVU("%[tmp1]", R(5))              /* d */\
+            MOVU("%[tmp2]", R(7))              /* e */\
+            OP(psubw,  R(4), R(2))             /* b-c */\
+            OP(psubw,  R(7), R(3))             /* f-e */\
+            MOV(R(5), R(0))\
+            OP(psubw,  R(4), R(5))             /* d-c */\
+            OP(psubw,  R(7), R(0))             /* d-e */\
+            MOV(R(2), R(4))\
+            OP(pminsw, R(3), R(2))\
+            OP(pmaxsw, R(4), R(3))\
+            OP(pmaxsw, R(5), R(2))\
+            OP(pminsw, R(5), R(3))\
+            OP(pmaxsw, R(0), R(2))             /* max */\
+            OP(pminsw, R(0), R(3))             /* min */\
+            OP(pxor,   R(4), R(4))\
+            OP(pmaxsw, R(3), R(6))\
+            OP(psubw,  R(2), R(4))             /* -max */\
+            OP(pmaxsw, R(4), R(6))             /* diff= MAX3(diff, min, -max); */\
+            "1: \n\t"\
+\
+            MOVU("%[tmp1]", R(2))              /* d */\
+            MOV(R(2), R(3))\
+            OP(psubw,  R(6), R(2))             /* d-diff */\
+            OP(paddw,  R(6), R(3))             /* d+diff */\
+            OP(pmaxsw, R(2), R(1))\
+            OP(pminsw, R(3), R(1))             /* d = clip(spatial_pred, d-diff, d+diff); */\
+            STORE\
+\
+            :[tmp0]"=m"(tmp[0]),\
+             [tmp1]"=m"(tmp[1]),\
+             [tmp2]"=m"(tmp[2]),\
+             [tmp3]"=m"(tmp[3])\
+            :[prev] "r"(prev),\
+             [cur]  "r"(cur),\
+             [next] "r"(next),\
+             [dst]  "r"(dst),\
+             [prefs]"r"((x86_reg)refs),\
+             [mrefs]"r"((x86_reg)-refs),\
+             [pw1]  "m"(pw_1),\
+             [zero] "m"(pb_0),\
+             [mode] "m"(mode)\
+            :XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",\
+                          "xmm4", "xmm5", "xmm6", "xmm7",) "memory"\
+        );\
+        dst += STEP*TEMPLATE_BPP;\
+        prev+= STEP*TEMPLATE_BPP;\
+        cur += STEP*TEMPLATE_BPP;\
+        next+= STEP*TEMPLATE_BPP;\
+    }
+
+static void RENAME(filter_line)(struct vf_priv_s *p, uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int refs, int parity){
+    uint16_t __attribute__((aligned(32))) tmp[4][16];
+    const int mode = p->mode;
+    int x, n = w & ~(STEP-1);
+
+    if(parity){
+#define prev2 "prev"
+#define next2 "cur"
+        FILTER
+#undef prev2
+#undef next2
+    }else{
+#define prev2 "cur"
+#define next2 "next"
+        FILTER
+#undef prev2
+#undef next2
+    }
+#if TEMPLATE_AVX2
+    __asm__ volatile("vzeroupper \n\t");
+#endif
+    TEMPLATE_TAIL(p, dst, prev, cur, next, w - n, refs, parity);
+}
+
+#undef R
+#undef OP
+#undef OPI
+#undef MOV
+#undef MOVU
+#undef ABS
+#undef STEP
+#undef PX
+#undef LOAD
+#undef STORE
+#undef TOP
+#undef BOT
+#undef ABSDIFF
+#undef CHECK
+#undef CHECK1
+#undef CHECK2
+#undef FILTER
@@ -2013,10 +2013,12 @@ static demuxer_t* mov_read_header(demuxer_t* demuxer){
             if(trak->media_handler == MOV_FOURCC('M','P','E','G')) {
                 stream_t *s;
                 demuxer_t *od;
+                int mp3_audio;
 
                 demuxer->video->id = t_no;
                 s = new_ds_stream(demuxer->video);
-                od = demux_open(s, DEMUXER_TYPE_MPEG_PS, -1, -1, -1, NULL);
+                // the settings are applied for the outer demuxer
+                od = demux_open_detached(s, DEMUXER_TYPE_MPEG_PS, -1, -1, -1, NULL, &mp3_audio);
                 if(od) return new_demuxers_demuxer(od, od, od);
                 demuxer->video->id = -2;	//new linked demuxer couldn't be allocated
                 break;
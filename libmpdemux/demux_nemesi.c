@@ -413,7 +413,7 @@ static void demux_seek_rtp(demuxer_t *demuxer, float rel_seek_secs,
 
     //flags & 1 -> absolute seek
     //flags & 2 -> percent seek
-    if (flags == 0) {
+    if (!(flags & (SEEK_ABSOLUTE | SEEK_FACTOR))) {
         time += rel_seek_secs;
         if (time < r.begin)
             time = r.begin;
@@ -1224,8 +1224,14 @@ char *demuxer_name = NULL;       // parameter from -demuxer
 char *audio_demuxer_name = NULL; // parameter from -audio-demuxer
 char *sub_demuxer_name = NULL;   // parameter from -sub-demuxer
 
-demuxer_t *demux_open(stream_t *vs, int file_format, int audio_id,
-                      int video_id, int dvdsub_id, char *filename)
+/**
+ * Open the demuxers without changing the player settings, which is left to
+ * demux_apply_settings() so that the open can be done from another thread.
+ * \param mp3_audio set to 1 if an MP3 -audiofile was opened
+ */
+demuxer_t *demux_open_detached(stream_t *vs, int file_format, int audio_id,
+                               int video_id, int dvdsub_id, char *filename,
+                               int *mp3_audio)
 {
     stream_t *as = NULL, *ss = NULL;
     demuxer_t *vd, *ad = NULL, *sd = NULL;
@@ -1304,7 +1310,7 @@ demuxer_t *demux_open(stream_t *vs, int file_format, int audio_id,
             free_stream(as);
         } else if (ad->audio->sh
                    && ((sh_audio_t *) ad->audio->sh)->format == 0x55) // MP3
-            hr_mp3_seek = 1;    // Enable high res seeking
+            *mp3_audio = 1;
     }
     if (ss) {
         sd = demux_open_stream(ss, sub_demuxer_type ? sub_demuxer_type : sfmt,
@@ -1325,11 +1331,28 @@ demuxer_t *demux_open(stream_t *vs, int file_format, int audio_id,
         res = new_demuxers_demuxer(vd, vd, sd);
     else
         res = vd;
+    return res;
+}
 
+/// Set correct_pts and hr_mp3_seek for a demuxer from demux_open_detached().
+void demux_apply_settings(demuxer_t *demuxer, int mp3_audio)
+{
+    if (mp3_audio)
+        hr_mp3_seek = 1;    // Enable high res seeking
     correct_pts = user_correct_pts;
     if (correct_pts < 0)
-        correct_pts = !force_fps && demux_control(res, DEMUXER_CTRL_CORRECT_PTS, NULL)
+        correct_pts = !force_fps && demux_control(demuxer, DEMUXER_CTRL_CORRECT_PTS, NULL)
                       == DEMUXER_CTRL_OK;
+}
+
+demuxer_t *demux_open(stream_t *vs, int file_format, int audio_id,
+                      int video_id, int dvdsub_id, char *filename)
+{
+    int mp3_audio = 0;
+    demuxer_t *res = demux_open_detached(vs, file_format, audio_id, video_id,
+                                         dvdsub_id, filename, &mp3_audio);
+    if (res)
+        demux_apply_settings(res, mp3_audio);
     return res;
 }
 
@@ -1437,6 +1460,7 @@ int demux_info_add(demuxer_t *demuxer, const char *opt, const char *param)
                    param);
             free(info[2 * n + 1]);
             info[2 * n + 1] = strdup(param);
+            demuxer->info_changed = 1;
             return 0;
         }
     }
@@ -1445,6 +1469,7 @@ int demux_info_add(demuxer_t *demuxer, const char *opt, const char *param)
     info[2 * n] = strdup(opt);
     info[2 * n + 1] = strdup(param);
     memset(&info[2 * (n + 1)], 0, 2 * sizeof(char *));
+    demuxer->info_changed = 1;
 
     return 1;
 }
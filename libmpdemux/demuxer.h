@@ -113,6 +113,8 @@
 
 #define SEEK_ABSOLUTE (1 << 0)
 #define SEEK_FACTOR   (1 << 1)
+/// hint: land on a keyframe at or before the target, demuxers may ignore it
+#define SEEK_BACKWARD (1 << 2)
 
 #define MP_INPUT_BUFFER_PADDING_SIZE 64
 
@@ -274,6 +276,7 @@ typedef struct demuxer {
 
   void* priv;  // fileformat-dependent data
   char** info;
+  int info_changed; // set by demux_info_add(), cleared by the player
 } demuxer_t;
 
 typedef struct {
@@ -423,6 +426,8 @@ static inline int avi_stream_id(unsigned int id){
 }
 
 demuxer_t* demux_open(stream_t *stream,int file_format,int aid,int vid,int sid,char* filename);
+demuxer_t* demux_open_detached(stream_t *stream,int file_format,int aid,int vid,int sid,char* filename,int *mp3_audio);
+void demux_apply_settings(demuxer_t *demuxer,int mp3_audio);
 void demux_flush(demuxer_t *demuxer);
 int demux_seek(demuxer_t *demuxer,float rel_seek_secs,float audio_delay,int flags);
 demuxer_t*  new_demuxers_demuxer(demuxer_t* vd, demuxer_t* ad, demuxer_t* sd);
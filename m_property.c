@@ -33,26 +33,123 @@
 #include "mpcommon.h"
 #include "help_mp.h"
 
-static int do_action(const m_option_t* prop_list, const char* name,
-                     int action, void* arg, void *ctx) {
+/// Properties of a list sorted by name for bsearch lookups. The few
+/// wildcard names are kept apart and checked in list order.
+typedef struct prop_index {
+    const m_option_t* list;
+    const m_option_t** sorted;
+    int count;
+    const m_option_t** wild;
+    int wild_count;
+} prop_index_t;
+
+#define MAX_PROP_INDEX 4
+static prop_index_t prop_indexes[MAX_PROP_INDEX];
+
+static int cmp_prop(const void* a, const void* b) {
+    return strcasecmp((*(const m_option_t* const*)a)->name,
+                      (*(const m_option_t* const*)b)->name);
+}
+
+static int is_wildcard(const m_option_t* opt) {
+    int l = strlen(opt->name) - 1;
+    return (opt->type->flags & M_OPT_TYPE_ALLOW_WILDCARD) &&
+           l > 0 && opt->name[l] == '*';
+}
+
+static prop_index_t* get_index(const m_option_t* list) {
+    prop_index_t* idx;
+    int i, n;
+
+    for(i = 0 ; i < MAX_PROP_INDEX && prop_indexes[i].list ; i++)
+        if(prop_indexes[i].list == list)
+            return &prop_indexes[i];
+    if(i == MAX_PROP_INDEX)
+        return NULL;
+    idx = &prop_indexes[i];
+    for(n = 0 ; list[n].name ; n++);
+    idx->sorted = malloc(n * sizeof(*idx->sorted));
+    idx->wild = malloc(n * sizeof(*idx->wild));
+    if(!idx->sorted || !idx->wild) {
+        free(idx->sorted);
+        free(idx->wild);
+        return NULL;
+    }
+    idx->count = idx->wild_count = 0;
+    for(i = 0 ; i < n ; i++) {
+        if(is_wildcard(&list[i]))
+            idx->wild[idx->wild_count++] = &list[i];
+        else
+            idx->sorted[idx->count++] = &list[i];
+    }
+    qsort(idx->sorted, idx->count, sizeof(*idx->sorted), cmp_prop);
+    idx->list = list;
+    return idx;
+}
+
+/// Same result as m_option_list_find().
+static const m_option_t* find_prop(const m_option_t* list, const char* name) {
+    prop_index_t* idx = get_index(list);
+    const m_option_t* found = NULL;
+    int lo, hi, i;
+
+    if(!idx)
+        return m_option_list_find(list, name);
+    lo = 0, hi = idx->count - 1;
+    while(lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int c = strcasecmp(idx->sorted[mid]->name, name);
+        if(!c) {
+            // the first of equal names in the list wins
+            found = idx->sorted[mid];
+            for(i = mid - 1 ; i >= 0 && !strcasecmp(idx->sorted[i]->name, name) ; i--)
+                if(idx->sorted[i] < found) found = idx->sorted[i];
+            for(i = mid + 1 ; i < idx->count && !strcasecmp(idx->sorted[i]->name, name) ; i++)
+                if(idx->sorted[i] < found) found = idx->sorted[i];
+            break;
+        }
+        if(c < 0) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    // a wildcard before it in the list takes precedence
+    for(i = 0 ; i < idx->wild_count ; i++) {
+        const m_option_t* w = idx->wild[i];
+        if(found && w > found)
+            break;
+        if(!strncasecmp(w->name, name, strlen(w->name) - 1))
+            return w;
+    }
+    return found;
+}
+
+/// Find the property of a path, key is set to the part after the '/'.
+static const m_option_t* resolve(const m_option_t* prop_list, const char* name,
+                                 const char** key) {
     const char* sep;
-    const m_option_t* prop;
-    m_property_action_t ka;
-    int r;
+    *key = NULL;
     if((sep = strchr(name,'/')) && sep[1]) {
         int len = sep-name;
         char base[len+1];
         memcpy(base,name,len);
         base[len] = 0;
-        prop = m_option_list_find(prop_list, base);
-        ka.key = sep+1;
+        *key = sep+1;
+        return find_prop(prop_list, base);
+    }
+    return find_prop(prop_list, name);
+}
+
+static int do_action(const m_option_t* prop, const char* key,
+                     int action, void* arg, void *ctx) {
+    m_property_action_t ka;
+    int r;
+    if(!prop) return M_PROPERTY_UNKNOWN;
+    if(key) {
+        ka.key = key;
         ka.action = action;
         ka.arg = arg;
         action = M_PROPERTY_KEY_ACTION;
         arg = &ka;
-    } else
-        prop = m_option_list_find(prop_list, name);
-    if(!prop) return M_PROPERTY_UNKNOWN;
+    }
     r = ((m_property_ctrl_f)prop->p)(prop,action,arg,ctx);
     if(action == M_PROPERTY_GET_TYPE && r < 0) {
         if(!arg) return M_PROPERTY_ERROR;
@@ -62,8 +159,8 @@ static int do_action(const m_option_t* prop_list, const char* name,
     return r;
 }
 
-int m_property_do(const m_option_t* prop_list, const char* name,
-                  int action, void* arg, void *ctx) {
+static int property_do(const m_option_t* prop, const char* key,
+                       int action, void* arg, void *ctx) {
     const m_option_t* opt;
     void* val;
     char* str;
@@ -71,18 +168,18 @@ int m_property_do(const m_option_t* prop_list, const char* name,
 
     switch(action) {
     case M_PROPERTY_PRINT:
-        if((r = do_action(prop_list,name,M_PROPERTY_PRINT,arg,ctx)) >= 0)
+        if((r = do_action(prop,key,M_PROPERTY_PRINT,arg,ctx)) >= 0)
             return r;
         // fallback on the default print for this type
     case M_PROPERTY_TO_STRING:
-        if((r = do_action(prop_list,name,M_PROPERTY_TO_STRING,arg,ctx)) !=
+        if((r = do_action(prop,key,M_PROPERTY_TO_STRING,arg,ctx)) !=
            M_PROPERTY_NOT_IMPLEMENTED)
             return r;
         // fallback on the options API. Get the type, value and print.
-        if((r = do_action(prop_list,name,M_PROPERTY_GET_TYPE,&opt,ctx)) <= 0)
+        if((r = do_action(prop,key,M_PROPERTY_GET_TYPE,&opt,ctx)) <= 0)
             return r;
         val = calloc(1,opt->type->size);
-        if((r = do_action(prop_list,name,M_PROPERTY_GET,val,ctx)) <= 0) {
+        if((r = do_action(prop,key,M_PROPERTY_GET,val,ctx)) <= 0) {
             free(val);
             return r;
         }
@@ -93,11 +190,11 @@ int m_property_do(const m_option_t* prop_list, const char* name,
         return str != (char*)-1;
     case M_PROPERTY_PARSE:
         // try the property own parsing func
-        if((r = do_action(prop_list,name,M_PROPERTY_PARSE,arg,ctx)) !=
+        if((r = do_action(prop,key,M_PROPERTY_PARSE,arg,ctx)) !=
            M_PROPERTY_NOT_IMPLEMENTED)
             return r;
         // fallback on the options API, get the type and parse.
-        if((r = do_action(prop_list,name,M_PROPERTY_GET_TYPE,&opt,ctx)) <= 0)
+        if((r = do_action(prop,key,M_PROPERTY_GET_TYPE,&opt,ctx)) <= 0)
             return r;
         if(!arg) return M_PROPERTY_ERROR;
         val = calloc(1,opt->type->size);
@@ -105,94 +202,237 @@ int m_property_do(const m_option_t* prop_list, const char* name,
             free(val);
             return r;
         }
-        r = do_action(prop_list,name,M_PROPERTY_SET,val,ctx);
+        r = do_action(prop,key,M_PROPERTY_SET,val,ctx);
         m_option_free(opt,val);
         free(val);
         return r;
     }
-    return do_action(prop_list,name,action,arg,ctx);
+    return do_action(prop,key,action,arg,ctx);
 }
 
-char* m_properties_expand_string(const m_option_t* prop_list,char* str, void *ctx) {
-    int l,fr=0,pos=0,size=strlen(str)+512;
-    char *p = NULL,*e,*ret = malloc(size), num_val;
-    int skip = 0, lvl = 0, skip_lvl = 0;
+int m_property_do(const m_option_t* prop_list, const char* name,
+                  int action, void* arg, void *ctx) {
+    const char* key;
+    const m_option_t* prop = resolve(prop_list, name, &key);
+    return property_do(prop, key, action, arg, ctx);
+}
+
+/// \defgroup PropertyTemplates Compiled expansion strings
+/// \ingroup Properties
+///@{
+
+enum {
+    TPL_TEXT,   ///< literal text
+    TPL_PROP,   ///< ${NAME}
+    TPL_IF,     ///< ?(NAME:
+    TPL_IFNOT,  ///< ?(!NAME:
+};
+
+typedef struct tpl_node {
+    int type;
+    int len;                ///< of the text
+    char* str;              ///< text or property path
+    const m_option_t* prop; ///< resolved at compile time
+    const char* key;        ///< sub-property part of str
+    int next;               ///< conditions: the node after the closing ')'
+} tpl_node_t;
 
-    while(str[0]) {
+struct m_property_template {
+    const m_option_t* prop_list;
+    char* src;
+    unsigned int hash;
+    tpl_node_t* nodes;
+    int count;
+    int sealed;     ///< text after a ')' must not extend the nodes before
+};
+
+static unsigned int hash_string(const char* s) {
+    unsigned int h = 2166136261U;
+    while(*s)
+        h = (h ^ (unsigned char)*s++) * 16777619U;
+    return h;
+}
+
+static tpl_node_t* add_node(m_property_template_t* t, int type) {
+    tpl_node_t* n;
+    if(!(t->count & 15)) {
+        tpl_node_t* nodes = realloc(t->nodes, (t->count + 16) * sizeof(*nodes));
+        if(!nodes) return NULL;
+        t->nodes = nodes;
+    }
+    n = &t->nodes[t->count++];
+    memset(n, 0, sizeof(*n));
+    n->type = type;
+    return n;
+}
+
+static int add_text(m_property_template_t* t, const char* p, int l) {
+    tpl_node_t* n = t->count ? &t->nodes[t->count-1] : NULL;
+    char* s;
+    if(l <= 0) return 1;
+    if(!n || n->type != TPL_TEXT || t->count <= t->sealed)
+        if(!(n = add_node(t, TPL_TEXT))) return 0;
+    if(!(s = realloc(n->str, n->len + l))) return 0;
+    memcpy(s + n->len, p, l);
+    n->str = s;
+    n->len += l;
+    return 1;
+}
+
+static int add_prop(m_property_template_t* t, int type, const char* name, int l) {
+    tpl_node_t* n = add_node(t, type);
+    if(!n || !(n->str = malloc(l+1))) return 0;
+    memcpy(n->str, name, l);
+    n->str[l] = 0;
+    n->prop = resolve(t->prop_list, n->str, &n->key);
+    return 1;
+}
+
+m_property_template_t* m_properties_compile_string(const m_option_t* prop_list,
+                                                   const char* str) {
+    m_property_template_t* t = calloc(1, sizeof(*t));
+    int open[256], lvl = 0, ok = 1, i;
+    const char *e;
+    char num_val;
+
+    if(!t) return NULL;
+    t->prop_list = prop_list;
+    t->src = strdup(str);
+    t->hash = hash_string(str);
+    while(ok && str[0]) {
         if(str[0] == '\\') {
             int sl = 1;
             switch(str[1]) {
+            case 0:
+                sl = 0; break;
             case 'e':
-                p = "\x1b", l = 1; break;
+                ok = add_text(t, "\x1b", 1); break;
             case 'n':
-                p = "\n", l = 1; break;
+                ok = add_text(t, "\n", 1); break;
             case 'r':
-                p = "\r", l = 1; break;
+                ok = add_text(t, "\r", 1); break;
             case 't':
-                p = "\t", l = 1; break;
+                ok = add_text(t, "\t", 1); break;
             case 'x':
                 if(str[2]) {
                     char num[3] = { str[2], str[3], 0 };
                     char* end = num;
                     num_val = strtol(num,&end,16);
                     sl = end-num;
-                    l = 1;
-                    p = &num_val;
-                } else
-                    l = 0;
+                    ok = add_text(t, &num_val, 1);
+                }
                 break;
             default:
-                p = str+1, l = 1;
+                ok = add_text(t, str+1, 1);
             }
             str+=1+sl;
         } else if(lvl > 0 && str[0] == ')') {
-            if(skip && lvl <= skip_lvl) skip = 0;
-            lvl--, str++, l = 0;
+            lvl--, str++;
+            // conditions deeper than open[] are not skipped correctly,
+            // the end of the string closes them
+            if(lvl < 256)
+                t->nodes[open[lvl]].next = t->count;
+            t->sealed = t->count;
         } else if(str[0] == '$' && str[1] == '{' && (e = strchr(str+2,'}'))) {
-            int pl = e-str-2;
-            char pname[pl+1];
-            memcpy(pname,str+2,pl);
-            pname[pl] = 0;
-            if(m_property_do(prop_list, pname,
-                             M_PROPERTY_PRINT, &p, ctx) >= 0 && p)
-                l = strlen(p), fr = 1;
-            else
-                l = 0;
+            ok = add_prop(t, TPL_PROP, str+2, e-str-2);
             str = e+1;
         } else if(str[0] == '?' && str[1] == '(' && (e = strchr(str+2,':'))) {
-            lvl++;
-            if(!skip) {
-                int is_not = str[2] == '!';
-                int pl = e - str - (is_not ? 3 : 2);
-                char pname[pl+1];
-                memcpy(pname, str + (is_not ? 3 : 2), pl);
-                pname[pl] = 0;
-                if(m_property_do(prop_list,pname,M_PROPERTY_GET,NULL,ctx) < 0) {
-                    if (!is_not)
-                        skip = 1, skip_lvl = lvl;
-                }
-                else if (is_not)
-                    skip = 1, skip_lvl = lvl;
+            int is_not = str[2] == '!';
+            const char* name = str + (is_not ? 3 : 2);
+            if((ok = add_prop(t, is_not ? TPL_IFNOT : TPL_IF, name, e-name))) {
+                if(lvl < 256)
+                    open[lvl] = t->count-1;
+                lvl++;
             }
-            str = e+1, l = 0;
-        } else
-            p = str, l = 1, str++;
+            str = e+1;
+        } else {
+            // copy up to the next special character at once
+            int l = strcspn(str+1, "\\)$?") + 1;
+            ok = add_text(t, str, l);
+            str += l;
+        }
+    }
+    // unterminated conditions extend to the end
+    for(i = 0 ; i < lvl && i < 256 ; i++)
+        t->nodes[open[i]].next = t->count;
+    if(!ok || !t->src) {
+        m_properties_free_template(t);
+        return NULL;
+    }
+    return t;
+}
+
+void m_properties_free_template(m_property_template_t* t) {
+    int i;
+    if(!t) return;
+    for(i = 0 ; i < t->count ; i++)
+        free(t->nodes[i].str);
+    free(t->nodes);
+    free(t->src);
+    free(t);
+}
 
-        if(skip || l <= 0) continue;
+char* m_properties_expand_template(const m_property_template_t* t, void *ctx) {
+    int pos = 0, size = 512, i = 0;
+    char* ret = malloc(size);
 
+    if(!ret) return NULL;
+    while(i < t->count) {
+        const tpl_node_t* n = &t->nodes[i++];
+        char* p = NULL;
+        int l = 0;
+        switch(n->type) {
+        case TPL_TEXT:
+            p = n->str, l = n->len;
+            break;
+        case TPL_PROP:
+            if(property_do(n->prop, n->key, M_PROPERTY_PRINT, &p, ctx) < 0 || !p)
+                continue;
+            l = strlen(p);
+            break;
+        case TPL_IF:
+        case TPL_IFNOT:
+            if((property_do(n->prop, n->key, M_PROPERTY_GET, NULL, ctx) < 0) ==
+               (n->type == TPL_IF))
+                i = n->next;
+            continue;
+        }
         if(pos+l+1 > size) {
             size = pos+l+512;
             ret = realloc(ret,size);
         }
         memcpy(ret+pos,p,l);
         pos += l;
-        if(fr) free(p), fr = 0;
+        if(n->type == TPL_PROP) free(p);
     }
-
     ret[pos] = 0;
     return ret;
 }
 
+#define TPL_CACHE_SIZE 16
+static m_property_template_t* tpl_cache[TPL_CACHE_SIZE];
+static int tpl_cache_next;
+
+char* m_properties_expand_string(const m_option_t* prop_list,char* str, void *ctx) {
+    unsigned int h = hash_string(str);
+    m_property_template_t* t;
+    int i;
+
+    for(i = 0 ; i < TPL_CACHE_SIZE ; i++) {
+        t = tpl_cache[i];
+        if(t && t->hash == h && t->prop_list == prop_list && !strcmp(t->src, str))
+            return m_properties_expand_template(t, ctx);
+    }
+    if(!(t = m_properties_compile_string(prop_list, str)))
+        return NULL;
+    m_properties_free_template(tpl_cache[tpl_cache_next]);
+    tpl_cache[tpl_cache_next] = t;
+    tpl_cache_next = (tpl_cache_next + 1) % TPL_CACHE_SIZE;
+    return m_properties_expand_template(t, ctx);
+}
+
+///@}
+
 void m_properties_print_help_list(const m_option_t* list) {
     char min[50],max[50];
     int i,count = 0;
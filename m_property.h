@@ -154,6 +154,23 @@ void m_properties_print_help_list(const m_option_t* list);
  */
 char* m_properties_expand_string(const m_option_t* prop_list,char* str, void *ctx);
 
+/// A property string parsed once for repeated expansion.
+typedef struct m_property_template m_property_template_t;
+
+/// Parse a property string, see m_properties_expand_string().
+/** The properties are looked up here, prop_list must outlive the template.
+ *  \return NULL on allocation failure.
+ */
+m_property_template_t* m_properties_compile_string(const m_option_t* prop_list,
+                                                   const char* str);
+
+/// Expand a parsed property string.
+/** \return The newly allocated expanded string.
+ */
+char* m_properties_expand_template(const m_property_template_t* t, void *ctx);
+
+void m_properties_free_template(m_property_template_t* t);
+
 // Helpers to use MPlayer's properties
 
 /// Do an action with an MPlayer property.
@@ -30,6 +30,7 @@
 #include "libvo/video_out.h"
 #include "sub/subreader.h"
 #include "libavutil/attributes.h"
+#include "frame_cache.h"
 
 // definitions used internally by the core player code
 
@@ -68,6 +69,16 @@ enum exit_reason {
   EXIT_ERROR
 };
 
+#define FRAME_JITTER_BINS 10
+
+/// how far from their due time the frames were shown
+typedef struct frame_jitter {
+    unsigned int count;
+    unsigned int hist[FRAME_JITTER_BINS]; ///< of the absolute errors
+    double sum, sum2;                     ///< of the errors in seconds
+    double max;                           ///< largest absolute error
+} frame_jitter_t;
+
 typedef struct MPContext {
     int osd_show_percentage;
     int osd_function;
@@ -94,8 +105,21 @@ typedef struct MPContext {
 
     // used to retry decoding after startup/seeking to compensate for codec delay
     int startup_decode_retry;
+    // exact seek: the frames before hr_seek_pts are decoded but neither
+    // filtered nor shown, MP_NOPTS_VALUE when no such seek is in progress
+    double hr_seek_pts;
+    int hr_seek_frames;     ///< decoded frames hidden so far
+    int hr_seek_skipped;    ///< packets decoded without non-reference frames
+    int hr_seek_retries;    ///< earlier seeks left if the keyframe is too late
+    int64_t hr_seek_start;  ///< GetTimerUS() at the seek
+    // -frame-cache: the last decoded frames, stepped through while paused
+    frame_cache_t *frame_cache;
+    int frame_cache_pos;    ///< cached frame shown, -1 for the decoded one
     // how long until we need to display the "current" frame
     float time_frame;
+    // GetTimerUS() at which the "current" frame is due
+    int64_t frame_deadline;
+    frame_jitter_t jitter;
 
     // AV sync: the next frame should be shown when the audio out has this
     // much (in seconds) buffered data left. Increased when more data is
@@ -157,5 +181,7 @@ av_noreturn void exit_player(enum exit_reason how);
 av_noreturn void exit_player_with_rc(enum exit_reason how, int rc);
 void add_subtitles(char *filename, float fps, int noerr);
 int reinit_video_chain(void);
+/// summary and histogram of the presentation errors in buf
+void frame_jitter_print(const frame_jitter_t *j, char *buf, int size);
 
 #endif /* MPLAYER_MP_CORE_H */
@@ -48,6 +48,7 @@
 #include "sub/av_sub.h"
 #include "sub/sub_cc.h"
 #include "libmpcodecs/dec_teletext.h"
+#include "libmpcodecs/vf_threads.h"
 #include "libavutil/intreadwrite.h"
 #include "m_option.h"
 #include "mpcommon.h"
@@ -74,12 +75,12 @@ void print_version(const char* name)
     GetCpuCaps(&gCpuCaps);
 #if ARCH_X86
     mp_msg(MSGT_CPLAYER, MSGL_V,
-           "CPUflags:  MMX: %d MMX2: %d 3DNow: %d 3DNowExt: %d SSE: %d SSE2: %d SSE3: %d SSSE3: %d SSE4: %d SSE4.2: %d AVX: %d\n",
+           "CPUflags:  MMX: %d MMX2: %d 3DNow: %d 3DNowExt: %d SSE: %d SSE2: %d SSE3: %d SSSE3: %d SSE4: %d SSE4.2: %d AVX: %d AVX2: %d\n",
            gCpuCaps.hasMMX, gCpuCaps.hasMMX2,
            gCpuCaps.has3DNow, gCpuCaps.has3DNowExt,
            gCpuCaps.hasSSE, gCpuCaps.hasSSE2, gCpuCaps.hasSSE3,
            gCpuCaps.hasSSSE3, gCpuCaps.hasSSE4, gCpuCaps.hasSSE42,
-           gCpuCaps.hasAVX);
+           gCpuCaps.hasAVX, gCpuCaps.hasAVX2);
 #if CONFIG_RUNTIME_CPUDETECT
     mp_msg(MSGT_CPLAYER, MSGL_V, "Compiled with runtime CPU detection.\n");
 #else
@@ -656,6 +657,7 @@ void common_uninit(void)
     done_freetype();
 #endif
     free_osd_list();
+    vf_threads_uninit();
 
 #ifdef CONFIG_ASS
     ass_library_done(ass_library);
@@ -21,6 +21,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <math.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -75,6 +76,7 @@
 #include "gui/interface.h"
 #include "input/input.h"
 #include "libao2/audio_out.h"
+#include "libao2/audio_thread.h"
 #include "libavutil/avstring.h"
 #include "libavutil/intreadwrite.h"
 #include "libmenu/menu.h"
@@ -120,6 +122,7 @@
 #include "path.h"
 #include "playtree.h"
 #include "playtreeparser.h"
+#include "preopen.h"
 #include "sub/spudec.h"
 #include "sub/subreader.h"
 #include "sub/vobsub.h"
@@ -161,6 +164,8 @@ static MPContext mpctx_s = {
     .set_of_sub_pos = -1,
     .file_format    = DEMUXER_TYPE_UNKNOWN,
     .loop_times     = -1,
+    .hr_seek_pts    = MP_NOPTS_VALUE,
+    .frame_cache_pos = -1,
 #ifdef CONFIG_DVBIN
     .last_dvb_step  = 1,
 #endif
@@ -209,6 +214,7 @@ static double seek_to_sec = MP_NOPTS_VALUE;
 static off_t seek_to_byte;
 static off_t step_sec;
 static int loop_seek;
+static int loop_ram_mb; // looped files up to this size are read into memory
 
 static m_time_size_t end_at = { .type = END_AT_NONE, .pos = 0 };
 
@@ -262,10 +268,15 @@ float audio_delay;
 static int ignore_start;
 
 static int softsleep;
+static int sleep_spin; // usecs before the frame deadline spent polling the timer
+static int hr_seek;    // relative seeks decode up to the exact target
+static int frame_cache_mb; // memory for the decoded frames kept for stepping back
+static int gapless;    // open the next file ahead and keep the outputs
 
 double force_fps;
 static int force_srate;
 static int audio_output_format = AF_FORMAT_UNKNOWN;
+static int audio_queue_ms = 200;
 int frame_dropping;        // option  0=no drop  1= drop vo  2= drop decode
 static int play_n_frames    = -1;
 static int play_n_frames_mf = -1;
@@ -707,7 +718,10 @@ void exit_player_with_rc(enum exit_reason how, int rc)
 
     if (mpctx->user_muted && !mpctx->edl_muted)
         mixer_mute(&mpctx->mixer);
+    preopen_cancel();
     uninit_player(INITIALIZED_ALL);
+    frame_cache_free(mpctx->frame_cache);
+    mpctx->frame_cache = NULL;
 #if defined(__MINGW32__) || defined(__CYGWIN__)
     timeEndPeriod(1);
 #endif
@@ -816,6 +830,7 @@ static void exit_sighandler(int x)
         case SIGTERM:
         case SIGKILL:
             async_quit_request = 1;
+            mp_input_wakeup();
             return; // killed from keyboard (^C) or killed [-9]
         case SIGILL:
 #if CONFIG_RUNTIME_CPUDETECT
@@ -886,6 +901,9 @@ static void parse_cfgfiles(m_config_t *conf)
     }
 }
 
+/// profiles or config files were applied for the current file only
+static int file_config_applied;
+
 #define PROFILE_CFG_PROTOCOL "protocol."
 
 static void load_per_protocol_config(m_config_t *conf, const char *const file)
@@ -905,6 +923,7 @@ static void load_per_protocol_config(m_config_t *conf, const char *const file)
     if (p) {
         mp_msg(MSGT_CPLAYER, MSGL_INFO, MSGTR_LoadingProtocolProfile, protocol);
         m_config_set_profile(conf, p);
+        file_config_applied = 1;
     }
 }
 
@@ -927,6 +946,7 @@ static void load_per_extension_config(m_config_t *conf, const char *const file)
     if (p) {
         mp_msg(MSGT_CPLAYER, MSGL_INFO, MSGTR_LoadingExtensionProfile, extension);
         m_config_set_profile(conf, p);
+        file_config_applied = 1;
     }
 }
 
@@ -977,14 +997,16 @@ static void load_per_file_config(m_config_t *conf, const char *const file)
         char dircfg[PATH_MAX];
         strcpy(dircfg, cfg);
         strcpy(dircfg + (name - cfg), "mplayer.conf");
-        try_load_config(conf, dircfg);
+        file_config_applied |= try_load_config(conf, dircfg);
 
-        if (try_load_config(conf, cfg))
+        if (try_load_config(conf, cfg)) {
+            file_config_applied = 1;
             return;
+        }
     }
 
     if ((confpath = get_path(name)) != NULL) {
-        try_load_config(conf, confpath);
+        file_config_applied |= try_load_config(conf, confpath);
 
         free(confpath);
     }
@@ -1001,6 +1023,14 @@ static int load_profile_config(m_config_t *conf, const char *const file)
     return file != NULL;
 }
 
+/// the background open of the next file must leave the input alone
+static int check_stream_interrupt(int time)
+{
+    if (preopen_in_thread())
+        return preopen_check_interrupt(time);
+    return mp_input_check_interrupt(time);
+}
+
 /* When libmpdemux performs a blocking operation (network connection or
  * cache filling) if the operation fails we use this function to check
  * if it was interrupted by the user.
@@ -1640,10 +1670,83 @@ static void update_osd_msg(void)
     }
 }
 
+/// seconds before the end of a file at which -gapless opens the next one
+#define GAPLESS_PREOPEN_SECS 5.0
+
+static int preopen_tried;       ///< the next file was looked at for this file
+static unsigned int gapless_kept; ///< outputs kept from the last file
+/// the decoder output the ao was opened for
+static struct {
+    int samplerate, channels, format;
+} ao_input;
+
+/// \return 1 if options of the current file alone are in effect
+static int file_options_applied(void)
+{
+    return file_config_applied ||
+           (mpctx->playtree_iter && mpctx->playtree_iter->tree->params);
+}
+
+/**
+ * \brief with -gapless open the next playtree entry near the end of the file
+ *
+ * Only when the next entry is the next file in the same list and neither
+ * file brings options of its own, the background open uses the options of
+ * the file playing.
+ */
+static void preopen_next_file(void)
+{
+    play_tree_iter_t *iter = mpctx->playtree_iter;
+    play_tree_iter_t *next;
+    double len, pos;
+    char *name;
+
+    if (!gapless || preopen_tried || !iter || use_gui ||
+        file_options_applied() || seek_to_byte || stream_dump_type ||
+        mpctx->loop_times >= 0 ||
+        iter->mode == PLAY_TREE_ITER_RND || iter->num_files > 1)
+        return;
+    len = demuxer_get_time_length(mpctx->demuxer);
+    pos = demuxer_get_current_time(mpctx->demuxer);
+    if (start_pts != MP_NOPTS_VALUE)
+        pos -= start_pts;
+    if (len <= 0 || pos < len - GAPLESS_PREOPEN_SECS)
+        return;
+    preopen_tried = 1;
+
+    // step a copy the way the end of the file will
+    next = play_tree_iter_new_copy(iter);
+    if (!next)
+        return;
+    if (play_tree_iter_step(next, 1, 0) == PLAY_TREE_ITER_ENTRY &&
+        next->tree->parent == iter->tree->parent && !next->tree->params &&
+        (name = play_tree_iter_get_file(next, 1)))
+        preopen_start(name, audio_id, video_id, dvdsub_id,
+                      file_options_applied());
+    play_tree_iter_free(next);
+}
+
+/**
+ * \brief close outputs kept for a gapless transition the new file cannot use
+ *
+ * The audio of the previous file still queued in the ao plays out.
+ */
+static void drop_kept_outputs(unsigned int mask)
+{
+    int eof = mpctx->eof;
+
+    mask         &= gapless_kept;
+    gapless_kept &= ~mask;
+    mpctx->eof    = 1;  // uninit_player() drains the ao at eof
+    uninit_player(mask);
+    mpctx->eof    = eof;
+}
+
 void reinit_audio_chain(void)
 {
     if (!mpctx->sh_audio)
         return;
+    mp_property_changed(MP_CHANGE_TRACKS);
     if (!(initialized_flags & INITIALIZED_ACODEC)) {
         current_module = "init_audio_codec";
         mp_msg(MSGT_CPLAYER, MSGL_INFO, "==========================================================================\n");
@@ -1653,6 +1756,14 @@ void reinit_audio_chain(void)
         mp_msg(MSGT_CPLAYER, MSGL_INFO, "==========================================================================\n");
     }
 
+    // an ao kept from the last file is used only for the same decoder output
+    if ((gapless_kept & INITIALIZED_AO) &&
+        (mpctx->sh_audio->samplerate    != ao_input.samplerate ||
+         mpctx->sh_audio->channels      != ao_input.channels   ||
+         mpctx->sh_audio->sample_format != ao_input.format))
+        drop_kept_outputs(INITIALIZED_AO);
+    gapless_kept &= ~INITIALIZED_AO;
+
     if (!(initialized_flags & INITIALIZED_AO)) {
         current_module     = "af_preinit";
         ao_data.samplerate = force_srate;
@@ -1678,6 +1789,11 @@ void reinit_audio_chain(void)
             goto init_error;
         }
         initialized_flags |= INITIALIZED_AO;
+        ao_input.samplerate = mpctx->sh_audio->samplerate;
+        ao_input.channels   = mpctx->sh_audio->channels;
+        ao_input.format     = mpctx->sh_audio->sample_format;
+        // decoding hiccups eat into the queue instead of the driver buffer
+        mpctx->audio_out = audio_thread_start(mpctx->audio_out, audio_queue_ms);
         mp_msg(MSGT_CPLAYER, MSGL_INFO, "AO: [%s] %dHz %dch %s (%d bytes per sample)\n",
                mpctx->audio_out->info->short_name,
                ao_data.samplerate, ao_data.channels,
@@ -1771,6 +1887,97 @@ static int check_framedrop(double frame_time)
     return 0;
 }
 
+/// Drop the decoded audio before pts, the audio of an exact seek
+/// starts at the keyframe the demuxer landed on.
+static void skip_audio_until(double pts)
+{
+    sh_audio_t *sh_audio = mpctx->sh_audio;
+    int frame = sh_audio->channels * sh_audio->samplesize;
+
+    while (frame > 0) {
+        double end;
+        int skip;
+
+        if (!sh_audio->a_buffer_len) {
+            int len = sh_audio->ad_driver->decode_audio(sh_audio,
+                                                        sh_audio->a_buffer, frame,
+                                                        sh_audio->a_buffer_size);
+            if (len <= 0)
+                break;
+            sh_audio->a_buffer_len = len;
+        }
+        // the pts after the decoded audio, a_buffer holds the end of it
+        end = calc_a_pts(sh_audio, mpctx->d_audio);
+        if (end == MP_NOPTS_VALUE)
+            break;
+        skip  = (pts - end) * sh_audio->o_bps + sh_audio->a_buffer_len;
+        skip -= skip % frame;
+        if (skip <= 0)
+            break;
+        if (skip < sh_audio->a_buffer_len) {
+            sh_audio->a_buffer_len -= skip;
+            memmove(sh_audio->a_buffer, sh_audio->a_buffer + skip,
+                    sh_audio->a_buffer_len);
+            break;
+        }
+        sh_audio->a_buffer_len = 0;
+    }
+}
+
+/// Whether a packet read during an exact seek can be decoded without its
+/// non-reference frames: both it and the next frame the decoder returns
+/// (the earliest pending pts) are before the target.
+static int hr_seek_skippable(sh_video_t *sh_video, double pts)
+{
+    int n = sh_video->num_buffered_pts;
+
+    return pts != MP_NOPTS_VALUE && pts < mpctx->hr_seek_pts &&
+           (!n || sh_video->buffered_pts[n - 1] < mpctx->hr_seek_pts);
+}
+
+/// Check a frame decoded during an exact seek.
+/// \return 1 if it is the target and the seek is done
+static int hr_seek_reached(sh_video_t *sh_video)
+{
+    double target = mpctx->hr_seek_pts;
+    double pts    = sh_video->pts;
+    // timestamps are often rounded to the millisecond
+    double tol    = sh_video->frametime > 0 ? sh_video->frametime / 2 : 0.001;
+
+    if (pts == MP_NOPTS_VALUE)
+        pts = target;
+    if (pts < target - tol) {
+        mpctx->hr_seek_frames++;
+        return 0;
+    }
+    if (pts > target + tol && !mpctx->hr_seek_frames &&
+        mpctx->hr_seek_retries > 0) {
+        // landed on a keyframe after the target, go back further
+        int back = 3 - mpctx->hr_seek_retries--;
+        if (demux_seek(mpctx->demuxer, target - pts - back, audio_delay,
+                       SEEK_BACKWARD))
+            return 0;
+    }
+    mp_msg(MSGT_CPLAYER, MSGL_V, "Exact seek to %.3f: %d frames hidden, "
+           "%d decoded without non-reference frames, %.1f ms.\n", pts,
+           mpctx->hr_seek_frames, mpctx->hr_seek_skipped,
+           (GetTimerUS() - mpctx->hr_seek_start) / 1000.0);
+    mpctx->hr_seek_pts = MP_NOPTS_VALUE;
+    if (mpctx->sh_audio)
+        skip_audio_until(pts);
+    return 1;
+}
+
+/// keep a copy of a frame about to be shown for -frame-cache
+static void cache_decoded_frame(sh_video_t *sh_video, mp_image_t *mpi)
+{
+    if (!mpctx->frame_cache || sh_video->pts == MP_NOPTS_VALUE)
+        return;
+    // seeks clear the cache, a larger gap means broken timestamps
+    frame_cache_add(mpctx->frame_cache, mpi, sh_video->pts,
+                    FFMAX(2 * sh_video->frametime, 0.5));
+}
+
 static int generate_video_frame(sh_video_t *sh_video, demux_stream_t *d_video)
 {
     unsigned char *start;
@@ -1780,6 +1987,7 @@ static int generate_video_frame(sh_video_t *sh_video, demux_stream_t *d_video)
 
     while (1) {
         int drop_frame = 0;
+        int preroll    = mpctx->hr_seek_pts != MP_NOPTS_VALUE;
         void *decoded_frame;
         current_module = "decode video";
         // XXX Time used in this call is not counted in any performance
@@ -1794,23 +2002,31 @@ static int generate_video_frame(sh_video_t *sh_video, demux_stream_t *d_video)
             start   = NULL;
             pts     = MP_NOPTS_VALUE;
             hit_eof = 1;
+        } else if (preroll) {
+            drop_frame = hr_seek_skippable(sh_video, pts);
+            mpctx->hr_seek_skipped += drop_frame;
         } else
 	    drop_frame = check_framedrop(sh_video->frametime);
         if (in_size > max_framesize)
             max_framesize = in_size;
         current_module = "decode video";
         decoded_frame  = decode_video(sh_video, start, in_size, drop_frame, pts, NULL);
+        if (decoded_frame && preroll && !hr_seek_reached(sh_video))
+            decoded_frame = NULL;
         if (decoded_frame) {
+            cache_decoded_frame(sh_video, decoded_frame);
             update_subtitles(sh_video, sh_video->pts, mpctx->d_sub, 0);
             update_teletext(sh_video, mpctx->demuxer, 0);
             update_osd_msg();
             current_module = "filter video";
             if (filter_video(sh_video, decoded_frame, sh_video->pts))
                 break;
-        } else if (drop_frame)
+        } else if (drop_frame && !preroll)
             return -1;
-        if (hit_eof)
+        if (hit_eof) {
+            mpctx->hr_seek_pts = MP_NOPTS_VALUE;
             return 0;
+        }
     }
     return 1;
 }
@@ -1819,7 +2035,10 @@ static int generate_video_frame(sh_video_t *sh_video, demux_stream_t *d_video)
 int rtc_fd = -1;
 #endif
 
-static float timing_sleep(float time_frame)
+/**
+ * \param interrupted set to 1 if input ended the sleep early
+ */
+static float timing_sleep(float time_frame, int *interrupted)
 {
 #ifdef HAVE_RTC
     if (rtc_fd >= 0) {
@@ -1836,23 +2055,60 @@ static float timing_sleep(float time_frame)
     {
         // assume kernel HZ=100 for softsleep, works with larger HZ but with
         // unnecessarily high CPU usage
-        float margin = softsleep ? 0.011 : 0;
+        int margin = softsleep ? 11000 : sleep_spin;
         current_module = "sleep_timer";
-        while (time_frame > margin) {
-            usec_sleep(1000000 * (time_frame - margin));
-            time_frame -= GetRelativeTime();
+        // sleep to the deadline instead of for time_frame, so that the
+        // wakeup latency is not added to the time of the next frame
+        if (time_frame > margin * 0.000001 &&
+            mp_input_sleep_until(mpctx->frame_deadline - margin)) {
+            *interrupted = 1;
+            return time_frame - GetRelativeTime();
         }
-        if (softsleep) {
+        if (margin) {
             current_module = "sleep_soft";
-            if (time_frame < 0)
+            if (softsleep && GetTimerUS() > mpctx->frame_deadline)
                 mp_msg(MSGT_AVSYNC, MSGL_WARN, MSGTR_SoftsleepUnderflow);
-            while (time_frame > 0)
-                time_frame -= GetRelativeTime();  // burn the CPU
+            while (GetTimerUS() < mpctx->frame_deadline)
+                ;  // burn the CPU
         }
+        time_frame -= GetRelativeTime();
     }
     return time_frame;
 }
 
+static void frame_jitter_add(frame_jitter_t *j, int64_t error)
+{
+    static const int bounds[FRAME_JITTER_BINS - 1] = {
+        50, 100, 250, 500, 1000, 2000, 5000, 10000, 20000
+    };
+    int64_t a = error < 0 ? -error : error;
+    int i;
+
+    for (i = 0; i < FRAME_JITTER_BINS - 1 && a >= bounds[i]; i++)
+        ;
+    j->hist[i]++;
+    j->count++;
+    j->sum  += error * 0.000001;
+    j->sum2 += error * 0.000001 * error * 0.000001;
+    j->max   = FFMAX(j->max, a * 0.000001);
+}
+
+void frame_jitter_print(const frame_jitter_t *j, char *buf, int size)
+{
+    static const char *const names[FRAME_JITTER_BINS] = {
+        "<50us", "<100us", "<250us", "<500us", "<1ms",
+        "<2ms", "<5ms", "<10ms", "<20ms", ">=20ms"
+    };
+    double mean = j->count ? j->sum / j->count : 0;
+    double var  = j->count ? j->sum2 / j->count - mean * mean : 0;
+    int i, n;
+
+    n = snprintf(buf, size, "%u frames, mean %.3f ms, sd %.3f ms, max %.3f ms;",
+                 j->count, mean * 1000, sqrt(FFMAX(var, 0)) * 1000, j->max * 1000);
+    for (i = 0; i < FRAME_JITTER_BINS && n > 0 && n < size; i++)
+        n += snprintf(buf + n, size - n, " %s %u", names[i], j->hist[i]);
+}
+
 static int select_subtitle(MPContext *mpctx)
 {
     // find the best sub to use
@@ -2124,6 +2380,7 @@ static int fill_audio_out_buffers(void)
     int audio_eof = 0;
     int bytes_to_write;
     int timeout = 0;
+    int out_pos = 0; // a_out_buffer_len bytes left to play from here
     sh_audio_t *const sh_audio = mpctx->sh_audio;
 
     current_module = "play_audio";
@@ -2148,7 +2405,9 @@ static int fill_audio_out_buffers(void)
         sleep_time = (ao_data.outburst - bytes_to_write) * 1000 / ao_data.bps;
         if (sleep_time < 10)
             sleep_time = 10;                  // limit to 100 wakeups per second
-        usec_sleep(sleep_time * 1000);
+        // the audio thread wakes us as soon as its queue has room
+        if (!audio_thread_wait(ao_data.outburst, sleep_time))
+            usec_sleep(sleep_time * 1000);
     }
 
     while (bytes_to_write) {
@@ -2161,7 +2420,16 @@ static int fill_audio_out_buffers(void)
         // Fill buffer if needed:
         current_module = "decode_audio";
         t = GetTimer();
-        if (!sh_audio->a_buffer_format_change) {
+        res = 0;
+        if (!sh_audio->a_buffer_format_change &&
+            sh_audio->a_out_buffer_len < playsize) {
+            // the decoder appends at a_out_buffer_len, move the rest down
+            // only now instead of after every chunk played
+            if (out_pos) {
+                memmove(sh_audio->a_out_buffer, sh_audio->a_out_buffer + out_pos,
+                        sh_audio->a_out_buffer_len);
+                out_pos = 0;
+            }
             res = mp_decode_audio(sh_audio, playsize);
             sh_audio->a_buffer_format_change = res == -2;
         }
@@ -2189,12 +2457,11 @@ static int fill_audio_out_buffers(void)
         // They're obviously badly broken in the way they handle av sync;
         // would not having access to this make them more broken?
         ao_data.pts = ((mpctx->sh_video ? mpctx->sh_video->timer : 0) + mpctx->delay) * 90000.0;
-        playsize    = mpctx->audio_out->play(sh_audio->a_out_buffer, playsize, playflags);
+        playsize    = mpctx->audio_out->play(sh_audio->a_out_buffer + out_pos, playsize, playflags);
 
         if (playsize > 0) {
             sh_audio->a_out_buffer_len -= playsize;
-            memmove(sh_audio->a_out_buffer, &sh_audio->a_out_buffer[playsize],
-                    sh_audio->a_out_buffer_len);
+            out_pos += playsize;
             mpctx->delay += playback_speed * playsize / (double)ao_data.bps;
         } else if ((sh_audio->a_buffer_format_change || audio_eof) &&
                    mpctx->audio_out->get_delay() < .04) {
@@ -2204,6 +2471,9 @@ static int fill_audio_out_buffers(void)
             sh_audio->a_out_buffer_len = 0;
         }
     }
+    if (out_pos && sh_audio->a_out_buffer_len)
+        memmove(sh_audio->a_out_buffer, sh_audio->a_out_buffer + out_pos,
+                sh_audio->a_out_buffer_len);
     if (sh_audio->a_buffer_format_change && !sh_audio->a_out_buffer_len) {
         uninit_player(INITIALIZED_AO);
         af_uninit(sh_audio->afilter);
@@ -2285,6 +2555,8 @@ static int sleep_until_update(float *time_frame, float *aq_sleep_time)
     }
 
     *aq_sleep_time += *time_frame;
+    *time_frame -= GetRelativeTime();
+    mpctx->frame_deadline = GetTimerUS() + (int64_t)(*time_frame * 1000000);
 
     //============================== SLEEP: ===================================
 
@@ -2292,11 +2564,12 @@ static int sleep_until_update(float *time_frame, float *aq_sleep_time)
     if (!(vo_flags & 256)) {
         if (*time_frame > 0.3) {
             // Avoid sleeping too long without reacting to user input
-            usec_sleep(200000);
+            mp_input_sleep_until(GetTimerUS() + 200000);
             *time_frame -= GetRelativeTime();
             frame_time_remaining = 1;
-	} else if (*time_frame > 0.001)
-            *time_frame = timing_sleep(*time_frame);
+	} else if (*time_frame > 0)
+            // on input the main loop handles it and comes back to this frame
+            *time_frame = timing_sleep(*time_frame, &frame_time_remaining);
     }
 
     handle_udp_master(mpctx->sh_video->pts);
@@ -2308,6 +2581,7 @@ int reinit_video_chain(void)
 {
     sh_video_t *const sh_video = mpctx->sh_video;
     double ar = -1.0;
+    mp_property_changed(MP_CHANGE_TRACKS);
     if (!video_read_properties(mpctx->sh_video)) {
         mp_msg(MSGT_CPLAYER, MSGL_ERR, MSGTR_CannotReadVideoProperties);
         goto err_out;
@@ -2330,7 +2604,8 @@ int reinit_video_chain(void)
         }
     }
     //================== Init VIDEO (codec & libvo) ==========================
-    if (!fixed_vo || !(initialized_flags & INITIALIZED_VO)) {
+    if (!(fixed_vo || (gapless_kept & INITIALIZED_VO)) ||
+        !(initialized_flags & INITIALIZED_VO)) {
         current_module = "preinit_libvo";
 
         //shouldn't we set dvideo->id=-2 when we fail?
@@ -2342,6 +2617,7 @@ int reinit_video_chain(void)
         }
         initialized_flags |= INITIALIZED_VO;
     }
+    gapless_kept &= ~INITIALIZED_VO;
 
     if (stream_control(mpctx->demuxer->stream, STREAM_CTRL_GET_ASPECT_RATIO, &ar) != STREAM_UNSUPPORTED)
         mpctx->sh_video->stream_aspect = ar;
@@ -2510,6 +2786,8 @@ static double update_video(int *blit_frame)
 #endif
         } while (!full_frame);
 
+        if (decoded_frame)
+            cache_decoded_frame(sh_video, decoded_frame);
         current_module = "filter_video";
         *blit_frame    = (decoded_frame && filter_video(sh_video, decoded_frame,
                                                         sh_video->pts));
@@ -2545,9 +2823,94 @@ static double update_video(int *blit_frame)
     return frame_time;
 }
 
+/// how long the pause loop may wait for input, -1 if only input can end it
+static int pause_wait_time(void)
+{
+    if (mpctx->sh_video && mpctx->video_out && vo_config_count)
+        return 20;  // for check_events()
+#ifdef CONFIG_GUI
+    if (use_gui)
+        return 20;
+#endif
+#ifdef CONFIG_MENU
+    if (vf_menu)
+        return 20;
+#endif
+#ifdef CONFIG_STREAM_CACHE
+    if (!quiet && stream_cache_size > 0)
+        return 20;
+#endif
+    return -1;
+}
+
+/**
+ * \brief find the cached frame a command given while paused is served with
+ * \return its index in the frame cache, -1 if the command needs the decoder
+ */
+static int cached_frame_for(mp_cmd_t *cmd)
+{
+    frame_cache_t *fc = mpctx->frame_cache;
+    int last, pos;
+    double pts;
+
+    if (!fc || !mpctx->sh_video || !frame_cache_count(fc))
+        return -1;
+    last = frame_cache_count(fc) - 1;
+    pos  = mpctx->frame_cache_pos >= 0 ? mpctx->frame_cache_pos : last;
+    switch (cmd->id) {
+    case MP_CMD_FRAME_BACK_STEP:
+        return pos - 1;
+    case MP_CMD_FRAME_STEP:
+        return mpctx->frame_cache_pos >= 0 ? pos + 1 : -1;
+    case MP_CMD_SEEK:
+        // only seeks in seconds that leave playback paused
+        if ((cmd->pausing != 1 && cmd->pausing != 2) ||
+            (cmd->nargs > 1 && cmd->args[1].v.i == 1))
+            return -1;
+        pts = cmd->args[0].v.f;
+        if (cmd->nargs < 2 || cmd->args[1].v.i != 2)
+            pts += mpctx->sh_video->pts;
+        return frame_cache_find(fc, pts);
+    }
+    return -1;
+}
+
+/// show a frame of the frame cache in place of the decoded one
+static void show_cached_frame(int i)
+{
+    sh_video_t *const sh_video = mpctx->sh_video;
+    mp_image_t *mpi = frame_cache_get(mpctx->frame_cache, i, &sh_video->pts);
+
+    mpctx->frame_cache_pos = i < frame_cache_count(mpctx->frame_cache) - 1 ? i : -1;
+    update_subtitles(sh_video, sh_video->pts, mpctx->d_sub, 0);
+    update_osd_msg();
+    current_module = "filter_video";
+    if (filter_video(sh_video, mpi, sh_video->pts) && vo_config_count)
+        mpctx->video_out->flip_page();
+    mp_property_changed(MP_CHANGE_SEEK);
+    mp_property_notify(mpctx);
+}
+
+/// Playback goes on from a cached frame by seeking back to it, together
+/// with any relative seek the command ending the pause asks for.
+static void leave_frame_cache(void)
+{
+    double pts, last_pts;
+
+    if (mpctx->frame_cache_pos < 0)
+        return;
+    frame_cache_get(mpctx->frame_cache, mpctx->frame_cache_pos, &pts);
+    frame_cache_get(mpctx->frame_cache,
+                    frame_cache_count(mpctx->frame_cache) - 1, &last_pts);
+    mpctx->sh_video->pts   = last_pts;
+    rel_seek_secs         += pts - last_pts;
+    mpctx->frame_cache_pos = -1;
+}
+
 static void pause_loop(void)
 {
     mp_cmd_t *cmd;
+    int cached = -1;
 #ifdef CONFIG_STREAM_CACHE
     int old_cache_fill = stream_cache_size > 0 ? cache_fill_status(mpctx->stream) : 0;
 #endif
@@ -2569,10 +2932,17 @@ static void pause_loop(void)
     if (mpctx->audio_out && mpctx->sh_audio)
         mpctx->audio_out->pause();  // pause audio, keep data if possible
 
-    while ((cmd = mp_input_get_cmd(20, 1, 1)) == NULL || cmd->pausing == 4) {
+    mp_property_changed(MP_CHANGE_PAUSE);
+    mp_property_notify(mpctx);
+
+    while ((cmd = mp_input_get_cmd(pause_wait_time(), 1, 1)) == NULL ||
+           cmd->pausing == 4 || (cached = cached_frame_for(cmd)) >= 0) {
         if (cmd) {
             cmd = mp_input_get_cmd(0, 1, 0);
-            run_command(mpctx, cmd);
+            if (cmd->pausing == 4)
+                run_command(mpctx, cmd);
+            else
+                show_cached_frame(cached);
             mp_cmd_free(cmd);
             continue;
         }
@@ -2606,13 +2976,14 @@ static void pause_loop(void)
 #endif
         if (mpctx->sh_video)
             handle_udp_master(mpctx->sh_video->pts);
-        usec_sleep(20000);
     }
     if (cmd && cmd->id == MP_CMD_PAUSE) {
         cmd = mp_input_get_cmd(0, 1, 0);
         mp_cmd_free(cmd);
     }
+    leave_frame_cache();
     mpctx->osd_function = OSD_PLAY;
+    mp_property_changed(MP_CHANGE_PAUSE);
     if (mpctx->audio_out && mpctx->sh_audio) {
         if (mpctx->eof) // do not play remaining audio if we e.g.  switch to the next file
             mpctx->audio_out->reset();
@@ -2726,10 +3097,24 @@ static void edl_update(MPContext *mpctx)
 // return -1 if seek failed (non-seekable stream?), 0 otherwise
 static int seek(MPContext *mpctx, double amount, int style)
 {
+    double target = MP_NOPTS_VALUE;
+
     current_module = "seek";
+    // only a relative seek has a target in the timestamps of the file
+    if (hr_seek && correct_pts && mpctx->sh_video &&
+        !(style & SEEK_ABSOLUTE) && mpctx->sh_video->pts != MP_NOPTS_VALUE) {
+        target = mpctx->sh_video->pts + amount;
+        style |= SEEK_BACKWARD;
+    }
     if (demux_seek(mpctx->demuxer, amount, audio_delay, style) == 0)
         return -1;
 
+    mpctx->hr_seek_pts     = target;
+    mpctx->hr_seek_frames  = 0;
+    mpctx->hr_seek_skipped = 0;
+    mpctx->hr_seek_retries = 2;
+    mpctx->hr_seek_start   = GetTimerUS();
+
     mpctx->startup_decode_retry = DEFAULT_STARTUP_DECODE_RETRY;
     if (mpctx->sh_video) {
         current_module = "seek_video_reset";
@@ -2742,13 +3127,19 @@ static int seek(MPContext *mpctx, double amount, int style)
         // (which is used by at least vobsub and edl code below) may
         // be completely wrong (probably 0).
         mpctx->sh_video->pts = mpctx->d_video->pts;
+        if (mpctx->frame_cache)
+            frame_cache_clear(mpctx->frame_cache);
+        mpctx->frame_cache_pos = -1;
         update_subtitles(mpctx->sh_video, mpctx->sh_video->pts, mpctx->d_sub, 1);
         update_teletext(mpctx->sh_video, mpctx->demuxer, 1);
     }
 
     if (mpctx->sh_audio) {
         current_module = "seek_audio_reset";
-        mpctx->audio_out->reset(); // stop audio, throwing away buffered data
+        // a loop plays the end of the file into its start, the audio
+        // still buffered is kept and the sync waits for it
+        if (!loop_seek)
+            mpctx->audio_out->reset(); // stop audio, throwing away buffered data
         if (!mpctx->sh_video)
             update_subtitles(NULL, mpctx->sh_audio->pts, mpctx->d_sub, 1);
     }
@@ -2774,6 +3165,7 @@ static int seek(MPContext *mpctx, double amount, int style)
     video_time_usage   = 0;
     vout_time_usage    = 0;
     drop_frame_cnt     = 0;
+    mp_property_changed(MP_CHANGE_SEEK);
 
     current_module = NULL;
     return 0;
@@ -2786,6 +3178,7 @@ int main(int argc, char *argv[])
 {
     int opt_exit = 0; // Flag indicating whether MPlayer should exit without playing anything.
     int profile_config_loaded;
+    int preopened = 0;
     int i;
 
     common_preinit(&argc, &argv);
@@ -3010,7 +3403,7 @@ int main(int argc, char *argv[])
     else if (!noconsolecontrols)
         mp_input_add_event_fd(0, getch2);
     // Set the libstream interrupt callback
-    stream_set_interrupt_callback(mp_input_check_interrupt);
+    stream_set_interrupt_callback(check_stream_interrupt);
 
 #ifdef CONFIG_MENU
     if (use_menu) {
@@ -3085,6 +3478,7 @@ play_next_file:
     mpctx->global_sub_size = 0;
     memset(mpctx->sub_counts, 0, sizeof(mpctx->sub_counts));
 
+    file_config_applied   = 0;
     profile_config_loaded = load_profile_config(mconfig, filename);
 
     if (video_driver_list)
@@ -3128,11 +3522,10 @@ play_next_file:
         mp_cmd_t *cmd;
         if (mpctx->video_out && vo_config_count)
             mpctx->video_out->control(VOCTRL_PAUSE, NULL);
-        while (!(cmd = mp_input_get_cmd(0, 1, 0))) { // wait for command
+        // wait for command
+        while (!(cmd = mp_input_get_cmd(mpctx->video_out && vo_config_count ? 20 : -1, 1, 0)))
             if (mpctx->video_out && vo_config_count)
                 mpctx->video_out->check_events();
-            usec_sleep(20000);
-        }
         switch (cmd->id) {
         case MP_CMD_LOADFILE:
             // prepare a tree entry with the new filename
@@ -3243,7 +3636,14 @@ play_next_file:
     mpctx->sh_video = NULL;
 
     current_module = "open_stream";
-    mpctx->stream  = open_stream(filename, 0, &mpctx->file_format);
+    // options for this file alone were not known to the background open
+    preopened = preopen_take(filename, audio_id, video_id, dvdsub_id,
+                             file_options_applied(),
+                             &mpctx->stream, &mpctx->demuxer, &mpctx->file_format);
+    if (preopened)
+        mp_msg(MSGT_CPLAYER, MSGL_V, "Using the stream opened in the background.\n");
+    else
+        mpctx->stream = open_stream(filename, 0, &mpctx->file_format);
     if (!mpctx->stream) { // error...
         mpctx->eof = libmpdemux_was_interrupted(PT_NEXT_ENTRY);
         goto goto_next_file;
@@ -3269,7 +3669,8 @@ play_next_file:
         }
         goto goto_next_file;
     }
-    mpctx->stream->start_pos += seek_to_byte;
+    if (!preopened)
+        mpctx->stream->start_pos += seek_to_byte;
 
     if (stream_dump_type == 5) {
         unsigned char buf[4096];
@@ -3361,9 +3762,17 @@ play_next_file:
     }
 #endif
 
+    // -loop 1 plays the file once
+    if (loop_ram_mb > 0 && !preopened &&
+        (mpctx->loop_times == 0 || mpctx->loop_times > 1)) {
+        current_module = "loop_ram";
+        if (stream_load_to_ram(mpctx->stream, (int64_t)loop_ram_mb << 20))
+            mp_msg(MSGT_CPLAYER, MSGL_V, "Looping %s from memory.\n", filename);
+    }
+
 // CACHE2: initial prefill: 20%  later: 5%  (should be set by -cacheopts)
 goto_enable_cache:
-    if (stream_cache_size > 0) {
+    if (stream_cache_size > 0 && !preopened) {
         int res;
         current_module = "enable_cache";
         res = stream_enable_cache(mpctx->stream, stream_cache_size * 1024ull,
@@ -3377,7 +3786,9 @@ goto_enable_cache:
 //============ Open DEMUXERS --- DETECT file type =======================
     current_module = "demux_open";
 
-    mpctx->demuxer = demux_open(mpctx->stream, mpctx->file_format, audio_id, video_id, dvdsub_id, filename);
+    if (!preopened)
+        mpctx->demuxer = demux_open(mpctx->stream, mpctx->file_format, audio_id, video_id, dvdsub_id, filename);
+    preopened = 0;
 
     // HACK to get MOV Reference Files working
     if (mpctx->demuxer && mpctx->demuxer->type == DEMUXER_TYPE_PLAYLIST) {
@@ -3682,6 +4093,8 @@ goto_enable_cache:
             //mpctx->d_video->id = -2;
             //if(!fixed_vo) uninit_player(INITIALIZED_VO);
         }
+        // outputs kept from the last file that this one does not use
+        drop_kept_outputs(INITIALIZED_AO | (fixed_vo ? 0 : INITIALIZED_VO));
 
         if (!mpctx->sh_video && !mpctx->sh_audio)
             goto goto_next_file;
@@ -3716,6 +4129,14 @@ goto_enable_cache:
             mpctx->loop_times = -1;
 
         mp_msg(MSGT_CPLAYER, MSGL_INFO, MSGTR_StartPlaying);
+        mp_property_changed(MP_CHANGE_FILE);
+        preopen_tried = 0;
+
+        if (frame_cache_mb > 0 && !mpctx->frame_cache)
+            mpctx->frame_cache = frame_cache_new(frame_cache_mb);
+        if (mpctx->frame_cache)
+            frame_cache_clear(mpctx->frame_cache);
+        mpctx->frame_cache_pos = -1;
 
         total_time_usage_start = GetTimer();
         audio_time_usage       = 0;
@@ -3723,6 +4144,7 @@ goto_enable_cache:
         vout_time_usage = 0;
         total_frame_cnt = 0;
         drop_frame_cnt  = 0;         // fix for multifile fps benchmark
+        memset(&mpctx->jitter, 0, sizeof(mpctx->jitter));
         play_n_frames   = play_n_frames_mf;
         mpctx->startup_decode_retry = DEFAULT_STARTUP_DECODE_RETRY;
 
@@ -3770,7 +4192,9 @@ goto_enable_cache:
 
 /*========================== PLAY AUDIO ============================*/
 
-            if (mpctx->sh_audio)
+            // during an exact seek the audio before the target is dropped
+            // once the video got there, nothing may reach the ao until then
+            if (mpctx->sh_audio && mpctx->hr_seek_pts == MP_NOPTS_VALUE)
                 if (!fill_audio_out_buffers())
                     // at eof, all audio at least written to ao
                     if (!mpctx->sh_video)
@@ -3870,6 +4294,8 @@ goto_enable_cache:
                     if (!frame_time_remaining && blit_frame) {
                         unsigned int t2 = GetTimer();
 
+                        if (!skip_timing)
+                            frame_jitter_add(&mpctx->jitter, GetTimerUS() - mpctx->frame_deadline);
                         if (vo_config_count)
                             mpctx->video_out->flip_page();
                         mpctx->num_buffered_frames--;
@@ -3960,6 +4386,7 @@ goto_enable_cache:
             }
 
             edl_update(mpctx);
+            preopen_next_file();
 
 //================= Keyboard events, SEEKing ====================
 
@@ -4021,6 +4448,9 @@ goto_enable_cache:
                 edl_decision  = 0;
             }
 
+            // slave mode property change events
+            mp_property_notify(mpctx);
+
 #ifdef CONFIG_GUI
             if (use_gui) {
                 if (mpctx->demuxer->file_format == DEMUXER_TYPE_AVI && mpctx->sh_video && mpctx->sh_video->video.dwLength > 2) {
@@ -4092,10 +4522,20 @@ goto_next_file:  // don't jump here after ao/vo/getch initialization!
                    100 * drop_frame_cnt / total_frame_cnt,
                    total_frame_cnt,
                    (total_time_usage > 0.5) ? (total_frame_cnt / total_time_usage) : 0);
+        if (mpctx->jitter.count) {
+            char buf[256];
+            frame_jitter_print(&mpctx->jitter, buf, sizeof(buf));
+            mp_msg(MSGT_CPLAYER, MSGL_INFO, "BENCHMARKj: %s\n", buf);
+        }
     }
 
+    // the outputs go on with the next file if it was opened ahead
+    gapless_kept = 0;
+    if ((mpctx->eof == 1 || mpctx->eof == PT_NEXT_ENTRY) && preopen_filename())
+        gapless_kept = initialized_flags & (INITIALIZED_AO | INITIALIZED_VO);
+
     // time to uninit all, except global stuff:
-    uninit_player(INITIALIZED_ALL - (INITIALIZED_GUI + INITIALIZED_INPUT + (fixed_vo ? INITIALIZED_VO : 0)));
+    uninit_player(INITIALIZED_ALL - (INITIALIZED_GUI + INITIALIZED_INPUT + (fixed_vo ? INITIALIZED_VO : 0) + gapless_kept));
 
     if (mpctx->eof == PT_NEXT_ENTRY || mpctx->eof == PT_PREV_ENTRY) {
         mpctx->eof = mpctx->eof == PT_NEXT_ENTRY ? 1 : -1;
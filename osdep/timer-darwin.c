@@ -52,6 +52,17 @@ int usec_sleep(int usec_delay)
 }
 
 
+/* current time in microseconds, 64 bit */
+int64_t GetTimerUS(void)
+{
+  return mach_absolute_time() * timebase_ratio * 1e6;
+}
+
+void sleep_until(int64_t deadline)
+{
+  mach_wait_until((deadline * 1e-6) / timebase_ratio);
+}
+
 /* current time in microseconds */
 unsigned int GetTimer(void)
 {
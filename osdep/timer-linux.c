@@ -21,13 +21,16 @@
 
 #include <unistd.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <time.h>
 #include <sys/time.h>
 #include "config.h"
 #include "timer.h"
 
 const char timer_name[] =
-#ifdef HAVE_NANOSLEEP
+#if defined(HAVE_CLOCK_GETTIME) && defined(TIMER_ABSTIME)
+    "clock_nanosleep()";
+#elif defined(HAVE_NANOSLEEP)
     "nanosleep()";
 #else
     "usleep()";
@@ -45,24 +48,48 @@ int usec_sleep(int usec_delay)
 #endif
 }
 
+// Returns current time in microseconds, not affected by changes of the
+// system time if CLOCK_MONOTONIC is available
+int64_t GetTimerUS(void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+    if (!clock_gettime(CLOCK_MONOTONIC, &ts))
+        return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+}
+
+void sleep_until(int64_t deadline)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(TIMER_ABSTIME)
+    // an absolute wakeup does not add the time until the call to the delay
+    struct timespec ts;
+    ts.tv_sec  =  deadline / 1000000;
+    ts.tv_nsec = (deadline % 1000000) * 1000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+#else
+    int64_t left = deadline - GetTimerUS();
+    if (left > 0)
+        usec_sleep(left);
+#endif
+}
+
 // Returns current time in microseconds
 unsigned int GetTimer(void)
 {
-    struct timeval tv;
-    //float s;
-    gettimeofday(&tv,NULL);
-    //s = tv.tv_usec; s *= 0.000001; s += tv.tv_sec;
-    return tv.tv_sec * 1000000 + tv.tv_usec;
+    return GetTimerUS();
 }
 
 // Returns current time in milliseconds
 unsigned int GetTimerMS(void)
 {
-    struct timeval tv;
-    //float s;
-    gettimeofday(&tv,NULL);
-    //s = tv.tv_usec; s *= 0.000001; s += tv.tv_sec;
-    return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    return GetTimerUS() / 1000;
 }
 
 static unsigned int RelativeTime = 0;
@@ -36,6 +36,18 @@ unsigned int GetTimerMS(void)
   return timeGetTime() ;
 }
 
+int64_t GetTimerUS(void)
+{
+  return (int64_t)timeGetTime() * 1000;
+}
+
+void sleep_until(int64_t deadline)
+{
+  int64_t left = deadline - GetTimerUS();
+  if (left > 0)
+    usec_sleep(left);
+}
+
 int usec_sleep(int usec_delay){
   // Sleep(0) won't sleep for one clocktick as the unix usleep
   // instead it will only make the thread ready
@@ -19,14 +19,20 @@
 #ifndef MPLAYER_TIMER_H
 #define MPLAYER_TIMER_H
 
+#include <stdint.h>
+
 extern const char timer_name[];
 
 void InitTimer(void);
 unsigned int GetTimer(void);
 unsigned int GetTimerMS(void);
 float GetRelativeTime(void);
+/// current time in microseconds, monotonic where the system allows
+int64_t GetTimerUS(void);
 
 int usec_sleep(int usec_delay);
+/// sleep until GetTimerUS() reaches deadline, not limited by the sleep granularity
+void sleep_until(int64_t deadline);
 
 /* timer's callback handling */
 typedef void timer_callback( void );
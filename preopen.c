@@ -0,0 +1,170 @@
+/*
+ * background open of the next file for gapless transitions
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "config.h"
+#include "mp_msg.h"
+#include "mpcommon.h"
+#include "osdep/timer.h"
+#include "preopen.h"
+
+/* The thread owns stream and demuxer until it has been joined, the main
+   loop only looks at them after preopen_take() or preopen_cancel(). */
+
+static pthread_t thread, main_thread;
+static int started;
+static volatile int cancel;
+static char *file;
+static int file_aid, file_vid, file_sid;
+static int start_opts;          ///< opened under options of a file alone
+static stream_t *stream;
+static demuxer_t *demuxer;
+static int format;
+static int mp3_audio;
+
+/// only plain files and network streams, devices are opened once
+static int stream_type_ok(int type)
+{
+    return type == STREAMTYPE_FILE || type == STREAMTYPE_STREAM ||
+           type == STREAMTYPE_SMB;
+}
+
+static void close_file(void)
+{
+    if (demuxer)
+        free_demuxer(demuxer);
+    if (stream)
+        free_stream(stream);
+    demuxer = NULL;
+    stream  = NULL;
+}
+
+static void *open_file(void *arg)
+{
+    stream = open_stream(file, 0, &format);
+    if (!stream || cancel || format == DEMUXER_TYPE_PLAYLIST ||
+        !stream_type_ok(stream->type))
+        goto fail;
+    if (stream_cache_size > 0 &&
+        !stream_enable_cache(stream, stream_cache_size * 1024ull,
+                             stream_cache_size * 1024ull * (stream_cache_min_percent / 100.0),
+                             stream_cache_size * 1024ull * (stream_cache_seek_min_percent / 100.0)))
+        goto fail;
+    if (cancel)
+        goto fail;
+    // correct_pts and hr_mp3_seek are left to preopen_take()
+    demuxer = demux_open_detached(stream, format, file_aid, file_vid,
+                                  file_sid, file, &mp3_audio);
+    if (!demuxer || demuxer->type == DEMUXER_TYPE_PLAYLIST || cancel)
+        goto fail;
+    // the first packets, decoding can start right away
+    if (demuxer->video->sh)
+        ds_fill_buffer(demuxer->video);
+    if (demuxer->audio->sh)
+        ds_fill_buffer(demuxer->audio);
+    return NULL;
+
+fail:
+    close_file();
+    return NULL;
+}
+
+int preopen_start(const char *filename, int aid, int vid, int sid,
+                  int file_opts)
+{
+    if (started || !(file = strdup(filename)))
+        return 0;
+    file_aid = aid;
+    file_vid = vid;
+    file_sid = sid;
+    start_opts = file_opts;
+    cancel   = 0;
+    mp3_audio = 0;
+    // set before the thread can ask for preopen_in_thread()
+    main_thread = pthread_self();
+    started     = 1;
+    if (pthread_create(&thread, NULL, open_file, NULL)) {
+        started = 0;
+        free(file);
+        file = NULL;
+        return 0;
+    }
+    mp_msg(MSGT_CPLAYER, MSGL_V, "Opening %s in the background.\n", file);
+    return 1;
+}
+
+const char *preopen_filename(void)
+{
+    return started ? file : NULL;
+}
+
+static void finish(void)
+{
+    pthread_join(thread, NULL);
+    started = 0;
+    free(file);
+    file = NULL;
+}
+
+int preopen_take(const char *filename, int aid, int vid, int sid,
+                 int file_opts, stream_t **s, demuxer_t **d, int *file_format)
+{
+    if (!started)
+        return 0;
+    if (!filename || strcmp(filename, file) || start_opts || file_opts ||
+        aid != file_aid || vid != file_vid || sid != file_sid) {
+        preopen_cancel();
+        return 0;
+    }
+    finish();
+    if (!demuxer)
+        return 0;
+    demux_apply_settings(demuxer, mp3_audio);
+    *s           = stream;
+    *d           = demuxer;
+    *file_format = format;
+    stream  = NULL;
+    demuxer = NULL;
+    return 1;
+}
+
+void preopen_cancel(void)
+{
+    if (!started)
+        return;
+    cancel = 1;
+    finish();
+    close_file();
+}
+
+int preopen_in_thread(void)
+{
+    return started && !pthread_equal(pthread_self(), main_thread);
+}
+
+int preopen_check_interrupt(int time)
+{
+    if (!cancel)
+        usec_sleep(time * 1000);
+    return cancel;
+}
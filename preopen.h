@@ -0,0 +1,76 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_PREOPEN_H
+#define MPLAYER_PREOPEN_H
+
+#include "config.h"
+#include "stream/stream.h"
+#include "libmpdemux/demuxer.h"
+
+#if HAVE_PTHREADS
+/**
+ * \brief open the stream and demuxer of a file from a thread
+ *
+ * The thread opens the stream, enables the cache, probes the demuxer with
+ * the stream ids given and reads the first packets, as the player would
+ * when it reaches the file. Only one file is opened at a time.
+ * \param file_opts nonzero if options of the playing file alone are in effect
+ * \return 0 if the thread could not be started or another file is open
+ */
+int preopen_start(const char *filename, int aid, int vid, int sid,
+                  int file_opts);
+
+/// \return the file being or already opened, NULL if none
+const char *preopen_filename(void);
+
+/**
+ * \brief wait for the open of filename and take over its stream and demuxer
+ *
+ * A file opened with other stream ids or that the thread left alone
+ * (playlists, discs, errors) is closed, as is one opened while either file
+ * had options of its own.
+ * \param file_opts nonzero if options of filename alone are in effect
+ * \return 1 if *stream, *demuxer and *file_format were set
+ */
+int preopen_take(const char *filename, int aid, int vid, int sid,
+                 int file_opts, stream_t **stream, demuxer_t **demuxer, int *file_format);
+
+/// stop the thread and close what it opened
+void preopen_cancel(void);
+
+/// \return 1 if called from the open thread
+int preopen_in_thread(void);
+
+/**
+ * \brief stream interrupt check for the open thread
+ *
+ * Sleeps up to time ms, user input is left to the main loop.
+ * \return 1 if the open is cancelled
+ */
+int preopen_check_interrupt(int time);
+#else
+#define preopen_start(filename, aid, vid, sid, file_opts) 0
+#define preopen_filename() NULL
+#define preopen_take(filename, aid, vid, sid, file_opts, stream, demuxer, file_format) 0
+#define preopen_cancel() ((void)0)
+#define preopen_in_thread() 0
+#define preopen_check_interrupt(time) 0
+#endif
+
+#endif /* MPLAYER_PREOPEN_H */
@@ -17,6 +17,7 @@
  */
 
 #include <ctype.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -517,6 +518,86 @@ stream_t* new_memory_stream(unsigned char* data,int len){
   return s;
 }
 
+struct ram_priv {
+  unsigned char *data;
+  int64_t size;
+};
+
+static int ram_fill_buffer(stream_t *s, char *buffer, int max_len){
+  struct ram_priv *p = s->priv;
+  int64_t left = p->size - s->pos;
+  if(left <= 0){
+    s->eof = 1;
+    return -1;
+  }
+  if(max_len > left) max_len = left;
+  memcpy(buffer, p->data + s->pos, max_len);
+  return max_len;
+}
+
+static int ram_seek(stream_t *s, int64_t newpos){
+  struct ram_priv *p = s->priv;
+  if(newpos < 0 || newpos > p->size){
+    s->eof = 1;
+    return 0;
+  }
+  s->pos = newpos;
+  return 1;
+}
+
+static int ram_control(stream_t *s, int cmd, void *arg){
+  struct ram_priv *p = s->priv;
+  if(cmd == STREAM_CTRL_GET_SIZE){
+    *(uint64_t*)arg = p->size;
+    return 1;
+  }
+  return STREAM_UNSUPPORTED;
+}
+
+static void ram_close(stream_t *s){
+  struct ram_priv *p = s->priv;
+  free(p->data);
+  free(p);
+}
+
+int stream_load_to_ram(stream_t *s, int64_t max_size){
+  struct ram_priv *p;
+  int64_t pos = stream_tell(s);
+  int64_t size = s->end_pos;
+
+  if(s->type != STREAMTYPE_FILE || !s->seek || s->close || s->cache_pid ||
+     size <= 0 || size > max_size || size > INT_MAX)
+    return 0;
+  p = calloc(1, sizeof(*p));
+  if(!p || !(p->data = malloc(size))){
+    free(p);
+    return 0;
+  }
+  p->size = size;
+  if(!stream_seek(s, 0) || stream_read(s, p->data, size) != size){
+    free(p->data);
+    free(p);
+    stream_reset(s);
+    stream_seek(s, pos);
+    return 0;
+  }
+  // the file is not needed anymore, serve the same bytes from memory
+  if(s->fd > 0) close(s->fd);
+  s->fd = -1;
+  s->priv = p;
+  s->fill_buffer = ram_fill_buffer;
+  s->write_buffer = NULL;
+  s->seek = ram_seek;
+  s->control = ram_control;
+  s->close = ram_close;
+  s->flags |= STREAM_NON_CACHEABLE;
+  s->buf_pos = s->buf_len = 0;
+  s->eof = 0;
+  stream_seek(s, pos);
+  mp_msg(MSGT_STREAM, MSGL_V, "Stream of %"PRId64" bytes loaded into memory.\n", size);
+  return 1;
+}
+
 stream_t* new_stream(int fd,int type){
   stream_t *s=calloc(1, sizeof(stream_t));
   if(s==NULL) return NULL;
@@ -363,6 +363,14 @@ int stream_control(stream_t *s, int cmd, void *arg);
 stream_t* new_stream(int fd,int type);
 void free_stream(stream_t *s);
 stream_t* new_memory_stream(unsigned char* data,int len);
+/**
+ * \brief read a seekable file of at most max_size bytes into memory
+ *
+ * The stream keeps its position and reads and seeks from the copy
+ * afterwards, the file is closed.
+ * \return 1 if the stream now reads from memory
+ */
+int stream_load_to_ram(stream_t *s, int64_t max_size);
 stream_t* open_stream(const char* filename,char** options,int* file_format);
 stream_t* open_stream_full(const char* filename,int mode, char** options, int* file_format);
 stream_t* open_output_stream(const char* filename,char** options);